@@ -0,0 +1,27 @@
+#include "tagging_plugin.hpp"
+
+#include <TelepathyQt/Constants>
+
+QString TaggingPlugin::name() const {
+    return "tagging";
+}
+
+Tp::RequestableChannelClassList TaggingPlugin::requestableChannelClasses() const {
+
+    Tp::RequestableChannelClass textChat;
+    textChat.fixedProperties[QString(TP_QT_IFACE_CHANNEL) + ".ChannelType"] = TP_QT_IFACE_CHANNEL_TYPE_TEXT;
+    textChat.fixedProperties[QString(TP_QT_IFACE_CHANNEL) + ".TargetHandleType"] = uint(Tp::HandleTypeContact);
+    textChat.allowedProperties << QString(TP_QT_IFACE_CHANNEL) + ".TargetHandle"
+        << QString(TP_QT_IFACE_CHANNEL) + ".TargetID";
+
+    return Tp::RequestableChannelClassList() << textChat;
+}
+
+void TaggingPlugin::transformIncoming(Tp::MessagePartList &message) {
+    if(!message.isEmpty()) 
+        message.first().insert(QLatin1String("x-pipe-tag"), QDBusVariant(name()));
+}
+
+void TaggingPlugin::transformOutgoing(Tp::MessagePartList &/* message */) {
+    // outgoing messages are left untouched
+}
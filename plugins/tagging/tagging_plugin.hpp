@@ -0,0 +1,24 @@
+#ifndef TAGGING_PLUGIN_HPP
+#define TAGGING_PLUGIN_HPP
+
+#include <QObject>
+
+#include "pipe_plugin.hpp"
+
+/**
+ * Sample pipe plugin marking every received message with a header field
+ */
+class TaggingPlugin : public QObject, public PipePlugin {
+
+    Q_OBJECT;
+    Q_PLUGIN_METADATA(IID PipePlugin_iid)
+    Q_INTERFACES(PipePlugin)
+
+    public:
+        virtual QString name() const override;
+        virtual Tp::RequestableChannelClassList requestableChannelClasses() const override;
+        virtual void transformIncoming(Tp::MessagePartList &message) override;
+        virtual void transformOutgoing(Tp::MessagePartList &message) override;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "channel_class_matcher.hpp"
+
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/RequestableChannelClassSpecList>
+
+ChannelClassMatcher::ChannelClassMatcher(const Tp::RequestableChannelClassList &classes) 
+    : reqChanClasses(classes)
+{
+    const QString channelTypeProp = QString(TP_QT_IFACE_CHANNEL) + QString(".ChannelType");
+    for(const Tp::RequestableChannelClass &cc: classes) {
+        QVariantMap fixed = cc.fixedProperties;
+        QString channelType = fixed.take(channelTypeProp).toString();
+        predicates[channelType].append(fixed);
+    }
+}
+
+bool ChannelClassMatcher::matchesChannelType(const QString &channelType) const {
+    return predicates.contains(channelType);
+}
+
+bool ChannelClassMatcher::matches(const QString &channelType, const QVariantMap &properties) const {
+
+    auto predIt = predicates.constFind(channelType);
+    if(predIt == predicates.constEnd()) return false;
+
+    for(const QVariantMap &fixed: *predIt) {
+        bool matched = true;
+        for(auto it = fixed.constBegin(); it != fixed.constEnd() && matched; ++it) {
+            auto propIt = properties.constFind(it.key());
+            matched = propIt != properties.constEnd() && *propIt == it.value();
+        }
+        if(matched) return true;
+    }
+    return false;
+}
+
+Tp::ChannelClassSpecList ChannelClassMatcher::channelFilter() const {
+
+    Tp::ChannelClassSpecList channelFilter;
+    Tp::RequestableChannelClassSpecList specList(reqChanClasses);
+    for(auto &reqChanSpec: specList) {
+        channelFilter << Tp::ChannelClassSpec(
+            reqChanSpec.channelType(), 
+            reqChanSpec.targetHandleType(),
+            reqChanSpec.fixedProperties());
+    }
+    return channelFilter;
+}
+
+Tp::RequestableChannelClassList ChannelClassMatcher::classes() const {
+    return reqChanClasses;
+}
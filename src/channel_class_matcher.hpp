@@ -0,0 +1,43 @@
+#ifndef PIPE_CHANNEL_CLASS_MATCHER_HPP
+#define PIPE_CHANNEL_CLASS_MATCHER_HPP
+
+#include <TelepathyQt/Types>
+#include <TelepathyQt/ChannelClassSpecList>
+#include <QHash>
+#include <QList>
+#include <QString>
+
+/**
+ * Requestable channel classes compiled for checking channels: channel types are kept in a hash
+ * together with remaining fixed properties each channel of given type has to match
+ */
+class ChannelClassMatcher {
+
+    public:
+        ChannelClassMatcher() = default;
+        explicit ChannelClassMatcher(const Tp::RequestableChannelClassList &classes);
+
+        /**
+         * @return true if there is a class with given channel type
+         */
+        bool matchesChannelType(const QString &channelType) const;
+
+        /**
+         * @param properties channel properties with fully qualified names
+         * @return true if all fixed properties of at least one class with given type are matched
+         */
+        bool matches(const QString &channelType, const QVariantMap &properties) const;
+
+        /**
+         * @return filter for clients interested in matching channels
+         */
+        Tp::ChannelClassSpecList channelFilter() const;
+
+        Tp::RequestableChannelClassList classes() const;
+
+    private:
+        Tp::RequestableChannelClassList reqChanClasses;
+        QHash<QString, QList<QVariantMap>> predicates;
+};
+
+#endif
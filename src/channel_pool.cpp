@@ -0,0 +1,123 @@
+#include "channel_pool.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    const double ACTIVITY_HALF_LIFE = 10 * 60 * 1000; // ms
+    // activities with lower score are forgotten
+    const double MIN_SCORE = 0.01;
+
+} /* anonymous namespace */
+
+PipeChannelPool::PipeChannelPool(const ChannelFactory &factory, int capacity, int idleTimeout, QObject *parent)
+    : QObject(parent), factory(factory), capacity(capacity), idleTimeout(idleTimeout)
+{
+    clock.start();
+
+    expireTimer.setInterval(std::max(1000, idleTimeout / 2));
+    connect(&expireTimer, &QTimer::timeout, this, &PipeChannelPool::expire);
+    expireTimer.start();
+}
+
+double PipeChannelPool::currentScore(uint handle) const {
+
+    auto it = activities.constFind(handle);
+    if(it == activities.constEnd()) return 0;
+    return it->score * std::exp2(-(clock.elapsed() - it->updated) / ACTIVITY_HALF_LIFE);
+}
+
+void PipeChannelPool::recordActivity(uint handle, double weight) {
+
+    double score = currentScore(handle) + weight;
+    activities[handle] = { score, clock.elapsed() };
+    if(!pool.contains(handle)) scheduleRefill();
+}
+
+Tp::BaseChannelPtr PipeChannelPool::take(uint handle) {
+
+    auto it = pool.find(handle);
+    if(it == pool.end()) return Tp::BaseChannelPtr();
+
+    Tp::BaseChannelPtr channel = it->channel;
+    pool.erase(it);
+    order.removeOne(handle);
+    QObject::disconnect(channel.data(), nullptr, this, nullptr);
+    pDebug() << "Taking pre-piped channel for handle: " << handle;
+
+    scheduleRefill();
+    return channel;
+}
+
+void PipeChannelPool::scheduleRefill() {
+
+    if(refillScheduled) return;
+    refillScheduled = true;
+    QTimer::singleShot(0, this, [this]() {
+            refillScheduled = false;
+            refill();
+        });
+}
+
+void PipeChannelPool::refill() {
+
+    // the most active contact without a pooled channel
+    uint candidate = 0;
+    double candidateScore = 0;
+    for(auto it = activities.constBegin(); it != activities.constEnd(); ++it) {
+        double score = currentScore(it.key());
+        if(pool.contains(it.key()) || score <= failed.value(it.key(), 0)) continue;
+        if(score > candidateScore) {
+            candidate = it.key();
+            candidateScore = score;
+        }
+    }
+    if(candidateScore < MIN_SCORE) return;
+
+    if(pool.size() >= capacity) {
+        uint victim = order.first();
+        if(currentScore(victim) >= candidateScore) return;
+        pDebug() << "Dropping pre-piped channel for handle: " << victim;
+        take(victim);
+    }
+
+    Tp::BaseChannelPtr channel = factory(candidate);
+    if(!channel) {
+        pWarning() << "Could not pre-pipe channel for handle: " << candidate;
+        failed[candidate] = candidateScore;
+        return;
+    }
+    failed.remove(candidate);
+
+    pDebug() << "Pre-piped channel for handle: " << candidate;
+    pool[candidate] = { channel, clock.elapsed() };
+    order.append(candidate);
+    connect(channel.data(), &Tp::BaseChannel::closed, this, [this, candidate]() { take(candidate); });
+
+    // more channels may be needed
+    scheduleRefill();
+}
+
+void PipeChannelPool::expire() {
+
+    qint64 now = clock.elapsed();
+    for(uint handle: QList<uint>(order)) {
+        if(now - pool.value(handle).pooled >= idleTimeout) {
+            pDebug() << "Pre-piped channel for handle: " << handle << " expired";
+            take(handle);
+            // activity which got the channel pooled is spent
+            activities.remove(handle);
+        }
+    }
+
+    for(auto it = activities.begin(); it != activities.end();) {
+        if(currentScore(it.key()) < MIN_SCORE) {
+            failed.remove(it.key());
+            it = activities.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
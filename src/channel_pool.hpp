@@ -0,0 +1,75 @@
+#ifndef PIPE_CHANNEL_POOL_HPP
+#define PIPE_CHANNEL_POOL_HPP
+
+#include <TelepathyQt/BaseChannel>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QTimer>
+#include <functional>
+
+/**
+ * Pool of text channels piped in advance for contacts with the highest activity, so they can be
+ * handed to clients without waiting for the pipes. Activity of a contact is a score which halves 
+ * every ACTIVITY_HALF_LIFE, at most one channel is piped per event loop iteration. Channels which
+ * are not taken within idle timeout are dropped, when pool is full the least recently pooled 
+ * channel gives place to a contact with higher score.
+ */
+class PipeChannelPool : public QObject {
+
+    public:
+        /**
+         * Pipes text channel for contact, returns null channel if it fails
+         */
+        typedef std::function<Tp::BaseChannelPtr (uint targetHandle)> ChannelFactory;
+
+        /**
+         * @param capacity maximal number of pooled channels
+         * @param idleTimeout time in ms after which not taken channels are dropped
+         */
+        PipeChannelPool(const ChannelFactory &factory, int capacity, int idleTimeout, QObject *parent = nullptr);
+
+        /**
+         * Increases activity score of contact
+         */
+        void recordActivity(uint handle, double weight);
+
+        /**
+         * Removes channel of contact from the pool
+         * @return pooled channel or null channel if there is none
+         */
+        Tp::BaseChannelPtr take(uint handle);
+
+    private:
+        struct Activity {
+            double score;
+            qint64 updated;
+        };
+
+        struct Entry {
+            Tp::BaseChannelPtr channel;
+            qint64 pooled;
+        };
+
+        double currentScore(uint handle) const;
+        void scheduleRefill();
+        void refill();
+        void expire();
+
+    private:
+        ChannelFactory factory;
+        int capacity;
+        int idleTimeout;
+        QElapsedTimer clock;
+        QHash<uint, Activity> activities;
+        QHash<uint, Entry> pool;
+        // pooled handles from the least recently pooled
+        QList<uint> order;
+        // contacts for which piping failed are not retried until their score grows again
+        QHash<uint, double> failed;
+        bool refillScheduled = false;
+        QTimer expireTimer;
+};
+
+#endif
@@ -3,25 +3,35 @@
 #include "utils.hpp"
 #include "simple_presence.hpp"
 #include "proxy_channel.hpp"
+#include "single_flight.hpp"
 
 #include <TelepathyQt/PendingVariant>
 #include <TelepathyQt/PendingReady>
 #include <TelepathyQt/Connection>
 #include <TelepathyQt/ChannelFactory>
 #include <TelepathyQt/ContactFactory>
-#include <future>
+#include <QDBusPendingCallWatcher>
+#include <QElapsedTimer>
 #include <QEventLoop>
 
+namespace {
+
+    // weights of contact activities for channel pre-piping
+    const double OPEN_ACTIVITY = 1.0;
+    const double PRESENCE_ACTIVITY = 0.25;
+
+} /* anonymous namespace */
+
 PipeConnection::PipeConnection(
         const Tp::ConnectionPtr &pipedConnection,
-        const PipePtr &pipe,
+        const PipeChain &pipes,
         const QDBusConnection &dbusConnection,
         const QString &cmName,
         const QString &protocolName,
         const QVariantMap &parameters,
         const ConnectionAdditionalData& additionalData) 
     : Tp::BaseConnection(dbusConnection, cmName, protocolName, parameters),
-    pipedConnection(pipedConnection), pipe(pipe)
+    pipedConnection(pipedConnection), pipe(pipes.front()), pipes(pipes)
 {
 
     pDebug() << "PipeConnection::PipeConnection: " << pipedConnection->objectPath();
@@ -79,8 +89,34 @@ PipeConnection::PipeConnection(
 
     }
 
-    if(contactListPtr != nullptr && simplePresencePtr != nullptr) 
-        simplePresencePtr->setContactList(contactListPtr.get());
+    if(contactListPtr != nullptr) {
+        if(simplePresencePtr != nullptr) 
+            simplePresencePtr->setContactList(contactListPtr.get(), additionalData.contactListFileName);
+        // restored from snapshot at once, piped list is fetched without blocking
+        contactListPtr->loadContactList();
+    }
+
+    if(additionalData.prePipePoolSize > 0 && this->interface(TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS))
+        addChannelPool(additionalData.prePipePoolSize, additionalData.prePipeIdleTimeout);
+
+    sendScheduler = std::make_shared<PipeSendScheduler>(
+            additionalData.interactiveSendWeight, additionalData.bulkSendWeight, additionalData.bulkSendRate);
+
+    if(additionalData.channelMemoryBudget > 0) {
+        idleChannelManager.reset(new PipeIdleChannelManager(
+                    pipedConnection->dbusConnection(),
+                    size_t(additionalData.channelMemoryBudget) * 1024, 
+                    qint64(additionalData.channelIdleTimeout) * 1000,
+                    [this](const QString &channelType, uint targetHandleType, uint targetHandle) {
+                        Tp::DBusError error;
+                        openChannel(channelType, targetHandleType, targetHandle, targetHandle, false, &error);
+                        if(error.isValid()) 
+                            pWarning() << "Could not pipe again channel: " << error.name() << " -> " << error.message();
+                    }));
+    }
+
+    // has to be connected before connection manager forgets this connection
+    connect(this, &Tp::BaseConnection::disconnected, this, &PipeConnection::closeProxyChannels);
 
     // lets set status to piped status
     setStatus(pipedConnection->status(), Tp::ConnectionStatusReasonNoneSpecified); 
@@ -125,18 +161,6 @@ void PipeConnection::addContactListInterface(const QString& contactListFilename,
     ContactList *pipedList = pipedConnection->interface<ContactList>();
 
     contactListPtr.reset(new PipeContactList(pipedList, contactListIface, contactListFilename, interfaces));
-    // obtain contact list asynchronously
-    std::async(std::launch::async, 
-            [this, contactListIface] {
-                try {
-                    this->contactListPtr->loadContactList();
-                    setStatus(pipedConnection->status(), Tp::ConnectionStatusReasonNoneSpecified);
-                } catch(PipeException<ContactListError> &e) { // it failed set it from here
-                    contactListIface->setContactListState(Tp::ContactListStateFailure);
-                    pWarning() << "Could not load contact list for connection: " << this->objectPath()
-                        << " because of: " << e.what();
-                }
-            });
 
     plugInterface(Tp::AbstractConnectionInterfacePtr::dynamicCast(contactListIface));
 }
@@ -164,13 +188,45 @@ void PipeConnection::addAdressingInterface() {
 
 void PipeConnection::addRequestsInterface() {
 
-    Tp::BaseConnectionRequestsInterfacePtr requestsIface = Tp::BaseConnectionRequestsInterface::create(this);
-    requestsIface->requestableChannelClasses << pipe->requestableChannelClasses(); 
+    requestsIface = PipeConnectionRequestsInterfacePtr(new PipeConnectionRequestsInterface(this, pipe->matcher().classes()));
     plugInterface(Tp::AbstractConnectionInterfacePtr::dynamicCast(requestsIface));
 }
 
+void PipeConnection::addChannelPool(uint poolSize, uint idleTimeout) {
+
+    QVariantMap textToContact;
+    textToContact[TP_QT_IFACE_CHANNEL + QString(".ChannelType")] = TP_QT_IFACE_CHANNEL_TYPE_TEXT;
+    textToContact[TP_QT_IFACE_CHANNEL + QString(".TargetHandleType")] = uint(Tp::HandleTypeContact);
+    if(!pipe->matcher().matches(TP_QT_IFACE_CHANNEL_TYPE_TEXT, textToContact)) return;
+
+    pDebug() << "Pre-piping up to " << poolSize << " text channels for connection: " << pipedConnection->objectPath();
+    channelPool.reset(new PipeChannelPool(
+            [this](uint targetHandle) {
+                if(!checkTargetHandle(Tp::HandleTypeContact, targetHandle)) return Tp::BaseChannelPtr();
+
+                // pooled channels are closed when they expire, so contacts with open channel are skipped
+                for(const Tp::ChannelDetails &details: channelsDetails()) {
+                    if(details.properties.value(TP_QT_IFACE_CHANNEL + QString(".ChannelType")).toString() == TP_QT_IFACE_CHANNEL_TYPE_TEXT
+                            && details.properties.value(TP_QT_IFACE_CHANNEL + QString(".TargetHandle")).toUInt() == targetHandle)
+                        return Tp::BaseChannelPtr();
+                }
+
+                Tp::DBusError error;
+                return createPipedChannel(TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeContact, targetHandle, &error);
+            },
+            poolSize, idleTimeout * 1000));
+
+    if(simplePresencePtr) {
+        simplePresencePtr->setActivityObserver([this](uint handle) { 
+                channelPool->recordActivity(handle, PRESENCE_ACTIVITY); 
+            });
+    }
+}
+
 QString PipeConnection::uniqueName() const {
-    return Tp::BaseConnection::uniqueName() + "_pipe_" + pipe->name();
+    QStringList names;
+    for(const PipePtr &chainedPipe: pipes) names << chainedPipe->name();
+    return Tp::BaseConnection::uniqueName() + "_pipe_" + names.join("_");
 }
 
 Tp::ConnectionPtr PipeConnection::getPipedConnection() const {
@@ -178,22 +234,17 @@ Tp::ConnectionPtr PipeConnection::getPipedConnection() const {
 }
 
 bool PipeConnection::checkChannelType(const QString &channelType) const {
-    Tp::RequestableChannelClassList reqChanList = pipe->requestableChannelClasses();
-    for(auto& cc: reqChanList) {
-        if(cc.fixedProperties["org.freedesktop.Telepathy.Channel.ChannelType"].toString() == channelType)
-            return true;
-    }
-    return false;
+    return pipe->matcher().matchesChannelType(channelType);
 }
 
 bool PipeConnection::checkHandleType(uint targetHandleType) const {
-    // check if channel is directed to one of piped contacts
-    // for now only simple contact interfaces are implemented
-    // TODO group interface
-    return targetHandleType == Tp::HandleTypeContact;
+    // channels directed to one of piped contacts or rooms
+    return targetHandleType == Tp::HandleTypeContact || targetHandleType == Tp::HandleTypeRoom;
 }
 
-bool PipeConnection::checkTargetHandle(uint targetHandle) const {
+bool PipeConnection::checkTargetHandle(uint targetHandleType, uint targetHandle) const {
+    // rooms are not part of contact list, all of them are piped if pipe accepts such channels
+    if(targetHandleType == Tp::HandleTypeRoom) return true;
     return (contactListPtr && contactListPtr->hasHandle(targetHandle));
 }
 
@@ -202,52 +253,121 @@ bool PipeConnection::checkChannel(const Tp::Channel &channel) const {
         << " handleType -> " << channel.targetHandleType()
         << " targetHandle -> " << channel.targetHandleType();
 
-    if(!checkChannelType(channel.channelType())) return false;
+    QVariantMap properties = channel.immutableProperties();
+    properties[QString(TP_QT_IFACE_CHANNEL) + QString(".ChannelType")] = channel.channelType();
+    properties[QString(TP_QT_IFACE_CHANNEL) + QString(".TargetHandleType")] = uint(channel.targetHandleType());
+    properties[QString(TP_QT_IFACE_CHANNEL) + QString(".TargetHandle")] = channel.targetHandle();
+
+    if(!pipe->matcher().matches(channel.channelType(), properties)) return false;
     if(!checkHandleType(channel.targetHandleType())) return false;
-    return checkTargetHandle(channel.targetHandle());
+    return checkTargetHandle(channel.targetHandleType(), channel.targetHandle());
 }
 
 Tp::BaseChannelPtr PipeConnection::pipeChannel(Tp::ChannelPtr channel, Tp::DBusError *error) {
 
-    QDBusPendingReply<QDBusObjectPath> pipeRep = pipe->createPipeChannel(QDBusObjectPath(channel->objectPath()));
-    pipeRep.waitForFinished();
-    if(pipeRep.isValid()) {
-        // getting object paths and bus names for connection and channel
-        QString chanObjectPath = pipeRep.value().path();
-        if(chanObjectPath.isEmpty()) {
-            error->set(TP_QT_ERROR_NOT_AVAILABLE, "Pipe did not return any channel");
+    // each pipe of the chain gets the channel returned by the previous one,
+    // only the channel returned by the last one is proxied
+    QString chanObjectPath = channel->objectPath();
+    PipeChain transforms;
+    for(const PipePtr &chainedPipe: pipes) {
+        // plugins and transforming pipes change messages of the proxied channel
+        if(chainedPipe->transformsMessages()) {
+            transforms.push_back(chainedPipe);
+            continue;
+        }
+        // optional property - pipes not implementing it are fully proxied
+        bool passThrough = chainedPipe->passThrough();
+
+        QDBusPendingReply<QDBusObjectPath> pipeRep = PipeSingleFlight::instance().call(
+                chainedPipe->service(), QString(), "CreatePipeChannel", chanObjectPath,
+                [&chainedPipe, &chanObjectPath]() -> QDBusPendingCall { 
+                    return chainedPipe->createPipeChannel(QDBusObjectPath(chanObjectPath)); 
+                });
+        pipeRep.waitForFinished();
+        if(!pipeRep.isValid()) {
+            pWarning() << "Invalid reply from pipe: " << pipeRep.error().name() << " -> " << pipeRep.error().message();
+            error->set(pipeRep.error().name(), pipeRep.error().message());
             return Tp::BaseChannelPtr();
         }
+        // pipe only observes the channel it was given, so messages are relayed
+        // without going through the pipe
+        if(passThrough) continue;
 
-        uint lastSlash = chanObjectPath.lastIndexOf('/');
-        QString conObjectPath = chanObjectPath.left(lastSlash);
-        QString conBusName = conObjectPath.right(conObjectPath.length()-1);
-        conBusName.replace("/", ".");
-        pDebug() << "PipeConnection::pipeChannel: Creating proxy channel channel for channel at: " << chanObjectPath
-            << " from connection: (" << conBusName << ", " << conObjectPath << ")";
-
-        Tp::ConnectionPtr pipedCon = Tp::Connection::create(
-                QDBusConnection::sessionBus(), 
-                conBusName, 
-                conObjectPath,
-                Tp::ChannelFactory::create(QDBusConnection::sessionBus()),
-                Tp::ContactFactory::create());
-
-        Tp::ChannelPtr pipedChannel = Tp::Channel::create(pipedCon, chanObjectPath, QVariantMap());
-        Tp::PendingReady *pendingReady = pipedChannel->becomeReady(Tp::Channel::FeatureCore);
-        { // wait for channel to become ready
-            QEventLoop loop;
-            QObject::connect(pendingReady, &Tp::PendingOperation::finished,
-                    &loop, &QEventLoop::quit);
-            loop.exec();
+        chanObjectPath = pipeRep.value().path();
+        if(chanObjectPath.isEmpty()) {
+            error->set(TP_QT_ERROR_NOT_AVAILABLE, "Pipe did not return any channel: " + chainedPipe->name());
+            return Tp::BaseChannelPtr();
         }
+    }
 
-        return Tp::BaseChannelPtr::dynamicCast(PipeProxyChannel::create(this, pipedChannel));
-    } else {
-        pWarning() << "Invalid reply from pipe: " << pipeRep.error().name() << " -> " << pipeRep.error().message();
-        error->set(pipeRep.error().name(), pipeRep.error().message());
-        return Tp::BaseChannelPtr();
+    if(chanObjectPath == channel->objectPath()) {
+        pDebug() << "PipeConnection::pipeChannel: Only pass-through and transforming pipes, creating proxy for: " << chanObjectPath;
+        return trackChannel(PipeProxyChannel::create(this, channel, transforms, sendScheduler));
+    }
+
+    // getting object paths and bus names for connection and channel
+    uint lastSlash = chanObjectPath.lastIndexOf('/');
+    QString conObjectPath = chanObjectPath.left(lastSlash);
+    QString conBusName = conObjectPath.right(conObjectPath.length()-1);
+    conBusName.replace("/", ".");
+    pDebug() << "PipeConnection::pipeChannel: Creating proxy channel channel for channel at: " << chanObjectPath
+        << " from connection: (" << conBusName << ", " << conObjectPath << ")";
+
+    Tp::ConnectionPtr pipedCon = Tp::Connection::create(
+            QDBusConnection::sessionBus(), 
+            conBusName, 
+            conObjectPath,
+            Tp::ChannelFactory::create(QDBusConnection::sessionBus()),
+            Tp::ContactFactory::create());
+
+    Tp::ChannelPtr pipedChannel = Tp::Channel::create(pipedCon, chanObjectPath, QVariantMap());
+    Tp::PendingReady *pendingReady = pipedChannel->becomeReady(Tp::Channel::FeatureCore);
+    { // wait for channel to become ready
+        QEventLoop loop;
+        QObject::connect(pendingReady, &Tp::PendingOperation::finished,
+                &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+
+    return trackChannel(PipeProxyChannel::create(this, pipedChannel, transforms, sendScheduler));
+}
+
+Tp::BaseChannelPtr PipeConnection::openChannel(const QString &channelType, uint targetHandleType, uint targetHandle, 
+        uint initiatorHandle, bool suppressHandler, Tp::DBusError *error)
+{
+    Tp::BaseChannelPtr channel = createChannel(
+            channelType, targetHandleType, targetHandle, initiatorHandle, suppressHandler, error);
+    if(!error->isValid() && requestsIface) requestsIface->announceChannel(channel);
+    return channel;
+}
+
+Tp::BaseChannelPtr PipeConnection::trackChannel(const PipeProxyChannelPtr &channel) {
+    proxyChannels.removeAll(QPointer<PipeProxyChannel>());
+    proxyChannels.append(QPointer<PipeProxyChannel>(channel.data()));
+    if(idleChannelManager) idleChannelManager->track(channel);
+    return Tp::BaseChannelPtr::dynamicCast(channel);
+}
+
+void PipeConnection::closeProxyChannels() {
+
+    QElapsedTimer teardownTimer;
+    teardownTimer.start();
+
+    // channels of disconnected piped connection are invalidated by it, closing them is useless
+    bool closePipedChannels = pipedConnection->isValid() 
+        && pipedConnection->status() != Tp::ConnectionStatus::ConnectionStatusDisconnected;
+
+    QList<QPointer<PipeProxyChannel>> closing;
+    closing.swap(proxyChannels);
+    int closed = 0;
+    for(const QPointer<PipeProxyChannel> &channel: closing) {
+        if(!channel) continue;
+        channel->release(closePipedChannels);
+        ++closed;
     }
+
+    pDebug() << "Closed " << closed << " proxy channels in " << teardownTimer.elapsed() << " ms, piped channels " 
+        << (closePipedChannels ? "closed" : "left to piped connection");
 }
 
 
@@ -265,30 +385,42 @@ Tp::BaseChannelPtr PipeConnection::createChannelCb(
         error->set(TP_QT_ERROR_NOT_IMPLEMENTED, "This handle type is not implemented in this connection");
         return Tp::BaseChannelPtr();
     }
-    if(!checkTargetHandle(targetHandle)) {
+    if(!checkTargetHandle(targetHandleType, targetHandle)) {
         error->set(TP_QT_ERROR_INVALID_HANDLE, "No such handle in this connection");
         return Tp::BaseChannelPtr();
     }
 
+    if(channelPool && channelType == TP_QT_IFACE_CHANNEL_TYPE_TEXT && targetHandleType == Tp::HandleTypeContact) {
+        channelPool->recordActivity(targetHandle, OPEN_ACTIVITY);
+        Tp::BaseChannelPtr pooled = channelPool->take(targetHandle);
+        if(pooled) return pooled;
+    }
+
     if(this->interface(TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS)) {
         pDebug() << "Getting channel from piped connection";
-        Tp::Client::ConnectionInterfaceRequestsInterface *reqIface = 
-            pipedConnection->interface<Tp::Client::ConnectionInterfaceRequestsInterface>();
 
         QString channelTypeProp = QString(TP_QT_IFACE_CHANNEL)+ QString(".ChannelType");
         QString targetHandleProp = QString(TP_QT_IFACE_CHANNEL)+ QString(".TargetHandle");
         QString targetHandleTypeProp = QString(TP_QT_IFACE_CHANNEL)+ QString(".TargetHandleType");
 
-        // first check if such channel already exists, if not create it
-        Tp::PendingVariant *pendingChans = reqIface->requestPropertyChannels();
+        // first check if such channel already exists, if not create it, requests made meanwhile
+        // for other channels share the reply
+        QDBusPendingReply<QDBusVariant> chansRep = PipeSingleFlight::instance().call(
+                pipedConnection->busName(), pipedConnection->objectPath(), "Get", "Channels",
+                [this]() -> QDBusPendingCall {
+                    Tp::Client::DBus::PropertiesInterface propsIface(
+                            QDBusConnection::sessionBus(), pipedConnection->busName(), pipedConnection->objectPath());
+                    return propsIface.Get(TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS, "Channels");
+                });
         { // wait for operation to finish -- damn async methods!!!
+            QDBusPendingCallWatcher watcher(chansRep);
             QEventLoop loop;
-            QObject::connect(pendingChans, &Tp::PendingOperation::finished,
+            QObject::connect(&watcher, &QDBusPendingCallWatcher::finished,
                     &loop, &QEventLoop::quit);
-            loop.exec();
+            if(!watcher.isFinished()) loop.exec();
         }
-        if(pendingChans->isValid()) {
-            QDBusArgument dbusArg = pendingChans->result().value<QDBusArgument>();
+        if(chansRep.isValid()) {
+            QDBusArgument dbusArg = chansRep.value().variant().value<QDBusArgument>();
             Tp::ChannelDetailsList chans;
             dbusArg >> chans;
 
@@ -310,42 +442,51 @@ Tp::BaseChannelPtr PipeConnection::createChannelCb(
                 }
             }
         } else {
-            pWarning() << "Invalid reply when getting list of channels: " << pendingChans->errorMessage();
-            error->set(pendingChans->errorName(), pendingChans->errorMessage());
+            pWarning() << "Invalid reply when getting list of channels: " << chansRep.error().message();
+            error->set(chansRep.error().name(), chansRep.error().message());
             return Tp::BaseChannelPtr();
         }
 
-        // have to create a new channel for piped connection
-        QVariantMap request;
-        request[channelTypeProp] = QVariant(channelType);
-        request[targetHandleProp] = QVariant(targetHandle);
-        request[targetHandleTypeProp] = QVariant(targetHandleType);
-
-        QDBusPendingReply<QDBusObjectPath, QVariantMap> newChanRep = reqIface->CreateChannel(request);
-
-        newChanRep.waitForFinished();
-        if(newChanRep.isValid()) {
-
-            QDBusObjectPath objectPath = newChanRep.argumentAt<0>();
-            QVariantMap props = newChanRep.argumentAt<1>();
-            pDebug() << "Creating proxy for channel at: " << objectPath.path();
-            Tp::ChannelPtr chan = Tp::Channel::create(pipedConnection, objectPath.path(), props);
-            Tp::PendingReady *pendingReady = chan->becomeReady();
-            { // wait for channel to become ready
-                QEventLoop loop;
-                QObject::connect(pendingReady, &Tp::PendingOperation::finished,
-                        &loop, &QEventLoop::quit);
-                loop.exec();
-            }
-            return pipeChannel(chan, error);
-        } else {
+        return createPipedChannel(channelType, targetHandleType, targetHandle, error);
+    } else {
+        error->set(TP_QT_ERROR_NOT_IMPLEMENTED, "Requests interface is not implemented");
+        return Tp::BaseChannelPtr();
+    }
+}
 
-            pWarning() << "Invalid reply when creating channel: " << newChanRep.error();
-            error->set(newChanRep.error().name(), newChanRep.error().message());
-            return Tp::BaseChannelPtr();
+Tp::BaseChannelPtr PipeConnection::createPipedChannel(
+        const QString &channelType, uint targetHandleType, uint targetHandle, Tp::DBusError *error)
+{
+    Tp::Client::ConnectionInterfaceRequestsInterface *reqIface = 
+        pipedConnection->interface<Tp::Client::ConnectionInterfaceRequestsInterface>();
+
+    QVariantMap request;
+    request[QString(TP_QT_IFACE_CHANNEL) + ".ChannelType"] = QVariant(channelType);
+    request[QString(TP_QT_IFACE_CHANNEL) + ".TargetHandle"] = QVariant(targetHandle);
+    request[QString(TP_QT_IFACE_CHANNEL) + ".TargetHandleType"] = QVariant(targetHandleType);
+
+    // identical requests are merged by requests interface, so the channel is created once
+    QDBusPendingReply<QDBusObjectPath, QVariantMap> newChanRep = reqIface->CreateChannel(request);
+
+    newChanRep.waitForFinished();
+    if(newChanRep.isValid()) {
+
+        QDBusObjectPath objectPath = newChanRep.argumentAt<0>();
+        QVariantMap props = newChanRep.argumentAt<1>();
+        pDebug() << "Creating proxy for channel at: " << objectPath.path();
+        Tp::ChannelPtr chan = Tp::Channel::create(pipedConnection, objectPath.path(), props);
+        Tp::PendingReady *pendingReady = chan->becomeReady();
+        { // wait for channel to become ready
+            QEventLoop loop;
+            QObject::connect(pendingReady, &Tp::PendingOperation::finished,
+                    &loop, &QEventLoop::quit);
+            loop.exec();
         }
+        return pipeChannel(chan, error);
     } else {
-        error->set(TP_QT_ERROR_NOT_IMPLEMENTED, "Requests interface is not implemented");
+
+        pWarning() << "Invalid reply when creating channel: " << newChanRep.error();
+        error->set(newChanRep.error().name(), newChanRep.error().message());
         return Tp::BaseChannelPtr();
     }
 }
@@ -356,28 +497,63 @@ void PipeConnection::connectCb(Tp::DBusError * /* error */) {
 
 Tp::UIntList PipeConnection::requestHandlesCb(uint handleType, const QStringList &identifiers, Tp::DBusError *error) {
 
-    if(handleType == Tp::HandleType::HandleTypeContact) {
+    if(handleType == Tp::HandleType::HandleTypeContact && contactListPtr) {
         try {
             return contactListPtr->getHandlesFor(identifiers);
         } catch(const ContactListExeption &e) {
-            pWarning() << "Could not return handles for identifiers in: " << objectPath();
-            setContactListDbusError(e, error);
+            // contacts outside of the roster, e.g. members of rooms, are known to piped connection
+            pDebug() << "Requesting handles not in contact list from piped connection: " << e.what();
         }
     }
-    return Tp::UIntList();
+    if(!checkHandleType(handleType)) {
+        error->set(TP_QT_ERROR_NOT_IMPLEMENTED, "This handle type is not implemented in this connection");
+        return Tp::UIntList();
+    }
+
+    // piped connection normalizes identifiers by rules of its protocol, its handles are used as they are
+    Tp::Client::ConnectionInterface pipedIface(
+            QDBusConnection::sessionBus(), pipedConnection->busName(), pipedConnection->objectPath());
+    QDBusPendingReply<Tp::UIntList> handlesRep = pipedIface.RequestHandles(handleType, identifiers);
+    handlesRep.waitForFinished();
+    if(!handlesRep.isValid()) {
+        if(handleType == Tp::HandleType::HandleTypeContact && contactListPtr) {
+            try {
+                return contactListPtr->getHandlesFor(identifiers, RosterLookup::NORMALIZED);
+            } catch(const ContactListExeption &e) {
+                pDebug() << "Identifiers are not in contact list even when normalized: " << e.what();
+            }
+        }
+        pWarning() << "Could not request handles from piped connection: " << handlesRep.error().message();
+        error->set(handlesRep.error().name(), handlesRep.error().message());
+        return Tp::UIntList();
+    }
+    return handlesRep.value();
 }
 
 QStringList PipeConnection::inspectHandlesCb(uint handleType, const Tp::UIntList &handles, Tp::DBusError *error) {
 
-    if(handleType == Tp::HandleType::HandleTypeContact) {
+    if(handleType == Tp::HandleType::HandleTypeContact && contactListPtr) {
         try {
             return contactListPtr->getIdentifiersFor(handles);
         } catch(const ContactListExeption &e) {
-            pWarning() << "Could not return identifiers for handles in: " << objectPath();
-            setContactListDbusError(e, error);
+            pDebug() << "Inspecting handles not in contact list on piped connection: " << e.what();
         }
     }
-    return QStringList();
+    if(!checkHandleType(handleType)) {
+        error->set(TP_QT_ERROR_NOT_IMPLEMENTED, "This handle type is not implemented in this connection");
+        return QStringList();
+    }
+
+    Tp::Client::ConnectionInterface pipedIface(
+            QDBusConnection::sessionBus(), pipedConnection->busName(), pipedConnection->objectPath());
+    QDBusPendingReply<QStringList> identifiersRep = pipedIface.InspectHandles(handleType, handles);
+    identifiersRep.waitForFinished();
+    if(!identifiersRep.isValid()) {
+        pWarning() << "Could not inspect handles on piped connection: " << identifiersRep.error().message();
+        error->set(identifiersRep.error().name(), identifiersRep.error().message());
+        return QStringList();
+    }
+    return identifiersRep.value();
 }
 
 Tp::ContactAttributesMap PipeConnection::getContactAttributesCb(
@@ -443,7 +619,15 @@ void PipeConnection::getContactsByVCardFieldCb(
         Tp::AddressingNormalizationMap &addressingNormalizationMap, 
         Tp::ContactAttributesMap &contactAttributesMap, Tp::DBusError *error) 
 {
-
+    resolveAddresses(addresses, interfaces,
+            [this, &field](const QString &address, RosterLookup lookup) { 
+                return contactListPtr->resolveVCardAddress(field, address, lookup); 
+            },
+            [this, &field, &interfaces](const QStringList &unresolved) {
+                return pipedConnection->interface<Tp::Client::ConnectionInterfaceAddressingInterface>()
+                    ->GetContactsByVCardField(field, unresolved, interfaces);
+            },
+            addressingNormalizationMap, contactAttributesMap, error);
 }
 
 void PipeConnection::getContactsByURICb(
@@ -451,7 +635,76 @@ void PipeConnection::getContactsByURICb(
         Tp::AddressingNormalizationMap &addressingNormalizationMap, 
         Tp::ContactAttributesMap &contactAttributesMap, Tp::DBusError *error)
 {
+    resolveAddresses(URIs, interfaces,
+            [this](const QString &uri, RosterLookup lookup) { 
+                return contactListPtr->resolveURI(uri, lookup); 
+            },
+            [this, &interfaces](const QStringList &unresolved) {
+                return pipedConnection->interface<Tp::Client::ConnectionInterfaceAddressingInterface>()
+                    ->GetContactsByURI(unresolved, interfaces);
+            },
+            addressingNormalizationMap, contactAttributesMap, error);
+}
+
+void PipeConnection::resolveAddresses(
+        const QStringList &addresses, const QStringList &interfaces,
+        const std::function<uint (const QString&, RosterLookup)> &resolveLocally,
+        const std::function<AddressingReply (const QStringList&)> &resolveByPipedConnection,
+        Tp::AddressingNormalizationMap &addressingNormalizationMap, 
+        Tp::ContactAttributesMap &contactAttributesMap, Tp::DBusError *error)
+{
+    if(!contactListPtr) {
+        error->set(TP_QT_ERROR_NOT_IMPLEMENTED, "Addressing requires contact list of piped connection");
+        return;
+    }
+
+    try {
+        Tp::UIntList handles;
+        QStringList unresolved;
+        for(const QString &address: addresses) {
+            uint handle = resolveLocally(address, RosterLookup::EXACT);
+            if(handle != 0) {
+                addressingNormalizationMap[address] = handle;
+                handles << handle;
+            } else {
+                unresolved << address;
+            }
+        }
 
+        if(!unresolved.empty()) {
+            AddressingReply addressingRep = resolveByPipedConnection(unresolved);
+            addressingRep.waitForFinished();
+            Tp::AddressingNormalizationMap resolved;
+            if(addressingRep.isValid()) {
+                resolved = addressingRep.argumentAt<0>();
+                for(auto it = resolved.constBegin(); it != resolved.constEnd(); ++it) {
+                    if(contactListPtr->hasHandle(it.value())) {
+                        addressingNormalizationMap[it.key()] = it.value();
+                        handles << it.value();
+                    }
+                }
+            } else {
+                pWarning() << "Piped connection: " << pipedConnection->objectPath() 
+                    << " could not resolve addresses: " << addressingRep.error().message();
+            }
+
+            // addresses piped connection could not normalize are looked up case insensitively
+            for(const QString &address: unresolved) {
+                if(resolved.contains(address)) continue;
+                uint handle = resolveLocally(address, RosterLookup::NORMALIZED);
+                if(handle != 0) {
+                    addressingNormalizationMap[address] = handle;
+                    handles << handle;
+                }
+            }
+        }
+
+        contactAttributesMap = contactListPtr->getContactAttributes(handles, interfaces);
+    } catch(PipeException<ContactListError> &e) {
+        pWarning() << "Exception happened while resolving addresses for connection: " 
+            << objectPath() << " with message: " << e.what();
+        setContactListDbusError(e, error);
+    }
 }
 
 uint PipeConnection::setPresenceCb(const QString &status, const QString &statusMessage, Tp::DBusError *error) {
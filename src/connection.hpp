@@ -4,16 +4,37 @@
 #include <TelepathyQt/BaseConnection>
 #include <TelepathyQt/Connection>
 #include <TelepathyQt/BaseChannel>
+#include <QPointer>
+#include <functional>
 #include <memory>
 
 #include "types.hpp"
 #include "contact_list.hpp"
 #include "simple_presence.hpp"
+#include "channel_pool.hpp"
+#include "idle_channel_manager.hpp"
+#include "send_scheduler.hpp"
+#include "requests_interface.hpp"
 
 struct ConnectionAdditionalData {
     QString contactListFileName;
+    // number of text channels piped in advance, 0 disables pre-piping
+    uint prePipePoolSize;
+    // time in seconds after which not used pre-piped channel is closed
+    uint prePipeIdleTimeout;
+    // memory in KiB which proxy channels may hold, 0 means no limit
+    uint channelMemoryBudget;
+    // time in seconds after which idle proxy channel may be closed to keep the budget
+    uint channelIdleTimeout;
+    // shares of sending of interactive and bulk channels
+    uint interactiveSendWeight;
+    uint bulkSendWeight;
+    // messages per second which bulk channel may send, 0 means no limit
+    uint bulkSendRate;
 };
 
+typedef QDBusPendingReply<Tp::AddressingNormalizationMap, Tp::ContactAttributesMap> AddressingReply;
+
 
 class PipeConnection : public Tp::BaseConnection {
 
@@ -22,7 +43,7 @@ class PipeConnection : public Tp::BaseConnection {
 
         PipeConnection(
                 const Tp::ConnectionPtr &pipedConnection,
-                const PipePtr &pipe,
+                const PipeChain &pipes,
                 const QDBusConnection &dbusConnection,
                 const QString &cmName,
                 const QString &protocolName,
@@ -38,19 +59,34 @@ class PipeConnection : public Tp::BaseConnection {
          */
         bool checkChannel(const Tp::Channel &channel) const;
 
+        /**
+         * Creates channel with callbacks of this connection and announces it on requests interface
+         */
+        Tp::BaseChannelPtr openChannel(const QString &channelType, uint targetHandleType, uint targetHandle, 
+                uint initiatorHandle, bool suppressHandler, Tp::DBusError *error);
+
     private:
         /**
          * @param channel to be piped
          * @returns piped channel
          */
         Tp::BaseChannelPtr pipeChannel(const Tp::ChannelPtr channel, Tp::DBusError *error);
+        /**
+         * Registers proxy of channel and passes it to idle channel manager if there is one
+         */
+        Tp::BaseChannelPtr trackChannel(const PipeProxyChannelPtr &channel);
 
         bool checkChannelType(const QString &channelType) const;
         bool checkHandleType(uint targetHandleType) const;
-        bool checkTargetHandle(uint targetHandle) const;
+        bool checkTargetHandle(uint targetHandleType, uint targetHandle) const;
 
         Tp::BaseChannelPtr createChannelCb(
                 const QString &channelType, uint targetHandleType, uint targetHandle, Tp::DBusError *error);
+        /**
+         * Creates a new channel on piped connection and pipes it
+         */
+        Tp::BaseChannelPtr createPipedChannel(
+                const QString &channelType, uint targetHandleType, uint targetHandle, Tp::DBusError *error);
 
         Tp::UIntList requestHandlesCb(uint handleType, const QStringList &identifiers, Tp::DBusError *error);
 
@@ -89,13 +125,38 @@ class PipeConnection : public Tp::BaseConnection {
         void addSimplePresenceInterface();
         void addAdressingInterface();
         void addRequestsInterface();
+        void addChannelPool(uint poolSize, uint idleTimeout);
+        /**
+         * Closes all proxy channels in one pass, piped channels are closed in parallel 
+         * unless they were invalidated with piped connection
+         */
+        void closeProxyChannels();
+
+        /**
+         * Resolves addresses with piped roster, addresses unknown to it are passed to piped 
+         * connection in one call, those it cannot normalize are looked up normalized in roster. 
+         * Only piped contacts are returned.
+         */
+        void resolveAddresses(
+                const QStringList &addresses, const QStringList &interfaces,
+                const std::function<uint (const QString&, RosterLookup)> &resolveLocally,
+                const std::function<AddressingReply (const QStringList&)> &resolveByPipedConnection,
+                Tp::AddressingNormalizationMap &addressingNormalizationMap, 
+                Tp::ContactAttributesMap &contactAttributesMap, Tp::DBusError *error);
 
     private:
 
         Tp::ConnectionPtr pipedConnection;
+        /** first pipe of the chain, it decides which channels are piped */
         PipePtr pipe;
+        PipeChain pipes;
         std::unique_ptr<PipeContactList> contactListPtr;
         std::unique_ptr<PipeSimplePresence> simplePresencePtr;
+        std::unique_ptr<PipeChannelPool> channelPool;
+        std::unique_ptr<PipeIdleChannelManager> idleChannelManager;
+        PipeConnectionRequestsInterfacePtr requestsIface;
+        QList<QPointer<PipeProxyChannel>> proxyChannels;
+        PipeSendSchedulerPtr sendScheduler;
 };
 
 typedef Tp::SharedPtr<PipeConnection> PipeConnectionPtr;
@@ -10,18 +10,26 @@
 #include <TelepathyQt/PendingReady>
 #include <QDebug>
 #include <QtDBus>
+#include <QDir>
+#include <QLibrary>
+#include <QPluginLoader>
+#include <QElapsedTimer>
+#include <QTimer>
 #include <vector>
 
 #include "connection_manager.hpp"
 #include "types.hpp"
 #include "defines.hpp"
-#include "pipe_interface.h"
 #include "protocol.hpp"
 #include "utils.hpp"
 
 namespace init {
 
-    std::vector<PipePtr> discoverPipes(const QDBusConnection& connection) {
+    /**
+     * Creates pipes from cache when possible, only pipes missing in cache are started.
+     * Cache entries of pipes which are not installed anymore are removed.
+     */
+    std::vector<PipePtr> discoverPipes(const QDBusConnection& connection, PipeCapabilityCache &cache) {
 
         QDBusConnectionInterface *dci = connection.interface();
         QDBusInterface dbus(dci->service(), dci->path(), dci->interface(), connection);
@@ -40,18 +48,28 @@ namespace init {
                     if(!pipeServices.contains(servName)) pipeServices << servName;
                 }
             }
+            cache.retain(pipeServices);
 
             QString path;
             for(auto it = pipeServices.constBegin(); it != pipeServices.constEnd(); ++it) {
+                path = "/" + *it;
+                path.replace('.', '/');
+
+                if(cache.contains(*it)) {
+                    pDebug() << "Pipe service - > " + *it + " is loaded from cache";
+                    pipes.push_back(std::make_shared<Pipe>(*it, path, connection, cache.properties(*it)));
+                    continue;
+                }
+
                 QDBusReply<bool> isRegisteredRep = dci->isServiceRegistered(*it);
                 QDBusReply<void> startServiceRep;
                 if((isRegisteredRep.isValid() && isRegisteredRep.value()) 
                         || (startServiceRep = dci->startService(*it), startServiceRep.isValid())) 
                 {
                     pDebug() << "Pipe service - > " + *it + " is started";
-                    path = "/" + *it;
-                    path.replace('.', '/');
-                    pipes.push_back(std::make_shared<Pipe>(*it, path, connection));
+                    PipePtr pipe = std::make_shared<Pipe>(*it, path, connection);
+                    if(pipe->isActive()) cache.update(*it, pipe->properties());
+                    pipes.push_back(pipe);
                 } else {
                     pWarning() << "Pipe service - > " + *it + " could not be started";
                 }
@@ -63,6 +81,50 @@ namespace init {
         return pipes;
     }
 
+    /**
+     * Fetches properties of cached pipes which are already running, other pipes are
+     * revalidated when they are activated
+     */
+    void revalidatePipes(const std::vector<PipePtr> &pipes, const QDBusConnection& connection, 
+            PipeCapabilityCache &cache) 
+    {
+        bool changed = false;
+        for(auto &pipe: pipes) {
+            if(pipe->isPlugin() || pipe->isActive()) continue;
+
+            QDBusReply<bool> isRegisteredRep = connection.interface()->isServiceRegistered(pipe->service());
+            if(isRegisteredRep.isValid() && isRegisteredRep.value() && pipe->refresh()) {
+                cache.update(pipe->service(), pipe->properties());
+                changed = true;
+            }
+        }
+        if(changed) cache.save();
+    }
+
+    /**
+     * @param owner owns loaders of plugins, so they stay loaded as long as it lives
+     */
+    std::vector<PipePtr> loadPlugins(QObject *owner) {
+
+        std::vector<PipePtr> plugins;
+        QDir pluginsDir(QDir::homePath() + QString("/" TP_QT_PIPE_PLUGINS));
+        for(const QString &fileName: pluginsDir.entryList(QDir::Files)) {
+            if(!QLibrary::isLibrary(fileName)) continue;
+
+            QPluginLoader *loader = new QPluginLoader(pluginsDir.absoluteFilePath(fileName), owner);
+            PipePlugin *plugin = qobject_cast<PipePlugin*>(loader->instance());
+            if(plugin != nullptr) {
+                pDebug() << "Pipe plugin - > " + fileName + " is loaded";
+                plugins.push_back(std::make_shared<Pipe>(plugin));
+            } else {
+                pWarning() << "Pipe plugin - > " + fileName + " could not be loaded: " << loader->errorString();
+                delete loader;
+            }
+        }
+
+        return plugins;
+    }
+
 } /* init namespace */
 
 void pipeChannels(PipeConnectionPtr pipeCon, std::vector<Tp::ChannelPtr> channels) {
@@ -80,7 +142,7 @@ void pipeChannels(PipeConnectionPtr pipeCon, std::vector<Tp::ChannelPtr> channel
             }
             pDebug() << "Piping channel: " << chan->objectPath();
             Tp::DBusError dbError;
-            QDBusObjectPath newChan(pipeCon->createChannel(
+            QDBusObjectPath newChan(pipeCon->openChannel(
                         chan->channelType(),
                         chan->targetHandleType(),
                         chan->targetHandle(), 
@@ -124,6 +186,7 @@ PipeConnectionManager::PipeConnectionManager(
         const QDBusConnection& connection) 
 : Tp::BaseConnectionManager(connection, TP_QT_PIPE_CONNECTION_MANAGER_NAME)
 {
+    capabilityCache.reset(new PipeCapabilityCache(QDir::homePath() + QString("/" TP_QT_PIPE_CAPABILITY_CACHE)));
     registrar = Tp::ClientRegistrar::create();
     init();
 }
@@ -147,20 +210,30 @@ void PipeConnectionManager::init() {
                         QCoreApplication::exit(1);
                 }
                 Tp::ChannelClassSpecList channelFilter;
-                std::vector<PipePtr> pipes = init::discoverPipes(dbusConnection());
+                QElapsedTimer discoveryTimer;
+                discoveryTimer.start();
+                capabilityCache->load();
+                std::vector<PipePtr> pipes = init::discoverPipes(dbusConnection(), *capabilityCache);
+                capabilityCache->save();
+                std::vector<PipePtr> plugins = init::loadPlugins(this);
+                pipes.insert(pipes.end(), plugins.begin(), plugins.end());
+                pDebug() << "Discovered " << pipes.size() << " pipes in " << discoveryTimer.elapsed() << " ms";
                 if(pipes.empty()) pWarning() << "No pipes found";
                 for(auto& pipe: pipes) {
+                    if(!pipe->isPlugin()) {
+                        // pipe activated later or changing its properties refreshes the cache
+                        Pipe *pipePtr = pipe.get();
+                        connect(pipePtr, &Pipe::propertiesChanged, this, [this, pipePtr]() {
+                                capabilityCache->update(pipePtr->service(), pipePtr->properties());
+                                capabilityCache->save();
+                            });
+                    }
+
                     addProtocol(Tp::BaseProtocolPtr(
                                 new PipeProtocol(dbusConnection(), pipe->name() + "Pipe", pipe, amp, this)));
 
                     // building channel filter for approver
-                    Tp::RequestableChannelClassSpecList protoRecList = pipe->requestableChannelClasses();
-                    for(auto &reqChanSpec: protoRecList) {
-                        channelFilter << Tp::ChannelClassSpec(
-                            reqChanSpec.channelType(), 
-                            reqChanSpec.targetHandleType(),
-                            reqChanSpec.fixedProperties());
-                    }
+                    channelFilter << pipe->matcher().channelFilter();
                 }
 
                 // registering objects
@@ -177,6 +250,11 @@ void PipeConnectionManager::init() {
                     pCritical() << "Could not register pipeApprover";
                     QCoreApplication::exit(1);
                 }
+
+                // checking cached pipes after everything is registered
+                QTimer::singleShot(0, this, [this, pipes]() {
+                        init::revalidatePipes(pipes, dbusConnection(), *capabilityCache);
+                    });
             });
 }
 
@@ -5,9 +5,11 @@
 #include <TelepathyQt/AccountManager>
 #include <TelepathyQt/Account>
 #include <TelepathyQt/ClientRegistrar>
+#include <memory>
 
 #include "casehandler.hpp"
 #include "approver.hpp"
+#include "pipe_cache.hpp"
 
 class PipeConnectionManager : public Tp::BaseConnectionManager {
 
@@ -37,6 +39,7 @@ class PipeConnectionManager : public Tp::BaseConnectionManager {
         Tp::ClientRegistrarPtr registrar;
         Tp::AccountManagerPtr amp;
         PipeApproverPtr pipeApprover;
+        std::unique_ptr<PipeCapabilityCache> capabilityCache;
 };
 
 #endif
@@ -2,9 +2,19 @@
 #include "pipe_exception.hpp"
 #include "defines.hpp"
 #include "utils.hpp"
+#include "single_flight.hpp"
 
 #include <algorithm>
 #include <QDataStream>
+#include <QDBusPendingCallWatcher>
+#include <QFileInfo>
+
+namespace {
+
+    const quint32 SNAPSHOT_VERSION = 2;
+    const int SNAPSHOT_INTERVAL = 60000; // ms
+
+} /* anonymous namespace */
 
 PipeContactList::PipeContactList(
         ContactList *pipedList, 
@@ -15,7 +25,11 @@ PipeContactList::PipeContactList(
         loaded(false), pipedList(pipedList),
         contactListIface(contactListIface),
         fileName(contactListFileName),
-        attributeInterfaces(attributeInterfaces)
+        attributeInterfaces(attributeInterfaces),
+        index(std::make_shared<PipeRosterIndex>()),
+        dirty(false),
+        loading(false),
+        resyncing(false)
 {
     // users are added to the list in order to pipe their connections
     contactListIface->setCanChangeContactList(true); 
@@ -29,90 +43,124 @@ PipeContactList::PipeContactList(
     contactListIface->setContactListState(Tp::ContactListState::ContactListStateNone);
 
     dirPath = QDir::homePath() + QString("/" TP_QT_PIPE_CONTACT_LISTS);
+    snapshotPath = QDir::homePath() + QString("/" TP_QT_PIPE_STATE) + fileName;
+
+    snapshotTimer.setInterval(SNAPSHOT_INTERVAL);
+    connect(&snapshotTimer, &QTimer::timeout, this, &PipeContactList::saveSnapshot);
+    snapshotTimer.start();
 
     connect(pipedList, &ContactList::ContactListStateChanged, this, &PipeContactList::contactListStateChangedCb);
     connect(pipedList, &ContactList::ContactsChangedWithID, this, &PipeContactList::contactsChangedWithIdCb);
     connect(pipedList, &ContactList::ContactsChanged, this, &PipeContactList::contactsChangedCb);
 }
 
+PipeContactList::~PipeContactList() {
+    saveSnapshot();
+}
+
 bool PipeContactList::isLoaded() const {
     return loaded;
 }
 
 
 void PipeContactList::loadContactList() {
-    if(loaded) return;
+    if(loaded || loading) return;
 
+    if(restoreSnapshot()) {
+        pDebug() << "Contact list: " << fileName << " restored from snapshot";
+        loaded = true;
+        contactListIface->setContactListState(Tp::ContactListState::ContactListStateSuccess);
+        notifyObserver(modifyIndex([](PipeRosterIndex &roster) { return roster.addToList(roster.pipedHandles()); }));
+        reconcileWithPipedList();
+        return;
+    }
+
+    loading = true;
     contactListIface->setContactListState(Tp::ContactListStateWaiting);
 
-    QDBusPendingReply<Tp::ContactAttributesMap> attrMapRep = pipedList->GetContactListAttributes(attributeInterfaces, false);
-    attrMapRep.waitForFinished();
-
-    if(attrMapRep.isValid()) {
-        pipedAttrMap = attrMapRep.value();
-        for(auto it = pipedAttrMap.constBegin(); it != pipedAttrMap.constEnd(); ++it) {
-            auto idIt = (*it).find(QString(TP_QT_IFACE_CONNECTION) + "/contact-id");
-            if(idIt != (*it).end()) {
-                idMap[it.key()] = idIt->toString();
-                revIdMap[idIt->toString()] = it.key();
-            } else {
-                pWarning() << "No id for handle: " << it.key();
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(getPipedListAttributes(), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *finishedWatcher) {
+            QDBusPendingReply<Tp::ContactAttributesMap> attrMapRep = *finishedWatcher;
+            finishedWatcher->deleteLater();
+            loading = false;
+            // list could be loaded by another caller which shared the reply
+            if(loaded) return;
+
+            if(attrMapRep.isError()) {
+                pWarning() << "Could not get attributes map of piped list: " << attrMapRep.error().message();
+                contactListIface->setContactListState(Tp::ContactListStateFailure);
+                return;
             }
-        }
 
-        QSet<QString> serializedHandles = loadFromFile(dirPath, fileName);
-        for(const QString& id: serializedHandles) {
-            if(revIdMap.contains(id)) pipedContacts.insert(id);
-            else pWarning() << "Could not find handle to pipe in contact list for id: (" << id << ")";
-        }
+            QSet<QString> serializedHandles = loadFromFile(dirPath, fileName);
+            RosterDelta delta = modifyIndex([&](PipeRosterIndex &roster) {
+                    roster.setAttributes(attrMapRep.value());
+                    for(const QString& id: roster.setPipedContacts(serializedHandles))
+                        pWarning() << "Could not find handle to pipe in contact list for id: (" << id << ")";
+                    return roster.addToList(roster.pipedHandles());
+                });
+
+            loaded = true;
+            dirty = true;
+            contactListIface->setContactListState(Tp::ContactListState::ContactListStateSuccess);
+            notifyObserver(delta);
+        });
+}
 
-        loaded = true;
-        contactListIface->setContactListState(Tp::ContactListState::ContactListStateSuccess);
+Tp::UIntList PipeContactList::getHandlesFor(const QStringList &identifiers, RosterLookup lookup) const {
+    return snapshot()->getHandlesFor(identifiers, lookup);
+}
 
-    } else {
-        pWarning() << "Could not get attributes map of piped list";
-    }
+QStringList PipeContactList::getIdentifiersFor(const Tp::UIntList &handles) const {
+    return snapshot()->getIdentifiersFor(handles);
 }
 
-Tp::UIntList PipeContactList::getHandlesFor(const QStringList &identifiers) const {
-    // Maybe add reverse mapping in future, now lets stay with this inefficient solution
-    Tp::UIntList handles;
-    for(const QString &id: identifiers) {
-        bool found = false;
-        for(auto it = idMap.constBegin(); it != idMap.constEnd(); ++it) {
-            if(it.value() == id) {
-                found = true;
-                handles.append(it.key());
-            }
-        }
-        if(!found) throw ContactListExeption(
-                "No handle for identifier: " + id.toStdString(), ContactListError::INVALID_HANDLE);
-    }
-    return handles;
+bool PipeContactList::hasHandle(uint handle) const {
+    return snapshot()->hasHandle(handle);
 }
 
-QStringList PipeContactList::getIdentifiersFor(const Tp::UIntList &handles) const {
+bool PipeContactList::hasIdentifier(const QString& identifier) const {
+    return snapshot()->hasIdentifier(identifier);
+}
 
-    QStringList identifiers;
-    for(uint h: handles) {
-        auto it = idMap.find(h);
-        if(it == idMap.end())
-            throw ContactListExeption(
-                    "No such handle in contact list: " + std::to_string(h), ContactListError::INVALID_HANDLE);
+uint PipeContactList::resolveURI(const QString &uri, RosterLookup lookup) const {
+    if(!isLoaded()) 
+        throw PipeException<ContactListError>("Contact list is not loaded", ContactListError::NOT_LOADED);
+    return snapshot()->resolveURI(uri, lookup);
+}
 
-        identifiers.append(*it);
-    }
-    return identifiers;
+uint PipeContactList::resolveVCardAddress(const QString &field, const QString &address, 
+        RosterLookup lookup) const 
+{
+    if(!isLoaded()) 
+        throw PipeException<ContactListError>("Contact list is not loaded", ContactListError::NOT_LOADED);
+    return snapshot()->resolveVCardAddress(field, address, lookup);
 }
 
-bool PipeContactList::hasHandle(uint handle) const {
-    if(idMap.contains(handle)) 
-        return pipedContacts.contains(idMap[handle]);
-    return false;
+Tp::UIntList PipeContactList::pipedHandles() const {
+    return snapshot()->pipedHandles();
 }
 
-bool PipeContactList::hasIdentifier(const QString& identifier) const {
-    return pipedContacts.contains(identifier);
+PipeRosterSnapshot PipeContactList::snapshot() const {
+    return std::atomic_load(&index);
+}
+
+RosterDelta PipeContactList::modifyIndex(const std::function<RosterDelta (PipeRosterIndex&)> &modify) {
+
+    std::lock_guard<std::mutex> lock(writeMutex);
+    // containers of index are implicitly shared, only modified ones are really copied
+    std::shared_ptr<PipeRosterIndex> next = std::make_shared<PipeRosterIndex>(*std::atomic_load(&index));
+    RosterDelta delta = modify(*next);
+    std::atomic_store(&index, PipeRosterSnapshot(std::move(next)));
+    return delta;
+}
+
+void PipeContactList::setRosterObserver(const RosterObserver &observer) {
+    this->observer = observer;
+}
+
+void PipeContactList::notifyObserver(const RosterDelta &delta) {
+    if(observer && !delta.isEmpty()) observer(delta);
 }
 
 Tp::ContactAttributesMap PipeContactList::getContactAttributes(
@@ -122,14 +170,7 @@ Tp::ContactAttributesMap PipeContactList::getContactAttributes(
     if(!isLoaded()) 
         throw PipeException<ContactListError>("Contact list is not loaded", ContactListError::NOT_LOADED);
 
-    Tp::ContactAttributesMap attrsToReturn;
-    for(uint handle: handles) {
-        auto it = pipedAttrMap.find(handle);
-        if(it != pipedAttrMap.end()) 
-            attrsToReturn[handle] = it.value();
-    }
-
-    return attrsToReturn;
+    return snapshot()->getContactAttributes(handles);
 }
 
 Tp::ContactAttributesMap PipeContactList::getContactListAttributes(const QStringList &interfaces) {
@@ -137,70 +178,31 @@ Tp::ContactAttributesMap PipeContactList::getContactListAttributes(const QString
     if(!isLoaded()) 
         throw PipeException<ContactListError>("Contact list is not loaded", ContactListError::NOT_LOADED);
 
-    Tp::UIntList handles;
-    for(const QString& p: pipedContacts) handles.append(revIdMap[p]);
-
-    return getContactAttributes(handles, interfaces);
+    return getContactAttributes(pipedHandles(), interfaces);
 }
 
 void PipeContactList::addToList(const Tp::UIntList &contacts) {
     if(!isLoaded()) 
         throw PipeException<ContactListError>("Contact list is not loaded", ContactListError::NOT_LOADED);
 
-    Tp::ContactSubscriptionMap subChangeMap;
-    Tp::HandleIdentifierMap newIdentifiers;
-    Tp::ContactSubscriptions subs;
-    for(uint handle: contacts) {
-        pDebug() << "Adding to contact list: " << handle;
-        if(pipedAttrMap.contains(handle)) {
-
-            auto it = pipedAttrMap[handle].find(QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/subscribe");
-            if(it != pipedAttrMap[handle].end()) subs.subscribe = it.value().toUInt();
-            else subs.subscribe = Tp::SubscriptionState::SubscriptionStateUnknown;
-
-            it = pipedAttrMap[handle].find(QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/publish");
-            if(it != pipedAttrMap[handle].end()) subs.publish = it.value().toUInt();
-            else subs.publish = Tp::SubscriptionState::SubscriptionStateUnknown;
-
-            it = pipedAttrMap[handle].find(QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/publish-request");
-            if(it != pipedAttrMap[handle].end()) subs.publishRequest = it.value().toString();
-            else subs.publishRequest = "";
-
-            auto hIt = idMap.find(handle);
-            if(hIt != idMap.end()) {
-                newIdentifiers[handle] = *hIt;
-                pipedContacts.insert(*hIt);
-                subChangeMap[handle] = subs;
-            }
-        } else {
-            pWarning() << "No such handle: " << handle;
-            throw ContactListExeption("No such handle: " + std::to_string(handle), ContactListError::INVALID_HANDLE);
-        }
-    }
+    pDebug() << "Adding to contact list: " << contacts;
+    RosterDelta delta = modifyIndex([&contacts](PipeRosterIndex &roster) { return roster.addToList(contacts); });
 
-    contactListIface->contactsChangedWithID(subChangeMap, newIdentifiers, Tp::HandleIdentifierMap());
-    saveToFile(dirPath, fileName, pipedContacts);
+    contactListIface->contactsChangedWithID(delta.changes, delta.identifiers, Tp::HandleIdentifierMap());
+    notifyObserver(delta);
+    dirty = true;
+    saveToFile(dirPath, fileName, snapshot()->pipedContacts());
 }
 
 void PipeContactList::remove(const Tp::UIntList &contacts) {
 
-    // first, check if all handles are piped
-    for(uint handle: contacts) {
-        auto it = idMap.find(handle);
-        if(it == idMap.end() || !pipedContacts.contains(*it)) 
-            throw ContactListExeption("No such handle in list", ContactListError::INVALID_HANDLE);
-    }
-
-    Tp::HandleIdentifierMap removed;
-    for(uint handle: contacts) {
-        const QString& id = idMap[handle];
-        removed[handle] = id;
-        pipedContacts.remove(id);
-        pDebug() << "Removing contact: " << id;
-    }
+    RosterDelta delta = modifyIndex([&contacts](PipeRosterIndex &roster) { return roster.remove(contacts); });
+    pDebug() << "Removing contacts: " << delta.removals.values();
 
-    contactListIface->contactsChangedWithID(Tp::ContactSubscriptionMap(), Tp::HandleIdentifierMap(), removed);
-    saveToFile(dirPath, fileName, pipedContacts);
+    contactListIface->contactsChangedWithID(Tp::ContactSubscriptionMap(), Tp::HandleIdentifierMap(), delta.removals);
+    notifyObserver(delta);
+    dirty = true;
+    saveToFile(dirPath, fileName, snapshot()->pipedContacts());
 }
 
 QSet<QString> PipeContactList::loadFromFile(const QString &dirPath, const QString &fileName) {
@@ -232,45 +234,141 @@ void PipeContactList::saveToFile(const QString &dirPath, const QString &filename
     os << pipedHandles;
 }
 
-void PipeContactList::contactListStateChangedCb(uint newState) {
-    if(!loaded && newState == Tp::ContactListState::ContactListStateSuccess) loadContactList();
-    contactListIface->setContactListState(newState);
+bool PipeContactList::restoreSnapshot() {
+
+    QFile inFile(snapshotPath);
+    if(!inFile.open(QIODevice::ReadOnly)) return false;
+
+    QDataStream is(&inFile);
+    quint32 version;
+    is >> version;
+    if(version != SNAPSHOT_VERSION) {
+        pWarning() << "Ignoring contact list snapshot with version: " << version;
+        return false;
+    }
+
+    std::shared_ptr<PipeRosterIndex> restored = std::make_shared<PipeRosterIndex>();
+    is >> *restored;
+    if(is.status() != QDataStream::Ok) {
+        pWarning() << "Contact list snapshot: " << snapshotPath << " is corrupted";
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(writeMutex);
+    std::atomic_store(&index, PipeRosterSnapshot(std::move(restored)));
+    return true;
 }
 
-void PipeContactList::contactsChangedWithIdCb(const Tp::ContactSubscriptionMap &changes,
-        const Tp::HandleIdentifierMap &identifiers, const Tp::HandleIdentifierMap &removals) 
-{
-    Tp::HandleIdentifierMap newRemovals;
-    for(auto it = removals.constBegin(); it != removals.constEnd(); ++it) {
-        auto pIt = pipedContacts.find(it.value());
-        if(pIt != pipedContacts.end()) {
-            newRemovals[it.key()] = it.value();
-            pipedContacts.erase(pIt);
-        }
-        idMap.remove(it.key());
-        revIdMap.remove(it.value());
+void PipeContactList::saveSnapshot() {
+
+    if(!dirty || !loaded) return;
+
+    QDir dir(QFileInfo(snapshotPath).absolutePath());
+    if(!dir.exists() && !dir.mkpath(dir.absolutePath())) {
+        pCritical() << "Cannot create path for contact list snapshot: " << snapshotPath;
+        return;
     }
 
-    Tp::HandleIdentifierMap changeIdentifiers;
-    Tp::ContactSubscriptionMap newChanges;
-    for(auto it = identifiers.constBegin(); it != identifiers.constEnd(); ++it) {
-        if(pipedContacts.find(it.value()) != pipedContacts.end()) {
-            changeIdentifiers[it.key()] = it.value();
-            newChanges[it.key()] = changes[it.key()];
+    QFile outFile(snapshotPath);
+    if(!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        pWarning() << "Could not write contact list snapshot: " << snapshotPath;
+        return;
+    }
+    QDataStream os(&outFile);
+    os << SNAPSHOT_VERSION << *snapshot();
+    dirty = false;
+}
+
+void PipeContactList::reconcileWithPipedList() {
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+            getPipedListAttributes(), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *finishedWatcher) {
+            QDBusPendingReply<Tp::ContactAttributesMap> attrMapRep = *finishedWatcher;
+            finishedWatcher->deleteLater();
+            if(attrMapRep.isError()) {
+                pWarning() << "Could not reconcile contact list: " << fileName 
+                    << " -> " << attrMapRep.error().message();
+                return;
+            }
+
+            QSet<QString> identifiers = loadFromFile(dirPath, fileName);
+            announceDelta(modifyIndex([&](PipeRosterIndex &roster) { 
+                        return roster.reconcile(attrMapRep.value(), identifiers); 
+                    }), "reconciled");
+        });
+}
+
+QDBusPendingCall PipeContactList::getPipedListAttributes() {
+    return PipeSingleFlight::instance().call(pipedList->service(), pipedList->path(), 
+            "GetContactListAttributes", attributeInterfaces.join(','), 
+            [this]() -> QDBusPendingCall { return pipedList->GetContactListAttributes(attributeInterfaces, false); });
+}
+
+void PipeContactList::resyncWithPipedList() {
+
+    if(resyncing) return;
+    resyncing = true;
+
+    // contact ids are always included, only subscriptions are requested on top of them
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pipedList->GetContactListAttributes(
+                QStringList() << TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST, false), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *finishedWatcher) {
+            QDBusPendingReply<Tp::ContactAttributesMap> attrMapRep = *finishedWatcher;
+            finishedWatcher->deleteLater();
+            resyncing = false;
+            if(attrMapRep.isError()) {
+                pWarning() << "Could not resync contact list: " << fileName 
+                    << " -> " << attrMapRep.error().message();
+                return;
+            }
+
+            announceDelta(modifyIndex([&attrMapRep](PipeRosterIndex &roster) { 
+                        return roster.resync(attrMapRep.value()); 
+                    }), "resynced");
+        });
+}
+
+void PipeContactList::announceDelta(const RosterDelta &delta, const char *operation) {
+
+    dirty = true;
+    if(delta.isEmpty()) return;
+
+    pDebug() << "Contact list: " << fileName << " " << operation << ", " << delta.changes.size() 
+        << " changed, " << delta.removals.size() << " removed";
+    contactListIface->contactsChangedWithID(delta.changes, delta.identifiers, delta.removals);
+    notifyObserver(delta);
+}
+
+void PipeContactList::contactListStateChangedCb(uint newState) {
+    if(newState == Tp::ContactListState::ContactListStateSuccess) {
+        // list is not ready before it is loaded, the load announces success or failure itself
+        if(!loaded) {
+            loadContactList();
+            return;
         }
-        Tp::ContactSubscriptions subs = changes[it.key()];
-        pipedAttrMap[it.key()]
-            [QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/subscribe"] = subs.subscribe;
-        pipedAttrMap[it.key()]
-            [QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/publish"] = subs.publish;
-        pipedAttrMap[it.key()]
-            [QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/publish-request"] = subs.publishRequest;
+        // list of piped connection was downloaded again, handles known to us may be stale
+        resyncWithPipedList();
+    } else if(loading) {
+        // state of the load in flight is announced when it finishes
+        return;
     }
+    contactListIface->setContactListState(newState);
+}
 
-    if(!(newChanges.empty() && changeIdentifiers.empty() && newRemovals.empty())) {
-        contactListIface->contactsChangedWithID(newChanges, changeIdentifiers, newRemovals);
-        if(!newRemovals.empty()) 
-            saveToFile(dirPath, fileName, pipedContacts);
+void PipeContactList::contactsChangedWithIdCb(const Tp::ContactSubscriptionMap &changes,
+        const Tp::HandleIdentifierMap &identifiers, const Tp::HandleIdentifierMap &removals) 
+{
+    RosterDelta delta = modifyIndex([&](PipeRosterIndex &roster) { 
+            return roster.applyChanges(changes, identifiers, removals); 
+        });
+    dirty = true;
+
+    if(!delta.isEmpty()) {
+        contactListIface->contactsChangedWithID(delta.changes, delta.identifiers, delta.removals);
+        notifyObserver(delta);
+        if(!delta.removals.empty()) 
+            saveToFile(dirPath, fileName, snapshot()->pipedContacts());
     }
 }
 
@@ -2,33 +2,30 @@
 #define PIPE_CONTACT_LIST_HPP
 
 #include <QObject>
+#include <QTimer>
 #include <TelepathyQt/ConnectionInterfaceContactListInterface>
 #include <TelepathyQt/BaseConnection>
 #include <atomic>
+#include <functional>
 #include <map>
+#include <mutex>
 #include <vector>
 #include <utility>
 
 #include "pipe_exception.hpp"
+#include "roster_index.hpp"
 
 typedef Tp::Client::ConnectionInterfaceContactListInterface ContactList;
 typedef Tp::Client::ConnectionInterfaceContactsInterface ContactsIface;
-
-enum class ContactListError {
-    UNDEFINED,
-    NOT_LOADED,
-    NETWORK_ERROR,
-    NOT_IMPLEMENTED,
-    NOT_AVAILABLE,
-    SERVICE_BUSY,
-    NOT_YET,
-    INVALID_HANDLE
-};
-
-typedef PipeException<ContactListError> ContactListExeption;
+typedef std::function<void (const RosterDelta&)> RosterObserver;
 
 /**
- * Class representing piped list which is stored in a file on disk
+ * Class representing piped list which is stored in a file on disk. Whole roster is also
+ * snapshotted periodically, so after restart the list is ready at once and reconciled with
+ * piped list in the background.
+ *
+ * Roster is published as immutable snapshots, readers only load current one and need no lock.
+ * Writers copy it, modify the copy and publish it, they are serialized by a mutex.
  */
 class PipeContactList : public QObject {
 
@@ -43,15 +40,15 @@ class PipeContactList : public QObject {
                 const Tp::BaseConnectionContactListInterfacePtr &contactListIface,
                 const QString &contactListFileName, 
                 const QStringList &attributeInterfaces);
+        virtual ~PipeContactList();
 
         /**
          * @return true if list was loaded and properly initialized
          */
         bool isLoaded() const;
         /**
-         * Loads serialized contact list 
-         *
-         * @throws ContactListException if error happens during the operation
+         * Loads serialized contact list, it is ready at once when there is a snapshot, otherwise
+         * when piped list is fetched. Failure is announced as contact list state.
          */
         void loadContactList();
 
@@ -89,7 +86,7 @@ class PipeContactList : public QObject {
          * @return piped handles for given identifiers
          * @throw ContactListException if there is no handle for at least on of identifiers
          */
-        Tp::UIntList getHandlesFor(const QStringList &identifiers) const;
+        Tp::UIntList getHandlesFor(const QStringList &identifiers, RosterLookup lookup = RosterLookup::EXACT) const;
 
         /**
          * @return piped identifiers for given handles
@@ -106,11 +103,66 @@ class PipeContactList : public QObject {
          */
         bool hasIdentifier(const QString& identifier) const;
 
+        /**
+         * @return piped handle of contact with given URI, 0 if there is no such contact
+         * @throws ContactListException if contact list has not been loaded
+         */
+        uint resolveURI(const QString &uri, RosterLookup lookup = RosterLookup::EXACT) const;
+        /**
+         * @return piped handle of contact with given vCard address, 0 if there is no such contact
+         * @throws ContactListException if contact list has not been loaded
+         */
+        uint resolveVCardAddress(const QString &field, const QString &address, 
+                RosterLookup lookup = RosterLookup::EXACT) const;
+
+        /**
+         * @return handles of all piped contacts
+         */
+        Tp::UIntList pipedHandles() const;
+
+        /**
+         * Sets function called whenever set of piped contacts changes, when list is loaded
+         * all piped contacts are reported as added
+         */
+        void setRosterObserver(const RosterObserver &observer);
+
+        /**
+         * @return current version of roster, it stays valid while it is held even if roster changes
+         */
+        PipeRosterSnapshot snapshot() const;
+
     private:
         void contactListStateChangedCb(uint newState);
         void contactsChangedWithIdCb(const Tp::ContactSubscriptionMap &changes, 
                 const Tp::HandleIdentifierMap &identifiers, const Tp::HandleIdentifierMap &removals);
         void contactsChangedCb(const Tp::ContactSubscriptionMap &changes, const Tp::UIntList &removals);
+        void notifyObserver(const RosterDelta &delta);
+
+        /**
+         * Restores roster from snapshot
+         * @return false if there is no usable snapshot
+         */
+        bool restoreSnapshot();
+        void saveSnapshot();
+        /**
+         * Fetches current roster of piped list and announces differences from restored one
+         */
+        void reconcileWithPipedList();
+        /**
+         * Requests attributes of whole piped list, the request is shared with identical ones in flight
+         */
+        QDBusPendingCall getPipedListAttributes();
+        /**
+         * Fetches identifiers and subscriptions of piped list after it was loaded again, 
+         * handles may be different then. Only differences are announced.
+         */
+        void resyncWithPipedList();
+        void announceDelta(const RosterDelta &delta, const char *operation);
+        /**
+         * Applies modification to a copy of current roster and publishes it, nothing is 
+         * published if the modification throws
+         */
+        RosterDelta modifyIndex(const std::function<RosterDelta (PipeRosterIndex&)> &modify);
 
         static QSet<QString> loadFromFile(const QString &dirPath, const QString& fileName);
         static void saveToFile(const QString &dirPath, const QString &filename, const QSet<QString> &pipedHandles);
@@ -122,10 +174,16 @@ class PipeContactList : public QObject {
         QString dirPath;
         QString fileName;
         QStringList attributeInterfaces;
-        Tp::ContactAttributesMap pipedAttrMap;
-        QMap<uint, QString> idMap;
-        QMap<QString, uint> revIdMap;
-        QSet<QString> pipedContacts;
+        PipeRosterSnapshot index;
+        std::mutex writeMutex;
+        QString snapshotPath;
+        QTimer snapshotTimer;
+        // roster changed since last snapshot
+        std::atomic_bool dirty;
+        RosterObserver observer;
+        // piped list is being fetched by loadContactList
+        bool loading;
+        bool resyncing;
 };
 
 #endif
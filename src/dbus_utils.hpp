@@ -0,0 +1,26 @@
+#ifndef PIPE_DBUS_UTILS_HPP
+#define PIPE_DBUS_UTILS_HPP
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QObject>
+
+/**
+ * Answers call received by an adaptor when the call it was forwarded to finishes, with the same
+ * arguments or error. No reply is sent if context is destroyed first.
+ */
+inline void forwardDBusReply(const QDBusConnection &connection, const QDBusMessage &call,
+        const QDBusPendingCall &pendingCall, QObject *context)
+{
+    call.setDelayedReply(true);
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pendingCall, context);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished, 
+            context, [connection, call](QDBusPendingCallWatcher *finishedWatcher) {
+                if(finishedWatcher->isError()) connection.send(call.createErrorReply(finishedWatcher->error()));
+                else connection.send(call.createReply(finishedWatcher->reply().arguments()));
+                finishedWatcher->deleteLater();
+            });
+}
+
+#endif
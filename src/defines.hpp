@@ -6,5 +6,8 @@
 
 #define TP_QT_PIPE_CONFIG_PATH ".config/telepathy-pipes/"
 #define TP_QT_PIPE_CONTACT_LISTS TP_QT_PIPE_CONFIG_PATH"contact_lists/"
+#define TP_QT_PIPE_PLUGINS TP_QT_PIPE_CONFIG_PATH"plugins/"
+#define TP_QT_PIPE_STATE TP_QT_PIPE_CONFIG_PATH"state/"
+#define TP_QT_PIPE_CAPABILITY_CACHE TP_QT_PIPE_CONFIG_PATH"pipes.cache"
 
 #endif
@@ -0,0 +1,227 @@
+#include "file_transfer_type.hpp"
+#include "utils.hpp"
+
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/DBusObject>
+
+namespace {
+
+    // properties announced with the channel, the others change during transfer
+    const char *IMMUTABLE_PROPERTIES[] = { "ContentType", "Filename", "Size", "ContentHashType", "ContentHash",
+        "Description", "Date", "FileCollection" };
+
+} /* anonymous namespace */
+
+// ------------ PipeChannelFileTransferType --------------------------------------------------------------------
+PipeChannelFileTransferType::PipeChannelFileTransferType(
+        Tp::Client::ChannelTypeFileTransferInterface *pipedFileTransferIface, const QVariantMap &pipedProperties)
+    : Tp::AbstractChannelInterface(TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER),
+    pipedFileTransferIface(pipedFileTransferIface),
+    properties(pipedProperties),
+    socketTypes(PipeSocketForwarder::forwardedSocketTypes(
+                qdbus_cast<Tp::SupportedSocketMap>(pipedProperties.value("AvailableSocketTypes"))))
+{
+    connect(pipedFileTransferIface, &Tp::Client::ChannelTypeFileTransferInterface::FileTransferStateChanged,
+            this, &PipeChannelFileTransferType::fileTransferStateChangedCb);
+    connect(pipedFileTransferIface, &Tp::Client::ChannelTypeFileTransferInterface::TransferredBytesChanged,
+            this, &PipeChannelFileTransferType::transferredBytesChangedCb);
+    connect(pipedFileTransferIface, &Tp::Client::ChannelTypeFileTransferInterface::InitialOffsetDefined,
+            this, &PipeChannelFileTransferType::initialOffsetDefinedCb);
+    connect(pipedFileTransferIface, &Tp::Client::ChannelTypeFileTransferInterface::URIDefined,
+            this, &PipeChannelFileTransferType::uriDefinedCb);
+}
+
+QVariantMap PipeChannelFileTransferType::immutableProperties() const {
+    QVariantMap immutable;
+    for(const char *name: IMMUTABLE_PROPERTIES) {
+        if(properties.contains(name))
+            immutable[TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER + QString(".") + name] = properties.value(name);
+    }
+    immutable[TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER + QString(".AvailableSocketTypes")] = QVariant::fromValue(socketTypes);
+    return immutable;
+}
+
+void PipeChannelFileTransferType::createAdaptor() {
+    (void) new PipeChannelFileTransferAdaptor(dbusObject()->dbusConnection(), this, dbusObject());
+}
+
+uint PipeChannelFileTransferType::state() const {
+    return properties.value("State").toUInt();
+}
+
+QString PipeChannelFileTransferType::contentType() const {
+    return properties.value("ContentType").toString();
+}
+
+QString PipeChannelFileTransferType::filename() const {
+    return properties.value("Filename").toString();
+}
+
+qulonglong PipeChannelFileTransferType::size() const {
+    return properties.value("Size").toULongLong();
+}
+
+uint PipeChannelFileTransferType::contentHashType() const {
+    return properties.value("ContentHashType").toUInt();
+}
+
+QString PipeChannelFileTransferType::contentHash() const {
+    return properties.value("ContentHash").toString();
+}
+
+QString PipeChannelFileTransferType::description() const {
+    return properties.value("Description").toString();
+}
+
+qulonglong PipeChannelFileTransferType::date() const {
+    return properties.value("Date").toULongLong();
+}
+
+Tp::SupportedSocketMap PipeChannelFileTransferType::availableSocketTypes() const {
+    return socketTypes;
+}
+
+qulonglong PipeChannelFileTransferType::transferredBytes() const {
+    return properties.value("TransferredBytes").toULongLong();
+}
+
+qulonglong PipeChannelFileTransferType::initialOffset() const {
+    return properties.value("InitialOffset").toULongLong();
+}
+
+QString PipeChannelFileTransferType::uri() const {
+    return properties.value("URI").toString();
+}
+
+QString PipeChannelFileTransferType::fileCollection() const {
+    return properties.value("FileCollection").toString();
+}
+
+void PipeChannelFileTransferType::acceptFile(uint addressType, uint accessControl, qulonglong offset,
+        const PipeSocketForwarder::AddressFunction &done)
+{
+    if(!PipeSocketForwarder::checkSocketType(addressType, accessControl, done)) return;
+    // piped connection manager is reached only through the forwarder, so it does not check the peer
+    PipeSocketForwarder::forwardReply(pipedFileTransferIface->AcceptFile(Tp::SocketAddressTypeUnix,
+                Tp::SocketAccessControlLocalhost, QDBusVariant(QVariant(uint(0))), offset), this, done);
+}
+
+void PipeChannelFileTransferType::provideFile(uint addressType, uint accessControl,
+        const PipeSocketForwarder::AddressFunction &done)
+{
+    if(!PipeSocketForwarder::checkSocketType(addressType, accessControl, done)) return;
+    PipeSocketForwarder::forwardReply(pipedFileTransferIface->ProvideFile(Tp::SocketAddressTypeUnix,
+                Tp::SocketAccessControlLocalhost, QDBusVariant(QVariant(uint(0)))), this, done);
+}
+
+void PipeChannelFileTransferType::fileTransferStateChangedCb(uint state, uint reason) {
+    properties["State"] = state;
+    emit fileTransferStateChanged(state, reason);
+}
+
+void PipeChannelFileTransferType::transferredBytesChangedCb(qulonglong count) {
+    properties["TransferredBytes"] = count;
+    emit transferredBytesChanged(count);
+}
+
+void PipeChannelFileTransferType::initialOffsetDefinedCb(qulonglong initialOffset) {
+    properties["InitialOffset"] = initialOffset;
+    emit initialOffsetDefined(initialOffset);
+}
+
+void PipeChannelFileTransferType::uriDefinedCb(const QString &uri) {
+    properties["URI"] = uri;
+    emit uriDefined(uri);
+}
+
+// ------------ PipeChannelFileTransferAdaptor -----------------------------------------------------------------
+PipeChannelFileTransferAdaptor::PipeChannelFileTransferAdaptor(
+        const QDBusConnection &dbusConnection, PipeChannelFileTransferType *fileTransfer, QObject *parent)
+    : QDBusAbstractAdaptor(parent),
+    dbusConnection(dbusConnection),
+    fileTransfer(fileTransfer)
+{
+    connect(fileTransfer, &PipeChannelFileTransferType::fileTransferStateChanged,
+            this, &PipeChannelFileTransferAdaptor::FileTransferStateChanged);
+    connect(fileTransfer, &PipeChannelFileTransferType::transferredBytesChanged,
+            this, &PipeChannelFileTransferAdaptor::TransferredBytesChanged);
+    connect(fileTransfer, &PipeChannelFileTransferType::initialOffsetDefined,
+            this, &PipeChannelFileTransferAdaptor::InitialOffsetDefined);
+    connect(fileTransfer, &PipeChannelFileTransferType::uriDefined, this, &PipeChannelFileTransferAdaptor::URIDefined);
+}
+
+uint PipeChannelFileTransferAdaptor::State() const {
+    return fileTransfer ? fileTransfer->state() : uint(Tp::FileTransferStateNone);
+}
+
+QString PipeChannelFileTransferAdaptor::ContentType() const {
+    return fileTransfer ? fileTransfer->contentType() : QString();
+}
+
+QString PipeChannelFileTransferAdaptor::Filename() const {
+    return fileTransfer ? fileTransfer->filename() : QString();
+}
+
+qulonglong PipeChannelFileTransferAdaptor::Size() const {
+    return fileTransfer ? fileTransfer->size() : 0;
+}
+
+uint PipeChannelFileTransferAdaptor::ContentHashType() const {
+    return fileTransfer ? fileTransfer->contentHashType() : uint(Tp::FileHashTypeNone);
+}
+
+QString PipeChannelFileTransferAdaptor::ContentHash() const {
+    return fileTransfer ? fileTransfer->contentHash() : QString();
+}
+
+QString PipeChannelFileTransferAdaptor::Description() const {
+    return fileTransfer ? fileTransfer->description() : QString();
+}
+
+qulonglong PipeChannelFileTransferAdaptor::Date() const {
+    return fileTransfer ? fileTransfer->date() : 0;
+}
+
+Tp::SupportedSocketMap PipeChannelFileTransferAdaptor::AvailableSocketTypes() const {
+    return fileTransfer ? fileTransfer->availableSocketTypes() : Tp::SupportedSocketMap();
+}
+
+qulonglong PipeChannelFileTransferAdaptor::TransferredBytes() const {
+    return fileTransfer ? fileTransfer->transferredBytes() : 0;
+}
+
+qulonglong PipeChannelFileTransferAdaptor::InitialOffset() const {
+    return fileTransfer ? fileTransfer->initialOffset() : 0;
+}
+
+QString PipeChannelFileTransferAdaptor::URI() const {
+    return fileTransfer ? fileTransfer->uri() : QString();
+}
+
+QString PipeChannelFileTransferAdaptor::FileCollection() const {
+    return fileTransfer ? fileTransfer->fileCollection() : QString();
+}
+
+void PipeChannelFileTransferAdaptor::AcceptFile(uint addressType, uint accessControl,
+        const QDBusVariant &/*accessControlParam*/, qulonglong offset, const QDBusMessage &dbusMessage)
+{
+    if(!fileTransfer) return;
+    dbusMessage.setDelayedReply(true);
+    fileTransfer->acceptFile(addressType, accessControl, offset, replyTo(dbusMessage));
+}
+
+void PipeChannelFileTransferAdaptor::ProvideFile(uint addressType, uint accessControl,
+        const QDBusVariant &/*accessControlParam*/, const QDBusMessage &dbusMessage)
+{
+    if(!fileTransfer) return;
+    dbusMessage.setDelayedReply(true);
+    fileTransfer->provideFile(addressType, accessControl, replyTo(dbusMessage));
+}
+
+PipeSocketForwarder::AddressFunction PipeChannelFileTransferAdaptor::replyTo(const QDBusMessage &dbusMessage) const {
+    QDBusConnection connection = dbusConnection;
+    return [connection, dbusMessage](const QDBusVariant &address, const QDBusError &error) {
+            if(error.isValid()) connection.send(dbusMessage.createErrorReply(error));
+            else connection.send(dbusMessage.createReply(QVariant::fromValue(address)));
+        };
+}
@@ -0,0 +1,136 @@
+#ifndef PIPE_FILE_TRANSFER_TYPE_HPP
+#define PIPE_FILE_TRANSFER_TYPE_HPP
+
+#include <TelepathyQt/BaseChannel>
+#include <TelepathyQt/Channel>
+#include <QDBusAbstractAdaptor>
+#include <QDBusMessage>
+#include <QDBusVariant>
+#include <QPointer>
+
+#include "socket_forwarder.hpp"
+
+/**
+ * File transfer type of proxy channel. Only Unix sockets with localhost access control are offered,
+ * the client gets socket of PipeSocketForwarder connected to the socket returned by piped channel,
+ * so file data are moved by the socket relay. State and progress of piped transfer are relayed.
+ */
+class PipeChannelFileTransferType : public Tp::AbstractChannelInterface {
+
+    Q_OBJECT;
+
+    public:
+        /**
+         * @param pipedProperties all properties of file transfer type of piped channel
+         */
+        PipeChannelFileTransferType(Tp::Client::ChannelTypeFileTransferInterface *pipedFileTransferIface,
+                const QVariantMap &pipedProperties);
+
+        QVariantMap immutableProperties() const override;
+
+        uint state() const;
+        QString contentType() const;
+        QString filename() const;
+        qulonglong size() const;
+        uint contentHashType() const;
+        QString contentHash() const;
+        QString description() const;
+        qulonglong date() const;
+        Tp::SupportedSocketMap availableSocketTypes() const;
+        qulonglong transferredBytes() const;
+        qulonglong initialOffset() const;
+        QString uri() const;
+        QString fileCollection() const;
+
+        /**
+         * Accepts the file on piped channel, done gets address of socket to read the file from
+         */
+        void acceptFile(uint addressType, uint accessControl, qulonglong offset,
+                const PipeSocketForwarder::AddressFunction &done);
+        /**
+         * Provides the file on piped channel, done gets address of socket to write the file to
+         */
+        void provideFile(uint addressType, uint accessControl, const PipeSocketForwarder::AddressFunction &done);
+
+    signals:
+        void fileTransferStateChanged(uint state, uint reason);
+        void transferredBytesChanged(qulonglong count);
+        void initialOffsetDefined(qulonglong initialOffset);
+        void uriDefined(const QString &uri);
+
+    private:
+        void createAdaptor() override;
+
+        void fileTransferStateChangedCb(uint state, uint reason);
+        void transferredBytesChangedCb(qulonglong count);
+        void initialOffsetDefinedCb(qulonglong initialOffset);
+        void uriDefinedCb(const QString &uri);
+
+    private:
+        Tp::Client::ChannelTypeFileTransferInterface *pipedFileTransferIface;
+        QVariantMap properties;
+        Tp::SupportedSocketMap socketTypes;
+};
+
+typedef Tp::SharedPtr<PipeChannelFileTransferType> PipeChannelFileTransferTypePtr;
+
+/**
+ * Exports PipeChannelFileTransferType on D-Bus, AcceptFile and ProvideFile are answered with delayed reply
+ */
+class PipeChannelFileTransferAdaptor : public QDBusAbstractAdaptor {
+
+    Q_OBJECT;
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Telepathy.Channel.Type.FileTransfer")
+    Q_PROPERTY(uint State READ State)
+    Q_PROPERTY(QString ContentType READ ContentType)
+    Q_PROPERTY(QString Filename READ Filename)
+    Q_PROPERTY(qulonglong Size READ Size)
+    Q_PROPERTY(uint ContentHashType READ ContentHashType)
+    Q_PROPERTY(QString ContentHash READ ContentHash)
+    Q_PROPERTY(QString Description READ Description)
+    Q_PROPERTY(qulonglong Date READ Date)
+    Q_PROPERTY(Tp::SupportedSocketMap AvailableSocketTypes READ AvailableSocketTypes)
+    Q_PROPERTY(qulonglong TransferredBytes READ TransferredBytes)
+    Q_PROPERTY(qulonglong InitialOffset READ InitialOffset)
+    Q_PROPERTY(QString URI READ URI)
+    Q_PROPERTY(QString FileCollection READ FileCollection)
+
+    public:
+        PipeChannelFileTransferAdaptor(const QDBusConnection &dbusConnection,
+                PipeChannelFileTransferType *fileTransfer, QObject *parent);
+
+        uint State() const;
+        QString ContentType() const;
+        QString Filename() const;
+        qulonglong Size() const;
+        uint ContentHashType() const;
+        QString ContentHash() const;
+        QString Description() const;
+        qulonglong Date() const;
+        Tp::SupportedSocketMap AvailableSocketTypes() const;
+        qulonglong TransferredBytes() const;
+        qulonglong InitialOffset() const;
+        QString URI() const;
+        QString FileCollection() const;
+
+    public slots:
+        void AcceptFile(uint addressType, uint accessControl, const QDBusVariant &accessControlParam,
+                qulonglong offset, const QDBusMessage &dbusMessage);
+        void ProvideFile(uint addressType, uint accessControl, const QDBusVariant &accessControlParam,
+                const QDBusMessage &dbusMessage);
+
+    signals:
+        void FileTransferStateChanged(uint state, uint reason);
+        void TransferredBytesChanged(qulonglong count);
+        void InitialOffsetDefined(qulonglong initialOffset);
+        void URIDefined(const QString &URI);
+
+    private:
+        PipeSocketForwarder::AddressFunction replyTo(const QDBusMessage &dbusMessage) const;
+
+    private:
+        QDBusConnection dbusConnection;
+        QPointer<PipeChannelFileTransferType> fileTransfer;
+};
+
+#endif
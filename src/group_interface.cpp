@@ -0,0 +1,342 @@
+#include "group_interface.hpp"
+#include "dbus_utils.hpp"
+#include "utils.hpp"
+
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/DBusObject>
+#include <QDBusPendingCallWatcher>
+
+// ------------ PipeChannelGroupInterface ----------------------------------------------------------------------
+PipeChannelGroupInterface::PipeChannelGroupInterface(const Tp::ChannelPtr &pipedChannel, const QVariantMap &pipedProperties)
+    : Tp::AbstractChannelInterface(TP_QT_IFACE_CHANNEL_INTERFACE_GROUP),
+    pipedGroupIface(pipedChannel->interface<Tp::Client::ChannelInterfaceGroupInterface>()),
+    pipedConnectionIface(QDBusConnection::sessionBus(), 
+            pipedChannel->connection()->busName(), pipedChannel->connection()->objectPath()),
+    flags(pipedProperties.value("GroupFlags").toUInt()),
+    self(pipedProperties.value("SelfHandle").toUInt()),
+    localPending(qdbus_cast<Tp::LocalPendingInfoList>(pipedProperties.value("LocalPendingMembers"))),
+    owners(qdbus_cast<Tp::HandleOwnerMap>(pipedProperties.value("HandleOwners")))
+{
+    Tp::UIntList members = qdbus_cast<Tp::UIntList>(pipedProperties.value("Members"));
+    Tp::UIntList remotePending = qdbus_cast<Tp::UIntList>(pipedProperties.value("RemotePendingMembers"));
+    memberSet = members.toSet();
+    remotePendingSet = remotePending.toSet();
+
+    // older connection managers do not provide identifiers
+    Tp::UIntList contacts = members + remotePending;
+    for(const Tp::LocalPendingInfo &info: localPending) contacts << info.toBeAdded;
+    if(self != 0) contacts << self;
+    Tp::UIntList unknown = collectIdentifiers(
+            contacts, qdbus_cast<Tp::HandleIdentifierMap>(pipedProperties.value("MemberIdentifiers")), identifiers);
+    if(!unknown.isEmpty()) {
+        inspect(unknown, [this](const Tp::HandleIdentifierMap &inspected) {
+                // contacts which left the group meanwhile are not added back
+                for(auto it = inspected.constBegin(); it != inspected.constEnd(); ++it) {
+                    if(isInGroup(it.key()) && !identifiers.contains(it.key())) identifiers[it.key()] = *it;
+                }
+            });
+    }
+
+    connect(pipedGroupIface, &Tp::Client::ChannelInterfaceGroupInterface::MembersChangedDetailed,
+            this, &PipeChannelGroupInterface::membersChangedCb);
+    connect(pipedGroupIface, &Tp::Client::ChannelInterfaceGroupInterface::GroupFlagsChanged,
+            this, &PipeChannelGroupInterface::groupFlagsChangedCb);
+    connect(pipedGroupIface, &Tp::Client::ChannelInterfaceGroupInterface::SelfContactChanged,
+            this, &PipeChannelGroupInterface::selfContactChangedCb);
+    connect(pipedGroupIface, &Tp::Client::ChannelInterfaceGroupInterface::HandleOwnersChangedDetailed,
+            this, &PipeChannelGroupInterface::handleOwnersChangedCb);
+}
+
+QVariantMap PipeChannelGroupInterface::immutableProperties() const {
+    return QVariantMap();
+}
+
+void PipeChannelGroupInterface::createAdaptor() {
+    (void) new PipeChannelGroupAdaptor(dbusObject()->dbusConnection(), this, dbusObject());
+}
+
+uint PipeChannelGroupInterface::groupFlags() const {
+    return flags;
+}
+
+Tp::HandleOwnerMap PipeChannelGroupInterface::handleOwners() const {
+    return owners;
+}
+
+Tp::LocalPendingInfoList PipeChannelGroupInterface::localPendingMembers() const {
+    return localPending;
+}
+
+Tp::UIntList PipeChannelGroupInterface::members() const {
+    return memberSet.toList();
+}
+
+Tp::UIntList PipeChannelGroupInterface::remotePendingMembers() const {
+    return remotePendingSet.toList();
+}
+
+uint PipeChannelGroupInterface::selfHandle() const {
+    return self;
+}
+
+Tp::HandleIdentifierMap PipeChannelGroupInterface::memberIdentifiers() const {
+    return identifiers;
+}
+
+QDBusPendingCall PipeChannelGroupInterface::addMembers(const Tp::UIntList &contacts, const QString &message) {
+    return pipedGroupIface->AddMembers(contacts, message);
+}
+
+QDBusPendingCall PipeChannelGroupInterface::removeMembers(
+        const Tp::UIntList &contacts, const QString &message, uint reason) 
+{
+    return pipedGroupIface->RemoveMembersWithReason(contacts, message, reason);
+}
+
+void PipeChannelGroupInterface::membersChangedCb(const Tp::UIntList &added, const Tp::UIntList &removed,
+        const Tp::UIntList &localPendingAdded, const Tp::UIntList &remotePendingAdded, const QVariantMap &details)
+{
+    std::shared_ptr<MembersDelta> delta = std::make_shared<MembersDelta>();
+    delta->added = added;
+    delta->removed = removed;
+    delta->localPending = localPendingAdded;
+    delta->remotePending = remotePendingAdded;
+    delta->details = details;
+    delta->resolved = false;
+    waitingDeltas << delta;
+
+    uint actor = details.value("actor").toUInt();
+    Tp::UIntList contacts = added + localPendingAdded + remotePendingAdded;
+    if(actor != 0) contacts << actor;
+    Tp::UIntList unknown = collectIdentifiers(
+            contacts, qdbus_cast<Tp::HandleIdentifierMap>(details.value("contact-ids")), delta->identifiers);
+    if(unknown.isEmpty()) {
+        delta->resolved = true;
+        relayDeltas();
+        return;
+    }
+    inspect(unknown, [this, delta](const Tp::HandleIdentifierMap &inspected) {
+            for(auto it = inspected.constBegin(); it != inspected.constEnd(); ++it) delta->identifiers[it.key()] = *it;
+            delta->resolved = true;
+            relayDeltas();
+        });
+}
+
+void PipeChannelGroupInterface::relayDeltas() {
+    while(!waitingDeltas.isEmpty() && waitingDeltas.first()->resolved) {
+        std::shared_ptr<MembersDelta> delta = waitingDeltas.takeFirst();
+        applyDelta(*delta);
+    }
+}
+
+void PipeChannelGroupInterface::applyDelta(const MembersDelta &delta) {
+    const Tp::UIntList &added = delta.added;
+    const Tp::UIntList &removed = delta.removed;
+    const Tp::UIntList &localPendingAdded = delta.localPending;
+    const Tp::UIntList &remotePendingAdded = delta.remotePending;
+    const Tp::HandleIdentifierMap &changedIds = delta.identifiers;
+    uint actor = delta.details.value("actor").toUInt();
+    uint reason = delta.details.value("change-reason").toUInt();
+    QString message = delta.details.value("message").toString();
+
+    for(uint handle: removed) {
+        memberSet.remove(handle);
+        removePending(handle);
+        identifiers.remove(handle);
+    }
+    for(uint handle: added) {
+        removePending(handle);
+        memberSet.insert(handle);
+    }
+    for(uint handle: localPendingAdded) {
+        memberSet.remove(handle);
+        removePending(handle);
+        Tp::LocalPendingInfo info;
+        info.toBeAdded = handle;
+        info.actor = actor;
+        info.reason = reason;
+        info.message = message;
+        localPending << info;
+    }
+    for(uint handle: remotePendingAdded) {
+        memberSet.remove(handle);
+        removePending(handle);
+        remotePendingSet.insert(handle);
+    }
+    for(auto it = changedIds.constBegin(); it != changedIds.constEnd(); ++it) identifiers[it.key()] = *it;
+
+    QVariantMap relayedDetails = delta.details;
+    relayedDetails["contact-ids"] = QVariant::fromValue(changedIds);
+    emit membersChangedDetailed(added, removed, localPendingAdded, remotePendingAdded, relayedDetails);
+    emit membersChanged(message, added, removed, localPendingAdded, remotePendingAdded, actor, reason);
+}
+
+void PipeChannelGroupInterface::groupFlagsChangedCb(uint added, uint removed) {
+    flags = (flags | added) & ~removed;
+    emit groupFlagsChanged(added, removed);
+}
+
+void PipeChannelGroupInterface::selfContactChangedCb(uint selfHandle, const QString &selfID) {
+    self = selfHandle;
+    identifiers[selfHandle] = selfID;
+    emit selfHandleChanged(selfHandle);
+    emit selfContactChanged(selfHandle, selfID);
+}
+
+void PipeChannelGroupInterface::handleOwnersChangedCb(const Tp::HandleOwnerMap &added, const Tp::UIntList &removed,
+        const Tp::HandleIdentifierMap &ownerIds)
+{
+    for(uint handle: removed) owners.remove(handle);
+    for(auto it = added.constBegin(); it != added.constEnd(); ++it) owners[it.key()] = *it;
+    emit handleOwnersChanged(added, removed);
+    emit handleOwnersChangedDetailed(added, removed, ownerIds);
+}
+
+Tp::UIntList PipeChannelGroupInterface::collectIdentifiers(const Tp::UIntList &handles, 
+        const Tp::HandleIdentifierMap &known, Tp::HandleIdentifierMap &result) const
+{
+    Tp::UIntList unknown;
+    for(uint handle: handles) {
+        auto it = known.constFind(handle);
+        if(it != known.constEnd()) result[handle] = *it;
+        else if(identifiers.contains(handle)) result[handle] = identifiers.value(handle);
+        else if(!unknown.contains(handle)) unknown << handle;
+    }
+    return unknown;
+}
+
+void PipeChannelGroupInterface::inspect(const Tp::UIntList &handles, 
+        const std::function<void (const Tp::HandleIdentifierMap&)> &inspected)
+{
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+            pipedConnectionIface.InspectHandles(Tp::HandleTypeContact, handles), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [handles, inspected](QDBusPendingCallWatcher *finishedWatcher) {
+            QDBusPendingReply<QStringList> inspectRep = *finishedWatcher;
+            finishedWatcher->deleteLater();
+            Tp::HandleIdentifierMap result;
+            if(inspectRep.isValid() && inspectRep.value().size() == handles.size()) {
+                for(int i = 0; i < handles.size(); ++i) result[handles[i]] = inspectRep.value()[i];
+            } else {
+                pWarning() << "Could not inspect members of piped channel: " << inspectRep.error().message();
+            }
+            inspected(result);
+        });
+}
+
+bool PipeChannelGroupInterface::isInGroup(uint handle) const {
+    if(handle == self || memberSet.contains(handle) || remotePendingSet.contains(handle)) return true;
+    for(const Tp::LocalPendingInfo &info: localPending) {
+        if(info.toBeAdded == handle) return true;
+    }
+    return false;
+}
+
+void PipeChannelGroupInterface::removePending(uint handle) {
+    remotePendingSet.remove(handle);
+    for(auto it = localPending.begin(); it != localPending.end(); ) {
+        if(it->toBeAdded == handle) it = localPending.erase(it);
+        else ++it;
+    }
+}
+
+// ------------ PipeChannelGroupAdaptor ------------------------------------------------------------------------
+PipeChannelGroupAdaptor::PipeChannelGroupAdaptor(
+        const QDBusConnection &dbusConnection, PipeChannelGroupInterface *group, QObject *parent) 
+    : QDBusAbstractAdaptor(parent),
+    dbusConnection(dbusConnection),
+    group(group)
+{
+    connect(group, &PipeChannelGroupInterface::handleOwnersChanged, this, &PipeChannelGroupAdaptor::HandleOwnersChanged);
+    connect(group, &PipeChannelGroupInterface::handleOwnersChangedDetailed, 
+            this, &PipeChannelGroupAdaptor::HandleOwnersChangedDetailed);
+    connect(group, &PipeChannelGroupInterface::selfHandleChanged, this, &PipeChannelGroupAdaptor::SelfHandleChanged);
+    connect(group, &PipeChannelGroupInterface::selfContactChanged, this, &PipeChannelGroupAdaptor::SelfContactChanged);
+    connect(group, &PipeChannelGroupInterface::groupFlagsChanged, this, &PipeChannelGroupAdaptor::GroupFlagsChanged);
+    connect(group, &PipeChannelGroupInterface::membersChanged, this, &PipeChannelGroupAdaptor::MembersChanged);
+    connect(group, &PipeChannelGroupInterface::membersChangedDetailed, 
+            this, &PipeChannelGroupAdaptor::MembersChangedDetailed);
+}
+
+uint PipeChannelGroupAdaptor::GroupFlags() const {
+    return group ? group->groupFlags() : 0;
+}
+
+Tp::HandleOwnerMap PipeChannelGroupAdaptor::HandleOwners() const {
+    return group ? group->handleOwners() : Tp::HandleOwnerMap();
+}
+
+Tp::LocalPendingInfoList PipeChannelGroupAdaptor::LocalPendingMembers() const {
+    return group ? group->localPendingMembers() : Tp::LocalPendingInfoList();
+}
+
+Tp::UIntList PipeChannelGroupAdaptor::Members() const {
+    return group ? group->members() : Tp::UIntList();
+}
+
+Tp::UIntList PipeChannelGroupAdaptor::RemotePendingMembers() const {
+    return group ? group->remotePendingMembers() : Tp::UIntList();
+}
+
+uint PipeChannelGroupAdaptor::SelfHandle() const {
+    return group ? group->selfHandle() : 0;
+}
+
+Tp::HandleIdentifierMap PipeChannelGroupAdaptor::MemberIdentifiers() const {
+    return group ? group->memberIdentifiers() : Tp::HandleIdentifierMap();
+}
+
+void PipeChannelGroupAdaptor::AddMembers(const Tp::UIntList &contacts, const QString &message, const QDBusMessage &dbusMessage) {
+    if(group) forwardDBusReply(dbusConnection, dbusMessage, group->addMembers(contacts, message), this);
+}
+
+Tp::UIntList PipeChannelGroupAdaptor::GetAllMembers(Tp::UIntList &localPending, Tp::UIntList &remotePending) {
+    localPending = GetLocalPendingMembers();
+    remotePending = RemotePendingMembers();
+    return Members();
+}
+
+uint PipeChannelGroupAdaptor::GetGroupFlags() {
+    return GroupFlags();
+}
+
+Tp::UIntList PipeChannelGroupAdaptor::GetHandleOwners(const Tp::UIntList &handles) {
+    // handles which are not channel-specific are their own owners
+    Tp::HandleOwnerMap owners = HandleOwners();
+    Tp::UIntList result;
+    for(uint handle: handles) result << owners.value(handle, handle);
+    return result;
+}
+
+Tp::UIntList PipeChannelGroupAdaptor::GetLocalPendingMembers() {
+    Tp::UIntList handles;
+    for(const Tp::LocalPendingInfo &info: LocalPendingMembers()) handles << info.toBeAdded;
+    return handles;
+}
+
+Tp::LocalPendingInfoList PipeChannelGroupAdaptor::GetLocalPendingMembersWithInfo() {
+    return LocalPendingMembers();
+}
+
+Tp::UIntList PipeChannelGroupAdaptor::GetMembers() {
+    return Members();
+}
+
+Tp::UIntList PipeChannelGroupAdaptor::GetRemotePendingMembers() {
+    return RemotePendingMembers();
+}
+
+uint PipeChannelGroupAdaptor::GetSelfHandle() {
+    return SelfHandle();
+}
+
+void PipeChannelGroupAdaptor::RemoveMembers(
+        const Tp::UIntList &contacts, const QString &message, const QDBusMessage &dbusMessage) 
+{
+    RemoveMembersWithReason(contacts, message, Tp::ChannelGroupChangeReasonNone, dbusMessage);
+}
+
+void PipeChannelGroupAdaptor::RemoveMembersWithReason(
+        const Tp::UIntList &contacts, const QString &message, uint reason, const QDBusMessage &dbusMessage) 
+{
+    if(group) forwardDBusReply(dbusConnection, dbusMessage, group->removeMembers(contacts, message, reason), this);
+}
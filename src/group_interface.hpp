@@ -0,0 +1,168 @@
+#ifndef PIPE_GROUP_INTERFACE_HPP
+#define PIPE_GROUP_INTERFACE_HPP
+
+#include <TelepathyQt/BaseChannel>
+#include <TelepathyQt/Channel>
+#include <QDBusAbstractAdaptor>
+#include <QDBusMessage>
+#include <QPointer>
+#include <QSet>
+#include <functional>
+#include <memory>
+
+/**
+ * Group interface of proxy channel. State of the group is obtained once when channel is piped,
+ * then changes of members, pending members, flags, owners and self handle of piped channel are 
+ * relayed. Identifiers of contacts are taken from the changes, or inspected on piped connection 
+ * when the piped channel does not provide them. Inspection does not block, a change waiting for 
+ * identifiers holds back the changes of members which came after it, so they are relayed in order.
+ */
+class PipeChannelGroupInterface : public Tp::AbstractChannelInterface {
+
+    Q_OBJECT;
+
+    public:
+        /**
+         * @param pipedProperties all properties of group interface of piped channel
+         */
+        PipeChannelGroupInterface(const Tp::ChannelPtr &pipedChannel, const QVariantMap &pipedProperties);
+
+        QVariantMap immutableProperties() const override;
+
+        uint groupFlags() const;
+        Tp::HandleOwnerMap handleOwners() const;
+        Tp::LocalPendingInfoList localPendingMembers() const;
+        Tp::UIntList members() const;
+        Tp::UIntList remotePendingMembers() const;
+        uint selfHandle() const;
+        Tp::HandleIdentifierMap memberIdentifiers() const;
+
+        QDBusPendingCall addMembers(const Tp::UIntList &contacts, const QString &message);
+        QDBusPendingCall removeMembers(const Tp::UIntList &contacts, const QString &message, uint reason);
+
+    signals:
+        void handleOwnersChanged(const Tp::HandleOwnerMap &added, const Tp::UIntList &removed);
+        void handleOwnersChangedDetailed(const Tp::HandleOwnerMap &added, const Tp::UIntList &removed,
+                const Tp::HandleIdentifierMap &identifiers);
+        void selfHandleChanged(uint selfHandle);
+        void selfContactChanged(uint selfHandle, const QString &selfID);
+        void groupFlagsChanged(uint added, uint removed);
+        void membersChanged(const QString &message, const Tp::UIntList &added, const Tp::UIntList &removed,
+                const Tp::UIntList &localPending, const Tp::UIntList &remotePending, uint actor, uint reason);
+        void membersChangedDetailed(const Tp::UIntList &added, const Tp::UIntList &removed,
+                const Tp::UIntList &localPending, const Tp::UIntList &remotePending, const QVariantMap &details);
+
+    private:
+        /**
+         * Change of members waiting to be relayed
+         */
+        struct MembersDelta {
+            Tp::UIntList added;
+            Tp::UIntList removed;
+            Tp::UIntList localPending;
+            Tp::UIntList remotePending;
+            QVariantMap details;
+            Tp::HandleIdentifierMap identifiers;
+            bool resolved;
+        };
+
+        void createAdaptor() override;
+
+        void membersChangedCb(const Tp::UIntList &added, const Tp::UIntList &removed,
+                const Tp::UIntList &localPending, const Tp::UIntList &remotePending, const QVariantMap &details);
+        void groupFlagsChangedCb(uint added, uint removed);
+        void selfContactChangedCb(uint selfHandle, const QString &selfID);
+        void handleOwnersChangedCb(const Tp::HandleOwnerMap &added, const Tp::UIntList &removed,
+                const Tp::HandleIdentifierMap &identifiers);
+
+        /**
+         * Adds identifiers of given handles found in known or among members to result
+         * @return handles whose identifiers have to be inspected on piped connection
+         */
+        Tp::UIntList collectIdentifiers(const Tp::UIntList &handles, const Tp::HandleIdentifierMap &known,
+                Tp::HandleIdentifierMap &result) const;
+        /**
+         * Inspects handles on piped connection, identifiers which could not be inspected are missing
+         */
+        void inspect(const Tp::UIntList &handles, const std::function<void (const Tp::HandleIdentifierMap&)> &inspected);
+        /**
+         * Relays changes of members from the oldest one until one waiting for identifiers
+         */
+        void relayDeltas();
+        void applyDelta(const MembersDelta &delta);
+        bool isInGroup(uint handle) const;
+        void removePending(uint handle);
+
+    private:
+        Tp::Client::ChannelInterfaceGroupInterface *pipedGroupIface;
+        Tp::Client::ConnectionInterface pipedConnectionIface;
+        uint flags;
+        uint self;
+        QSet<uint> memberSet;
+        QSet<uint> remotePendingSet;
+        Tp::LocalPendingInfoList localPending;
+        Tp::HandleOwnerMap owners;
+        Tp::HandleIdentifierMap identifiers;
+        QList<std::shared_ptr<MembersDelta>> waitingDeltas;
+};
+
+typedef Tp::SharedPtr<PipeChannelGroupInterface> PipeChannelGroupInterfacePtr;
+
+/**
+ * Exports PipeChannelGroupInterface on D-Bus
+ */
+class PipeChannelGroupAdaptor : public QDBusAbstractAdaptor {
+
+    Q_OBJECT;
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Telepathy.Channel.Interface.Group")
+    Q_PROPERTY(uint GroupFlags READ GroupFlags)
+    Q_PROPERTY(Tp::HandleOwnerMap HandleOwners READ HandleOwners)
+    Q_PROPERTY(Tp::LocalPendingInfoList LocalPendingMembers READ LocalPendingMembers)
+    Q_PROPERTY(Tp::UIntList Members READ Members)
+    Q_PROPERTY(Tp::UIntList RemotePendingMembers READ RemotePendingMembers)
+    Q_PROPERTY(uint SelfHandle READ SelfHandle)
+    Q_PROPERTY(Tp::HandleIdentifierMap MemberIdentifiers READ MemberIdentifiers)
+
+    public:
+        PipeChannelGroupAdaptor(const QDBusConnection &dbusConnection, PipeChannelGroupInterface *group, QObject *parent);
+
+        uint GroupFlags() const;
+        Tp::HandleOwnerMap HandleOwners() const;
+        Tp::LocalPendingInfoList LocalPendingMembers() const;
+        Tp::UIntList Members() const;
+        Tp::UIntList RemotePendingMembers() const;
+        uint SelfHandle() const;
+        Tp::HandleIdentifierMap MemberIdentifiers() const;
+
+    public slots:
+        void AddMembers(const Tp::UIntList &contacts, const QString &message, const QDBusMessage &dbusMessage);
+        Tp::UIntList GetAllMembers(Tp::UIntList &localPending, Tp::UIntList &remotePending);
+        uint GetGroupFlags();
+        Tp::UIntList GetHandleOwners(const Tp::UIntList &handles);
+        Tp::UIntList GetLocalPendingMembers();
+        Tp::LocalPendingInfoList GetLocalPendingMembersWithInfo();
+        Tp::UIntList GetMembers();
+        Tp::UIntList GetRemotePendingMembers();
+        uint GetSelfHandle();
+        void RemoveMembers(const Tp::UIntList &contacts, const QString &message, const QDBusMessage &dbusMessage);
+        void RemoveMembersWithReason(const Tp::UIntList &contacts, const QString &message, uint reason,
+                const QDBusMessage &dbusMessage);
+
+    signals:
+        void HandleOwnersChanged(const Tp::HandleOwnerMap &added, const Tp::UIntList &removed);
+        void HandleOwnersChangedDetailed(const Tp::HandleOwnerMap &added, const Tp::UIntList &removed,
+                const Tp::HandleIdentifierMap &identifiers);
+        void SelfHandleChanged(uint selfHandle);
+        void SelfContactChanged(uint selfHandle, const QString &selfID);
+        void GroupFlagsChanged(uint added, uint removed);
+        void MembersChanged(const QString &message, const Tp::UIntList &added, const Tp::UIntList &removed,
+                const Tp::UIntList &localPending, const Tp::UIntList &remotePending, uint actor, uint reason);
+        void MembersChangedDetailed(const Tp::UIntList &added, const Tp::UIntList &removed,
+                const Tp::UIntList &localPending, const Tp::UIntList &remotePending, const QVariantMap &details);
+
+    private:
+        QDBusConnection dbusConnection;
+        QPointer<PipeChannelGroupInterface> group;
+};
+
+#endif
@@ -0,0 +1,128 @@
+#include "idle_channel_manager.hpp"
+#include "utils.hpp"
+
+#include <TelepathyQt/Channel>
+#include <QDateTime>
+#include <algorithm>
+
+namespace {
+
+    const int RECLAIM_INTERVAL = 30 * 1000; // ms
+    const int MIN_RECLAIM_INTERVAL = 1000; // ms
+
+} /* anonymous namespace */
+
+PipeIdleChannelManager::PipeIdleChannelManager(const QDBusConnection &bus, size_t budget, qint64 idleTimeout, 
+        const RepipeFunction &repipe)
+    : bus(bus), budget(budget), idleTimeout(idleTimeout), repipe(repipe)
+{
+    // short idle timeout is checked more often
+    reclaimTimer.setInterval(int(qBound<qint64>(MIN_RECLAIM_INTERVAL, idleTimeout, RECLAIM_INTERVAL)));
+    connect(&reclaimTimer, &QTimer::timeout, this, &PipeIdleChannelManager::reclaimIdle);
+    reclaimTimer.start();
+}
+
+PipeIdleChannelManager::~PipeIdleChannelManager() {
+    for(auto it = dormant.constBegin(); it != dormant.constEnd(); ++it) watch(it.key(), *it, false);
+}
+
+void PipeIdleChannelManager::track(const PipeProxyChannelPtr &channel) {
+
+    // channel could be piped again by client request before it received anything
+    QString path = channel->getPipedChannel()->objectPath();
+    auto it = dormant.find(path);
+    if(it != dormant.end()) {
+        watch(path, *it, false);
+        dormant.erase(it);
+    }
+
+    channels.append(QPointer<PipeProxyChannel>(channel.data()));
+}
+
+QList<int> PipeIdleChannelManager::selectIdle(const QList<ChannelUsage> &usage, size_t budget, qint64 now, 
+        qint64 idleTimeout) 
+{
+    size_t used = 0;
+    for(const ChannelUsage &channel: usage) used += channel.size;
+    if(used <= budget) return QList<int>();
+
+    QList<int> idle;
+    for(int i = 0; i < usage.size(); ++i) {
+        if(now - usage[i].lastActivity >= idleTimeout && !usage[i].hasPendingMessages) idle.append(i);
+    }
+    std::sort(idle.begin(), idle.end(), [&usage](int first, int second) {
+                return usage[first].lastActivity < usage[second].lastActivity;
+            });
+
+    QList<int> selected;
+    for(int i: idle) {
+        if(used <= budget) break;
+        used -= usage[i].size;
+        selected.append(i);
+    }
+    return selected;
+}
+
+void PipeIdleChannelManager::reclaimIdle() {
+
+    channels.removeAll(QPointer<PipeProxyChannel>());
+
+    QList<ChannelUsage> usage;
+    for(const QPointer<PipeProxyChannel> &channel: channels) 
+        usage.append({ channel->estimatedSize(), channel->lastActivity(), channel->hasPendingMessages() });
+
+    QList<int> selected = selectIdle(usage, budget, QDateTime::currentMSecsSinceEpoch(), idleTimeout);
+    if(selected.isEmpty()) return;
+
+    pDebug() << "Proxy channels are over budget of " << budget << " bytes, closing idle: " << selected.size();
+    QList<QPointer<PipeProxyChannel>> idle;
+    for(int i: selected) idle.append(channels[i]);
+
+    for(const QPointer<PipeProxyChannel> &channel: idle) {
+        Tp::ChannelPtr pipedChannel = channel->getPipedChannel();
+        DormantChannel dormantChannel { pipedChannel->busName(), pipedChannel->channelType(),
+            pipedChannel->targetHandleType(), pipedChannel->targetHandle() };
+        dormant[pipedChannel->objectPath()] = dormantChannel;
+        watch(pipedChannel->objectPath(), dormantChannel, true);
+
+        channels.removeOne(channel);
+        channel->reclaim();
+    }
+}
+
+void PipeIdleChannelManager::watch(const QString &path, const DormantChannel &dormantChannel, bool connect) {
+
+    if(connect) {
+        bus.connect(dormantChannel.busName, path, TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES, "MessageReceived",
+                this, SLOT(dormantMessageReceivedCb(QDBusMessage)));
+        bus.connect(dormantChannel.busName, path, TP_QT_IFACE_CHANNEL, "Closed",
+                this, SLOT(dormantClosedCb(QDBusMessage)));
+    } else {
+        bus.disconnect(dormantChannel.busName, path, TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES, "MessageReceived",
+                this, SLOT(dormantMessageReceivedCb(QDBusMessage)));
+        bus.disconnect(dormantChannel.busName, path, TP_QT_IFACE_CHANNEL, "Closed",
+                this, SLOT(dormantClosedCb(QDBusMessage)));
+    }
+}
+
+void PipeIdleChannelManager::dormantMessageReceivedCb(const QDBusMessage &message) {
+
+    auto it = dormant.find(message.path());
+    if(it == dormant.end()) return;
+
+    DormantChannel dormantChannel = *it;
+    watch(message.path(), dormantChannel, false);
+    dormant.erase(it);
+
+    pDebug() << "Piping again channel: " << message.path();
+    repipe(dormantChannel.channelType, dormantChannel.targetHandleType, dormantChannel.targetHandle);
+}
+
+void PipeIdleChannelManager::dormantClosedCb(const QDBusMessage &message) {
+
+    auto it = dormant.find(message.path());
+    if(it == dormant.end()) return;
+
+    watch(message.path(), *it, false);
+    dormant.erase(it);
+}
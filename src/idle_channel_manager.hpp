@@ -0,0 +1,86 @@
+#ifndef PIPE_IDLE_CHANNEL_MANAGER_HPP
+#define PIPE_IDLE_CHANNEL_MANAGER_HPP
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <functional>
+
+#include "proxy_channel.hpp"
+
+/**
+ * Keeps memory held by proxy channels of one connection within budget. When proxies exceed it,
+ * those idle for the longest time without pending messages are closed, while their piped 
+ * channels stay open. Such channel is piped again when it receives a message, the message 
+ * is then obtained by the new proxy from pending messages of piped channel.
+ */
+class PipeIdleChannelManager : public QObject {
+
+    Q_OBJECT;
+    Q_DISABLE_COPY(PipeIdleChannelManager)
+
+    public:
+        /**
+         * Pipes again channel of given type and target
+         */
+        typedef std::function<void (const QString &channelType, uint targetHandleType, uint targetHandle)> RepipeFunction;
+
+        /**
+         * Memory and activity of one proxy
+         */
+        struct ChannelUsage {
+            size_t size;
+            qint64 lastActivity;
+            bool hasPendingMessages;
+        };
+
+        /**
+         * @param bus connection of piped channels, dormant channels are watched on it
+         * @param budget memory in bytes which proxies of connection may hold
+         * @param idleTimeout time in ms after which proxy without activity may be closed
+         */
+        PipeIdleChannelManager(const QDBusConnection &bus, size_t budget, qint64 idleTimeout, 
+                const RepipeFunction &repipe);
+        virtual ~PipeIdleChannelManager();
+
+        void track(const PipeProxyChannelPtr &channel);
+
+        /**
+         * Selects proxies to close so that the rest fits in budget, the longest idle ones without 
+         * pending messages are selected first. Less may be selected when others are not idle.
+         * @param now current time in ms since epoch
+         * @return indexes of selected proxies
+         */
+        static QList<int> selectIdle(const QList<ChannelUsage> &usage, size_t budget, qint64 now, qint64 idleTimeout);
+
+    private slots:
+        void dormantMessageReceivedCb(const QDBusMessage &message);
+        void dormantClosedCb(const QDBusMessage &message);
+
+    private:
+        struct DormantChannel {
+            QString busName;
+            QString channelType;
+            uint targetHandleType;
+            uint targetHandle;
+        };
+
+        void reclaimIdle();
+        void watch(const QString &path, const DormantChannel &dormantChannel, bool connect);
+
+    private:
+        QDBusConnection bus;
+        size_t budget;
+        qint64 idleTimeout;
+        RepipeFunction repipe;
+        QList<QPointer<PipeProxyChannel>> channels;
+        // piped channels without proxy by object path
+        QHash<QString, DormantChannel> dormant;
+        QTimer reclaimTimer;
+};
+
+#endif
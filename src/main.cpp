@@ -11,6 +11,9 @@ void registerPipeTypes() {
     typedef Tp::RequestableChannelClassList RequestableChannelClassList;
     qRegisterMetaType<RequestableChannelClassList>("RequestableChannelClassList");
     qDBusRegisterMetaType<RequestableChannelClassList>();
+    typedef Tp::MessagePartListList MessagePartListList;
+    qRegisterMetaType<MessagePartListList>("MessagePartListList");
+    qDBusRegisterMetaType<MessagePartListList>();
 }
 
 int main(int argc, char **argv) {
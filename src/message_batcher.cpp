@@ -0,0 +1,98 @@
+#include "message_batcher.hpp"
+#include "utils.hpp"
+
+#include <QDBusPendingCallWatcher>
+#include <QTimer>
+#include <algorithm>
+
+namespace {
+
+    const int MIN_BATCH_SIZE = 1;
+    const int MAX_BATCH_SIZE = 256;
+    // batches transformed faster than that may grow, slower ones shrink
+    const qint64 TARGET_BATCH_MSECS = 20;
+
+} /* anonymous namespace */
+
+PipeMessageBatcher::PipeMessageBatcher(const PipeChain &transforms, MessageSink sink, QObject *parent) 
+    : QObject(parent),
+    transforms(transforms),
+    sink(std::move(sink)),
+    currentBatchSize(MIN_BATCH_SIZE)
+{ }
+
+void PipeMessageBatcher::add(const Tp::MessagePartList &message) {
+    queue.append(message);
+    scheduleFlush();
+}
+
+int PipeMessageBatcher::batchSize() const {
+    return currentBatchSize;
+}
+
+void PipeMessageBatcher::scheduleFlush() {
+    // messages arriving in the same iteration of event loop get into the same batch
+    if(inFlight || flushScheduled) return;
+    flushScheduled = true;
+    QTimer::singleShot(0, this, [this]() {
+        flushScheduled = false;
+        flush();
+    });
+}
+
+void PipeMessageBatcher::flush() {
+
+    if(inFlight || queue.isEmpty()) return;
+
+    batchWasFull = queue.size() >= currentBatchSize;
+    int count = std::min(queue.size(), currentBatchSize);
+    batch = queue.mid(0, count);
+    queue.erase(queue.begin(), queue.begin() + count);
+
+    inFlight = true;
+    batchTimer.start();
+    transformStage(0);
+}
+
+void PipeMessageBatcher::transformStage(size_t stage) {
+
+    for(; stage < transforms.size() && transforms[stage]->isPlugin(); ++stage) {
+        for(Tp::MessagePartList &message: batch) transforms[stage]->transformIncoming(message);
+    }
+    if(stage == transforms.size()) {
+        finishBatch();
+        return;
+    }
+
+    const PipePtr &transform = transforms[stage];
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(transform->transformMessages(true, batch), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished,
+            this, [this, stage, transform](QDBusPendingCallWatcher *finishedWatcher) {
+                QDBusPendingReply<Tp::MessagePartListList> transformRep = *finishedWatcher;
+                if(transformRep.isValid() && transformRep.value().size() == batch.size()) {
+                    batch = transformRep.value();
+                } else {
+                    // messages are passed further untransformed
+                    pWarning() << "Pipe: " << transform->name() << " could not transform batch of " << batch.size()
+                        << " messages: " << transformRep.error().message();
+                }
+                finishedWatcher->deleteLater();
+                transformStage(stage + 1);
+            });
+}
+
+void PipeMessageBatcher::finishBatch() {
+
+    qint64 elapsed = batchTimer.elapsed();
+    if(elapsed > TARGET_BATCH_MSECS) 
+        currentBatchSize = std::max(MIN_BATCH_SIZE, currentBatchSize / 2);
+    else if(batchWasFull && elapsed < TARGET_BATCH_MSECS / 2)
+        currentBatchSize = std::min(MAX_BATCH_SIZE, currentBatchSize * 2);
+
+    Tp::MessagePartListList transformed;
+    transformed.swap(batch);
+    for(const Tp::MessagePartList &message: transformed) sink(message);
+
+    inFlight = false;
+    scheduleFlush();
+}
@@ -0,0 +1,48 @@
+#ifndef PIPE_MESSAGE_BATCHER_HPP
+#define PIPE_MESSAGE_BATCHER_HPP
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <TelepathyQt/Types>
+#include <functional>
+
+#include "types.hpp"
+
+/**
+ * Passes received messages through transforming pipes in batches, so that one call to each pipe
+ * handles many messages. Size of a batch adapts to load: it grows while batches are transformed
+ * quickly and the queue is not drained, and shrinks when pipes are slow. Order of messages is kept.
+ */
+class PipeMessageBatcher : public QObject {
+
+    public:
+        typedef std::function<void(const Tp::MessagePartList&)> MessageSink;
+
+        /**
+         * @param sink gets messages after they went through all pipes
+         */
+        PipeMessageBatcher(const PipeChain &transforms, MessageSink sink, QObject *parent = nullptr);
+
+        void add(const Tp::MessagePartList &message);
+
+        int batchSize() const;
+
+    private:
+        void scheduleFlush();
+        void flush();
+        void transformStage(size_t stage);
+        void finishBatch();
+
+    private:
+        PipeChain transforms;
+        MessageSink sink;
+        Tp::MessagePartListList queue;
+        Tp::MessagePartListList batch;
+        bool inFlight = false;
+        bool flushScheduled = false;
+        bool batchWasFull = false;
+        int currentBatchSize;
+        QElapsedTimer batchTimer;
+};
+
+#endif
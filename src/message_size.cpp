@@ -0,0 +1,54 @@
+#include "message_size.hpp"
+
+namespace {
+
+    // bookkeeping of containers and implicitly shared data, roughly as on 64 bit platforms
+    const size_t LIST_NODE_SIZE = 16;
+    const size_t MAP_NODE_SIZE = 48;
+    const size_t SHARED_DATA_SIZE = 24;
+    // values which are not strings nor byte arrays, e.g. numbers or D-Bus structures
+    const size_t OTHER_VALUE_SIZE = 32;
+
+    size_t stringSize(const QString &string) {
+        return SHARED_DATA_SIZE + size_t(string.size()) * sizeof(QChar);
+    }
+
+    size_t valueSize(const QVariant &value) {
+        switch(value.userType()) {
+            case QMetaType::QString:
+                return stringSize(value.toString());
+            case QMetaType::QByteArray:
+                return SHARED_DATA_SIZE + size_t(value.toByteArray().size());
+            case QMetaType::QStringList: {
+                size_t size = SHARED_DATA_SIZE;
+                for(const QString &string: value.toStringList()) size += LIST_NODE_SIZE + stringSize(string);
+                return size;
+            }
+            default:
+                return OTHER_VALUE_SIZE;
+        }
+    }
+
+} /* anonymous namespace */
+
+namespace message_size {
+
+    size_t estimate(const Tp::MessagePartList &message) {
+
+        size_t size = SHARED_DATA_SIZE;
+        for(const Tp::MessagePart &part: message) {
+            size += LIST_NODE_SIZE + SHARED_DATA_SIZE;
+            for(auto it = part.constBegin(); it != part.constEnd(); ++it)
+                size += MAP_NODE_SIZE + stringSize(it.key()) + valueSize(it->variant());
+        }
+        return size;
+    }
+
+    size_t estimate(const Tp::MessagePartListList &messages) {
+
+        size_t size = 0;
+        for(const Tp::MessagePartList &message: messages) size += LIST_NODE_SIZE + estimate(message);
+        return size;
+    }
+
+} /* message_size namespace */
@@ -0,0 +1,24 @@
+#ifndef PIPE_MESSAGE_SIZE_HPP
+#define PIPE_MESSAGE_SIZE_HPP
+
+#include <TelepathyQt/Types>
+#include <cstddef>
+
+/**
+ * Estimates of memory held by messages, they are used to keep proxies within memory budget
+ */
+namespace message_size {
+
+    /**
+     * @return approximate number of bytes held by message, its headers and contents included
+     */
+    size_t estimate(const Tp::MessagePartList &message);
+
+    /**
+     * @return sum of estimates of given messages
+     */
+    size_t estimate(const Tp::MessagePartListList &messages);
+
+} /* message_size namespace */
+
+#endif
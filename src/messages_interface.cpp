@@ -0,0 +1,230 @@
+#include "messages_interface.hpp"
+#include "utils.hpp"
+
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/DBusObject>
+#include <QDBusError>
+#include <QDBusPendingCallWatcher>
+
+// ------------ PipeChannelMessagesInterface -------------------------------------------------------------------
+PipeChannelMessagesInterface::PipeChannelMessagesInterface(
+        Tp::BaseChannelTextType *textType,
+        Tp::Client::ChannelInterfaceMessagesInterface *pipedMesIface,
+        const QStringList &supportedContentTypes,
+        const Tp::UIntList &messageTypes,
+        uint messagePartSupportFlags,
+        uint deliveryReportingSupport,
+        const PipeChain &transforms,
+        const PipeSentTokenIndexPtr &sentTokens,
+        const PipeSendSchedulerPtr &sendScheduler)
+    : Tp::AbstractChannelInterface(TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES),
+    textType(textType),
+    pipedMesIface(pipedMesIface),
+    contentTypes(supportedContentTypes),
+    types(messageTypes),
+    partSupportFlags(messagePartSupportFlags),
+    reportingSupport(deliveryReportingSupport),
+    transforms(transforms),
+    sentTokens(sentTokens),
+    sendScheduler(sendScheduler)
+{
+    // text type keeps pending messages, their changes are announced here
+    connect(textType, &Tp::BaseChannelTextType::messageReceived, this, &PipeChannelMessagesInterface::messageReceived);
+    connect(textType, &Tp::BaseChannelTextType::pendingMessagesRemoved, 
+            this, &PipeChannelMessagesInterface::pendingMessagesRemoved);
+}
+
+QVariantMap PipeChannelMessagesInterface::immutableProperties() const {
+    QVariantMap properties;
+    properties[TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES + QString(".SupportedContentTypes")] = contentTypes;
+    properties[TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES + QString(".MessageTypes")] = QVariant::fromValue(types);
+    properties[TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES + QString(".MessagePartSupportFlags")] = partSupportFlags;
+    properties[TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES + QString(".DeliveryReportingSupport")] = reportingSupport;
+    return properties;
+}
+
+PipeChannelMessagesInterface::~PipeChannelMessagesInterface() {
+
+    // their transformation is dropped with this interface, callers must not wait for them
+    QDBusPendingCall closed = QDBusPendingCall::fromError(QDBusError(TP_QT_ERROR_CANCELLED, "Channel was closed"));
+    for(const OutgoingMessagePtr &message: outgoing) message->sent(closed);
+}
+
+void PipeChannelMessagesInterface::createAdaptor() {
+    (void) new PipeChannelMessagesAdaptor(dbusObject()->dbusConnection(), this, dbusObject());
+}
+
+QStringList PipeChannelMessagesInterface::supportedContentTypes() const {
+    return contentTypes;
+}
+
+Tp::UIntList PipeChannelMessagesInterface::messageTypes() const {
+    return types;
+}
+
+uint PipeChannelMessagesInterface::messagePartSupportFlags() const {
+    return partSupportFlags;
+}
+
+Tp::MessagePartListList PipeChannelMessagesInterface::pendingMessages() const {
+    return textType->pendingMessages();
+}
+
+uint PipeChannelMessagesInterface::deliveryReportingSupport() const {
+    return reportingSupport;
+}
+
+void PipeChannelMessagesInterface::sendMessage(const Tp::MessagePartList &message, uint flags, const SentFunction &sent) {
+
+    OutgoingMessagePtr outgoingMessage(new OutgoingMessage { message, flags, sent, false });
+    outgoing.enqueue(outgoingMessage);
+    transformStage(outgoingMessage, 0);
+}
+
+void PipeChannelMessagesInterface::transformStage(const OutgoingMessagePtr &message, size_t stage) {
+
+    // outgoing messages go through plugins in reverse order
+    for(; stage < transforms.size() && transforms[transforms.size() - 1 - stage]->isPlugin(); ++stage) {
+        transforms[transforms.size() - 1 - stage]->transformOutgoing(message->message);
+    }
+    if(stage == transforms.size()) {
+        message->transformed = true;
+        sendTransformed();
+        return;
+    }
+
+    const PipePtr &transform = transforms[transforms.size() - 1 - stage];
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+            transform->transformMessages(false, Tp::MessagePartListList() << message->message), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished,
+            this, [this, message, stage, transform](QDBusPendingCallWatcher *finishedWatcher) {
+                QDBusPendingReply<Tp::MessagePartListList> transformRep = *finishedWatcher;
+                if(transformRep.isValid() && transformRep.value().size() == 1) {
+                    message->message = transformRep.value().first();
+                } else {
+                    // message is sent untransformed
+                    pWarning() << "Pipe: " << transform->name() << " could not transform message: " 
+                        << transformRep.error().message();
+                }
+                finishedWatcher->deleteLater();
+                transformStage(message, stage + 1);
+            });
+}
+
+void PipeChannelMessagesInterface::sendTransformed() {
+    // messages of the channel keep their order even if a later one was transformed sooner
+    while(!outgoing.isEmpty() && outgoing.head()->transformed) sendToPiped(*outgoing.dequeue());
+}
+
+void PipeChannelMessagesInterface::sendToPiped(const OutgoingMessage &outgoing) {
+
+    QPointer<PipeChannelMessagesInterface> self(this);
+    Tp::MessagePartList message = outgoing.message;
+    uint flags = outgoing.flags;
+    SentFunction sent = outgoing.sent;
+    auto sentCb = [self, message, flags, sent](const QDBusPendingCall &reply) {
+            QDBusPendingReply<QString> tokenRep = reply;
+            if(self && tokenRep.isValid()) {
+                self->sentTokens->add(tokenRep.value());
+                emit self->messageSent(message, flags, tokenRep.value());
+            }
+            sent(tokenRep);
+        };
+
+    if(sendScheduler) {
+        // sent when its turn among messages of all channels of connection comes
+        // channel can be closed before the turn comes
+        QPointer<Tp::Client::ChannelInterfaceMessagesInterface> mesIface(pipedMesIface);
+        sendScheduler->send(pipedMesIface->path(), [mesIface, message, flags]() -> QDBusPendingCall {
+                    if(!mesIface) 
+                        return QDBusPendingCall::fromError(QDBusError(TP_QT_ERROR_CANCELLED, "Channel was closed"));
+                    return mesIface->SendMessage(message, flags);
+                }, sentCb);
+    } else {
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pipedMesIface->SendMessage(message, flags), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, [sentCb](QDBusPendingCallWatcher *finishedWatcher) {
+                finishedWatcher->deleteLater();
+                sentCb(*finishedWatcher);
+            });
+    }
+}
+
+Tp::MessagePartContentMap PipeChannelMessagesInterface::getPendingMessageContent(
+        uint messageId, const Tp::UIntList &parts, Tp::DBusError *error) const
+{
+    for(const Tp::MessagePartList &message: textType->pendingMessages()) {
+        if(message.isEmpty() || message.first().value("pending-message-id").variant().toUInt() != messageId) continue;
+
+        Tp::MessagePartContentMap contents;
+        for(uint part: parts) {
+            if(part == 0 || part >= uint(message.size())) {
+                error->set(TP_QT_ERROR_INVALID_ARGUMENT, "No such part: " + QString::number(part));
+                return Tp::MessagePartContentMap();
+            }
+            auto contentIt = message[part].constFind(QLatin1String("content"));
+            if(contentIt != message[part].constEnd()) contents[part] = *contentIt;
+        }
+        return contents;
+    }
+
+    error->set(TP_QT_ERROR_INVALID_ARGUMENT, "No such pending message: " + QString::number(messageId));
+    return Tp::MessagePartContentMap();
+}
+
+// ------------ PipeChannelMessagesAdaptor ---------------------------------------------------------------------
+PipeChannelMessagesAdaptor::PipeChannelMessagesAdaptor(
+        const QDBusConnection &dbusConnection, PipeChannelMessagesInterface *messages, QObject *parent) 
+    : QDBusAbstractAdaptor(parent),
+    dbusConnection(dbusConnection),
+    messages(messages)
+{
+    connect(messages, &PipeChannelMessagesInterface::messageSent, this, &PipeChannelMessagesAdaptor::MessageSent);
+    connect(messages, &PipeChannelMessagesInterface::pendingMessagesRemoved, 
+            this, &PipeChannelMessagesAdaptor::PendingMessagesRemoved);
+    connect(messages, &PipeChannelMessagesInterface::messageReceived, this, &PipeChannelMessagesAdaptor::MessageReceived);
+}
+
+QStringList PipeChannelMessagesAdaptor::SupportedContentTypes() const {
+    return messages ? messages->supportedContentTypes() : QStringList();
+}
+
+Tp::UIntList PipeChannelMessagesAdaptor::MessageTypes() const {
+    return messages ? messages->messageTypes() : Tp::UIntList();
+}
+
+uint PipeChannelMessagesAdaptor::MessagePartSupportFlags() const {
+    return messages ? messages->messagePartSupportFlags() : 0;
+}
+
+Tp::MessagePartListList PipeChannelMessagesAdaptor::PendingMessages() const {
+    return messages ? messages->pendingMessages() : Tp::MessagePartListList();
+}
+
+uint PipeChannelMessagesAdaptor::DeliveryReportingSupport() const {
+    return messages ? messages->deliveryReportingSupport() : 0;
+}
+
+void PipeChannelMessagesAdaptor::SendMessage(const Tp::MessagePartList &message, uint flags, const QDBusMessage &dbusMessage) {
+
+    if(!messages) return;
+    dbusMessage.setDelayedReply(true);
+    QDBusConnection connection = dbusConnection;
+    messages->sendMessage(message, flags, [connection, dbusMessage](const QDBusPendingReply<QString> &tokenRep) {
+            if(tokenRep.isError()) connection.send(dbusMessage.createErrorReply(tokenRep.error()));
+            else connection.send(dbusMessage.createReply(tokenRep.value()));
+        });
+}
+
+Tp::MessagePartContentMap PipeChannelMessagesAdaptor::GetPendingMessageContent(
+        uint messageID, const Tp::UIntList &parts, const QDBusMessage &dbusMessage)
+{
+    if(!messages) return Tp::MessagePartContentMap();
+
+    Tp::DBusError error;
+    Tp::MessagePartContentMap contents = messages->getPendingMessageContent(messageID, parts, &error);
+    if(error.isValid()) {
+        dbusMessage.setDelayedReply(true);
+        dbusConnection.send(dbusMessage.createErrorReply(error.name(), error.message()));
+    }
+    return contents;
+}
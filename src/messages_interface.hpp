@@ -0,0 +1,153 @@
+#ifndef PIPE_MESSAGES_INTERFACE_HPP
+#define PIPE_MESSAGES_INTERFACE_HPP
+
+#include <TelepathyQt/BaseChannel>
+#include <TelepathyQt/ChannelInterface>
+#include <QDBusAbstractAdaptor>
+#include <QDBusMessage>
+#include <QDBusPendingReply>
+#include <QPointer>
+#include <QQueue>
+#include <functional>
+#include <memory>
+
+#include "types.hpp"
+#include "sent_token_index.hpp"
+#include "send_scheduler.hpp"
+
+/**
+ * Messages interface of proxy channel. Outgoing messages are transformed without blocking and passed
+ * to send scheduler of the connection in order they came, SendMessage is answered when piped channel
+ * accepts the message, so no caller waits for another one. Received messages and their removal are announced as text
+ * type of the channel adds and acknowledges them.
+ */
+class PipeChannelMessagesInterface : public Tp::AbstractChannelInterface {
+
+    Q_OBJECT;
+
+    public:
+        /**
+         * Receives finished SendMessage call of piped channel
+         */
+        typedef std::function<void (const QDBusPendingReply<QString> &reply)> SentFunction;
+
+        /**
+         * @param sendScheduler scheduler of outgoing messages of connection, they are sent 
+         *          directly without it
+         */
+        PipeChannelMessagesInterface(
+                Tp::BaseChannelTextType *textType,
+                Tp::Client::ChannelInterfaceMessagesInterface *pipedMesIface,
+                const QStringList &supportedContentTypes,
+                const Tp::UIntList &messageTypes,
+                uint messagePartSupportFlags,
+                uint deliveryReportingSupport,
+                const PipeChain &transforms,
+                const PipeSentTokenIndexPtr &sentTokens,
+                const PipeSendSchedulerPtr &sendScheduler);
+        /**
+         * Messages which were not sent yet fail
+         */
+        virtual ~PipeChannelMessagesInterface();
+
+        QVariantMap immutableProperties() const override;
+
+        QStringList supportedContentTypes() const;
+        Tp::UIntList messageTypes() const;
+        uint messagePartSupportFlags() const;
+        Tp::MessagePartListList pendingMessages() const;
+        uint deliveryReportingSupport() const;
+
+        /**
+         * Sends message through piped channel when its turn comes
+         * @param sent called when piped channel accepts or refuses the message
+         */
+        void sendMessage(const Tp::MessagePartList &message, uint flags, const SentFunction &sent);
+
+        /**
+         * @return contents of given parts of pending message
+         */
+        Tp::MessagePartContentMap getPendingMessageContent(uint messageId, const Tp::UIntList &parts, 
+                Tp::DBusError *error) const;
+
+    signals:
+        void messageSent(const Tp::MessagePartList &content, uint flags, const QString &messageToken);
+        void pendingMessagesRemoved(const Tp::UIntList &messageIDs);
+        void messageReceived(const Tp::MessagePartList &message);
+
+    private:
+        struct OutgoingMessage {
+            Tp::MessagePartList message;
+            uint flags;
+            SentFunction sent;
+            bool transformed;
+        };
+        typedef std::shared_ptr<OutgoingMessage> OutgoingMessagePtr;
+
+        void createAdaptor() override;
+        /**
+         * Transforms message by given stage of transforms and the following ones, outgoing messages
+         * go through them in reverse order
+         */
+        void transformStage(const OutgoingMessagePtr &outgoing, size_t stage);
+        /**
+         * Sends transformed messages from the head of outgoing queue
+         */
+        void sendTransformed();
+        void sendToPiped(const OutgoingMessage &outgoing);
+
+    private:
+        Tp::BaseChannelTextType *textType;
+        Tp::Client::ChannelInterfaceMessagesInterface *pipedMesIface;
+        QStringList contentTypes;
+        Tp::UIntList types;
+        uint partSupportFlags;
+        uint reportingSupport;
+        PipeChain transforms;
+        PipeSentTokenIndexPtr sentTokens;
+        PipeSendSchedulerPtr sendScheduler;
+        // messages being transformed and transformed ones waiting for those before them
+        QQueue<OutgoingMessagePtr> outgoing;
+};
+
+typedef Tp::SharedPtr<PipeChannelMessagesInterface> PipeChannelMessagesInterfacePtr;
+
+/**
+ * Exports PipeChannelMessagesInterface on D-Bus, SendMessage is answered with delayed reply
+ */
+class PipeChannelMessagesAdaptor : public QDBusAbstractAdaptor {
+
+    Q_OBJECT;
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Telepathy.Channel.Interface.Messages")
+    Q_PROPERTY(QStringList SupportedContentTypes READ SupportedContentTypes)
+    Q_PROPERTY(Tp::UIntList MessageTypes READ MessageTypes)
+    Q_PROPERTY(uint MessagePartSupportFlags READ MessagePartSupportFlags)
+    Q_PROPERTY(Tp::MessagePartListList PendingMessages READ PendingMessages)
+    Q_PROPERTY(uint DeliveryReportingSupport READ DeliveryReportingSupport)
+
+    public:
+        PipeChannelMessagesAdaptor(const QDBusConnection &dbusConnection, 
+                PipeChannelMessagesInterface *messages, QObject *parent);
+
+        QStringList SupportedContentTypes() const;
+        Tp::UIntList MessageTypes() const;
+        uint MessagePartSupportFlags() const;
+        Tp::MessagePartListList PendingMessages() const;
+        uint DeliveryReportingSupport() const;
+
+    public slots:
+        void SendMessage(const Tp::MessagePartList &message, uint flags, const QDBusMessage &dbusMessage);
+        Tp::MessagePartContentMap GetPendingMessageContent(uint messageID, const Tp::UIntList &parts, 
+                const QDBusMessage &dbusMessage);
+
+    signals:
+        void MessageSent(const Tp::MessagePartList &content, uint flags, const QString &messageToken);
+        void PendingMessagesRemoved(const Tp::UIntList &messageIDs);
+        void MessageReceived(const Tp::MessagePartList &message);
+
+    private:
+        QDBusConnection dbusConnection;
+        QPointer<PipeChannelMessagesInterface> messages;
+};
+
+#endif
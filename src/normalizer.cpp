@@ -0,0 +1,126 @@
+#include "normalizer.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PIPE_NORMALIZER_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+    /**
+     * Lowers ASCII letters of UTF-16 code units from given position
+     * @return false when a non ASCII unit is found, dst is not complete then
+     */
+    bool lowerAsciiTail(const ushort *src, ushort *dst, int size, int i) {
+
+        for(; i < size; ++i) {
+            ushort unit = src[i];
+            if(unit >= 0x80) return false;
+            dst[i] = (unit >= 'A' && unit <= 'Z') ? ushort(unit + 0x20) : unit;
+        }
+        return true;
+    }
+
+#ifdef PIPE_NORMALIZER_X86
+    /**
+     * Lowers 8 units at once, SSE2 is part of x86-64 so it is used whenever compiled for it
+     */
+    __attribute__((target("sse2")))
+    bool lowerAsciiSse2(const ushort *src, ushort *dst, int size, int i) {
+
+        const __m128i nonAscii = _mm_set1_epi16(short(0xff80));
+        const __m128i beforeA = _mm_set1_epi16('A' - 1);
+        const __m128i afterZ = _mm_set1_epi16('Z' + 1);
+        const __m128i caseBit = _mm_set1_epi16(0x20);
+        for(; i + 8 <= size; i += 8) {
+            __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+            __m128i ascii = _mm_cmpeq_epi16(_mm_and_si128(units, nonAscii), _mm_setzero_si128());
+            if(_mm_movemask_epi8(ascii) != 0xffff) return false;
+            __m128i upper = _mm_and_si128(_mm_cmpgt_epi16(units, beforeA), _mm_cmplt_epi16(units, afterZ));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi16(units, _mm_and_si128(upper, caseBit)));
+        }
+        return lowerAsciiTail(src, dst, size, i);
+    }
+
+    /**
+     * Lowers 16 units at once, built for AVX2 regardless of compiler flags and used only
+     * when CPU supports it
+     */
+    __attribute__((target("avx2")))
+    bool lowerAsciiAvx2(const ushort *src, ushort *dst, int size, int i) {
+
+        const __m256i nonAscii = _mm256_set1_epi16(short(0xff80));
+        const __m256i beforeA = _mm256_set1_epi16('A' - 1);
+        const __m256i afterZ = _mm256_set1_epi16('Z' + 1);
+        const __m256i caseBit = _mm256_set1_epi16(0x20);
+        for(; i + 16 <= size; i += 16) {
+            __m256i units = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+            if(!_mm256_testz_si256(units, nonAscii)) return false;
+            // signed comparison is fine, all units are ASCII here
+            __m256i upper = _mm256_and_si256(
+                    _mm256_cmpgt_epi16(units, beforeA), _mm256_cmpgt_epi16(afterZ, units));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), 
+                    _mm256_add_epi16(units, _mm256_and_si256(upper, caseBit)));
+        }
+        return lowerAsciiSse2(src, dst, size, i);
+    }
+#endif
+
+    typedef bool (*LowerAscii)(const ushort*, ushort*, int, int);
+
+    LowerAscii selectLowerAscii() {
+#ifdef PIPE_NORMALIZER_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx2")) return lowerAsciiAvx2;
+        if(__builtin_cpu_supports("sse2")) return lowerAsciiSse2;
+#endif
+        return lowerAsciiTail;
+    }
+
+    /**
+     * Lowers ASCII letters of UTF-16 code units with the widest vector unit CPU supports
+     * @return false when a non ASCII unit is found, dst is not complete then
+     */
+    bool lowerAscii(const ushort *src, ushort *dst, int size) {
+        // selected once, initialization of local static is thread safe
+        static const LowerAscii lower = selectLowerAscii();
+        return lower(src, dst, size, 0);
+    }
+
+} /* anonymous namespace */
+
+namespace normalizer {
+
+    QString identifier(const QString &id) {
+
+        const QChar *data = id.constData();
+        int begin = 0;
+        int end = id.size();
+        while(begin < end && data[begin].isSpace()) ++begin;
+        while(end > begin && data[end - 1].isSpace()) --end;
+
+        // identifiers are mostly ASCII, others are lowered by Qt
+        QString normalized(end - begin, Qt::Uninitialized);
+        if(!lowerAscii(reinterpret_cast<const ushort*>(data + begin), 
+                    reinterpret_cast<ushort*>(normalized.data()), end - begin))
+        {
+            return id.mid(begin, end - begin).toLower();
+        }
+        return normalized;
+    }
+
+    QStringList identifiers(const QStringList &ids) {
+
+        QStringList normalized;
+        normalized.reserve(ids.size());
+        for(const QString &id: ids) normalized.append(identifier(id));
+        return normalized;
+    }
+
+    QString uriIdentifier(const QString &uri) {
+        QString normalized = identifier(uri);
+        int schemeEnd = normalized.indexOf(':');
+        return schemeEnd == -1 ? normalized : normalized.mid(schemeEnd + 1);
+    }
+
+} /* normalizer namespace */
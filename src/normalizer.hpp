@@ -0,0 +1,33 @@
+#ifndef PIPE_NORMALIZER_HPP
+#define PIPE_NORMALIZER_HPP
+
+#include <QString>
+#include <QStringList>
+
+/**
+ * Normalization of contact identifiers and addresses for the NORMALIZED fallback lookups of
+ * PipeRosterIndex, identifiers are matched exactly first and piped connection normalizes misses
+ * by its own rules. PipeProtocol::normalizeContact does not use it, case rules of the piped
+ * protocol are not known there.
+ */
+namespace normalizer {
+
+    /**
+     * @return identifier without surrounding white space in lower case, URIs are normalized
+     *          the same way, e.g. "XMPP:Bob@Example.com " -> "xmpp:bob@example.com"
+     */
+    QString identifier(const QString &id);
+
+    /**
+     * @return identifiers normalized one by one, in the same order
+     */
+    QStringList identifiers(const QStringList &ids);
+
+    /**
+     * @return normalized identifier part of URI, whole URI when there is no scheme
+     */
+    QString uriIdentifier(const QString &uri);
+
+} /* normalizer namespace */
+
+#endif
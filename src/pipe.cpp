@@ -0,0 +1,214 @@
+#include "pipe.hpp"
+#include "defines.hpp"
+#include "utils.hpp"
+
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/DBus>
+
+Pipe::Pipe(const QString &service, const QString &path, const QDBusConnection &connection) 
+    : iface(new PipeInterface(service, path, connection))
+{
+    active = refresh();
+
+    iface->connection().connect(service, path, TP_QT_IFACE_PROPERTIES, "PropertiesChanged",
+            this, SLOT(propertiesChangedCb(QString, QVariantMap, QStringList)));
+}
+
+Pipe::Pipe(const QString &service, const QString &path, const QDBusConnection &connection,
+        const QVariantMap &cachedProperties)
+    : iface(new PipeInterface(service, path, connection))
+{
+    applyProperties(cachedProperties);
+
+    // subscribing to signal does not activate the service
+    iface->connection().connect(service, path, TP_QT_IFACE_PROPERTIES, "PropertiesChanged",
+            this, SLOT(propertiesChangedCb(QString, QVariantMap, QStringList)));
+}
+
+Pipe::Pipe(PipePlugin *plugin) 
+    : plugin(plugin)
+{
+    active = refresh();
+}
+
+Pipe::~Pipe() {
+    disconnectFromPeer();
+}
+
+QString Pipe::name() const {
+    return pipeName;
+}
+
+Tp::RequestableChannelClassList Pipe::requestableChannelClasses() const {
+    return chanMatcher.classes();
+}
+
+bool Pipe::passThrough() const {
+    return isPassThrough;
+}
+
+const ChannelClassMatcher& Pipe::matcher() const {
+    return chanMatcher;
+}
+
+QString Pipe::service() const {
+    return iface ? iface->service() : QString();
+}
+
+bool Pipe::isPlugin() const {
+    return plugin != nullptr;
+}
+
+bool Pipe::isPeerConnected() const {
+    return peerIface && peerIface->connection().isConnected();
+}
+
+QDBusPendingReply<QDBusObjectPath> Pipe::createPipeChannel(const QDBusObjectPath &channelObject) {
+    if(isPlugin()) 
+        return QDBusPendingCall::fromError(QDBusMessage::createError(
+                    TP_QT_ERROR_NOT_IMPLEMENTED, "Plugin pipes do not create channels"));
+    return callInterface().createPipeChannel(channelObject);
+}
+
+bool Pipe::transformsMessages() const {
+    return isPlugin() || isTransforming;
+}
+
+void Pipe::transformIncoming(Tp::MessagePartList &message) {
+    if(isPlugin()) plugin->transformIncoming(message);
+}
+
+void Pipe::transformOutgoing(Tp::MessagePartList &message) {
+    if(isPlugin()) plugin->transformOutgoing(message);
+}
+
+QDBusPendingReply<Tp::MessagePartListList> Pipe::transformMessages(
+        bool incoming, const Tp::MessagePartListList &messages) 
+{
+    if(isPlugin()) 
+        return QDBusPendingCall::fromError(QDBusMessage::createError(
+                    TP_QT_ERROR_NOT_IMPLEMENTED, "Plugin pipes transform messages in process"));
+    return callInterface().TransformMessages(incoming, messages);
+}
+
+PipeInterface& Pipe::callInterface() {
+    if(!peerAddress.isEmpty() && !peerIface) connectToPeer();
+    if(isPeerConnected()) return *peerIface;
+    return *iface;
+}
+
+void Pipe::connectToPeer() {
+
+    QDBusConnection peer = QDBusConnection::connectToPeer(peerAddress, "pipe_peer_" + iface->service());
+    if(peer.isConnected()) {
+        pDebug() << "Connected to pipe: " << iface->service() << " at peer address: " << peerAddress;
+        // peer connections have no service names
+        peerIface.reset(new PipeInterface(QString(), iface->path(), peer));
+    } else {
+        pWarning() << "Could not connect to pipe: " << iface->service() << " at peer address: " << peerAddress
+            << " -> " << peer.lastError().message() << ", using bus instead";
+        QDBusConnection::disconnectFromPeer(peer.name());
+        peerAddress.clear();
+    }
+}
+
+void Pipe::disconnectFromPeer() {
+    if(peerIface) {
+        QString connectionName = peerIface->connection().name();
+        peerIface.reset();
+        QDBusConnection::disconnectFromPeer(connectionName);
+    }
+}
+
+bool Pipe::isActive() const {
+    return active;
+}
+
+QVariantMap Pipe::properties() const {
+
+    QVariantMap props;
+    props["name"] = pipeName;
+    props["PassThrough"] = isPassThrough;
+    props["TransformsMessages"] = isTransforming;
+    props["PeerAddress"] = peerAddress;
+    props["RequestableChannelClasses"] = QVariant::fromValue(chanMatcher.classes());
+    return props;
+}
+
+bool Pipe::activate() {
+
+    if(active) return true;
+
+    QDBusConnectionInterface *dci = iface->connection().interface();
+    QDBusReply<bool> isRegisteredRep = dci->isServiceRegistered(iface->service());
+    if(!isRegisteredRep.isValid() || !isRegisteredRep.value()) {
+        QDBusReply<void> startServiceRep = dci->startService(iface->service());
+        if(!startServiceRep.isValid()) {
+            pWarning() << "Pipe service - > " << iface->service() << " could not be started: " 
+                << startServiceRep.error().message();
+            return false;
+        }
+    }
+
+    pDebug() << "Pipe service - > " << iface->service() << " is activated";
+    active = refresh();
+    if(active) emit propertiesChanged();
+    return active;
+}
+
+bool Pipe::refresh() {
+
+    if(isPlugin()) {
+        pipeName = plugin->name();
+        chanMatcher = ChannelClassMatcher(plugin->requestableChannelClasses());
+        return true;
+    }
+
+    Tp::Client::DBus::PropertiesInterface propsIface(iface->connection(), iface->service(), iface->path());
+    QDBusPendingReply<QVariantMap> propsRep = propsIface.GetAll(TP_QT_IFACE_PIPE);
+    propsRep.waitForFinished();
+
+    if(propsRep.isValid()) {
+        applyProperties(propsRep.value());
+        return true;
+    } else {
+        pWarning() << "Could not get properties of pipe: " << iface->service() << " -> " << propsRep.error().message();
+        return false;
+    }
+}
+
+void Pipe::applyProperties(const QVariantMap &properties) {
+
+    auto it = properties.constFind("name");
+    if(it != properties.constEnd()) pipeName = it->toString();
+
+    // optional property
+    it = properties.constFind("PassThrough");
+    if(it != properties.constEnd()) isPassThrough = it->toBool();
+
+    // optional property
+    it = properties.constFind("TransformsMessages");
+    if(it != properties.constEnd()) isTransforming = it->toBool();
+
+    // optional property
+    it = properties.constFind("PeerAddress");
+    if(it != properties.constEnd() && it->toString() != peerAddress) {
+        disconnectFromPeer();
+        peerAddress = it->toString();
+    }
+
+    it = properties.constFind("RequestableChannelClasses");
+    if(it != properties.constEnd()) 
+        chanMatcher = ChannelClassMatcher(qdbus_cast<Tp::RequestableChannelClassList>(*it));
+}
+
+void Pipe::propertiesChangedCb(const QString &interface, const QVariantMap &changed, const QStringList &invalidated) {
+
+    if(interface != TP_QT_IFACE_PIPE) return;
+
+    pDebug() << "Properties of pipe: " << iface->service() << " changed";
+    if(invalidated.empty()) applyProperties(changed);
+    else refresh();
+
+    emit propertiesChanged();
+}
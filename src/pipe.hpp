@@ -0,0 +1,131 @@
+#ifndef PIPE_PIPE_HPP
+#define PIPE_PIPE_HPP
+
+#include <QObject>
+#include <QtDBus>
+#include <memory>
+
+#include "pipe_interface.h"
+#include "pipe_plugin.hpp"
+#include "channel_class_matcher.hpp"
+
+typedef OrgFreedesktopTelepathyPipeInterface PipeInterface;
+
+/**
+ * Pipe service with its properties fetched once and cached. The cache is updated 
+ * when the pipe emits PropertiesChanged. Properties can also come from cache persisted
+ * between runs, then service is not started until activate() is called. If pipe advertises a peer address, calls to
+ * the pipe, createPipeChannel and TransformMessages, are made over a private connection instead of the bus. Channels
+ * created by the pipe are still proxied over the bus, as Tp::Channel needs a bus daemon to track its service.
+ *
+ * Pipe can be also backed by an in-process plugin, then it does not create any channels
+ * and transforms messages of proxied channels instead.
+ */
+class Pipe : public QObject {
+
+    Q_OBJECT;
+    Q_DISABLE_COPY(Pipe)
+
+    public:
+        Pipe(const QString &service, const QString &path, const QDBusConnection &connection);
+        /**
+         * Creates pipe from cached properties without activating its service
+         */
+        Pipe(const QString &service, const QString &path, const QDBusConnection &connection,
+                const QVariantMap &cachedProperties);
+        explicit Pipe(PipePlugin *plugin);
+        virtual ~Pipe();
+
+        QString name() const;
+        Tp::RequestableChannelClassList requestableChannelClasses() const;
+        /**
+         * @return true if pipe only observes channels it is given
+         */
+        bool passThrough() const;
+        /**
+         * @return requestable channel classes of this pipe compiled for checking channels
+         */
+        const ChannelClassMatcher& matcher() const;
+
+        QString service() const;
+        /**
+         * @return true if pipe is an in-process plugin
+         */
+        bool isPlugin() const;
+        /**
+         * @return true if pipe transforms messages of proxied channels instead of creating
+         *          its own channels, it is true for plugins and pipes implementing TransformMessages
+         */
+        bool transformsMessages() const;
+        /**
+         * @return true if calls to the pipe go over a private peer connection
+         */
+        bool isPeerConnected() const;
+        /**
+         * @return true if pipe service was started and its properties were fetched from it
+         */
+        bool isActive() const;
+
+        /**
+         * @return properties of the pipe in form accepted by constructor from cache
+         */
+        QVariantMap properties() const;
+
+        QDBusPendingReply<QDBusObjectPath> createPipeChannel(const QDBusObjectPath &channelObject);
+
+        /**
+         * Transforms message received on piped channel in process, only plugins do it, other pipes
+         * are called with transformMessages
+         */
+        void transformIncoming(Tp::MessagePartList &message);
+        /**
+         * Transforms message to be sent on piped channel in process, see transformIncoming
+         */
+        void transformOutgoing(Tp::MessagePartList &message);
+        /**
+         * Transforms many messages with one call without blocking, not available for plugins
+         */
+        QDBusPendingReply<Tp::MessagePartListList> transformMessages(
+                bool incoming, const Tp::MessagePartListList &messages);
+
+        /**
+         * Fetches all properties of the pipe again
+         * @return false if properties could not be obtained
+         */
+        bool refresh();
+
+        /**
+         * Starts pipe service if it is not running and fetches its properties,
+         * emits propertiesChanged on success
+         * @return false if service could not be started
+         */
+        bool activate();
+
+    signals:
+        void propertiesChanged();
+
+    private slots:
+        void propertiesChangedCb(const QString &interface, const QVariantMap &changed, const QStringList &invalidated);
+
+    private:
+        void applyProperties(const QVariantMap &properties);
+        /**
+         * @return interface on peer connection if it is available, otherwise interface on the bus
+         */
+        PipeInterface& callInterface();
+        void connectToPeer();
+        void disconnectFromPeer();
+
+    private:
+        std::unique_ptr<PipeInterface> iface;
+        PipePlugin *plugin = nullptr;
+        QString pipeName;
+        bool isPassThrough = false;
+        bool isTransforming = false;
+        ChannelClassMatcher chanMatcher;
+        QString peerAddress;
+        std::unique_ptr<PipeInterface> peerIface;
+        bool active = false;
+};
+
+#endif
@@ -0,0 +1,112 @@
+#include "pipe_cache.hpp"
+#include "utils.hpp"
+
+#include <TelepathyQt/Types>
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+namespace {
+
+    const quint32 CACHE_VERSION = 1;
+    const QString CLASSES_PROPERTY = "RequestableChannelClasses";
+
+    // channel classes are stored as plain variants, so no stream operators have to be registered
+    QVariantList encodeClasses(const Tp::RequestableChannelClassList &classes) {
+        QVariantList encoded;
+        for(const Tp::RequestableChannelClass &rcc: classes) {
+            QVariantMap cls;
+            cls["fixed"] = rcc.fixedProperties;
+            cls["allowed"] = rcc.allowedProperties;
+            encoded << cls;
+        }
+        return encoded;
+    }
+
+    Tp::RequestableChannelClassList decodeClasses(const QVariantList &encoded) {
+        Tp::RequestableChannelClassList classes;
+        for(const QVariant &cls: encoded) {
+            Tp::RequestableChannelClass rcc;
+            rcc.fixedProperties = cls.toMap().value("fixed").toMap();
+            rcc.allowedProperties = cls.toMap().value("allowed").toStringList();
+            classes << rcc;
+        }
+        return classes;
+    }
+
+} /* anonymous namespace */
+
+PipeCapabilityCache::PipeCapabilityCache(const QString &filePath)
+    : filePath(filePath)
+{}
+
+void PipeCapabilityCache::load() {
+
+    entries.clear();
+    QFile file(filePath);
+    if(!file.open(QIODevice::ReadOnly)) {
+        pDebug() << "No pipe cache at: " << filePath;
+        return;
+    }
+
+    QDataStream in(&file);
+    quint32 version;
+    in >> version;
+    if(version != CACHE_VERSION) {
+        pWarning() << "Ignoring pipe cache with version: " << version;
+        return;
+    }
+
+    QMap<QString, QVariantMap> stored;
+    in >> stored;
+    if(in.status() != QDataStream::Ok) {
+        pWarning() << "Pipe cache: " << filePath << " is corrupted";
+        return;
+    }
+
+    for(auto it = stored.begin(); it != stored.end(); ++it) {
+        QVariantMap &props = it.value();
+        props[CLASSES_PROPERTY] = QVariant::fromValue(decodeClasses(props.value(CLASSES_PROPERTY).toList()));
+    }
+    entries = stored;
+}
+
+bool PipeCapabilityCache::save() const {
+
+    QDir().mkpath(QFileInfo(filePath).absolutePath());
+    QFile file(filePath);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        pWarning() << "Could not write pipe cache: " << filePath;
+        return false;
+    }
+
+    QMap<QString, QVariantMap> stored = entries;
+    for(auto it = stored.begin(); it != stored.end(); ++it) {
+        QVariantMap &props = it.value();
+        props[CLASSES_PROPERTY] = encodeClasses(props.value(CLASSES_PROPERTY).value<Tp::RequestableChannelClassList>());
+    }
+
+    QDataStream out(&file);
+    out << CACHE_VERSION << stored;
+    return out.status() == QDataStream::Ok;
+}
+
+bool PipeCapabilityCache::contains(const QString &service) const {
+    return entries.contains(service);
+}
+
+QVariantMap PipeCapabilityCache::properties(const QString &service) const {
+    return entries.value(service);
+}
+
+void PipeCapabilityCache::update(const QString &service, const QVariantMap &properties) {
+    entries[service] = properties;
+}
+
+void PipeCapabilityCache::retain(const QStringList &services) {
+    for(auto it = entries.begin(); it != entries.end();) {
+        if(services.contains(it.key())) ++it;
+        else it = entries.erase(it);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef PIPE_PIPE_CACHE_HPP
+#define PIPE_PIPE_CACHE_HPP
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+
+/**
+ * Properties of pipe services persisted between runs, so protocols can be registered
+ * without starting the services. Entries are keyed by service name and hold properties
+ * in the form returned by Pipe::properties().
+ */
+class PipeCapabilityCache {
+
+    public:
+        explicit PipeCapabilityCache(const QString &filePath);
+
+        /**
+         * Reads cache file, cache stays empty if file is missing or has other version
+         */
+        void load();
+        /**
+         * @return false if cache file could not be written
+         */
+        bool save() const;
+
+        bool contains(const QString &service) const;
+        QVariantMap properties(const QString &service) const;
+        void update(const QString &service, const QVariantMap &properties);
+        /**
+         * Removes entries of services which are not present anymore
+         */
+        void retain(const QStringList &services);
+
+    private:
+        QString filePath;
+        QMap<QString, QVariantMap> entries;
+};
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef PIPE_PLUGIN_HPP
+#define PIPE_PLUGIN_HPP
+
+#include <QtPlugin>
+#include <QString>
+#include <TelepathyQt/Types>
+
+/**
+ * Pipe loaded into telepathy-pipes process from a shared library. Instead of providing piped
+ * channels over D-Bus it transforms messages of piped text channels in place.
+ *
+ * Plugins are Qt plugins implementing this interface, placed in TP_QT_PIPE_PLUGINS directory.
+ */
+class PipePlugin {
+
+    public:
+        virtual ~PipePlugin() = default;
+
+        /**
+         * @return name of the pipe, protocol of the pipe is registered with this name
+         */
+        virtual QString name() const = 0;
+
+        /**
+         * @return channel classes which are piped through this plugin
+         */
+        virtual Tp::RequestableChannelClassList requestableChannelClasses() const = 0;
+
+        /**
+         * Called for every message received on piped channel before it is passed to clients,
+         * message-token of the header has to be kept
+         */
+        virtual void transformIncoming(Tp::MessagePartList &message) = 0;
+
+        /**
+         * Called for every message sent by clients before it is sent on piped channel
+         */
+        virtual void transformOutgoing(Tp::MessagePartList &message) = 0;
+};
+
+#define PipePlugin_iid "org.freedesktop.Telepathy.PipePlugin"
+
+Q_DECLARE_INTERFACE(PipePlugin, PipePlugin_iid)
+
+#endif
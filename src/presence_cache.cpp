@@ -0,0 +1,84 @@
+#include "presence_cache.hpp"
+
+namespace {
+
+    // handles asked for in one GetPresences call
+    const int PRESENCE_BATCH = 100;
+
+    bool samePresence(const Tp::SimplePresence &first, const Tp::SimplePresence &second) {
+        return first.type == second.type && first.status == second.status 
+            && first.statusMessage == second.statusMessage;
+    }
+
+} /* anonymous namespace */
+
+QList<Tp::UIntList> PipePresenceCache::fetchBatches(const Tp::UIntList &handles) {
+
+    QList<Tp::UIntList> batches;
+    for(int i = 0; i < handles.size(); i += PRESENCE_BATCH) 
+        batches << handles.mid(i, PRESENCE_BATCH);
+    stats.fetches += batches.size();
+    return batches;
+}
+
+Tp::SimpleContactPresences PipePresenceCache::update(const Tp::SimpleContactPresences &presences,
+        const std::function<bool (uint)> &isPiped) 
+{
+    stats.received += presences.size();
+
+    Tp::SimpleContactPresences changed;
+    for(auto it = presences.cbegin(); it != presences.cend(); ++it) {
+        if(!isPiped(it.key())) continue;
+
+        auto cachedIt = cache.find(it.key());
+        if(cachedIt != cache.end() && samePresence(*cachedIt, it.value())) {
+            ++stats.suppressed;
+            continue;
+        }
+        cache[it.key()] = it.value();
+        changed[it.key()] = it.value();
+    }
+    stats.emitted += changed.size();
+    return changed;
+}
+
+Tp::SimpleContactPresences PipePresenceCache::applyRoster(const RosterDelta &delta, Tp::UIntList &missing) {
+
+    for(auto it = delta.removals.cbegin(); it != delta.removals.cend(); ++it)
+        cache.remove(it.key());
+
+    Tp::SimpleContactPresences known;
+    for(auto it = delta.identifiers.cbegin(); it != delta.identifiers.cend(); ++it) {
+        if(cache.contains(it.key())) continue;
+
+        // restored presences may be stale, fetched ones replace them when they differ
+        missing << it.key();
+        auto restoredIt = restored.find(it.value());
+        if(restoredIt != restored.end()) {
+            cache[it.key()] = *restoredIt;
+            known[it.key()] = *restoredIt;
+            restored.erase(restoredIt);
+        }
+    }
+    stats.emitted += known.size();
+    return known;
+}
+
+void PipePresenceCache::restore(const QHash<QString, Tp::SimplePresence> &presences) {
+    restored = presences;
+}
+
+QHash<QString, Tp::SimplePresence> PipePresenceCache::byIdentifier(
+        const std::function<QString (uint)> &identifierOf) const 
+{
+    QHash<QString, Tp::SimplePresence> presences;
+    for(auto it = cache.cbegin(); it != cache.cend(); ++it) {
+        QString id = identifierOf(it.key());
+        if(!id.isEmpty()) presences[id] = *it;
+    }
+    return presences;
+}
+
+const PresenceCounters& PipePresenceCache::counters() const {
+    return stats;
+}
@@ -0,0 +1,70 @@
+#ifndef PIPE_PRESENCE_CACHE_HPP
+#define PIPE_PRESENCE_CACHE_HPP
+
+#include <TelepathyQt/Types>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <functional>
+
+#include "roster_index.hpp"
+
+/**
+ * Statistics of presence traffic of one connection
+ */
+struct PresenceCounters {
+    // GetPresences calls made to piped connection
+    quint64 fetches = 0;
+    // presences received from piped connection
+    quint64 received = 0;
+    // presences dropped because they were the same as cached ones
+    quint64 suppressed = 0;
+    // presences announced by pipe connection
+    quint64 emitted = 0;
+};
+
+/**
+ * Presences of piped contacts, it does not depend on any D-Bus object. Presences which are the same
+ * as cached ones are suppressed. Presences of previous run are kept by identifiers until their 
+ * contacts are piped again.
+ */
+class PipePresenceCache {
+
+    public:
+        /**
+         * @return handles split to GetPresences calls, calls are counted as fetches
+         */
+        QList<Tp::UIntList> fetchBatches(const Tp::UIntList &handles);
+
+        /**
+         * Caches presences of piped contacts
+         * @return presences which changed and have to be announced
+         */
+        Tp::SimpleContactPresences update(const Tp::SimpleContactPresences &presences,
+                const std::function<bool (uint)> &isPiped);
+
+        /**
+         * Forgets presences of removed contacts, added contacts get their restored presences
+         * @param missing filled with added contacts whose presences have to be fetched
+         * @return restored presences to announce
+         */
+        Tp::SimpleContactPresences applyRoster(const RosterDelta &delta, Tp::UIntList &missing);
+
+        /**
+         * Sets presences of previous run by identifiers
+         */
+        void restore(const QHash<QString, Tp::SimplePresence> &presences);
+        /**
+         * @return cached presences by identifiers, contacts without identifier are left out
+         */
+        QHash<QString, Tp::SimplePresence> byIdentifier(const std::function<QString (uint)> &identifierOf) const;
+
+        const PresenceCounters& counters() const;
+
+    private:
+        Tp::SimpleContactPresences cache;
+        QHash<QString, Tp::SimplePresence> restored;
+        PresenceCounters stats;
+};
+
+#endif
@@ -8,6 +8,7 @@
 #include "protocol.hpp"
 #include "utils.hpp"
 #include "defines.hpp"
+#include "single_flight.hpp"
 
 PipeProtocol::PipeProtocol(
         const QDBusConnection &dbusConnection, 
@@ -33,7 +34,23 @@ PipeProtocol::PipeProtocol(
             Tp::ProtocolParameter(QLatin1String("Protocol"),
                 QLatin1String("s"), Tp::ConnMgrParamFlagRequired)
             << Tp::ProtocolParameter(QLatin1String("Identificator"),
-                QLatin1String("s"), Tp::ConnMgrParamFlagRequired));
+                QLatin1String("s"), Tp::ConnMgrParamFlagRequired)
+            << Tp::ProtocolParameter(QLatin1String("Chain"),
+                QLatin1String("as"), Tp::ConnMgrParamFlags())
+            << Tp::ProtocolParameter(QLatin1String("PrePipePoolSize"),
+                QLatin1String("u"), Tp::ConnMgrParamFlagHasDefault, 0u)
+            << Tp::ProtocolParameter(QLatin1String("PrePipeIdleTimeout"),
+                QLatin1String("u"), Tp::ConnMgrParamFlagHasDefault, 300u)
+            << Tp::ProtocolParameter(QLatin1String("ChannelMemoryBudget"),
+                QLatin1String("u"), Tp::ConnMgrParamFlagHasDefault, 0u)
+            << Tp::ProtocolParameter(QLatin1String("ChannelIdleTimeout"),
+                QLatin1String("u"), Tp::ConnMgrParamFlagHasDefault, 600u)
+            << Tp::ProtocolParameter(QLatin1String("InteractiveSendWeight"),
+                QLatin1String("u"), Tp::ConnMgrParamFlagHasDefault, 4u)
+            << Tp::ProtocolParameter(QLatin1String("BulkSendWeight"),
+                QLatin1String("u"), Tp::ConnMgrParamFlagHasDefault, 1u)
+            << Tp::ProtocolParameter(QLatin1String("BulkSendRate"),
+                QLatin1String("u"), Tp::ConnMgrParamFlagHasDefault, 5u));
 
     // set callbacks
     setCreateConnectionCallback(Tp::memFun(this, &PipeProtocol::createConnection));
@@ -66,6 +83,25 @@ PipeProtocol::PipeProtocol(
 }
 
 
+PipePtr PipeProtocol::getPipe() const {
+    return pipe;
+}
+
+PipeChain PipeProtocol::buildChain(const QVariantMap &parameters) const {
+
+    PipeChain chain { pipe };
+    for(const QString &pipeName: parameters.value("Chain").toStringList()) {
+        Tp::SharedPtr<PipeProtocol> chainedProto = 
+            Tp::SharedPtr<PipeProtocol>::dynamicCast(cm->protocol(pipeName + "Pipe"));
+        if(!chainedProto) {
+            pWarning() << "No pipe to chain with name: " << pipeName;
+            return PipeChain();
+        }
+        chain.push_back(chainedProto->getPipe());
+    }
+    return chain;
+}
+
 bool isConnectionPipable(const PipeProtocol &protocol, const Tp::ConnectionPtr &connection) {
 
     // check requestable channel classes
@@ -73,10 +109,13 @@ bool isConnectionPipable(const PipeProtocol &protocol, const Tp::ConnectionPtr &
     QString objectPath = QString(TP_QT_CONNECTION_MANAGER_OBJECT_PATH_BASE)
         + connection->cmName() + "/" + connection->protocolName();
 
-    Tp::Client::DBus::PropertiesInterface propsIface(QDBusConnection::sessionBus(), busName, objectPath);
-
-    QDBusPendingReply<QDBusVariant> reqChanClassesRep = propsIface.Get(
-            TP_QT_IFACE_PROTOCOL, "RequestableChannelClasses");
+    // accounts of the same protocol are checked with one call when their checks overlap
+    QDBusPendingReply<QDBusVariant> reqChanClassesRep = PipeSingleFlight::instance().call(
+            busName, objectPath, "Get", "RequestableChannelClasses",
+            [&busName, &objectPath]() -> QDBusPendingCall {
+                Tp::Client::DBus::PropertiesInterface propsIface(QDBusConnection::sessionBus(), busName, objectPath);
+                return propsIface.Get(TP_QT_IFACE_PROTOCOL, "RequestableChannelClasses");
+            });
     reqChanClassesRep.waitForFinished();
 
     if(reqChanClassesRep.isValid()) {
@@ -116,6 +155,22 @@ Tp::BaseConnectionPtr PipeProtocol::createConnection(const QVariantMap &paramete
         return Tp::BaseConnectionPtr();
     }
 
+    PipeChain chain = buildChain(parameters);
+    if(chain.empty()) {
+        error->set(TP_QT_ERROR_INVALID_ARGUMENT, 
+                QString("Chain contains unknown pipes for protocol: ") + name());
+        return Tp::BaseConnectionPtr();
+    }
+
+    // pipes loaded from cache are started with their first connection
+    for(auto &chainedPipe: chain) {
+        if(!chainedPipe->activate()) {
+            error->set(TP_QT_ERROR_NOT_AVAILABLE, 
+                    QString("Pipe service could not be started: ") + chainedPipe->service());
+            return Tp::BaseConnectionPtr();
+        }
+    }
+
     Tp::AccountSetPtr accSet = amp->validAccounts();
     QList<Tp::AccountPtr> accnts= accSet->accounts();
     for(auto ap: accnts) {
@@ -154,12 +209,21 @@ Tp::BaseConnectionPtr PipeProtocol::createConnection(const QVariantMap &paramete
                 if(pipedConnection->isReady())
                     return Tp::BaseConnectionPtr(new PipeConnection(
                                 pipedConnection,
-                                pipe,
+                                chain,
                                 QDBusConnection::sessionBus(),
                                 TP_QT_PIPE_CONNECTION_MANAGER_NAME,
                                 name(),
                                 parameters,
-                                { name() + "_" + protocolIt->value<QString>() + "_" + nameIt->value<QString>() }));
+                                { 
+                                    name() + "_" + protocolIt->value<QString>() + "_" + nameIt->value<QString>(),
+                                    parameters.value("PrePipePoolSize", 0u).toUInt(),
+                                    parameters.value("PrePipeIdleTimeout", 300u).toUInt(),
+                                    parameters.value("ChannelMemoryBudget", 0u).toUInt(),
+                                    parameters.value("ChannelIdleTimeout", 600u).toUInt(),
+                                    parameters.value("InteractiveSendWeight", 4u).toUInt(),
+                                    parameters.value("BulkSendWeight", 1u).toUInt(),
+                                    parameters.value("BulkSendRate", 5u).toUInt()
+                                }));
                 else {
                     error->set(TP_QT_ERROR_NETWORK_ERROR, "Piped connection has problems becoming ready: " + pipe->name());
                     return Tp::BaseConnectionPtr();
@@ -182,5 +246,10 @@ QString PipeProtocol::identifyAccount(const QVariantMap &parameters, Tp::DBusErr
 }
 
 QString PipeProtocol::normalizeContact(const QString &contactId, Tp::DBusError *error) {
-    return QString();
+
+    // letter case rules belong to the piped protocol, which is not known until connection is created
+    QString normalized = contactId.trimmed();
+    if(normalized.isEmpty()) 
+        error->set(TP_QT_ERROR_INVALID_HANDLE, "Contact identifier is empty");
+    return normalized;
 }
@@ -25,7 +25,15 @@ class PipeProtocol : public Tp::BaseProtocol {
 
         virtual ~PipeProtocol() = default;
 
+        PipePtr getPipe() const;
+
     private:
+        /**
+         * @return this protocol's pipe followed by pipes with names given in Chain parameter
+         *          or empty chain if one of them does not exist
+         */
+        PipeChain buildChain(const QVariantMap &parameters) const;
+
 
         Tp::BaseConnectionPtr createConnection(const QVariantMap &parameters, Tp::DBusError *error);
         QString identifyAccount(const QVariantMap &parameters, Tp::DBusError *error);
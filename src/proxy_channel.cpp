@@ -1,20 +1,45 @@
 #include "proxy_channel.hpp"
 #include "utils.hpp"
+#include "message_size.hpp"
 
 #include <TelepathyQt/Channel>
+#include <TelepathyQt/Connection>
 #include <TelepathyQt/PendingVariant>
 #include <TelepathyQt/PendingVariantMap>
+#include <QDateTime>
 #include <QObject>
 #include <QtDBus>
 
-// ------------ PipeProxyChannel --------------------------------------------------------------------------------
-PipeProxyChannelPtr PipeProxyChannel::create(Tp::BaseConnection* connection, Tp::ChannelPtr underChan) {
+namespace {
+
+    // estimate of memory held by proxy channel and its interfaces without messages
+    const size_t PROXY_CHANNEL_SIZE = 32 * 1024;
 
-    return PipeProxyChannelPtr(new PipeProxyChannel( QDBusConnection::sessionBus(), connection, underChan));
+    // minimal interval between forwarded chat states of one channel
+    const int CHAT_STATE_INTERVAL = 500; // ms
+    // delivery reports are relayed when batch is full or the interval since the first one passes
+    const int REPORT_BATCH_SIZE = 128;
+    const int REPORT_BATCH_INTERVAL = 200; // ms
+
+    bool isDeliveryReport(const Tp::MessagePart &header) {
+        auto it = header.constFind(QLatin1String("message-type"));
+        return it != header.constEnd() && it->variant().toUInt() == Tp::ChannelTextMessageTypeDeliveryReport;
+    }
+
+} /* anonymous namespace */
+
+// ------------ PipeProxyChannel --------------------------------------------------------------------------------
+PipeProxyChannelPtr PipeProxyChannel::create(
+        Tp::BaseConnection* connection, Tp::ChannelPtr underChan, const PipeChain &transforms,
+        const PipeSendSchedulerPtr &sendScheduler) 
+{
+    return PipeProxyChannelPtr(new PipeProxyChannel( 
+                QDBusConnection::sessionBus(), connection, underChan, transforms, sendScheduler));
 }
 
 PipeProxyChannel::PipeProxyChannel(
-        const QDBusConnection &dbusConnection, Tp::BaseConnection* connection, Tp::ChannelPtr underChan) 
+        const QDBusConnection &dbusConnection, Tp::BaseConnection* connection, 
+        Tp::ChannelPtr underChan, const PipeChain &transforms, const PipeSendSchedulerPtr &sendScheduler) 
     : Tp::BaseChannel(
             dbusConnection,
             connection,
@@ -22,18 +47,34 @@ PipeProxyChannel::PipeProxyChannel(
             underChan->targetHandle(),
             underChan->targetHandleType()),
     pipedChannel(underChan),
-    pipedIface(QDBusConnection::sessionBus(), underChan->busName(), underChan->objectPath())
+    pipedIface(QDBusConnection::sessionBus(), underChan->busName(), underChan->objectPath()),
+    transforms(transforms),
+    sentTokens(std::make_shared<PipeSentTokenIndex>()),
+    sendScheduler(sendScheduler),
+    activity(QDateTime::currentMSecsSinceEpoch())
 {
     // assuming this to interfaces are supported always at the same time
     if(underChan->channelType() == TP_QT_IFACE_CHANNEL_TYPE_TEXT &&
             underChan->hasInterface(TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES)) 
     {
-        Tp::BaseChannelTextTypePtr textTypePtr = addBaseChannelTextType();
-        addBaseChannelMessagesInterface(textTypePtr);
+        textType = addBaseChannelTextType();
+        addBaseChannelMessagesInterface(textType);
+
+        Tp::Client::ChannelInterfaceMessagesInterface *pipedMesIface = 
+            underChan->interface<Tp::Client::ChannelInterfaceMessagesInterface>();
+        auto touch = [this]() { activity = QDateTime::currentMSecsSinceEpoch(); };
+        connect(pipedMesIface, &Tp::Client::ChannelInterfaceMessagesInterface::MessageReceived, this, touch);
+        connect(pipedMesIface, &Tp::Client::ChannelInterfaceMessagesInterface::MessageSent, this, touch);
     } 
     else if(underChan->channelType() == TP_QT_IFACE_CHANNEL_TYPE_SERVER_AUTHENTICATION) {
         addBaseChannelServerAuthenticationType();
     }
+    else if(underChan->channelType() == TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER) {
+        addBaseChannelFileTransferType();
+    }
+    else if(underChan->channelType() == TP_QT_IFACE_CHANNEL_TYPE_STREAM_TUBE) {
+        addBaseChannelStreamTubeType();
+    }
 
     // plug necessary interfaces
     for(const QString &iface: underChan->interfaces()) {
@@ -41,6 +82,10 @@ PipeProxyChannel::PipeProxyChannel(
             addBaseChannelGroupInterface();
         } else if(iface == TP_QT_IFACE_CHANNEL_INTERFACE_CAPTCHA_AUTHENTICATION) {
             addBaseChannelCaptchaAuthenticationInterface();
+        } else if(iface == TP_QT_IFACE_CHANNEL_INTERFACE_CHAT_STATE) {
+            addBaseChannelChatStateInterface();
+        } else if(iface == TP_QT_IFACE_CHANNEL_INTERFACE_TUBE) {
+            addBaseChannelTubeInterface();
         }
     }
 
@@ -48,20 +93,61 @@ PipeProxyChannel::PipeProxyChannel(
 }
 
 PipeProxyChannel::~PipeProxyChannel() {
-    if(pipedChannel && pipedChannel->isValid()) {
+    dropDeliveryReports();
+    if(!keepPipedChannel && pipedChannel && pipedChannel->isValid()) {
         pipedChannel->requestClose();
     }
 }
 
+Tp::ChannelPtr PipeProxyChannel::getPipedChannel() const {
+    return pipedChannel;
+}
+
+qint64 PipeProxyChannel::lastActivity() const {
+    return activity;
+}
+
+size_t PipeProxyChannel::estimatedSize() const {
+    return PROXY_CHANNEL_SIZE + (textType ? message_size::estimate(textType->pendingMessages()) : 0);
+}
+
+bool PipeProxyChannel::hasPendingMessages() const {
+    Tp::SharedPtr<PipeChannelTextType> pipeTextType = Tp::SharedPtr<PipeChannelTextType>::dynamicCast(textType);
+    return textType && (!textType->pendingMessages().isEmpty() || (pipeTextType && pipeTextType->hasQueuedDeliveryReports()));
+}
+
+void PipeProxyChannel::reclaim() {
+    pDebug() << "Reclaiming idle proxy of channel: " << pipedChannel->objectPath();
+    dropDeliveryReports();
+    keepPipedChannel = true;
+    emit closed();
+}
+
+void PipeProxyChannel::release(bool closePipedChannel) {
+    dropDeliveryReports();
+    if(closePipedChannel && !keepPipedChannel && pipedChannel->isValid()) {
+        // reply is not needed, destructor must not close it again
+        pipedIface.Close();
+    }
+    keepPipedChannel = true;
+    emit closed();
+}
+
 void PipeProxyChannel::closedCb() {
+    dropDeliveryReports();
     emit closed();
 }
 
+void PipeProxyChannel::dropDeliveryReports() {
+    Tp::SharedPtr<PipeChannelTextType> pipeTextType = Tp::SharedPtr<PipeChannelTextType>::dynamicCast(textType);
+    if(pipeTextType) pipeTextType->dropDeliveryReports();
+}
+
 Tp::BaseChannelTextTypePtr PipeProxyChannel::addBaseChannelTextType() {
 
     Tp::Client::ChannelTypeTextInterface *pipedTextIface = pipedChannel->interface<Tp::Client::ChannelTypeTextInterface>();
     Tp::Client::ChannelInterfaceMessagesInterface *pipedMesIface = pipedChannel->interface<Tp::Client::ChannelInterfaceMessagesInterface>();
-    Tp::BaseChannelTextTypePtr textTypePtr(new PipeChannelTextType(this, pipedTextIface, pipedMesIface));
+    Tp::BaseChannelTextTypePtr textTypePtr(new PipeChannelTextType(this, pipedTextIface, pipedMesIface, transforms, sentTokens));
     plugInterface(textTypePtr);
 
     return textTypePtr;
@@ -85,16 +171,19 @@ void PipeProxyChannel::addBaseChannelMessagesInterface(Tp::BaseChannelTextTypePt
         uint supportedFlags = resMap["MessagePartSupportFlags"].toUInt();
         uint deliveryReportingSupport = resMap["DeliveryReportingSupport"].toUInt();
 
-        Tp::BaseChannelMessagesInterfacePtr messagesPtr(
+        PipeChannelMessagesInterfacePtr messagesPtr(
                 new PipeChannelMessagesInterface(
                     textTypePtr.data(),
                     pipedMesIface,
                     supportedContentTypes,
                     messageTypes,
                     supportedFlags,
-                    deliveryReportingSupport));
+                    deliveryReportingSupport,
+                    transforms,
+                    sentTokens,
+                    sendScheduler));
 
-        plugInterface(messagesPtr);
+        plugInterface(Tp::AbstractChannelInterfacePtr::dynamicCast(messagesPtr));
     } else {
         pWarning() << "Could not get all properties of messages interface to pipe";
     }
@@ -117,19 +206,104 @@ void PipeProxyChannel::addBaseChannelCaptchaAuthenticationInterface() {
 
 void PipeProxyChannel::addBaseChannelGroupInterface() {
 
-    // TODO
-    //Tp::BaseChannelGroupInterfacePtr groupPtr(new PipeChannelGroupInterface(this));
-    //plugInterface(groupPtr);
+    Tp::Client::ChannelInterfaceGroupInterface *pipedGroupIface = pipedChannel->interface<Tp::Client::ChannelInterfaceGroupInterface>();
+    Tp::PendingVariantMap *pendingRep = pipedGroupIface->requestAllProperties();
+    { // wait for operation to finish
+        QEventLoop loop;
+        QObject::connect(pendingRep, &Tp::PendingOperation::finished,
+                &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+    if(pendingRep->isValid()) {
+        PipeChannelGroupInterfacePtr groupPtr(new PipeChannelGroupInterface(pipedChannel, pendingRep->result()));
+        plugInterface(Tp::AbstractChannelInterfacePtr::dynamicCast(groupPtr));
+    } else {
+        pWarning() << "Could not get all properties of group interface to pipe";
+    }
+}
+
+void PipeProxyChannel::addBaseChannelFileTransferType() {
+
+    Tp::Client::ChannelTypeFileTransferInterface *pipedFileTransferIface = 
+        pipedChannel->interface<Tp::Client::ChannelTypeFileTransferInterface>();
+    QVariantMap properties;
+    if(requestPipedProperties(pipedFileTransferIface, properties)) {
+        PipeChannelFileTransferTypePtr fileTransferPtr(new PipeChannelFileTransferType(pipedFileTransferIface, properties));
+        plugInterface(Tp::AbstractChannelInterfacePtr::dynamicCast(fileTransferPtr));
+    } else {
+        pWarning() << "Could not get all properties of file transfer type to pipe";
+    }
+}
+
+void PipeProxyChannel::addBaseChannelStreamTubeType() {
+
+    Tp::Client::ChannelTypeStreamTubeInterface *pipedStreamTubeIface = 
+        pipedChannel->interface<Tp::Client::ChannelTypeStreamTubeInterface>();
+    QVariantMap properties;
+    if(requestPipedProperties(pipedStreamTubeIface, properties)) {
+        PipeChannelStreamTubeTypePtr streamTubePtr(new PipeChannelStreamTubeType(pipedStreamTubeIface, properties));
+        plugInterface(Tp::AbstractChannelInterfacePtr::dynamicCast(streamTubePtr));
+    } else {
+        pWarning() << "Could not get all properties of stream tube type to pipe";
+    }
+}
+
+void PipeProxyChannel::addBaseChannelTubeInterface() {
+
+    Tp::Client::ChannelInterfaceTubeInterface *pipedTubeIface = 
+        pipedChannel->interface<Tp::Client::ChannelInterfaceTubeInterface>();
+    QVariantMap properties;
+    if(requestPipedProperties(pipedTubeIface, properties)) {
+        PipeChannelTubeInterfacePtr tubePtr(new PipeChannelTubeInterface(pipedTubeIface, properties));
+        plugInterface(Tp::AbstractChannelInterfacePtr::dynamicCast(tubePtr));
+    } else {
+        pWarning() << "Could not get all properties of tube interface to pipe";
+    }
+}
+
+bool PipeProxyChannel::requestPipedProperties(Tp::AbstractInterface *pipedIface, QVariantMap &properties) {
+
+    Tp::PendingVariantMap *pendingRep = pipedIface->requestAllProperties();
+    { // wait for operation to finish
+        QEventLoop loop;
+        QObject::connect(pendingRep, &Tp::PendingOperation::finished,
+                &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+    if(!pendingRep->isValid()) return false;
+    properties = pendingRep->result();
+    return true;
+}
+
+void PipeProxyChannel::addBaseChannelChatStateInterface() {
+
+    Tp::BaseChannelChatStateInterfacePtr chatStatePtr(new PipeChannelChatStateInterface(
+                pipedChannel->interface<Tp::Client::ChannelInterfaceChatStateInterface>(),
+                pipedChannel->connection()->selfHandle()));
+    plugInterface(chatStatePtr);
 }
         
 // ------------ TextType ----------------------------------------------------------------------------------------
 PipeChannelTextType::PipeChannelTextType(Tp::BaseChannel *chan,
         Tp::Client::ChannelTypeTextInterface *textIface,
-        Tp::Client::ChannelInterfaceMessagesInterface *mesIface) 
+        Tp::Client::ChannelInterfaceMessagesInterface *mesIface,
+        const PipeChain &transforms,
+        const PipeSentTokenIndexPtr &sentTokens) 
     : Tp::BaseChannelTextType(chan), 
     textIface(textIface),
-    mesIface(mesIface)
+    mesIface(mesIface),
+    sentTokens(sentTokens)
 {
+    reportTimer.setSingleShot(true);
+    reportTimer.setInterval(REPORT_BATCH_INTERVAL);
+    connect(&reportTimer, &QTimer::timeout, this, &PipeChannelTextType::flushDeliveryReports);
+
+    if(!transforms.empty()) {
+        batcher = new PipeMessageBatcher(transforms, 
+                [this](const Tp::MessagePartList &message) { addReceivedMessage(message); }, 
+                this);
+    }
+
     setMessageAcknowledgedCallback(Tp::memFun(this, &PipeChannelTextType::messageAcknowledgedCb));
 
     Tp::PendingVariant *pendingRep = mesIface->requestPropertyPendingMessages();
@@ -153,8 +327,21 @@ PipeChannelTextType::PipeChannelTextType(Tp::BaseChannel *chan,
             });
 }
 
+PipeChannelTextType::~PipeChannelTextType() {
+
+    const DeliveryReportStats &stats = sentTokens->stats();
+    if(stats.reports > 0) {
+        pDebug() << "Delivery reports: " << stats.reports << ", unmatched: " << stats.unmatched 
+            << ", repeated: " << stats.repeated
+            << ", average lag: " << stats.totalLag / qMax<qint64>(1, stats.reports - stats.unmatched - stats.repeated) 
+            << " ms, max lag: " << stats.maxLag << " ms";
+    }
+}
+
 void PipeChannelTextType::messageAcknowledgedCb(QString token) {
 
+    if(reportTokens.remove(token)) return;
+
     auto it = pendingTokenMap.find(token);
     if(it != pendingTokenMap.end()) {
         Tp::UIntList ids;
@@ -173,9 +360,15 @@ void PipeChannelTextType::mesageReceivedCb(const Tp::MessagePartList &newMessage
         auto itToken = header.find(QLatin1String("message-token"));
         auto itId = header.find(QLatin1String("pending-message-id"));
         if(itToken != header.end() && itId != header.end()) {
+            if(isDeliveryReport(header)) {
+                if(relayingReports) queueDeliveryReport(newMessage, itToken->variant().toString(), itId->variant().toUInt());
+                return;
+            }
+
             // add new mapping
             pendingTokenMap[itToken->variant().toString()] = itId->variant().toUInt();
-            addReceivedMessage(newMessage);
+            if(batcher != nullptr) batcher->add(newMessage);
+            else addReceivedMessage(newMessage);
         } else {
             pWarning() << "Received message has no message-token or pending-message-id";
         }
@@ -184,28 +377,138 @@ void PipeChannelTextType::mesageReceivedCb(const Tp::MessagePartList &newMessage
     }
 }
 
-// ------------ MessagesInterface -------------------------------------------------------------------------------
-PipeChannelMessagesInterface::PipeChannelMessagesInterface(
-                Tp::BaseChannelTextType *chan,
-                Tp::Client::ChannelInterfaceMessagesInterface *pipedMesIface,
-                QStringList supportedContentTypes,
-                Tp::UIntList messageTypes,
-                uint messagePartSupportFlags,
-                uint deliveryReportingSupport)
-: Tp::BaseChannelMessagesInterface(chan, supportedContentTypes, messageTypes, messagePartSupportFlags, deliveryReportingSupport),
-    pipedMesIface(pipedMesIface) 
+void PipeChannelTextType::queueDeliveryReport(const Tp::MessagePartList &report, const QString &token, uint pendingId) {
+
+    reportBatch.append(report);
+    batchTokens.append(token);
+    reportIds.append(pendingId);
+
+    if(reportIds.size() >= REPORT_BATCH_SIZE) flushDeliveryReports();
+    else if(!reportTimer.isActive()) reportTimer.start();
+}
+
+void PipeChannelTextType::flushDeliveryReports() {
+
+    reportTimer.stop();
+    if(reportIds.isEmpty()) return;
+
+    // reports are matched only when relayed, report left on piped channel is not repeated for the next proxy
+    for(int i = 0; i < reportBatch.size(); ++i) {
+        const Tp::MessagePart &header = reportBatch[i].first();
+        auto tokenIt = header.constFind(QLatin1String("delivery-token"));
+        auto statusIt = header.constFind(QLatin1String("delivery-status"));
+        DeliveryReportMatch match = sentTokens->report(
+                tokenIt != header.constEnd() ? tokenIt->variant().toString() : QString(),
+                statusIt != header.constEnd() ? statusIt->variant().toUInt() : uint(Tp::DeliveryStatusUnknown));
+
+        // clients already know repeated status, such report is only acknowledged on piped channel
+        if(match != DeliveryReportMatch::REPEATED) {
+            addReceivedMessage(reportBatch[i]);
+            reportTokens.insert(batchTokens[i]);
+        }
+    }
+    reportBatch.clear();
+    batchTokens.clear();
+
+    // reports are kept by this channel now, so piped channel can drop them
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(
+            textIface->AcknowledgePendingMessages(reportIds), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [](QDBusPendingCallWatcher *finishedWatcher) {
+            QDBusPendingReply<> ackRep = *finishedWatcher;
+            if(ackRep.isError()) 
+                pWarning() << "Could not acknowledge delivery reports: " << ackRep.error().message();
+            finishedWatcher->deleteLater();
+        });
+    reportIds.clear();
+}
+
+bool PipeChannelTextType::hasQueuedDeliveryReports() const {
+    return !reportIds.isEmpty();
+}
+
+void PipeChannelTextType::dropDeliveryReports() {
+
+    reportTimer.stop();
+    relayingReports = false;
+    if(!reportIds.isEmpty())
+        pDebug() << "Leaving " << reportIds.size() << " delivery reports on piped channel";
+    reportBatch.clear();
+    batchTokens.clear();
+    reportIds.clear();
+}
+
+// ------------ ChatState ---------------------------------------------------------------------------------------
+PipeChannelChatStateInterface::PipeChannelChatStateInterface(
+        Tp::Client::ChannelInterfaceChatStateInterface *pipedChatStateIface, uint selfHandle)
+    : pipedChatStateIface(pipedChatStateIface), selfHandle(selfHandle)
 {
-    setSendMessageCallback(Tp::memFun(this, &PipeChannelMessagesInterface::sendMessageCb));
+    setSetChatStateCallback(Tp::memFun(this, &PipeChannelChatStateInterface::setChatStateCb));
+
+    intervalTimer.setSingleShot(true);
+    intervalTimer.setInterval(CHAT_STATE_INTERVAL);
+    connect(&intervalTimer, &QTimer::timeout, this, &PipeChannelChatStateInterface::flush);
+
+    Tp::PendingVariant *pendingRep = pipedChatStateIface->requestPropertyChatStates();
+    connect(pendingRep, &Tp::PendingOperation::finished, this, [this, pendingRep](Tp::PendingOperation *op) {
+            if(op->isValid()) {
+                Tp::ChatStateMap states = qdbus_cast<Tp::ChatStateMap>(pendingRep->result());
+                for(auto it = states.constBegin(); it != states.constEnd(); ++it) forwarded[it.key()] = it.value();
+                setChatStates(states);
+            } else {
+                pWarning() << "Could not get chat states of piped channel: " << op->errorMessage();
+            }
+        });
+
+    connect(pipedChatStateIface, &Tp::Client::ChannelInterfaceChatStateInterface::ChatStateChanged,
+            this, &PipeChannelChatStateInterface::chatStateChangedCb);
 }
 
-QString PipeChannelMessagesInterface::sendMessageCb(const Tp::MessagePartList &messages, uint flags, Tp::DBusError* error) {
+void PipeChannelChatStateInterface::setChatStateCb(uint state, Tp::DBusError *error) {
 
-    QDBusPendingReply<QString> pendingToken = pipedMesIface->SendMessage(messages, flags);
-    pendingToken.waitForFinished();
-    if(pendingToken.isValid()) {
-        return pendingToken.value();
-    } else {
-        error->set(pendingToken.error().name(), pendingToken.error().message());
-        return QString();
+    // own state is sent at once, client expects error if it fails
+    if(forwarded.contains(selfHandle) && forwarded.value(selfHandle) == state) return;
+
+    // own state is updated when piped channel announces it
+    QDBusPendingReply<> setRep = pipedChatStateIface->SetChatState(state);
+    setRep.waitForFinished();
+    if(!setRep.isValid()) error->set(setRep.error().name(), setRep.error().message());
+}
+
+void PipeChannelChatStateInterface::chatStateChangedCb(uint contact, uint state) {
+
+    // own state is not coalesced, so that SetChatState compares with the current one
+    if(contact == selfHandle) {
+        waiting.remove(contact);
+        if(!forwarded.contains(contact) || forwarded.value(contact) != state) {
+            forwarded[contact] = state;
+            chatStateChanged(contact, state);
+        }
+        return;
+    }
+
+    if(intervalTimer.isActive()) {
+        waiting[contact] = state;
+        return;
+    }
+
+    if(!forwarded.contains(contact) || forwarded.value(contact) != state) {
+        forwarded[contact] = state;
+        chatStateChanged(contact, state);
+        intervalTimer.start();
     }
 }
+
+void PipeChannelChatStateInterface::flush() {
+
+    bool anyForwarded = false;
+    for(auto it = waiting.constBegin(); it != waiting.constEnd(); ++it) {
+        if(!forwarded.contains(it.key()) || forwarded.value(it.key()) != it.value()) {
+            forwarded[it.key()] = it.value();
+            chatStateChanged(it.key(), it.value());
+            anyForwarded = true;
+        }
+    }
+    waiting.clear();
+
+    if(anyForwarded) intervalTimer.start();
+}
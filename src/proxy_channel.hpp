@@ -3,6 +3,18 @@
 
 #include <TelepathyQt/BaseChannel>
 #include <TelepathyQt/ChannelInterface>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+
+#include "types.hpp"
+#include "message_batcher.hpp"
+#include "sent_token_index.hpp"
+#include "send_scheduler.hpp"
+#include "group_interface.hpp"
+#include "messages_interface.hpp"
+#include "file_transfer_type.hpp"
+#include "stream_tube_type.hpp"
 
 class PipeProxyChannel;
 typedef Tp::SharedPtr<PipeProxyChannel> PipeProxyChannelPtr;
@@ -10,11 +22,48 @@ typedef Tp::SharedPtr<PipeProxyChannel> PipeProxyChannelPtr;
 class PipeProxyChannel : public Tp::BaseChannel {
 
     public:
-        static PipeProxyChannelPtr create(Tp::BaseConnection* connection, Tp::ChannelPtr underChan);
+        /**
+         * @param transforms pipes transforming messages of the channel
+         * @param sendScheduler scheduler of outgoing messages of connection, they are sent 
+         *          directly without it
+         */
+        static PipeProxyChannelPtr create(
+                Tp::BaseConnection* connection, Tp::ChannelPtr underChan, const PipeChain &transforms = PipeChain(),
+                const PipeSendSchedulerPtr &sendScheduler = PipeSendSchedulerPtr());
         virtual ~PipeProxyChannel();
 
+        Tp::ChannelPtr getPipedChannel() const;
+
+        /**
+         * @return time of the last message received or sent through the channel in ms since epoch
+         */
+        qint64 lastActivity() const;
+        /**
+         * @return rough estimate of memory held by the proxy in bytes, pending messages are 
+         *          counted by their headers and contents
+         */
+        size_t estimatedSize() const;
+        /**
+         * @return true if some received messages were not acknowledged by clients or delivery
+         * reports wait to be relayed
+         */
+        bool hasPendingMessages() const;
+
+        /**
+         * Closes the proxy but leaves piped channel open, so that it can be piped again
+         */
+        void reclaim();
+        /**
+         * Closes the proxy at once. Piped channel is closed without waiting for the result,
+         * so that many channels can be closed in parallel.
+         *
+         * @param closePipedChannel false if piped channel is already gone with its connection
+         */
+        void release(bool closePipedChannel);
+
     protected:
-        PipeProxyChannel(const QDBusConnection &dbusConnection, Tp::BaseConnection* connection, Tp::ChannelPtr underChan);
+        PipeProxyChannel(const QDBusConnection &dbusConnection, Tp::BaseConnection* connection, 
+                Tp::ChannelPtr underChan, const PipeChain &transforms, const PipeSendSchedulerPtr &sendScheduler);
 
     private:
         Tp::BaseChannelTextTypePtr addBaseChannelTextType();
@@ -22,48 +71,81 @@ class PipeProxyChannel : public Tp::BaseChannel {
         void addBaseChannelServerAuthenticationType();
         void addBaseChannelCaptchaAuthenticationInterface();
         void addBaseChannelGroupInterface();
+        void addBaseChannelChatStateInterface();
+        void addBaseChannelFileTransferType();
+        void addBaseChannelStreamTubeType();
+        void addBaseChannelTubeInterface();
+        /**
+         * Waits for all properties of given interface of piped channel
+         * @return false if they could not be obtained
+         */
+        bool requestPipedProperties(Tp::AbstractInterface *pipedIface, QVariantMap &properties);
 
         void closedCb();
+        /**
+         * Leaves delivery reports on piped channel, proxy which is closing cannot relay them
+         */
+        void dropDeliveryReports();
 
     private:
         Tp::ChannelPtr pipedChannel;
         Tp::Client::ChannelInterface pipedIface;
+        PipeChain transforms;
+        PipeSentTokenIndexPtr sentTokens;
+        PipeSendSchedulerPtr sendScheduler;
+        Tp::BaseChannelTextTypePtr textType;
+        qint64 activity;
+        bool keepPipedChannel = false;
 };
 
+/**
+ * Text type relaying received messages. Delivery reports are not transformed, they are relayed
+ * in batches and acknowledged on piped channel at once, each batch with one call. Reports repeating
+ * status already reported for a message sent through the pipe are only acknowledged.
+ */
 class PipeChannelTextType : public Tp::BaseChannelTextType {
 
     public:
         PipeChannelTextType(Tp::BaseChannel *chan, 
                 Tp::Client::ChannelTypeTextInterface *textIface, 
-                Tp::Client::ChannelInterfaceMessagesInterface *mesIface);
+                Tp::Client::ChannelInterfaceMessagesInterface *mesIface,
+                const PipeChain &transforms,
+                const PipeSentTokenIndexPtr &sentTokens);
+        virtual ~PipeChannelTextType();
+
+        /**
+         * Relays waiting delivery reports and acknowledges them on piped channel
+         */
+        void flushDeliveryReports();
+        /**
+         * Drops waiting delivery reports without acknowledging them, so that they stay pending on
+         * piped channel for the next proxy. Reports received later are left there too. It has to be
+         * called when the channel is closing.
+         */
+        void dropDeliveryReports();
+        /**
+         * @return true if delivery reports wait for their batch
+         */
+        bool hasQueuedDeliveryReports() const;
 
     private:
         void messageAcknowledgedCb(QString);
         void mesageReceivedCb(const Tp::MessagePartList &newMessage);
+        void queueDeliveryReport(const Tp::MessagePartList &report, const QString &token, uint pendingId);
 
     private:
         Tp::Client::ChannelTypeTextInterface *textIface;
         Tp::Client::ChannelInterfaceMessagesInterface *mesIface;
+        PipeMessageBatcher *batcher = nullptr;
         QMap<QString, uint> pendingTokenMap;
-};
-
-class PipeChannelMessagesInterface : public Tp::BaseChannelMessagesInterface {
-
-    public:
-        PipeChannelMessagesInterface(
-                Tp::BaseChannelTextType *chan,
-                Tp::Client::ChannelInterfaceMessagesInterface *pipedMesIface,
-                QStringList supportedContentTypes,
-                Tp::UIntList messageTypes,
-                uint messagePartSupportFlags,
-                uint deliveryReportingSupport);
-
-    private:
-        QString sendMessageCb(const Tp::MessagePartList &messages, uint flags, Tp::DBusError* error);
-
-    private:
-        Tp::Client::ChannelInterfaceMessagesInterface *pipedMesIface;
-
+        PipeSentTokenIndexPtr sentTokens;
+        QList<Tp::MessagePartList> reportBatch;
+        QStringList batchTokens;
+        Tp::UIntList reportIds;
+        // tokens of relayed reports, they are already acknowledged on piped channel
+        QSet<QString> reportTokens;
+        QTimer reportTimer;
+        bool relayingReports = true;
 };
 
 class PipeChannelServerAuthenticationType : public Tp::BaseChannelServerAuthenticationType {
@@ -84,14 +166,34 @@ class PipeChannelCaptchaAuthenticationInterface : public Tp::BaseChannelCaptchaA
         void cancelCaptchaCb(const QString&, DBusError*);
 };
 
-class PipeChannelGroupInterface : public Tp::BaseChannelGroupInterface {
+/**
+ * Chat state interface relaying only real transitions of contacts' states. Transitions are 
+ * forwarded at most once per interval, states changed in the meantime are coalesced and only
+ * the last one of each contact is forwarded when the interval ends. Own state is forwarded at once
+ * and setting the state it already has is not passed to piped channel.
+ */
+class PipeChannelChatStateInterface : public Tp::BaseChannelChatStateInterface {
 
     public:
-        PipeChannelGroupInterface(Tp::BaseChannel *chan);
+        /**
+         * @param selfHandle handle of the user on piped connection
+         */
+        PipeChannelChatStateInterface(Tp::Client::ChannelInterfaceChatStateInterface *pipedChatStateIface,
+                uint selfHandle);
+
+    private:
+        void setChatStateCb(uint state, Tp::DBusError *error);
+        void chatStateChangedCb(uint contact, uint state);
+        void flush();
 
     private:
-        void removeMembersCb(const Tp::UIntList&, const QString&, DBusError*);
-        void setAddMembersCallback(const Tp::UIntList&, const QString&, DBusError*);
+        Tp::Client::ChannelInterfaceChatStateInterface *pipedChatStateIface;
+        uint selfHandle;
+        // last states announced by piped channel and forwarded, including own state
+        QHash<uint, uint> forwarded;
+        // states waiting for the end of interval
+        QHash<uint, uint> waiting;
+        QTimer intervalTimer;
 };
 
 #endif
@@ -4,3 +4,4 @@
  */
 #include <TelepathyQt/Types>
 typedef Tp::RequestableChannelClassList RequestableChannelClassList;
+typedef Tp::MessagePartListList MessagePartListList;
@@ -0,0 +1,29 @@
+#include "request_merger.hpp"
+
+bool PipeRequestMerger::start(const QString &key, const Waiter &waiter) {
+
+    auto it = inFlight.find(key);
+    if(it == inFlight.end()) {
+        inFlight.insert(key, QList<Waiter>());
+        return true;
+    }
+
+    it->append(waiter);
+    ++mergedRequests;
+    return false;
+}
+
+void PipeRequestMerger::finish(const QString &key, const QString &errorName, const QString &errorMessage) {
+
+    // waiters may start new requests, so the entry is gone before they are called
+    QList<Waiter> waiters = inFlight.take(key);
+    for(const Waiter &waiter: waiters) waiter(errorName, errorMessage);
+}
+
+bool PipeRequestMerger::isInFlight(const QString &key) const {
+    return inFlight.contains(key);
+}
+
+quint64 PipeRequestMerger::merged() const {
+    return mergedRequests;
+}
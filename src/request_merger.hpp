@@ -0,0 +1,47 @@
+#ifndef PIPE_REQUEST_MERGER_HPP
+#define PIPE_REQUEST_MERGER_HPP
+
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <functional>
+
+/**
+ * Merges identical requests made while one of them is being served. Only the first request is 
+ * served, the others wait for it and are answered once it finishes, with its error if it failed. 
+ * It does not depend on any D-Bus object, requests are identified by a key chosen by the caller.
+ */
+class PipeRequestMerger {
+
+    public:
+        /**
+         * Called when request in flight finishes
+         * @param errorName empty when the request succeeded
+         */
+        typedef std::function<void (const QString &errorName, const QString &errorMessage)> Waiter;
+
+        /**
+         * @return true if there is no identical request in flight and caller has to serve this one,
+         *          false if waiter was queued to be called when the request in flight finishes
+         */
+        bool start(const QString &key, const Waiter &waiter);
+
+        /**
+         * Ends request in flight and calls waiters queued while it was served, identical requests
+         * made by the waiters are served again
+         */
+        void finish(const QString &key, const QString &errorName = QString(), const QString &errorMessage = QString());
+
+        bool isInFlight(const QString &key) const;
+
+        /**
+         * @return number of requests which waited for an identical one
+         */
+        quint64 merged() const;
+
+    private:
+        QHash<QString, QList<Waiter>> inFlight;
+        quint64 mergedRequests = 0;
+};
+
+#endif
@@ -0,0 +1,207 @@
+#include "requests_interface.hpp"
+#include "utils.hpp"
+
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/DBusObject>
+
+namespace {
+
+    /**
+     * @return key of request which is the same for requests of the same channel, target is given
+     *          by its resolved handle, all other properties have to be equal
+     */
+    QString requestKey(const QVariantMap &request, uint targetHandle) {
+
+        QString targetHandleProp = TP_QT_IFACE_CHANNEL + QString(".TargetHandle");
+        QString targetIdProp = TP_QT_IFACE_CHANNEL + QString(".TargetID");
+        QString key;
+        for(auto it = request.constBegin(); it != request.constEnd(); ++it) {
+            if(it.key() == targetHandleProp || it.key() == targetIdProp) continue;
+            key += it.key() + '=' + (it->type() == QVariant::StringList ? it->toStringList().join(',') : it->toString()) + '\n';
+        }
+        return key + targetHandleProp + '=' + QString::number(targetHandle);
+    }
+
+} /* anonymous namespace */
+
+// ------------ PipeConnectionRequestsInterface ----------------------------------------------------------------
+PipeConnectionRequestsInterface::PipeConnectionRequestsInterface(
+        Tp::BaseConnection *connection, const Tp::RequestableChannelClassList &classes)
+    : Tp::AbstractConnectionInterface(TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS),
+    connection(connection),
+    classes(classes)
+{
+}
+
+QVariantMap PipeConnectionRequestsInterface::immutableProperties() const {
+    QVariantMap properties;
+    properties[TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS + QString(".RequestableChannelClasses")] = 
+        QVariant::fromValue(classes);
+    return properties;
+}
+
+void PipeConnectionRequestsInterface::createAdaptor() {
+    (void) new PipeConnectionRequestsAdaptor(dbusObject()->dbusConnection(), this, dbusObject());
+}
+
+Tp::ChannelDetailsList PipeConnectionRequestsInterface::channels() const {
+    return connection->channelsDetails();
+}
+
+Tp::RequestableChannelClassList PipeConnectionRequestsInterface::requestableChannelClasses() const {
+    return classes;
+}
+
+void PipeConnectionRequestsInterface::createChannel(const QVariantMap &request, const ChannelAnswer &answer) {
+    this->request(request, false, answer);
+}
+
+void PipeConnectionRequestsInterface::ensureChannel(const QVariantMap &request, const ChannelAnswer &answer) {
+    this->request(request, true, answer);
+}
+
+void PipeConnectionRequestsInterface::announceChannel(const Tp::BaseChannelPtr &channel) {
+
+    QDBusObjectPath objectPath(channel->objectPath());
+    connect(channel.data(), &Tp::BaseChannel::closed, this, [this, objectPath]() { emit channelClosed(objectPath); });
+    emit newChannels(Tp::ChannelDetailsList() << channel->details());
+}
+
+void PipeConnectionRequestsInterface::request(const QVariantMap &request, bool ensure, const ChannelAnswer &answer) {
+
+    QString channelTypeProp = TP_QT_IFACE_CHANNEL + QString(".ChannelType");
+    QString targetHandleTypeProp = TP_QT_IFACE_CHANNEL + QString(".TargetHandleType");
+    QString targetHandleProp = TP_QT_IFACE_CHANNEL + QString(".TargetHandle");
+    QString targetIdProp = TP_QT_IFACE_CHANNEL + QString(".TargetID");
+    if(!request.contains(channelTypeProp)) {
+        answer(Tp::BaseChannelPtr(), false, TP_QT_ERROR_INVALID_ARGUMENT, "Channel type is missing in the request");
+        return;
+    }
+    if(request.contains(targetHandleProp) && request.contains(targetIdProp)) {
+        answer(Tp::BaseChannelPtr(), false, TP_QT_ERROR_INVALID_ARGUMENT, "Request has both TargetHandle and TargetID");
+        return;
+    }
+
+    QString channelType = request.value(channelTypeProp).toString();
+    uint targetHandleType = request.value(targetHandleTypeProp).toUInt();
+    uint targetHandle = request.value(targetHandleProp).toUInt();
+    if(request.contains(targetIdProp)) {
+        Tp::DBusError error;
+        Tp::UIntList handles = connection->requestHandles(targetHandleType, 
+                QStringList() << request.value(targetIdProp).toString(), &error);
+        if(error.isValid() || handles.size() != 1) {
+            answer(Tp::BaseChannelPtr(), false, error.isValid() ? error.name() : QString(TP_QT_ERROR_INVALID_HANDLE),
+                    error.isValid() ? error.message() : QString("TargetID could not be resolved"));
+            return;
+        }
+        targetHandle = handles.first();
+    }
+
+    // only EnsureChannel may get a channel piped for another request
+    QString key = requestKey(request, targetHandle);
+    if(!ensure && merger.isInFlight(key)) {
+        answer(Tp::BaseChannelPtr(), false, TP_QT_ERROR_NOT_AVAILABLE, "Identical channel is being requested");
+        return;
+    }
+
+    // ensure requests made while the channel is being piped get it when it is ready
+    bool first = merger.start(key, 
+            [this, channelType, targetHandleType, targetHandle, answer](const QString &errorName, const QString &errorMessage) {
+                if(errorName.isEmpty()) answerMerged(channelType, targetHandleType, targetHandle, answer);
+                else answer(Tp::BaseChannelPtr(), false, errorName, errorMessage);
+            });
+    if(!first) {
+        pDebug() << "Request for channel: " << channelType << " to: " << targetHandle 
+            << " waits for the identical one in flight";
+        return;
+    }
+
+    Tp::DBusError error;
+    bool yours = true;
+    Tp::BaseChannelPtr channel = ensure 
+        ? connection->ensureChannel(channelType, targetHandleType, targetHandle, yours, 
+                connection->selfHandle(), false, &error)
+        : connection->createChannel(channelType, targetHandleType, targetHandle, 
+                connection->selfHandle(), false, &error);
+    if(error.isValid()) {
+        answer(Tp::BaseChannelPtr(), false, error.name(), error.message());
+        merger.finish(key, error.name(), error.message());
+        return;
+    }
+
+    if(yours) announceChannel(channel);
+    answer(channel, yours, QString(), QString());
+    merger.finish(key);
+}
+
+void PipeConnectionRequestsInterface::answerMerged(
+        const QString &channelType, uint targetHandleType, uint targetHandle, const ChannelAnswer &answer)
+{
+    Tp::DBusError error;
+    bool yours = false;
+    // found the way EnsureChannel finds it, so it is neither created nor announced again
+    Tp::BaseChannelPtr channel = connection->ensureChannel(channelType, targetHandleType, targetHandle, yours, 
+            connection->selfHandle(), false, &error);
+    if(error.isValid()) {
+        answer(Tp::BaseChannelPtr(), false, error.name(), error.message());
+        return;
+    }
+
+    // channel could be closed meanwhile and piped again for this request
+    if(yours) announceChannel(channel);
+    answer(channel, yours, QString(), QString());
+}
+
+// ------------ PipeConnectionRequestsAdaptor ------------------------------------------------------------------
+PipeConnectionRequestsAdaptor::PipeConnectionRequestsAdaptor(
+        const QDBusConnection &dbusConnection, PipeConnectionRequestsInterface *requests, QObject *parent) 
+    : QDBusAbstractAdaptor(parent),
+    dbusConnection(dbusConnection),
+    requests(requests)
+{
+    connect(requests, &PipeConnectionRequestsInterface::newChannels, this, &PipeConnectionRequestsAdaptor::NewChannels);
+    connect(requests, &PipeConnectionRequestsInterface::channelClosed, this, &PipeConnectionRequestsAdaptor::ChannelClosed);
+}
+
+Tp::ChannelDetailsList PipeConnectionRequestsAdaptor::Channels() const {
+    return requests ? requests->channels() : Tp::ChannelDetailsList();
+}
+
+Tp::RequestableChannelClassList PipeConnectionRequestsAdaptor::RequestableChannelClasses() const {
+    return requests ? requests->requestableChannelClasses() : Tp::RequestableChannelClassList();
+}
+
+void PipeConnectionRequestsAdaptor::CreateChannel(const QVariantMap &request, const QDBusMessage &dbusMessage) {
+
+    if(!requests) return;
+    dbusMessage.setDelayedReply(true);
+    QDBusConnection connection = dbusConnection;
+    requests->createChannel(request, [connection, dbusMessage](const Tp::BaseChannelPtr &channel, bool,
+                const QString &errorName, const QString &errorMessage) {
+                if(!errorName.isEmpty()) {
+                    connection.send(dbusMessage.createErrorReply(errorName, errorMessage));
+                    return;
+                }
+                connection.send(dbusMessage.createReply(QVariantList() 
+                            << QVariant::fromValue(QDBusObjectPath(channel->objectPath()))
+                            << channel->details().properties));
+            });
+}
+
+void PipeConnectionRequestsAdaptor::EnsureChannel(const QVariantMap &request, const QDBusMessage &dbusMessage) {
+
+    if(!requests) return;
+    dbusMessage.setDelayedReply(true);
+    QDBusConnection connection = dbusConnection;
+    requests->ensureChannel(request, [connection, dbusMessage](const Tp::BaseChannelPtr &channel, bool yours,
+                const QString &errorName, const QString &errorMessage) {
+                if(!errorName.isEmpty()) {
+                    connection.send(dbusMessage.createErrorReply(errorName, errorMessage));
+                    return;
+                }
+                connection.send(dbusMessage.createReply(QVariantList() 
+                            << yours
+                            << QVariant::fromValue(QDBusObjectPath(channel->objectPath()))
+                            << channel->details().properties));
+            });
+}
@@ -0,0 +1,107 @@
+#ifndef PIPE_REQUESTS_INTERFACE_HPP
+#define PIPE_REQUESTS_INTERFACE_HPP
+
+#include <TelepathyQt/BaseConnection>
+#include <TelepathyQt/BaseChannel>
+#include <QDBusAbstractAdaptor>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QPointer>
+#include <functional>
+
+#include "request_merger.hpp"
+
+/**
+ * Requests interface of pipe connection. Channels are created by callbacks of the connection.
+ * Requests are identical when their target handle, TargetID resolved by the connection, and all
+ * other properties are equal. EnsureChannel identical to a request in flight waits for it and gets
+ * its channel, so the channel is created and announced only once. CreateChannel is never merged,
+ * it fails with NotAvailable while an identical request is in flight. Channels created by the
+ * connection are announced with announceChannel.
+ */
+class PipeConnectionRequestsInterface : public Tp::AbstractConnectionInterface {
+
+    Q_OBJECT;
+
+    public:
+        /**
+         * Answers channel request
+         * @param errorName empty when channel was obtained
+         */
+        typedef std::function<void (const Tp::BaseChannelPtr &channel, bool yours, 
+                const QString &errorName, const QString &errorMessage)> ChannelAnswer;
+
+        PipeConnectionRequestsInterface(Tp::BaseConnection *connection, const Tp::RequestableChannelClassList &classes);
+
+        QVariantMap immutableProperties() const override;
+
+        Tp::ChannelDetailsList channels() const;
+        Tp::RequestableChannelClassList requestableChannelClasses() const;
+
+        /**
+         * Creates requested channel, answer is called when it is piped
+         */
+        void createChannel(const QVariantMap &request, const ChannelAnswer &answer);
+        /**
+         * Returns existing channel or creates requested one, answer is called when it is piped
+         */
+        void ensureChannel(const QVariantMap &request, const ChannelAnswer &answer);
+
+        /**
+         * Emits NewChannels for channel created by the connection and ChannelClosed when it is closed
+         */
+        void announceChannel(const Tp::BaseChannelPtr &channel);
+
+    signals:
+        void newChannels(const Tp::ChannelDetailsList &channels);
+        void channelClosed(const QDBusObjectPath &removed);
+
+    private:
+        void createAdaptor() override;
+
+        void request(const QVariantMap &request, bool ensure, const ChannelAnswer &answer);
+        /**
+         * Answers request which waited for identical one with the channel it piped
+         */
+        void answerMerged(const QString &channelType, uint targetHandleType, uint targetHandle, 
+                const ChannelAnswer &answer);
+
+    private:
+        Tp::BaseConnection *connection;
+        Tp::RequestableChannelClassList classes;
+        PipeRequestMerger merger;
+};
+
+typedef Tp::SharedPtr<PipeConnectionRequestsInterface> PipeConnectionRequestsInterfacePtr;
+
+/**
+ * Exports PipeConnectionRequestsInterface on D-Bus, channels are returned with delayed replies
+ */
+class PipeConnectionRequestsAdaptor : public QDBusAbstractAdaptor {
+
+    Q_OBJECT;
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Telepathy.Connection.Interface.Requests")
+    Q_PROPERTY(Tp::ChannelDetailsList Channels READ Channels)
+    Q_PROPERTY(Tp::RequestableChannelClassList RequestableChannelClasses READ RequestableChannelClasses)
+
+    public:
+        PipeConnectionRequestsAdaptor(const QDBusConnection &dbusConnection, 
+                PipeConnectionRequestsInterface *requests, QObject *parent);
+
+        Tp::ChannelDetailsList Channels() const;
+        Tp::RequestableChannelClassList RequestableChannelClasses() const;
+
+    public slots:
+        void CreateChannel(const QVariantMap &request, const QDBusMessage &dbusMessage);
+        void EnsureChannel(const QVariantMap &request, const QDBusMessage &dbusMessage);
+
+    signals:
+        void NewChannels(const Tp::ChannelDetailsList &channels);
+        void ChannelClosed(const QDBusObjectPath &removed);
+
+    private:
+        QDBusConnection dbusConnection;
+        QPointer<PipeConnectionRequestsInterface> requests;
+};
+
+#endif
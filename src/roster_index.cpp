@@ -0,0 +1,401 @@
+#include "roster_index.hpp"
+#include "normalizer.hpp"
+#include "utils.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QDBusArgument>
+
+namespace {
+
+    Tp::ContactSubscriptions subscriptionsOf(const QVariantMap &attrs) {
+
+        Tp::ContactSubscriptions subs;
+        auto it = attrs.find(QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/subscribe");
+        if(it != attrs.end()) subs.subscribe = it.value().toUInt();
+        else subs.subscribe = Tp::SubscriptionState::SubscriptionStateUnknown;
+
+        it = attrs.find(QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/publish");
+        if(it != attrs.end()) subs.publish = it.value().toUInt();
+        else subs.publish = Tp::SubscriptionState::SubscriptionStateUnknown;
+
+        it = attrs.find(QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/publish-request");
+        if(it != attrs.end()) subs.publishRequest = it.value().toString();
+        else subs.publishRequest = "";
+
+        return subs;
+    }
+
+    bool sameSubscriptions(const Tp::ContactSubscriptions &first, const Tp::ContactSubscriptions &second) {
+        return first.subscribe == second.subscribe && first.publish == second.publish
+            && first.publishRequest == second.publishRequest;
+    }
+
+    const QString URIS_ATTRIBUTE = QString(TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING) + "/uris";
+    const QString ADDRESSES_ATTRIBUTE = QString(TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING) + "/addresses";
+
+    /**
+     * Converts attributes to types which stream without registered operators. Addresses are kept
+     * as a map of variants, other attributes which are not of a built in type, like D-Bus arguments
+     * of structures, are left out and come again with reconciliation.
+     */
+    QVariantMap plainAttributes(const QVariantMap &attributes) {
+
+        QVariantMap plain;
+        for(auto it = attributes.constBegin(); it != attributes.constEnd(); ++it) {
+            if(it.key() == URIS_ATTRIBUTE) {
+                plain[it.key()] = qdbus_cast<QStringList>(*it);
+            } else if(it.key() == ADDRESSES_ATTRIBUTE) {
+                Tp::StringStringMap addresses = qdbus_cast<Tp::StringStringMap>(*it);
+                QVariantMap addressMap;
+                for(auto addrIt = addresses.constBegin(); addrIt != addresses.constEnd(); ++addrIt)
+                    addressMap[addrIt.key()] = addrIt.value();
+                plain[it.key()] = addressMap;
+            } else if(it->userType() < QMetaType::User) {
+                plain[it.key()] = *it;
+            }
+        }
+        return plain;
+    }
+
+    /**
+     * Restores types of attributes converted by plainAttributes, so they are marshalled as before
+     */
+    QVariantMap typedAttributes(const QVariantMap &plain) {
+
+        QVariantMap attributes = plain;
+        auto it = attributes.find(ADDRESSES_ATTRIBUTE);
+        if(it != attributes.end()) {
+            Tp::StringStringMap addresses;
+            QVariantMap addressMap = it->toMap();
+            for(auto addrIt = addressMap.constBegin(); addrIt != addressMap.constEnd(); ++addrIt)
+                addresses[addrIt.key()] = addrIt->toString();
+            *it = QVariant::fromValue(addresses);
+        }
+        return attributes;
+    }
+
+} /* anonymous namespace */
+
+void PipeRosterIndex::setAttributes(const Tp::ContactAttributesMap &attributes) {
+
+    pipedAttrMap = attributes;
+    idMap.clear();
+    revIdMap.clear();
+    normalizedIds.clear();
+    uriIndex.clear();
+    normalizedUris.clear();
+    vCardIndex.clear();
+    normalizedVCardIndex.clear();
+    for(auto it = pipedAttrMap.constBegin(); it != pipedAttrMap.constEnd(); ++it) {
+        indexAddresses(it.key(), *it);
+        auto idIt = (*it).find(QString(TP_QT_IFACE_CONNECTION) + "/contact-id");
+        if(idIt != (*it).end()) {
+            idMap[it.key()] = idIt->toString();
+            revIdMap[idIt->toString()] = it.key();
+            normalizedIds[normalizer::identifier(idIt->toString())] = it.key();
+        } else {
+            pWarning() << "No id for handle: " << it.key();
+        }
+    }
+}
+
+QStringList PipeRosterIndex::setPipedContacts(const QSet<QString> &identifiers) {
+
+    QStringList missing;
+    piped.clear();
+    for(const QString& id: identifiers) {
+        if(revIdMap.contains(id)) piped.insert(id);
+        else missing << id;
+    }
+    return missing;
+}
+
+const QSet<QString>& PipeRosterIndex::pipedContacts() const {
+    return piped;
+}
+
+Tp::UIntList PipeRosterIndex::getHandlesFor(const QStringList &identifiers, RosterLookup lookup) const {
+
+    Tp::UIntList handles;
+    QStringList unknown;
+    QList<int> unknownPositions;
+    for(int i = 0; i < identifiers.size(); ++i) {
+        auto it = revIdMap.find(identifiers[i]);
+        if(it == revIdMap.end()) {
+            unknown << identifiers[i];
+            unknownPositions << i;
+            handles.append(0);
+        } else {
+            handles.append(*it);
+        }
+    }
+
+    if(!unknown.empty() && lookup == RosterLookup::EXACT)
+        throw ContactListExeption(
+                "No handle for identifier: " + unknown.first().toStdString(), ContactListError::INVALID_HANDLE);
+
+    // identifiers which are not exact are normalized at once
+    QStringList normalized = normalizer::identifiers(unknown);
+    for(int i = 0; i < normalized.size(); ++i) {
+        uint handle = normalizedIds.value(normalized[i]);
+        if(handle == 0 || !idMap.contains(handle))
+            throw ContactListExeption(
+                    "No handle for identifier: " + unknown[i].toStdString(), ContactListError::INVALID_HANDLE);
+
+        handles[unknownPositions[i]] = handle;
+    }
+    return handles;
+}
+
+QStringList PipeRosterIndex::getIdentifiersFor(const Tp::UIntList &handles) const {
+
+    QStringList identifiers;
+    for(uint h: handles) {
+        auto it = idMap.find(h);
+        if(it == idMap.end())
+            throw ContactListExeption(
+                    "No such handle in contact list: " + std::to_string(h), ContactListError::INVALID_HANDLE);
+
+        identifiers.append(*it);
+    }
+    return identifiers;
+}
+
+bool PipeRosterIndex::hasHandle(uint handle) const {
+    auto it = idMap.find(handle);
+    return it != idMap.end() && piped.contains(*it);
+}
+
+bool PipeRosterIndex::hasIdentifier(const QString &identifier) const {
+    return piped.contains(identifier);
+}
+
+uint PipeRosterIndex::resolveURI(const QString &uri, RosterLookup lookup) const {
+
+    uint handle;
+    if(lookup == RosterLookup::EXACT) {
+        auto it = uriIndex.constFind(uri);
+        handle = it != uriIndex.constEnd() ? *it : revIdMap.value(uri.mid(uri.indexOf(':') + 1));
+    } else {
+        auto it = normalizedUris.constFind(normalizer::identifier(uri));
+        handle = it != normalizedUris.constEnd() ? *it : normalizedIds.value(normalizer::uriIdentifier(uri));
+    }
+    return handle != 0 && hasHandle(handle) ? handle : 0;
+}
+
+uint PipeRosterIndex::resolveVCardAddress(const QString &field, const QString &address, RosterLookup lookup) const {
+
+    uint handle;
+    if(lookup == RosterLookup::EXACT) {
+        const QHash<QString, uint> fieldIndex = vCardIndex.value(field.toLower());
+        auto it = fieldIndex.constFind(address);
+        handle = it != fieldIndex.constEnd() ? *it : revIdMap.value(address);
+    } else {
+        QString normalized = normalizer::identifier(address);
+        const QHash<QString, uint> fieldIndex = normalizedVCardIndex.value(field.toLower());
+        auto it = fieldIndex.constFind(normalized);
+        handle = it != fieldIndex.constEnd() ? *it : normalizedIds.value(normalized);
+    }
+    return handle != 0 && hasHandle(handle) ? handle : 0;
+}
+
+void PipeRosterIndex::indexAddresses(uint handle, const QVariantMap &attributes) {
+
+    auto it = attributes.constFind(URIS_ATTRIBUTE);
+    if(it != attributes.constEnd()) {
+        for(const QString &uri: qdbus_cast<QStringList>(*it)) {
+            uriIndex[uri] = handle;
+            normalizedUris[normalizer::identifier(uri)] = handle;
+        }
+    }
+
+    it = attributes.constFind(ADDRESSES_ATTRIBUTE);
+    if(it != attributes.constEnd()) {
+        Tp::StringStringMap addresses = qdbus_cast<Tp::StringStringMap>(*it);
+        for(auto addrIt = addresses.constBegin(); addrIt != addresses.constEnd(); ++addrIt) {
+            QString field = addrIt.key().toLower();
+            vCardIndex[field][addrIt.value()] = handle;
+            normalizedVCardIndex[field][normalizer::identifier(addrIt.value())] = handle;
+        }
+    }
+}
+
+Tp::ContactAttributesMap PipeRosterIndex::getContactAttributes(const Tp::UIntList &handles) const {
+
+    Tp::ContactAttributesMap attrsToReturn;
+    for(uint handle: handles) {
+        auto it = pipedAttrMap.find(handle);
+        if(it != pipedAttrMap.end())
+            attrsToReturn[handle] = it.value();
+    }
+    return attrsToReturn;
+}
+
+Tp::UIntList PipeRosterIndex::pipedHandles() const {
+
+    Tp::UIntList handles;
+    for(const QString& p: piped) handles.append(revIdMap.value(p));
+    return handles;
+}
+
+RosterDelta PipeRosterIndex::addToList(const Tp::UIntList &contacts) {
+
+    RosterDelta delta;
+    for(uint handle: contacts) {
+        auto attrIt = pipedAttrMap.constFind(handle);
+        if(attrIt == pipedAttrMap.constEnd()) {
+            pWarning() << "No such handle: " << handle;
+            throw ContactListExeption("No such handle: " + std::to_string(handle), ContactListError::INVALID_HANDLE);
+        }
+
+        Tp::ContactSubscriptions subs = subscriptionsOf(*attrIt);
+        auto hIt = idMap.find(handle);
+        if(hIt != idMap.end()) {
+            delta.identifiers[handle] = *hIt;
+            piped.insert(*hIt);
+            delta.changes[handle] = subs;
+        }
+    }
+    return delta;
+}
+
+RosterDelta PipeRosterIndex::remove(const Tp::UIntList &contacts) {
+
+    // first, check if all handles are piped
+    for(uint handle: contacts) {
+        auto it = idMap.find(handle);
+        if(it == idMap.end() || !piped.contains(*it))
+            throw ContactListExeption("No such handle in list", ContactListError::INVALID_HANDLE);
+    }
+
+    RosterDelta delta;
+    for(uint handle: contacts) {
+        const QString id = idMap.value(handle);
+        delta.removals[handle] = id;
+        piped.remove(id);
+    }
+    return delta;
+}
+
+RosterDelta PipeRosterIndex::applyChanges(const Tp::ContactSubscriptionMap &changes,
+        const Tp::HandleIdentifierMap &identifiers, const Tp::HandleIdentifierMap &removals)
+{
+    RosterDelta delta;
+    for(auto it = removals.constBegin(); it != removals.constEnd(); ++it) {
+        auto pIt = piped.find(it.value());
+        if(pIt != piped.end()) {
+            delta.removals[it.key()] = it.value();
+            piped.erase(pIt);
+        }
+        idMap.remove(it.key());
+        revIdMap.remove(it.value());
+        pipedAttrMap.remove(it.key());
+        normalizedIds.remove(normalizer::identifier(it.value()));
+    }
+
+    for(auto it = identifiers.constBegin(); it != identifiers.constEnd(); ++it) {
+        Tp::ContactSubscriptions subs = changes.value(it.key());
+
+        // identifier of known handle has changed, piping follows the handle
+        auto oldIt = idMap.constFind(it.key());
+        if(oldIt != idMap.constEnd() && *oldIt != it.value()) {
+            const QString oldId = *oldIt;
+            if(revIdMap.value(oldId) == it.key()) revIdMap.remove(oldId);
+            QString oldNormalized = normalizer::identifier(oldId);
+            if(normalizedIds.value(oldNormalized) == it.key()) normalizedIds.remove(oldNormalized);
+            if(piped.remove(oldId)) piped.insert(it.value());
+        }
+
+        if(piped.contains(it.value())) {
+            delta.identifiers[it.key()] = it.value();
+            delta.changes[it.key()] = subs;
+        }
+        idMap[it.key()] = it.value();
+        revIdMap[it.value()] = it.key();
+        normalizedIds[normalizer::identifier(it.value())] = it.key();
+
+        QVariantMap &attrs = pipedAttrMap[it.key()];
+        attrs[QString(TP_QT_IFACE_CONNECTION) + "/contact-id"] = it.value();
+        attrs[QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/subscribe"] = subs.subscribe;
+        attrs[QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/publish"] = subs.publish;
+        attrs[QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/publish-request"] = subs.publishRequest;
+    }
+    return delta;
+}
+
+RosterDelta PipeRosterIndex::reconcile(const Tp::ContactAttributesMap &attributes, const QSet<QString> &identifiers) {
+
+    PipeRosterIndex current;
+    current.setAttributes(attributes);
+    current.setPipedContacts(identifiers);
+
+    RosterDelta delta;
+    for(const QString &id: piped) {
+        if(!current.piped.contains(id)) delta.removals[revIdMap.value(id)] = id;
+    }
+
+    for(const QString &id: current.piped) {
+        uint newHandle = current.revIdMap.value(id);
+        Tp::ContactSubscriptions subs = subscriptionsOf(current.pipedAttrMap.value(newHandle));
+
+        bool wasPiped = piped.contains(id);
+        uint oldHandle = revIdMap.value(id);
+        // handles are not guaranteed to survive restart of piped connection
+        if(wasPiped && newHandle != oldHandle) delta.removals[oldHandle] = id;
+        if(!wasPiped || newHandle != oldHandle 
+                || !sameSubscriptions(subs, subscriptionsOf(pipedAttrMap.value(oldHandle)))) 
+        {
+            delta.identifiers[newHandle] = id;
+            delta.changes[newHandle] = subs;
+        }
+    }
+
+    // handle taken over by another contact is only changed, clients would drop it otherwise
+    for(auto it = delta.identifiers.constBegin(); it != delta.identifiers.constEnd(); ++it)
+        delta.removals.remove(it.key());
+
+    *this = std::move(current);
+    return delta;
+}
+
+RosterDelta PipeRosterIndex::resync(const Tp::ContactAttributesMap &identities) {
+
+    Tp::ContactAttributesMap merged;
+    for(auto it = identities.constBegin(); it != identities.constEnd(); ++it) {
+        QString id = (*it).value(QString(TP_QT_IFACE_CONNECTION) + "/contact-id").toString();
+        auto knownIt = revIdMap.constFind(id);
+        if(knownIt == revIdMap.constEnd()) {
+            merged[it.key()] = *it;
+            continue;
+        }
+
+        QVariantMap attrs = pipedAttrMap.value(*knownIt);
+        for(auto attrIt = (*it).constBegin(); attrIt != (*it).constEnd(); ++attrIt)
+            attrs[attrIt.key()] = *attrIt;
+        merged[it.key()] = attrs;
+    }
+
+    return reconcile(merged, piped);
+}
+
+QDataStream& operator<<(QDataStream &out, const PipeRosterIndex &index) {
+
+    QMap<uint, QVariantMap> attributes;
+    for(auto it = index.pipedAttrMap.constBegin(); it != index.pipedAttrMap.constEnd(); ++it)
+        attributes[it.key()] = plainAttributes(*it);
+    return out << attributes << index.piped;
+}
+
+QDataStream& operator>>(QDataStream &in, PipeRosterIndex &index) {
+
+    QMap<uint, QVariantMap> plain;
+    QSet<QString> piped;
+    in >> plain >> piped;
+
+    Tp::ContactAttributesMap attributes;
+    for(auto it = plain.constBegin(); it != plain.constEnd(); ++it)
+        attributes[it.key()] = typedAttributes(*it);
+    index.setAttributes(attributes);
+    index.piped = piped;
+    return in;
+}
@@ -0,0 +1,173 @@
+#ifndef PIPE_ROSTER_INDEX_HPP
+#define PIPE_ROSTER_INDEX_HPP
+
+#include <TelepathyQt/Types>
+#include <QDataStream>
+#include <QHash>
+#include <QMap>
+#include <QSet>
+#include <QString>
+#include <memory>
+
+#include "pipe_exception.hpp"
+
+enum class ContactListError {
+    UNDEFINED,
+    NOT_LOADED,
+    NETWORK_ERROR,
+    NOT_IMPLEMENTED,
+    NOT_AVAILABLE,
+    SERVICE_BUSY,
+    NOT_YET,
+    INVALID_HANDLE
+};
+
+typedef PipeException<ContactListError> ContactListExeption;
+
+/**
+ * How identifiers and addresses are matched in roster. Piped connection knows rules of its protocol,
+ * so they are matched exactly and normalized lookup is left for cases piped connection cannot handle.
+ */
+enum class RosterLookup {
+    EXACT,
+    // trimmed and lowercased
+    NORMALIZED
+};
+
+/**
+ * Changes of piped roster to be announced with ContactsChangedWithID
+ */
+struct RosterDelta {
+    Tp::ContactSubscriptionMap changes;
+    Tp::HandleIdentifierMap identifiers;
+    Tp::HandleIdentifierMap removals;
+
+    bool isEmpty() const {
+        return changes.empty() && identifiers.empty() && removals.empty();
+    }
+};
+
+/**
+ * Roster of piped connection: mappings between handles and identifiers, attributes of contacts
+ * and set of piped identifiers. It does not depend on any D-Bus object, so it can be filled
+ * with any data.
+ */
+class PipeRosterIndex {
+
+    public:
+        /**
+         * Builds mappings from contact list attributes of piped connection
+         */
+        void setAttributes(const Tp::ContactAttributesMap &attributes);
+
+        /**
+         * Marks identifiers as piped
+         * @return identifiers which are not present in the roster and were skipped
+         */
+        QStringList setPipedContacts(const QSet<QString> &identifiers);
+
+        const QSet<QString>& pipedContacts() const;
+
+        /**
+         * Identifiers are looked up as they are first, normalized lookup also tries normalized ones
+         * @return piped handles for given identifiers
+         * @throw ContactListException if there is no handle for at least on of identifiers
+         */
+        Tp::UIntList getHandlesFor(const QStringList &identifiers, RosterLookup lookup = RosterLookup::EXACT) const;
+
+        /**
+         * @return piped identifiers for given handles
+         * @throw ContactListException if there is no identifier for at least on of handles
+         */
+        QStringList getIdentifiersFor(const Tp::UIntList &handles) const;
+
+        /**
+         * @return true if such handle exists in this roster and is piped
+         */
+        bool hasHandle(uint handle) const;
+        /**
+         * @return true if such identifier is piped
+         */
+        bool hasIdentifier(const QString &identifier) const;
+
+        /**
+         * Looks URI up among addresses of contacts, then among their identifiers
+         * @return piped handle of contact with given URI, 0 if there is no such contact
+         */
+        uint resolveURI(const QString &uri, RosterLookup lookup = RosterLookup::EXACT) const;
+        /**
+         * Looks address up among vCard addresses of contacts, then among their identifiers
+         * @return piped handle of contact with given address, 0 if there is no such contact
+         */
+        uint resolveVCardAddress(const QString &field, const QString &address, 
+                RosterLookup lookup = RosterLookup::EXACT) const;
+
+        Tp::ContactAttributesMap getContactAttributes(const Tp::UIntList &handles) const;
+        Tp::UIntList pipedHandles() const;
+
+        /**
+         * Marks contacts with given handles as piped
+         * @return changes to announce
+         * @throws ContactListException when one of given handles is not present in roster
+         */
+        RosterDelta addToList(const Tp::UIntList &contacts);
+
+        /**
+         * Stops piping contacts with given handles
+         * @return changes to announce
+         * @throws ContactListException when one of given handles is not piped
+         */
+        RosterDelta remove(const Tp::UIntList &contacts);
+
+        /**
+         * Applies changes of piped contact list
+         * @return changes concerning piped contacts only
+         */
+        RosterDelta applyChanges(const Tp::ContactSubscriptionMap &changes,
+                const Tp::HandleIdentifierMap &identifiers, const Tp::HandleIdentifierMap &removals);
+
+        /**
+         * Replaces roster with current attributes of piped connection and pipes given identifiers
+         * which are present in it
+         * @return changes of piped contacts between previous and new roster, handle which another
+         * contact took over is reported as changed, never as removed
+         */
+        RosterDelta reconcile(const Tp::ContactAttributesMap &attributes, const QSet<QString> &identifiers);
+
+        /**
+         * Rebuilds handle mappings from identifiers and subscriptions of piped connection, other
+         * attributes of contacts already in the roster are kept under their new handles
+         * @return changes of piped contacts, contacts which only kept their handles are not included
+         */
+        RosterDelta resync(const Tp::ContactAttributesMap &identities);
+
+        /**
+         * Serializes attributes and piped identifiers, handle mappings are rebuilt when read.
+         * Only attributes of plain types are stored, others are filled by reconciliation.
+         */
+        friend QDataStream& operator<<(QDataStream &out, const PipeRosterIndex &index);
+        friend QDataStream& operator>>(QDataStream &in, PipeRosterIndex &index);
+
+    private:
+        void indexAddresses(uint handle, const QVariantMap &attributes);
+
+    private:
+        Tp::ContactAttributesMap pipedAttrMap;
+        QMap<uint, QString> idMap;
+        QMap<QString, uint> revIdMap;
+        QSet<QString> piped;
+        // lookup tables for addressing, may point to removed handles so results have to be checked
+        QHash<QString, uint> normalizedIds;
+        QHash<QString, uint> uriIndex;
+        QHash<QString, uint> normalizedUris;
+        // vCard addresses by lowercased field
+        QHash<QString, QHash<QString, uint>> vCardIndex;
+        QHash<QString, QHash<QString, uint>> normalizedVCardIndex;
+};
+
+/**
+ * Published version of roster, it is never modified so it can be read from any thread
+ */
+typedef std::shared_ptr<const PipeRosterIndex> PipeRosterSnapshot;
+
+#endif
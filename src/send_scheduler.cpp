@@ -0,0 +1,120 @@
+#include "send_scheduler.hpp"
+#include "utils.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QDBusError>
+#include <QDBusPendingCallWatcher>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    const double RATE_HALF_LIFE = 1000; // ms
+    // decayed rate above which channel is bulk, about two messages per second
+    const double BULK_RATE = 3.0;
+    const double MIN_RATE = 0.01;
+    // messages sent to piped connection at once
+    const int MAX_IN_FLIGHT = 4;
+
+} /* anonymous namespace */
+
+PipeSendScheduler::PipeSendScheduler(uint interactiveWeight, uint bulkWeight, uint bulkRate, QObject *parent)
+    : QObject(parent), 
+    interactiveWeight(std::max(1u, interactiveWeight)), 
+    bulkWeight(std::max(1u, bulkWeight)), 
+    bulkRate(bulkRate),
+    tokens(bulkRate)
+{
+    clock.start();
+    tokenTimer.setSingleShot(true);
+    connect(&tokenTimer, &QTimer::timeout, this, &PipeSendScheduler::dispatch);
+}
+
+PipeSendScheduler::~PipeSendScheduler() {
+
+    // senders must not wait for scheduler which is gone
+    QDBusPendingCall gone = QDBusPendingCall::fromError(QDBusError(TP_QT_ERROR_DISCONNECTED, "Connection is gone"));
+    for(ChannelQueue &queue: queues) {
+        for(const Job &job: queue.jobs) job.sent(gone);
+    }
+    for(const SentFunction &sent: sending) sent(gone);
+}
+
+void PipeSendScheduler::send(const QString &channel, const SendFunction &sendFunction, const SentFunction &sent) {
+
+    ChannelQueue &queue = queues[channel];
+    queue.rate = currentRate(queue) + 1;
+    queue.updated = clock.elapsed();
+    double start = std::max(virtualTime, queue.lastFinish);
+    Job job { sendFunction, sent, start + 1.0 / (isBulk(queue) ? bulkWeight : interactiveWeight) };
+    queue.lastFinish = job.finish;
+    queue.jobs.enqueue(job);
+
+    dispatch();
+}
+
+double PipeSendScheduler::currentRate(const ChannelQueue &queue) const {
+    return queue.rate * std::exp2(-(clock.elapsed() - queue.updated) / RATE_HALF_LIFE);
+}
+
+bool PipeSendScheduler::isBulk(const ChannelQueue &queue) const {
+    return currentRate(queue) > BULK_RATE;
+}
+
+void PipeSendScheduler::refillTokens() {
+
+    qint64 now = clock.elapsed();
+    // remainder of the next token is kept, so tokens are not lost when refilled often
+    tokenCredit += (now - tokensUpdated) * bulkRate;
+    tokensUpdated = now;
+    tokens += tokenCredit / 1000;
+    tokenCredit %= 1000;
+    if(tokens >= bulkRate) {
+        tokens = bulkRate;
+        tokenCredit = 0;
+    }
+}
+
+void PipeSendScheduler::dispatch() {
+
+    refillTokens();
+    while(sending.size() < MAX_IN_FLIGHT) {
+
+        // head with the lowest finish time, bulk channels only if they have a token
+        ChannelQueue *next = nullptr;
+        bool bulkWaiting = false;
+        for(auto it = queues.begin(); it != queues.end();) {
+            if(it->jobs.isEmpty()) {
+                if(currentRate(*it) < MIN_RATE) it = queues.erase(it);
+                else ++it;
+                continue;
+            }
+            bool bulk = isBulk(*it);
+            if(bulk && bulkRate > 0 && tokens < 1) {
+                bulkWaiting = true;
+            } else if(!next || it->jobs.head().finish < next->jobs.head().finish) {
+                next = &*it;
+            }
+            ++it;
+        }
+
+        if(!next) {
+            if(bulkWaiting && !tokenTimer.isActive()) 
+                tokenTimer.start(std::max<qint64>(1, (1000 - tokenCredit + bulkRate - 1) / bulkRate));
+            return;
+        }
+
+        if(isBulk(*next) && bulkRate > 0) tokens -= 1;
+        Job job = next->jobs.dequeue();
+        virtualTime = std::max(virtualTime, job.finish);
+
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(job.sendFunction(), this);
+        sending.insert(watcher, job.sent);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *finishedWatcher) {
+                finishedWatcher->deleteLater();
+                SentFunction sent = sending.take(finishedWatcher);
+                if(sent) sent(*finishedWatcher);
+                dispatch();
+            });
+    }
+}
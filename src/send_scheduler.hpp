@@ -0,0 +1,87 @@
+#ifndef PIPE_SEND_SCHEDULER_HPP
+#define PIPE_SEND_SCHEDULER_HPP
+
+#include <QDBusPendingCall>
+#include <QDBusPendingCallWatcher>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QString>
+#include <QTimer>
+#include <functional>
+#include <memory>
+
+/**
+ * Weighted fair queue of outgoing messages of one connection. Every channel has its own queue, 
+ * messages are sent in order of their virtual finish times, so each channel gets share of sending
+ * proportional to its weight. Channels sending faster than BULK_RATE messages per second are 
+ * bulk, they get bulk weight and their rate is capped by a token bucket, other channels are 
+ * interactive. Callers are told when their messages are sent, so that they can answer with 
+ * delayed replies.
+ */
+class PipeSendScheduler : public QObject {
+
+    public:
+        /**
+         * Makes the call sending the message
+         */
+        typedef std::function<QDBusPendingCall ()> SendFunction;
+        /**
+         * Receives finished call sending the message
+         */
+        typedef std::function<void (const QDBusPendingCall &reply)> SentFunction;
+
+        /**
+         * @param bulkRate messages per second which bulk channel may send, 0 means no cap
+         */
+        PipeSendScheduler(uint interactiveWeight, uint bulkWeight, uint bulkRate, QObject *parent = nullptr);
+        virtual ~PipeSendScheduler();
+
+        /**
+         * Queues message of channel, it is sent when its turn comes
+         * @param channel object path of the channel, identifies its queue
+         * @param sent called with finished call made by sendFunction, or with an error when 
+         *          scheduler is destroyed first
+         */
+        void send(const QString &channel, const SendFunction &sendFunction, const SentFunction &sent);
+
+    private:
+        struct Job {
+            SendFunction sendFunction;
+            SentFunction sent;
+            double finish;
+        };
+
+        struct ChannelQueue {
+            QQueue<Job> jobs;
+            double lastFinish;
+            // sending rate, halves every second
+            double rate;
+            qint64 updated;
+        };
+
+        double currentRate(const ChannelQueue &queue) const;
+        bool isBulk(const ChannelQueue &queue) const;
+        void refillTokens();
+        void dispatch();
+
+    private:
+        double interactiveWeight;
+        double bulkWeight;
+        qint64 bulkRate;
+        QElapsedTimer clock;
+        QHash<QString, ChannelQueue> queues;
+        double virtualTime = 0;
+        qint64 tokens;
+        // part of the next token earned since it was refilled, in milliseconds times messages per second
+        qint64 tokenCredit = 0;
+        qint64 tokensUpdated = 0;
+        // messages being sent
+        QHash<QDBusPendingCallWatcher*, SentFunction> sending;
+        QTimer tokenTimer;
+};
+
+typedef std::shared_ptr<PipeSendScheduler> PipeSendSchedulerPtr;
+
+#endif
@@ -0,0 +1,47 @@
+#include "sent_token_index.hpp"
+
+#include <algorithm>
+
+PipeSentTokenIndex::PipeSentTokenIndex(int capacity)
+    : capacity(capacity)
+{
+    clock.start();
+    sent.reserve(capacity);
+}
+
+void PipeSentTokenIndex::add(const QString &token) {
+
+    if(token.isEmpty()) return;
+    while(order.size() >= capacity) sent.remove(order.dequeue());
+
+    SentMessage message;
+    message.sentAt = clock.elapsed();
+    message.status = 0;
+    sent.insert(token, message);
+    order.enqueue(token);
+}
+
+DeliveryReportMatch PipeSentTokenIndex::report(const QString &token, uint status) {
+
+    ++reportStats.reports;
+    auto it = sent.find(token);
+    if(it == sent.end()) {
+        ++reportStats.unmatched;
+        return DeliveryReportMatch::UNKNOWN;
+    }
+
+    if(it->status == status) {
+        ++reportStats.repeated;
+        return DeliveryReportMatch::REPEATED;
+    }
+    it->status = status;
+
+    qint64 lag = clock.elapsed() - it->sentAt;
+    reportStats.totalLag += lag;
+    reportStats.maxLag = std::max(reportStats.maxLag, lag);
+    return DeliveryReportMatch::NEW_STATUS;
+}
+
+const DeliveryReportStats& PipeSentTokenIndex::stats() const {
+    return reportStats;
+}
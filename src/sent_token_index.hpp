@@ -0,0 +1,71 @@
+#ifndef PIPE_SENT_TOKEN_INDEX_HPP
+#define PIPE_SENT_TOKEN_INDEX_HPP
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QQueue>
+#include <QString>
+#include <memory>
+
+/**
+ * Statistics of delivery reports of one channel, lags are in milliseconds
+ */
+struct DeliveryReportStats {
+    quint64 reports = 0;
+    // reports of messages which are not in the index (not sent by pipe or already dropped)
+    quint64 unmatched = 0;
+    // reports repeating status already reported for the message
+    quint64 repeated = 0;
+    qint64 totalLag = 0;
+    qint64 maxLag = 0;
+};
+
+enum class DeliveryReportMatch {
+    // first report of its status for a sent message
+    NEW_STATUS,
+    // status was already reported for the message
+    REPEATED,
+    // message was not sent through the pipe or it was already dropped from the index
+    UNKNOWN
+};
+
+/**
+ * Bounded index of tokens of messages sent through proxied channel with times they were sent 
+ * and statuses reported for them. It matches delivery reports with sent messages to measure 
+ * their lag and to find reports which repeat a known status. When it is full the oldest tokens
+ * are dropped.
+ */
+class PipeSentTokenIndex {
+
+    public:
+        explicit PipeSentTokenIndex(int capacity = 4096);
+
+        void add(const QString &token);
+
+        /**
+         * Records delivery report of message with given token, token stays in the index because 
+         * more reports may follow (e.g. delivered and read)
+         * @param status delivery status of the report
+         */
+        DeliveryReportMatch report(const QString &token, uint status);
+
+        const DeliveryReportStats& stats() const;
+
+    private:
+        struct SentMessage {
+            qint64 sentAt;
+            // last reported delivery status, 0 (unknown) before the first report
+            uint status;
+        };
+
+        int capacity;
+        QElapsedTimer clock;
+        QHash<QString, SentMessage> sent;
+        // tokens in order they were sent
+        QQueue<QString> order;
+        DeliveryReportStats reportStats;
+};
+
+typedef std::shared_ptr<PipeSentTokenIndex> PipeSentTokenIndexPtr;
+
+#endif
@@ -1,8 +1,22 @@
 #include "simple_presence.hpp"
 #include "utils.hpp"
+#include "defines.hpp"
 
 #include <TelepathyQt/PendingOperation>
 #include <TelepathyQt/PendingVariant>
+#include <QDataStream>
+#include <QDBusPendingCallWatcher>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+namespace {
+
+    const quint32 SNAPSHOT_VERSION = 1;
+    const int SNAPSHOT_INTERVAL = 60000; // ms
+    const char SNAPSHOT_SUFFIX[] = ".presences";
+
+} /* anonymous namespace */
 
 // in current implementation I assume 
 // that I always get a full list of statuses when signal is emitted
@@ -42,23 +56,146 @@ PipeSimplePresence::PipeSimplePresence(
             this, &PipeSimplePresence::presenceChangedCb);
 }
 
-void PipeSimplePresence::setContactList(PipeContactList *pipeList) {
+PipeSimplePresence::~PipeSimplePresence() {
+    saveSnapshot();
+    const PresenceCounters &stats = cache.counters();
+    pDebug() << "Presences fetched in " << stats.fetches
+        << " calls, received: " << stats.received << ", suppressed: " << stats.suppressed 
+        << ", announced: " << stats.emitted;
+}
+
+void PipeSimplePresence::setContactList(PipeContactList *pipeList, const QString &snapshotName) {
     this->pipeList = pipeList;
+
+    snapshotPath = QDir::homePath() + QString("/" TP_QT_PIPE_STATE) + snapshotName + SNAPSHOT_SUFFIX;
+    restoreSnapshot();
+    snapshotTimer.setInterval(SNAPSHOT_INTERVAL);
+    connect(&snapshotTimer, &QTimer::timeout, this, &PipeSimplePresence::saveSnapshot);
+    snapshotTimer.start();
+
+    pipeList->setRosterObserver([this](const RosterDelta &delta) { rosterChangedCb(delta); });
+    if(pipeList->isLoaded()) fetchPresences(pipeList->pipedHandles());
+}
+
+const PresenceCounters& PipeSimplePresence::counters() const {
+    return cache.counters();
 }
 
 void PipeSimplePresence::setPresence(const QString &/* status */, const QString &/* statusMessager */) {
     // nothing to do
 }
 
+void PipeSimplePresence::setActivityObserver(const std::function<void (uint)> &observer) {
+    activityObserver = observer;
+}
+
 void PipeSimplePresence::presenceChangedCb(const Tp::SimpleContactPresences &presences) {
+    updatePresences(presences);
+}
+
+void PipeSimplePresence::rosterChangedCb(const RosterDelta &delta) {
+
+    Tp::UIntList missing;
+    announce(cache.applyRoster(delta, missing));
+    fetchPresences(missing);
+}
+
+void PipeSimplePresence::fetchPresences(const Tp::UIntList &handles) {
+
+    for(const Tp::UIntList &batch: cache.fetchBatches(handles)) {
+        QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pipedPresence->GetPresences(batch), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *finishedWatcher) {
+                QDBusPendingReply<Tp::SimpleContactPresences> presencesRep = *finishedWatcher;
+                finishedWatcher->deleteLater();
+                if(presencesRep.isValid()) {
+                    updatePresences(presencesRep.value());
+                } else {
+                    pWarning() << "Could not get presences from connection: " 
+                        << pipedPresence->path() << " " << presencesRep.error().message();
+                }
+            });
+    }
+}
+
+void PipeSimplePresence::updatePresences(const Tp::SimpleContactPresences &presences) {
+
+    if(pipeList == nullptr) return;
+
+    Tp::SimpleContactPresences changed = cache.update(presences, 
+            [this](uint handle) { return pipeList->hasHandle(handle); });
+    if(changed.empty()) return;
 
-    Tp::SimpleContactPresences newPresences;
-    if(pipeList != nullptr) {
-        for(auto it = presences.cbegin(); it != presences.cend(); ++it) {
-            if(pipeList->hasHandle(it.key())) 
-                newPresences[it.key()] = it.value();
-        }
-        presenceIface->setPresences(newPresences);
-    } 
+    dirty = true;
+    if(activityObserver) {
+        for(auto it = changed.cbegin(); it != changed.cend(); ++it) 
+            if(it->type == Tp::ConnectionPresenceTypeAvailable) activityObserver(it.key());
+    }
+    announce(changed);
 }
 
+void PipeSimplePresence::announce(const Tp::SimpleContactPresences &presences) {
+    if(!presences.empty()) presenceIface->setPresences(presences);
+}
+
+void PipeSimplePresence::restoreSnapshot() {
+
+    QFile inFile(snapshotPath);
+    if(!inFile.open(QIODevice::ReadOnly)) return;
+
+    QDataStream is(&inFile);
+    quint32 version;
+    is >> version;
+    if(version != SNAPSHOT_VERSION) {
+        pWarning() << "Ignoring presence snapshot with version: " << version;
+        return;
+    }
+
+    QMap<QString, QVariantList> stored;
+    is >> stored;
+    if(is.status() != QDataStream::Ok) {
+        pWarning() << "Presence snapshot: " << snapshotPath << " is corrupted";
+        return;
+    }
+
+    QHash<QString, Tp::SimplePresence> restored;
+    for(auto it = stored.constBegin(); it != stored.constEnd(); ++it) {
+        if(it->size() != 3) continue;
+        Tp::SimplePresence presence;
+        presence.type = it->at(0).toUInt();
+        presence.status = it->at(1).toString();
+        presence.statusMessage = it->at(2).toString();
+        restored[it.key()] = presence;
+    }
+    cache.restore(restored);
+}
+
+void PipeSimplePresence::saveSnapshot() {
+
+    if(!dirty || pipeList == nullptr) return;
+
+    QDir dir(QFileInfo(snapshotPath).absolutePath());
+    if(!dir.exists() && !dir.mkpath(dir.absolutePath())) {
+        pCritical() << "Cannot create path for presence snapshot: " << snapshotPath;
+        return;
+    }
+
+    QFile outFile(snapshotPath);
+    if(!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        pWarning() << "Could not write presence snapshot: " << snapshotPath;
+        return;
+    }
+
+    // handles are not kept across restarts, presences are stored by identifiers
+    PipeRosterSnapshot roster = pipeList->snapshot();
+    Tp::ContactAttributesMap attributes = roster->getContactAttributes(roster->pipedHandles());
+    QHash<QString, Tp::SimplePresence> presences = cache.byIdentifier([&attributes](uint handle) {
+            return attributes.value(handle).value(QString(TP_QT_IFACE_CONNECTION) + "/contact-id").toString();
+        });
+    QMap<QString, QVariantList> stored;
+    for(auto it = presences.cbegin(); it != presences.cend(); ++it)
+        stored[it.key()] = QVariantList() << it->type << it->status << it->statusMessage;
+
+    QDataStream os(&outFile);
+    os << SNAPSHOT_VERSION << stored;
+    dirty = false;
+}
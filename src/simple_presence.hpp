@@ -3,8 +3,11 @@
 
 #include <TelepathyQt/Connection>
 #include <QObject>
+#include <QTimer>
+#include <functional>
 
 #include "contact_list.hpp"
+#include "presence_cache.hpp"
 
 typedef Tp::Client::ConnectionInterfaceSimplePresenceInterface SimplePresence;
 
@@ -18,27 +21,62 @@ enum class SimplePresenceError {
 
 typedef PipeException<SimplePresenceError> SimplePresenceException;
 
+/**
+ * Pipes presences of piped contacts. Presences are cached, cache is filled with batched
+ * GetPresences calls when contacts start being piped, so clients are served by base interface
+ * without calling piped connection and updates which change nothing are not announced.
+ *
+ * Cache is snapshotted by identifiers, after restart presences of previous run are announced
+ * as soon as contacts are piped and replaced by current ones when piped connection answers.
+ */
 class PipeSimplePresence : public QObject {
     
     public:
         PipeSimplePresence(
                 SimplePresence *pipedPresence, Tp::BaseConnectionSimplePresenceInterfacePtr presenceIface);
+        virtual ~PipeSimplePresence();
 
         /**
          * Sets contact list as a source of contacts to pipe
+         * @param snapshotName name of presence snapshot in pipes state directory
          */
-        void setContactList(PipeContactList *pipeList);
+        void setContactList(PipeContactList *pipeList, const QString &snapshotName);
 
         void setPresence(const QString &status, const QString &statusMessager);
 
+        const PresenceCounters& counters() const;
+
+        /**
+         * Sets function called with handles of contacts which became available
+         */
+        void setActivityObserver(const std::function<void (uint)> &observer);
+
     private:
         void presenceChangedCb(const Tp::SimpleContactPresences &presence);
+        void rosterChangedCb(const RosterDelta &delta);
+        /**
+         * Fetches presences of given handles from piped connection in batches
+         */
+        void fetchPresences(const Tp::UIntList &handles);
+        /**
+         * Caches presences of piped contacts and announces those which changed
+         */
+        void updatePresences(const Tp::SimpleContactPresences &presences);
+        void announce(const Tp::SimpleContactPresences &presences);
+
+        void restoreSnapshot();
+        void saveSnapshot();
 
     private:
         PipeContactList *pipeList = nullptr;
         SimplePresence *pipedPresence;
         Tp::BaseConnectionSimplePresenceInterfacePtr presenceIface;
-
+        PipePresenceCache cache;
+        std::function<void (uint)> activityObserver;
+        QString snapshotPath;
+        QTimer snapshotTimer;
+        // cache changed since last snapshot
+        bool dirty = false;
 };
 
 #endif
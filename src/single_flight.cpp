@@ -0,0 +1,34 @@
+#include "single_flight.hpp"
+#include "utils.hpp"
+
+PipeSingleFlight& PipeSingleFlight::instance() {
+    static thread_local PipeSingleFlight singleFlight;
+    return singleFlight;
+}
+
+QDBusPendingCall PipeSingleFlight::call(const QString &service, const QString &path, const QString &method, 
+        const QString &arguments, const CallFunction &makeCall) 
+{
+    QString key = service + '\n' + path + '\n' + method + '\n' + arguments;
+
+    // there are only a few calls in flight, finished ones are dropped when another one is made
+    for(auto it = inFlight.begin(); it != inFlight.end();) {
+        if(it->isFinished()) it = inFlight.erase(it);
+        else ++it;
+    }
+
+    auto it = inFlight.constFind(key);
+    if(it != inFlight.constEnd()) {
+        ++mergedCalls;
+        pDebug() << "Merging call: " << method << " on: " << path << " with the one in flight";
+        return *it;
+    }
+
+    QDBusPendingCall pendingCall = makeCall();
+    inFlight.insert(key, pendingCall);
+    return pendingCall;
+}
+
+quint64 PipeSingleFlight::merged() const {
+    return mergedCalls;
+}
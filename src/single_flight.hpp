@@ -0,0 +1,47 @@
+#ifndef PIPE_SINGLE_FLIGHT_HPP
+#define PIPE_SINGLE_FLIGHT_HPP
+
+#include <QDBusPendingCall>
+#include <QHash>
+#include <QString>
+#include <functional>
+
+/**
+ * Merges identical D-Bus calls made while one of them is still in flight, callers of merged 
+ * calls all get the reply of the first one. Calls are identified by service, object path, 
+ * method and their arguments written as a string. Each thread has its own table, pending calls
+ * are delivered to the thread which made them so they are never shared with other threads.
+ */
+class PipeSingleFlight {
+
+    public:
+        typedef std::function<QDBusPendingCall ()> CallFunction;
+
+        /**
+         * @return instance shared by all connections of the calling thread
+         */
+        static PipeSingleFlight& instance();
+
+        /**
+         * @param makeCall makes the call when no identical one is in flight
+         * @return pending call which may be shared with other callers
+         */
+        QDBusPendingCall call(const QString &service, const QString &path, const QString &method, 
+                const QString &arguments, const CallFunction &makeCall);
+
+        /**
+         * @return number of calls which were merged into already running ones
+         */
+        quint64 merged() const;
+
+    private:
+        PipeSingleFlight() = default;
+        PipeSingleFlight(const PipeSingleFlight&) = delete;
+        PipeSingleFlight& operator=(const PipeSingleFlight&) = delete;
+
+    private:
+        QHash<QString, QDBusPendingCall> inFlight;
+        quint64 mergedCalls = 0;
+};
+
+#endif
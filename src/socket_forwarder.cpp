@@ -0,0 +1,148 @@
+#include "socket_forwarder.hpp"
+#include "utils.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDir>
+#include <QFile>
+#include <QSocketNotifier>
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+    std::string systemError(const std::string &message) {
+        return message + ": " + std::strerror(errno);
+    }
+
+    bool fillAddress(sockaddr_un &address, const QByteArray &path) {
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        if(path.size() >= int(sizeof(address.sun_path))) return false;
+        std::memcpy(address.sun_path, path.constData(), path.size());
+        return true;
+    }
+
+} /* anonymous namespace */
+
+PipeSocketForwarder::PipeSocketForwarder(const QByteArray &targetPath, QObject *parent)
+    : QObject(parent),
+    targetPath(targetPath)
+{
+    directory = QFile::encodeName(QDir::tempPath() + "/telepathy-pipes-XXXXXX");
+    if(mkdtemp(directory.data()) == nullptr)
+        throw SocketRelayException(systemError("Could not create directory for socket"), SocketRelayError::SYSTEM_ERROR);
+    socketPath = directory + "/socket";
+
+    sockaddr_un address;
+    listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(listenFd == -1 || !fillAddress(address, socketPath)
+            || bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1
+            || listen(listenFd, SOMAXCONN) == -1)
+    {
+        std::string message = systemError("Could not listen on socket " + socketPath.toStdString());
+        if(listenFd != -1) close(listenFd);
+        unlink(socketPath.constData());
+        rmdir(directory.constData());
+        throw SocketRelayException(message, SocketRelayError::SYSTEM_ERROR);
+    }
+
+    notifier = new QSocketNotifier(listenFd, QSocketNotifier::Read, this);
+    connect(notifier, &QSocketNotifier::activated, this, &PipeSocketForwarder::acceptCb);
+}
+
+PipeSocketForwarder::~PipeSocketForwarder() {
+    notifier->setEnabled(false);
+    close(listenFd);
+    unlink(socketPath.constData());
+    rmdir(directory.constData());
+}
+
+QByteArray PipeSocketForwarder::path() const {
+    return socketPath;
+}
+
+uint PipeSocketForwarder::forwarded() const {
+    return connections;
+}
+
+void PipeSocketForwarder::forwardReply(const QDBusPendingCall &pipedCall, QObject *parent, const AddressFunction &done) {
+
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(pipedCall, parent);
+    QObject::connect(watcher, &QDBusPendingCallWatcher::finished, parent, [parent, done](QDBusPendingCallWatcher *finishedWatcher) {
+            QDBusPendingReply<QDBusVariant> addressRep = *finishedWatcher;
+            finishedWatcher->deleteLater();
+            if(addressRep.isError()) {
+                done(QDBusVariant(), addressRep.error());
+                return;
+            }
+
+            QByteArray pipedPath = addressRep.value().variant().toByteArray();
+            if(pipedPath.isEmpty()) {
+                done(QDBusVariant(), QDBusError(QDBusMessage::createError(TP_QT_ERROR_NOT_AVAILABLE,
+                                "Piped channel did not return Unix socket address")));
+                return;
+            }
+            try {
+                PipeSocketForwarder *forwarder = new PipeSocketForwarder(pipedPath, parent);
+                done(QDBusVariant(QVariant(forwarder->path())), QDBusError());
+            } catch(const SocketRelayException &e) {
+                pWarning() << "Could not forward socket of piped channel: " << e.what();
+                done(QDBusVariant(), QDBusError(QDBusMessage::createError(TP_QT_ERROR_NOT_AVAILABLE, e.what())));
+            }
+        });
+}
+
+Tp::SupportedSocketMap PipeSocketForwarder::forwardedSocketTypes(const Tp::SupportedSocketMap &pipedSocketTypes) {
+    Tp::SupportedSocketMap socketTypes;
+    if(pipedSocketTypes.value(Tp::SocketAddressTypeUnix).contains(Tp::SocketAccessControlLocalhost))
+        socketTypes[Tp::SocketAddressTypeUnix] = Tp::UIntList() << Tp::SocketAccessControlLocalhost;
+    return socketTypes;
+}
+
+bool PipeSocketForwarder::checkSocketType(uint addressType, uint accessControl, const AddressFunction &done) {
+    if(addressType == Tp::SocketAddressTypeUnix && accessControl == Tp::SocketAccessControlLocalhost) return true;
+    done(QDBusVariant(), QDBusError(QDBusMessage::createError(TP_QT_ERROR_NOT_IMPLEMENTED,
+                    "Only Unix sockets with localhost access control are piped")));
+    return false;
+}
+
+void PipeSocketForwarder::acceptCb() {
+
+    while(true) {
+        int clientFd = accept4(listenFd, nullptr, nullptr, SOCK_CLOEXEC);
+        if(clientFd == -1) {
+            int acceptError = errno;
+            if(acceptError == EINTR) continue;
+            if(acceptError != EAGAIN && acceptError != EWOULDBLOCK)
+                pWarning() << "Could not accept connection to forward: " << std::strerror(acceptError);
+            return;
+        }
+
+        // target listens on local socket, so connecting does not block for long
+        sockaddr_un address;
+        int targetFd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if(targetFd == -1 || !fillAddress(address, targetPath)
+                || ::connect(targetFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1)
+        {
+            pWarning() << "Could not connect forwarded connection to: " << targetPath << ", " << std::strerror(errno);
+            if(targetFd != -1) close(targetFd);
+            close(clientFd);
+            continue;
+        }
+
+        try {
+            PipeSocketRelay::instance().relay(clientFd, targetFd);
+            ++connections;
+        } catch(const SocketRelayException &e) {
+            pWarning() << "Could not relay forwarded connection: " << e.what();
+            close(clientFd);
+            close(targetFd);
+        }
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef PIPE_SOCKET_FORWARDER_HPP
+#define PIPE_SOCKET_FORWARDER_HPP
+
+#include <TelepathyQt/Types>
+#include <QByteArray>
+#include <QDBusError>
+#include <QDBusPendingCall>
+#include <QDBusVariant>
+#include <QObject>
+#include <functional>
+
+#include "socket_relay.hpp"
+
+class QSocketNotifier;
+
+/**
+ * Listens on its own Unix socket and connects each accepted connection to the target Unix socket,
+ * data of both sockets is then moved by PipeSocketRelay. The socket lives in a directory accessible
+ * only to the user. Connections being relayed are not closed with the forwarder.
+ */
+class PipeSocketForwarder : public QObject {
+
+    Q_OBJECT;
+
+    public:
+        /**
+         * Receives address of forwarder, or error when there is none
+         */
+        typedef std::function<void (const QDBusVariant &address, const QDBusError &error)> AddressFunction;
+
+        /**
+         * @throws SocketRelayException if listening socket could not be set up
+         */
+        PipeSocketForwarder(const QByteArray &targetPath, QObject *parent = nullptr);
+        virtual ~PipeSocketForwarder();
+
+        /**
+         * @return path of listening socket
+         */
+        QByteArray path() const;
+        /**
+         * @return number of connections handed to the relay
+         */
+        uint forwarded() const;
+
+        /**
+         * When call returning Unix socket address finishes, creates forwarder to that address
+         * owned by parent and passes address of the forwarder to done
+         */
+        static void forwardReply(const QDBusPendingCall &pipedCall, QObject *parent, const AddressFunction &done);
+
+        /**
+         * @return socket types of piped channel which can be forwarded, Unix sockets with localhost access control
+         */
+        static Tp::SupportedSocketMap forwardedSocketTypes(const Tp::SupportedSocketMap &pipedSocketTypes);
+        /**
+         * @return false and passes error to done if socket of given type cannot be forwarded
+         */
+        static bool checkSocketType(uint addressType, uint accessControl, const AddressFunction &done);
+
+    private:
+        void acceptCb();
+
+    private:
+        QByteArray targetPath;
+        QByteArray directory;
+        QByteArray socketPath;
+        int listenFd = -1;
+        QSocketNotifier *notifier = nullptr;
+        uint connections = 0;
+};
+
+#endif
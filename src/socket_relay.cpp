@@ -0,0 +1,252 @@
+#include "socket_relay.hpp"
+#include "utils.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+    // data moved by one splice call, also a limit of data kept in a pipe for one direction
+    const size_t SPLICE_CHUNK = 1 << 16;
+    const int MAX_EVENTS = 64;
+
+    std::string systemError(const std::string &message) {
+        return message + ": " + std::strerror(errno);
+    }
+
+    bool setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL);
+        return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+    }
+
+} /* anonymous namespace */
+
+PipeSocketRelay& PipeSocketRelay::instance() {
+    static PipeSocketRelay relay;
+    return relay;
+}
+
+PipeSocketRelay::PipeSocketRelay()
+    : stopped(false), relays(0)
+{
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if(epollFd == -1)
+        throw SocketRelayException(systemError("Could not create epoll"), SocketRelayError::SYSTEM_ERROR);
+
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(wakeFd == -1) {
+        close(epollFd);
+        throw SocketRelayException(systemError("Could not create eventfd"), SocketRelayError::SYSTEM_ERROR);
+    }
+
+    epoll_event event {};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+
+    worker = std::thread(&PipeSocketRelay::run, this);
+}
+
+PipeSocketRelay::~PipeSocketRelay() {
+
+    stopped = true;
+    uint64_t one = 1;
+    if(write(wakeFd, &one, sizeof(one)) == -1)
+        pWarning() << "Could not wake socket relay thread: " << std::strerror(errno);
+    worker.join();
+
+    for(Relay *relay: pending) closeRelay(relay);
+    for(Relay *relay: std::set<Relay*>(active)) closeRelay(relay);
+    releaseClosed();
+    close(wakeFd);
+    close(epollFd);
+}
+
+void PipeSocketRelay::relay(int firstFd, int secondFd) {
+
+    if(!setNonBlocking(firstFd) || !setNonBlocking(secondFd))
+        throw SocketRelayException(systemError("Could not make sockets non-blocking"), SocketRelayError::SYSTEM_ERROR);
+
+    Relay *relay = new Relay;
+    relay->endpoints[0] = { relay, firstFd };
+    relay->endpoints[1] = { relay, secondFd };
+    relay->directions[0].from = relay->directions[1].to = firstFd;
+    relay->directions[0].to = relay->directions[1].from = secondFd;
+
+    for(int i = 0; i < 2; ++i) {
+        if(pipe2(relay->directions[i].pipeFds, O_NONBLOCK | O_CLOEXEC) == -1) {
+            std::string message = systemError("Could not create pipe for relay");
+            if(i == 1) {
+                close(relay->directions[0].pipeFds[0]);
+                close(relay->directions[0].pipeFds[1]);
+            }
+            delete relay;
+            throw SocketRelayException(message, SocketRelayError::SYSTEM_ERROR);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pending.push_back(relay);
+    }
+    ++relays;
+
+    uint64_t one = 1;
+    if(write(wakeFd, &one, sizeof(one)) == -1)
+        pWarning() << "Could not wake socket relay thread: " << std::strerror(errno);
+}
+
+size_t PipeSocketRelay::activeRelays() const {
+    return relays;
+}
+
+void PipeSocketRelay::run() {
+
+    epoll_event events[MAX_EVENTS];
+    while(!stopped) {
+        int ready = epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if(ready == -1) {
+            if(errno == EINTR) continue;
+            pCritical() << "Socket relay stopped, epoll_wait failed: " << std::strerror(errno);
+            return;
+        }
+
+        for(int i = 0; i < ready; ++i) {
+            if(events[i].data.ptr == nullptr) {
+                uint64_t counter;
+                if(read(wakeFd, &counter, sizeof(counter)) == -1 && errno != EAGAIN)
+                    pWarning() << "Could not read socket relay wake up counter: " << std::strerror(errno);
+                registerPending();
+            } else {
+                handle(static_cast<Endpoint*>(events[i].data.ptr), events[i].events);
+            }
+        }
+        releaseClosed();
+    }
+}
+
+void PipeSocketRelay::registerPending() {
+
+    std::vector<Relay*> toRegister;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        toRegister.swap(pending);
+    }
+
+    for(Relay *relay: toRegister) {
+        bool registered = true;
+        for(Endpoint &endpoint: relay->endpoints) {
+            epoll_event event {};
+            event.events = EPOLLIN;
+            event.data.ptr = &endpoint;
+            registered = registered && epoll_ctl(epollFd, EPOLL_CTL_ADD, endpoint.fd, &event) != -1;
+        }
+        if(registered) {
+            active.insert(relay);
+        } else {
+            pWarning() << "Could not register sockets for relay: " << std::strerror(errno);
+            closeRelay(relay);
+        }
+    }
+}
+
+void PipeSocketRelay::handle(Endpoint *endpoint, uint32_t events) {
+
+    Relay *relay = endpoint->relay;
+    if(relay->closed) return;
+
+    bool ok = (events & EPOLLERR) == 0;
+    bool readDrained = true;
+    for(Direction &direction: relay->directions) {
+        if(!direction.done && (direction.from == endpoint->fd || direction.to == endpoint->fd))
+            ok = pump(direction) && ok;
+        if(direction.from == endpoint->fd) readDrained = direction.done;
+    }
+    // peer hung up - nothing can be written to it anymore, so finish when its data is delivered
+    if((events & EPOLLHUP) && readDrained) ok = false;
+
+    if(!ok || (relay->directions[0].done && relay->directions[1].done)) closeRelay(relay);
+    else updateInterest(relay);
+}
+
+bool PipeSocketRelay::pump(Direction &direction) {
+
+    bool progress = true;
+    while(progress) {
+        progress = false;
+
+        if(!direction.eof && direction.buffered < SPLICE_CHUNK) {
+            ssize_t in = splice(direction.from, nullptr, direction.pipeFds[1], nullptr,
+                    SPLICE_CHUNK - direction.buffered, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if(in > 0) {
+                direction.buffered += in;
+                progress = true;
+            } else if(in == 0) {
+                direction.eof = true;
+            } else if(errno != EAGAIN) {
+                pWarning() << "Socket relay could not read: " << std::strerror(errno);
+                return false;
+            }
+        }
+
+        if(direction.buffered > 0) {
+            ssize_t out = splice(direction.pipeFds[0], nullptr, direction.to, nullptr,
+                    direction.buffered, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if(out > 0) {
+                direction.buffered -= out;
+                progress = true;
+            } else if(out == -1 && errno != EAGAIN) {
+                pWarning() << "Socket relay could not write: " << std::strerror(errno);
+                return false;
+            }
+        }
+    }
+
+    if(direction.eof && direction.buffered == 0) {
+        shutdown(direction.to, SHUT_WR);
+        direction.done = true;
+    }
+    return true;
+}
+
+void PipeSocketRelay::updateInterest(Relay *relay) {
+
+    for(Endpoint &endpoint: relay->endpoints) {
+        epoll_event event {};
+        event.data.ptr = &endpoint;
+        for(Direction &direction: relay->directions) {
+            // read while there is place in the pipe, wait for writability only when data is waiting
+            if(direction.from == endpoint.fd && !direction.eof && direction.buffered < SPLICE_CHUNK)
+                event.events |= EPOLLIN;
+            if(direction.to == endpoint.fd && direction.buffered > 0)
+                event.events |= EPOLLOUT;
+        }
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, endpoint.fd, &event);
+    }
+}
+
+void PipeSocketRelay::closeRelay(Relay *relay) {
+
+    for(Endpoint &endpoint: relay->endpoints) {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, endpoint.fd, nullptr);
+        close(endpoint.fd);
+    }
+    for(Direction &direction: relay->directions) {
+        close(direction.pipeFds[0]);
+        close(direction.pipeFds[1]);
+    }
+    relay->closed = true;
+    active.erase(relay);
+    closed.push_back(relay);
+    --relays;
+}
+
+void PipeSocketRelay::releaseClosed() {
+    for(Relay *relay: closed) delete relay;
+    closed.clear();
+}
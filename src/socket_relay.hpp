@@ -0,0 +1,99 @@
+#ifndef PIPE_SOCKET_RELAY_HPP
+#define PIPE_SOCKET_RELAY_HPP
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "pipe_exception.hpp"
+
+enum class SocketRelayError {
+    UNDEFINED,
+    SYSTEM_ERROR
+};
+
+typedef PipeException<SocketRelayError> SocketRelayException;
+
+/**
+ * Moves bytes between pairs of connected sockets with splice(), so data never enters user space.
+ * All sockets are served by one epoll thread running outside of Qt event loop.
+ */
+class PipeSocketRelay {
+
+    public:
+        /**
+         * @return relay shared by the whole process
+         * @throws SocketRelayException if it could not be set up
+         */
+        static PipeSocketRelay& instance();
+
+        /**
+         * @throws SocketRelayException if epoll could not be set up
+         */
+        PipeSocketRelay();
+        ~PipeSocketRelay();
+
+        PipeSocketRelay(const PipeSocketRelay&) = delete;
+        PipeSocketRelay& operator=(const PipeSocketRelay&) = delete;
+
+        /**
+         * Starts relaying data between two connected sockets in both directions. Relay takes
+         * ownership of descriptors and closes them when both directions reach end of stream.
+         *
+         * @throws SocketRelayException if relay could not be set up
+         */
+        void relay(int firstFd, int secondFd);
+
+        /**
+         * @return number of socket pairs being relayed
+         */
+        size_t activeRelays() const;
+
+    private:
+        struct Direction {
+            int from;
+            int to;
+            int pipeFds[2];
+            size_t buffered = 0;
+            bool eof = false;
+            bool done = false;
+        };
+
+        struct Relay;
+
+        struct Endpoint {
+            Relay *relay;
+            int fd;
+        };
+
+        struct Relay {
+            Direction directions[2];
+            Endpoint endpoints[2];
+            bool closed = false;
+        };
+
+        void run();
+        void registerPending();
+        void handle(Endpoint *endpoint, uint32_t events);
+        bool pump(Direction &direction);
+        void updateInterest(Relay *relay);
+        void closeRelay(Relay *relay);
+        void releaseClosed();
+
+    private:
+        int epollFd;
+        int wakeFd;
+        std::atomic_bool stopped;
+        std::atomic<size_t> relays;
+        std::mutex pendingMutex;
+        std::vector<Relay*> pending;
+        // relays registered in epoll, used only by worker thread
+        std::set<Relay*> active;
+        // relays closed while handling events, freed after the whole batch is handled
+        std::vector<Relay*> closed;
+        std::thread worker;
+};
+
+#endif
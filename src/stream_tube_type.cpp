@@ -0,0 +1,182 @@
+#include "stream_tube_type.hpp"
+#include "dbus_utils.hpp"
+#include "utils.hpp"
+
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/DBusObject>
+#include <TelepathyQt/PendingVariant>
+
+// ------------ PipeChannelStreamTubeType ----------------------------------------------------------------------
+PipeChannelStreamTubeType::PipeChannelStreamTubeType(
+        Tp::Client::ChannelTypeStreamTubeInterface *pipedStreamTubeIface, const QVariantMap &pipedProperties)
+    : Tp::AbstractChannelInterface(TP_QT_IFACE_CHANNEL_TYPE_STREAM_TUBE),
+    pipedStreamTubeIface(pipedStreamTubeIface),
+    serviceName(pipedProperties.value("Service").toString()),
+    socketTypes(PipeSocketForwarder::forwardedSocketTypes(
+                qdbus_cast<Tp::SupportedSocketMap>(pipedProperties.value("SupportedSocketTypes"))))
+{
+    connect(pipedStreamTubeIface, &Tp::Client::ChannelTypeStreamTubeInterface::NewRemoteConnection,
+            this, &PipeChannelStreamTubeType::newRemoteConnection);
+    connect(pipedStreamTubeIface, &Tp::Client::ChannelTypeStreamTubeInterface::NewLocalConnection,
+            this, &PipeChannelStreamTubeType::newLocalConnection);
+    connect(pipedStreamTubeIface, &Tp::Client::ChannelTypeStreamTubeInterface::ConnectionClosed,
+            this, &PipeChannelStreamTubeType::connectionClosed);
+}
+
+QVariantMap PipeChannelStreamTubeType::immutableProperties() const {
+    QVariantMap properties;
+    properties[TP_QT_IFACE_CHANNEL_TYPE_STREAM_TUBE + QString(".Service")] = serviceName;
+    properties[TP_QT_IFACE_CHANNEL_TYPE_STREAM_TUBE + QString(".SupportedSocketTypes")] = QVariant::fromValue(socketTypes);
+    return properties;
+}
+
+void PipeChannelStreamTubeType::createAdaptor() {
+    (void) new PipeChannelStreamTubeAdaptor(dbusObject()->dbusConnection(), this, dbusObject());
+}
+
+QString PipeChannelStreamTubeType::service() const {
+    return serviceName;
+}
+
+Tp::SupportedSocketMap PipeChannelStreamTubeType::supportedSocketTypes() const {
+    return socketTypes;
+}
+
+QDBusPendingCall PipeChannelStreamTubeType::offer(uint addressType, const QDBusVariant &address, uint accessControl,
+        const QVariantMap &parameters, Tp::DBusError *error)
+{
+    if(addressType != Tp::SocketAddressTypeUnix || accessControl != Tp::SocketAccessControlLocalhost) {
+        error->set(TP_QT_ERROR_NOT_IMPLEMENTED, "Only Unix sockets with localhost access control are piped");
+        return QDBusPendingCall::fromError(QDBusError());
+    }
+    QByteArray clientPath = address.variant().toByteArray();
+    if(clientPath.isEmpty()) {
+        error->set(TP_QT_ERROR_INVALID_ARGUMENT, "Address is not a Unix socket path");
+        return QDBusPendingCall::fromError(QDBusError());
+    }
+
+    PipeSocketForwarder *forwarder = nullptr;
+    try {
+        forwarder = new PipeSocketForwarder(clientPath, this);
+    } catch(const SocketRelayException &e) {
+        error->set(TP_QT_ERROR_NOT_AVAILABLE, e.what());
+        return QDBusPendingCall::fromError(QDBusError());
+    }
+    return pipedStreamTubeIface->Offer(Tp::SocketAddressTypeUnix, QDBusVariant(QVariant(forwarder->path())),
+            Tp::SocketAccessControlLocalhost, parameters);
+}
+
+void PipeChannelStreamTubeType::accept(uint addressType, uint accessControl, const PipeSocketForwarder::AddressFunction &done) {
+    if(!PipeSocketForwarder::checkSocketType(addressType, accessControl, done)) return;
+    PipeSocketForwarder::forwardReply(pipedStreamTubeIface->Accept(Tp::SocketAddressTypeUnix,
+                Tp::SocketAccessControlLocalhost, QDBusVariant(QVariant(uint(0)))), this, done);
+}
+
+// ------------ PipeChannelStreamTubeAdaptor -------------------------------------------------------------------
+PipeChannelStreamTubeAdaptor::PipeChannelStreamTubeAdaptor(
+        const QDBusConnection &dbusConnection, PipeChannelStreamTubeType *streamTube, QObject *parent)
+    : QDBusAbstractAdaptor(parent),
+    dbusConnection(dbusConnection),
+    streamTube(streamTube)
+{
+    connect(streamTube, &PipeChannelStreamTubeType::newRemoteConnection,
+            this, &PipeChannelStreamTubeAdaptor::NewRemoteConnection);
+    connect(streamTube, &PipeChannelStreamTubeType::newLocalConnection,
+            this, &PipeChannelStreamTubeAdaptor::NewLocalConnection);
+    connect(streamTube, &PipeChannelStreamTubeType::connectionClosed, this, &PipeChannelStreamTubeAdaptor::ConnectionClosed);
+}
+
+QString PipeChannelStreamTubeAdaptor::Service() const {
+    return streamTube ? streamTube->service() : QString();
+}
+
+Tp::SupportedSocketMap PipeChannelStreamTubeAdaptor::SupportedSocketTypes() const {
+    return streamTube ? streamTube->supportedSocketTypes() : Tp::SupportedSocketMap();
+}
+
+void PipeChannelStreamTubeAdaptor::Offer(uint addressType, const QDBusVariant &address, uint accessControl,
+        const QVariantMap &parameters, const QDBusMessage &dbusMessage)
+{
+    if(!streamTube) return;
+
+    Tp::DBusError error;
+    QDBusPendingCall offerCall = streamTube->offer(addressType, address, accessControl, parameters, &error);
+    if(error.isValid()) {
+        dbusMessage.setDelayedReply(true);
+        dbusConnection.send(dbusMessage.createErrorReply(error.name(), error.message()));
+        return;
+    }
+    forwardDBusReply(dbusConnection, dbusMessage, offerCall, this);
+}
+
+void PipeChannelStreamTubeAdaptor::Accept(uint addressType, uint accessControl,
+        const QDBusVariant &/*accessControlParam*/, const QDBusMessage &dbusMessage)
+{
+    if(!streamTube) return;
+    dbusMessage.setDelayedReply(true);
+    QDBusConnection connection = dbusConnection;
+    streamTube->accept(addressType, accessControl, [connection, dbusMessage](const QDBusVariant &address, const QDBusError &error) {
+            if(error.isValid()) connection.send(dbusMessage.createErrorReply(error));
+            else connection.send(dbusMessage.createReply(QVariant::fromValue(address)));
+        });
+}
+
+// ------------ PipeChannelTubeInterface -----------------------------------------------------------------------
+PipeChannelTubeInterface::PipeChannelTubeInterface(
+        Tp::Client::ChannelInterfaceTubeInterface *pipedTubeIface, const QVariantMap &pipedProperties)
+    : Tp::AbstractChannelInterface(TP_QT_IFACE_CHANNEL_INTERFACE_TUBE),
+    pipedTubeIface(pipedTubeIface),
+    tubeParameters(qdbus_cast<QVariantMap>(pipedProperties.value("Parameters"))),
+    tubeState(pipedProperties.value("State").toUInt())
+{
+    connect(pipedTubeIface, &Tp::Client::ChannelInterfaceTubeInterface::TubeChannelStateChanged,
+            this, &PipeChannelTubeInterface::tubeChannelStateChangedCb);
+}
+
+QVariantMap PipeChannelTubeInterface::immutableProperties() const {
+    // parameters of incoming tube are known when it is announced
+    QVariantMap properties;
+    if(tubeState != Tp::TubeChannelStateNotOffered)
+        properties[TP_QT_IFACE_CHANNEL_INTERFACE_TUBE + QString(".Parameters")] = tubeParameters;
+    return properties;
+}
+
+void PipeChannelTubeInterface::createAdaptor() {
+    (void) new PipeChannelTubeAdaptor(this, dbusObject());
+}
+
+QVariantMap PipeChannelTubeInterface::parameters() const {
+    return tubeParameters;
+}
+
+uint PipeChannelTubeInterface::state() const {
+    return tubeState;
+}
+
+void PipeChannelTubeInterface::tubeChannelStateChangedCb(uint state) {
+    tubeState = state;
+    // offered tube got its parameters with Offer
+    if(tubeParameters.isEmpty()) {
+        Tp::PendingVariant *pendingRep = pipedTubeIface->requestPropertyParameters();
+        connect(pendingRep, &Tp::PendingOperation::finished, this, [this, pendingRep](Tp::PendingOperation *op) {
+                if(op->isValid()) tubeParameters = qdbus_cast<QVariantMap>(pendingRep->result());
+            });
+    }
+    emit tubeChannelStateChanged(state);
+}
+
+// ------------ PipeChannelTubeAdaptor -------------------------------------------------------------------------
+PipeChannelTubeAdaptor::PipeChannelTubeAdaptor(PipeChannelTubeInterface *tube, QObject *parent)
+    : QDBusAbstractAdaptor(parent),
+    tube(tube)
+{
+    connect(tube, &PipeChannelTubeInterface::tubeChannelStateChanged, this, &PipeChannelTubeAdaptor::TubeChannelStateChanged);
+}
+
+QVariantMap PipeChannelTubeAdaptor::Parameters() const {
+    return tube ? tube->parameters() : QVariantMap();
+}
+
+uint PipeChannelTubeAdaptor::State() const {
+    return tube ? tube->state() : uint(Tp::TubeChannelStateNotOffered);
+}
@@ -0,0 +1,152 @@
+#ifndef PIPE_STREAM_TUBE_TYPE_HPP
+#define PIPE_STREAM_TUBE_TYPE_HPP
+
+#include <TelepathyQt/BaseChannel>
+#include <TelepathyQt/Channel>
+#include <QDBusAbstractAdaptor>
+#include <QDBusMessage>
+#include <QDBusVariant>
+#include <QPointer>
+
+#include "socket_forwarder.hpp"
+
+/**
+ * Stream tube type of proxy channel. Only Unix sockets with localhost access control are offered.
+ * Accepted tube gives the client socket of PipeSocketForwarder connected to the socket of piped
+ * channel, offered tube gives piped channel socket of forwarder connected to the socket of client.
+ * Connection ids of piped channel are relayed unchanged, each forwarded connection has one.
+ */
+class PipeChannelStreamTubeType : public Tp::AbstractChannelInterface {
+
+    Q_OBJECT;
+
+    public:
+        /**
+         * @param pipedProperties all properties of stream tube type of piped channel
+         */
+        PipeChannelStreamTubeType(Tp::Client::ChannelTypeStreamTubeInterface *pipedStreamTubeIface,
+                const QVariantMap &pipedProperties);
+
+        QVariantMap immutableProperties() const override;
+
+        QString service() const;
+        Tp::SupportedSocketMap supportedSocketTypes() const;
+
+        /**
+         * Offers the tube on piped channel, connections from it are forwarded to address of client
+         */
+        QDBusPendingCall offer(uint addressType, const QDBusVariant &address, uint accessControl,
+                const QVariantMap &parameters, Tp::DBusError *error);
+        /**
+         * Accepts the tube on piped channel, done gets address of socket to connect to
+         */
+        void accept(uint addressType, uint accessControl, const PipeSocketForwarder::AddressFunction &done);
+
+    signals:
+        void newRemoteConnection(uint handle, const QDBusVariant &connectionParam, uint connectionID);
+        void newLocalConnection(uint connectionID);
+        void connectionClosed(uint connectionID, const QString &error, const QString &message);
+
+    private:
+        void createAdaptor() override;
+
+    private:
+        Tp::Client::ChannelTypeStreamTubeInterface *pipedStreamTubeIface;
+        QString serviceName;
+        Tp::SupportedSocketMap socketTypes;
+};
+
+typedef Tp::SharedPtr<PipeChannelStreamTubeType> PipeChannelStreamTubeTypePtr;
+
+/**
+ * Exports PipeChannelStreamTubeType on D-Bus, Offer and Accept are answered with delayed reply
+ */
+class PipeChannelStreamTubeAdaptor : public QDBusAbstractAdaptor {
+
+    Q_OBJECT;
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Telepathy.Channel.Type.StreamTube")
+    Q_PROPERTY(QString Service READ Service)
+    Q_PROPERTY(Tp::SupportedSocketMap SupportedSocketTypes READ SupportedSocketTypes)
+
+    public:
+        PipeChannelStreamTubeAdaptor(const QDBusConnection &dbusConnection,
+                PipeChannelStreamTubeType *streamTube, QObject *parent);
+
+        QString Service() const;
+        Tp::SupportedSocketMap SupportedSocketTypes() const;
+
+    public slots:
+        void Offer(uint addressType, const QDBusVariant &address, uint accessControl, const QVariantMap &parameters,
+                const QDBusMessage &dbusMessage);
+        void Accept(uint addressType, uint accessControl, const QDBusVariant &accessControlParam,
+                const QDBusMessage &dbusMessage);
+
+    signals:
+        void NewRemoteConnection(uint handle, const QDBusVariant &connectionParam, uint connectionID);
+        void NewLocalConnection(uint connectionID);
+        void ConnectionClosed(uint connectionID, const QString &error, const QString &message);
+
+    private:
+        QDBusConnection dbusConnection;
+        QPointer<PipeChannelStreamTubeType> streamTube;
+};
+
+/**
+ * Tube interface of proxy channel, state and parameters of piped tube are relayed
+ */
+class PipeChannelTubeInterface : public Tp::AbstractChannelInterface {
+
+    Q_OBJECT;
+
+    public:
+        /**
+         * @param pipedProperties all properties of tube interface of piped channel
+         */
+        PipeChannelTubeInterface(Tp::Client::ChannelInterfaceTubeInterface *pipedTubeIface,
+                const QVariantMap &pipedProperties);
+
+        QVariantMap immutableProperties() const override;
+
+        QVariantMap parameters() const;
+        uint state() const;
+
+    signals:
+        void tubeChannelStateChanged(uint state);
+
+    private:
+        void createAdaptor() override;
+
+        void tubeChannelStateChangedCb(uint state);
+
+    private:
+        Tp::Client::ChannelInterfaceTubeInterface *pipedTubeIface;
+        QVariantMap tubeParameters;
+        uint tubeState;
+};
+
+typedef Tp::SharedPtr<PipeChannelTubeInterface> PipeChannelTubeInterfacePtr;
+
+/**
+ * Exports PipeChannelTubeInterface on D-Bus
+ */
+class PipeChannelTubeAdaptor : public QDBusAbstractAdaptor {
+
+    Q_OBJECT;
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Telepathy.Channel.Interface.Tube")
+    Q_PROPERTY(QVariantMap Parameters READ Parameters)
+    Q_PROPERTY(uint State READ State)
+
+    public:
+        PipeChannelTubeAdaptor(PipeChannelTubeInterface *tube, QObject *parent);
+
+        QVariantMap Parameters() const;
+        uint State() const;
+
+    signals:
+        void TubeChannelStateChanged(uint state);
+
+    private:
+        QPointer<PipeChannelTubeInterface> tube;
+};
+
+#endif
@@ -2,9 +2,11 @@
 #define TYPES_HPP
 
 #include <memory>
-#include "pipe_interface.h"
+#include <vector>
+#include "pipe.hpp"
 
-typedef OrgFreedesktopTelepathyPipeInterface Pipe;
 typedef std::shared_ptr<Pipe> PipePtr;
+/** Pipes applied one after another to the same channel */
+typedef std::vector<PipePtr> PipeChain;
 
 #endif
@@ -0,0 +1,79 @@
+#include "connection.hpp"
+#include "bench_counters.hpp"
+#include "bench_services.hpp"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QTemporaryDir>
+#include <cstdio>
+
+/**
+ * Resolves addresses of a piped roster through Addressing interface of pipes connection, each set
+ * in one GetContactsByURI call. URIs known to the roster index are resolved locally, URIs differing
+ * in case go to the piped connection in one batched call and URIs of unknown contacts miss in both.
+ * Use --addresses to set size of roster and of each set. Needs session bus.
+ */
+
+namespace {
+
+    void measure(const char *name, const PipeConnectionPtr &connection, const QStringList &URIs) {
+
+        PipeBenchCounters counters;
+        counters.start();
+        QDBusMessage reply = callConnection(connection, TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING, "GetContactsByURI",
+                QVariantList() << URIs << QStringList());
+        counters.stop();
+        if(reply.type() != QDBusMessage::ReplyMessage || reply.arguments().isEmpty()) {
+            std::fprintf(stderr, "%s lookup failed: %s\n", name, qPrintable(reply.errorMessage()));
+            return;
+        }
+
+        Tp::AddressingNormalizationMap resolved = qdbus_cast<Tp::AddressingNormalizationMap>(reply.arguments().at(0));
+        std::printf("%-20s %12d %12d %12.2f %14.0f %14llu\n", name, URIs.size(), resolved.size(),
+                counters.nanoseconds() / 1e6, URIs.size() * 1e9 / qMax<int64_t>(1, counters.nanoseconds()),
+                (unsigned long long) counters.allocations());
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    registerBenchTypes();
+    int addresses = intArgument(app.arguments(), "--addresses", 10000);
+
+    if(!QDBusConnection::sessionBus().isConnected()) {
+        std::fprintf(stderr, "No session bus\n");
+        return 1;
+    }
+
+    QTemporaryDir home;
+    qputenv("HOME", home.path().toLocal8Bit());
+
+    FakeServices services;
+    services.startServices();
+    PipeChain pipes { std::make_shared<Pipe>(FakeServices::pipeService(), FakeServices::pipePath(),
+            QDBusConnection::sessionBus()) };
+
+    PipeConnectionPtr connection = pipeAccount(services, pipes, "addressing", addresses);
+    if(!connection) {
+        std::fprintf(stderr, "Roster of %d contacts was not loaded\n", addresses);
+        return 1;
+    }
+
+    QStringList rosterURIs, caseURIs, unknownURIs;
+    for(int handle = 1; handle <= addresses; ++handle) {
+        rosterURIs << FakeServices::contactURI(handle);
+        caseURIs << FakeServices::contactURI(handle).toUpper();
+        unknownURIs << FakeServices::contactURI(addresses + 1 + handle);
+    }
+
+    std::printf("%-20s %12s %12s %12s %14s %14s\n", "Lookup", "addresses", "resolved", "ms", "addresses/s", "allocations");
+    measure("roster index", connection, rosterURIs);
+    measure("piped connection", connection, caseURIs);
+    measure("unknown", connection, unknownURIs);
+
+    connection.reset();
+    services.stopServices();
+    return 0;
+}
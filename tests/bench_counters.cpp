@@ -0,0 +1,127 @@
+#include "bench_counters.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+    std::atomic<uint64_t> allocationsTotal(0);
+
+    void* countedAllocation(std::size_t size) {
+        allocationsTotal.fetch_add(1, std::memory_order_relaxed);
+        void *p = std::malloc(size ? size : 1);
+        if(!p) throw std::bad_alloc();
+        return p;
+    }
+
+    int openCacheMissCounter() {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+        return -1;
+#endif
+    }
+
+} /* anonymous namespace */
+
+void* operator new(std::size_t size) {
+    return countedAllocation(size);
+}
+
+void* operator new[](std::size_t size) {
+    return countedAllocation(size);
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+    std::free(p);
+}
+
+PipeBenchCounters::PipeBenchCounters() : perfFd(openCacheMissCounter()), elapsed(0),
+    allocationsStarted(0), allocationCount(0), misses(-1)
+{
+}
+
+PipeBenchCounters::~PipeBenchCounters() {
+#ifdef __linux__
+    if(perfFd >= 0) close(perfFd);
+#endif
+}
+
+void PipeBenchCounters::start() {
+#ifdef __linux__
+    if(perfFd >= 0) {
+        ioctl(perfFd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(perfFd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+    allocationsStarted = allocationsTotal.load(std::memory_order_relaxed);
+    started = std::chrono::steady_clock::now();
+}
+
+void PipeBenchCounters::stop() {
+    auto stopped = std::chrono::steady_clock::now();
+    allocationCount = allocationsTotal.load(std::memory_order_relaxed) - allocationsStarted;
+    elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(stopped - started).count();
+    misses = -1;
+#ifdef __linux__
+    if(perfFd >= 0) {
+        ioctl(perfFd, PERF_EVENT_IOC_DISABLE, 0);
+        long long count = 0;
+        if(read(perfFd, &count, sizeof(count)) == sizeof(count)) misses = count;
+    }
+#endif
+}
+
+int64_t PipeBenchCounters::nanoseconds() const {
+    return elapsed;
+}
+
+uint64_t PipeBenchCounters::allocations() const {
+    return allocationCount;
+}
+
+int64_t PipeBenchCounters::cacheMisses() const {
+    return misses;
+}
+
+int64_t PipeBenchCounters::residentKilobytes() {
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+#ifdef __linux__
+    FILE *statm = std::fopen("/proc/self/statm", "r");
+    if(!statm) return -1;
+    long long size = 0, resident = 0;
+    int fields = std::fscanf(statm, "%lld %lld", &size, &resident);
+    std::fclose(statm);
+    return fields == 2 ? resident * sysconf(_SC_PAGESIZE) / 1024 : -1;
+#else
+    return -1;
+#endif
+}
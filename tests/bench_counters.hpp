@@ -0,0 +1,45 @@
+#ifndef PIPE_BENCH_COUNTERS_HPP
+#define PIPE_BENCH_COUNTERS_HPP
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * Measures time, heap allocations and cache misses of a section of code. Allocations are counted
+ * by replaced global operator new, cache misses are read from perf_event_open where it is available.
+ */
+class PipeBenchCounters {
+
+    public:
+        PipeBenchCounters();
+        ~PipeBenchCounters();
+
+        PipeBenchCounters(const PipeBenchCounters&) = delete;
+        PipeBenchCounters& operator=(const PipeBenchCounters&) = delete;
+
+        void start();
+        void stop();
+
+        int64_t nanoseconds() const;
+        uint64_t allocations() const;
+        /**
+         * @return cache misses of the last measured section, -1 when hardware counters are not available
+         */
+        int64_t cacheMisses() const;
+
+        /**
+         * Returns free heap memory to the system first where the allocator allows it
+         * @return resident set size of the process in KiB, -1 when it is not available
+         */
+        static int64_t residentKilobytes();
+
+    private:
+        int perfFd;
+        std::chrono::steady_clock::time_point started;
+        int64_t elapsed;
+        uint64_t allocationsStarted;
+        uint64_t allocationCount;
+        int64_t misses;
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "connection.hpp"
+#include "proxy_channel.hpp"
+#include "bench_counters.hpp"
+#include "bench_services.hpp"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QElapsedTimer>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+/**
+ * Bulk sender load: fake channels receive delivery reports at given rate per minute, spread evenly
+ * over piped text channels and ticks. Reports how many reports proxies relayed, their lag from the
+ * tick which produced them and how many stayed unacknowledged on piped channels. Use --rate,
+ * --seconds, --channels and --interval (ms between ticks) to shape the load. Needs session bus.
+ */
+
+namespace {
+
+    /**
+     * Reports relayed by one proxy channel, due[t] is number of reports it gets up to tick t
+     */
+    struct RelayedReports {
+        int relayed = 0;
+        std::vector<int> due;
+    };
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    registerBenchTypes();
+    QStringList args = app.arguments();
+    int rate = intArgument(args, "--rate", 50000);
+    int seconds = intArgument(args, "--seconds", 60);
+    int channels = intArgument(args, "--channels", 10);
+    int interval = intArgument(args, "--interval", 100);
+
+    if(!QDBusConnection::sessionBus().isConnected()) {
+        std::fprintf(stderr, "No session bus\n");
+        return 1;
+    }
+
+    QTemporaryDir home;
+    qputenv("HOME", home.path().toLocal8Bit());
+
+    FakeServices services;
+    services.startServices();
+    PipeChain pipes { std::make_shared<Pipe>(FakeServices::pipeService(), FakeServices::pipePath(),
+            QDBusConnection::sessionBus()) };
+
+    PipeConnectionPtr connection = pipeAccount(services, pipes, "reports", channels);
+    if(!connection) {
+        std::fprintf(stderr, "Roster of %d contacts was not loaded\n", channels);
+        return 1;
+    }
+
+    int ticks = qMax(1, seconds * 1000 / qMax(1, interval));
+    std::vector<qint64> tickTimes(ticks + 1, 0);
+    std::vector<RelayedReports> relayed(channels);
+    for(RelayedReports &reports: relayed) {
+        reports.due.resize(ticks + 1);
+        for(int tick = 0; tick <= ticks; ++tick)
+            reports.due[tick] = int(qint64(rate) * tick * interval / 60000 / channels);
+    }
+
+    QElapsedTimer clock;
+    clock.start();
+    double totalLag = 0, maxLag = 0;
+    std::vector<Tp::BaseChannelPtr> piped;
+    QStringList channelPaths;
+    for(int handle = 1; handle <= channels; ++handle) {
+        Tp::DBusError error;
+        Tp::BaseChannelPtr channel = connection->openChannel(TP_QT_IFACE_CHANNEL_TYPE_TEXT,
+                Tp::HandleTypeContact, handle, connection->selfHandle(), false, &error);
+        PipeProxyChannelPtr proxy = PipeProxyChannelPtr::dynamicCast(channel);
+        Tp::BaseChannelTextTypePtr textType = channel ? Tp::BaseChannelTextTypePtr::dynamicCast(
+                channel->interface(TP_QT_IFACE_CHANNEL_TYPE_TEXT)) : Tp::BaseChannelTextTypePtr();
+        if(error.isValid() || !proxy || !textType) {
+            std::fprintf(stderr, "Could not pipe channel: %s\n", qPrintable(error.message()));
+            return 1;
+        }
+        piped.push_back(channel);
+        channelPaths << proxy->getPipedChannel()->objectPath();
+
+        RelayedReports &reports = relayed[handle - 1];
+        QObject::connect(textType.data(), &Tp::BaseChannelTextType::messageReceived,
+                [&reports, &tickTimes, &clock, &totalLag, &maxLag](const Tp::MessagePartList &message) {
+                    if(message.isEmpty() || message.first().value("message-type").variant().toUInt()
+                            != Tp::ChannelTextMessageTypeDeliveryReport) return;
+                    ++reports.relayed;
+                    size_t tick = std::lower_bound(reports.due.begin(), reports.due.end(), reports.relayed)
+                        - reports.due.begin();
+                    double lag = (clock.nsecsElapsed() - tickTimes[qMin(tick, tickTimes.size() - 1)]) / 1e6;
+                    totalLag += lag;
+                    maxLag = qMax(maxLag, lag);
+                });
+    }
+    // proxies fetch pending messages of piped channels
+    settle();
+
+    QString connectionPath = connection->getPipedConnection()->objectPath();
+    int produced = 0;
+    PipeBenchCounters counters;
+    counters.start();
+    for(int tick = 1; tick <= ticks; ++tick) {
+        int count = relayed[0].due[tick] - relayed[0].due[tick - 1];
+        tickTimes[tick] = clock.nsecsElapsed();
+        if(count > 0) {
+            services.invoke([&services, &connectionPath, &channelPaths, count]() {
+                    FakeConnectionPtr fakeConnection = services.connection(connectionPath);
+                    if(!fakeConnection) return;
+                    for(const QString &channelPath: channelPaths) {
+                        FakeChannelPtr fakeChannel = fakeConnection->channel(channelPath);
+                        if(fakeChannel) fakeChannel->receiveDeliveryReports(count);
+                    }
+                });
+            produced += count * channels;
+        }
+        settle(interval);
+    }
+
+    QElapsedTimer drain;
+    drain.start();
+    int total = 0;
+    bool finished = waitFor([&relayed, &total, produced]() {
+            total = 0;
+            for(const RelayedReports &reports: relayed) total += reports.relayed;
+            return total >= produced;
+        });
+    qint64 drainMs = drain.elapsed();
+    counters.stop();
+
+    // acknowledged reports are removed from pending messages of fake channels
+    int unacknowledged = 0;
+    waitFor([&services, &connectionPath, &channelPaths, &unacknowledged]() {
+            services.invoke([&services, &connectionPath, &channelPaths, &unacknowledged]() {
+                    unacknowledged = 0;
+                    FakeConnectionPtr fakeConnection = services.connection(connectionPath);
+                    for(const QString &channelPath: channelPaths) {
+                        FakeChannelPtr fakeChannel = fakeConnection ? fakeConnection->channel(channelPath) : FakeChannelPtr();
+                        if(fakeChannel) unacknowledged += fakeChannel->pendingMessages();
+                    }
+                });
+            return unacknowledged == 0;
+        }, 5000);
+
+    double minutes = counters.nanoseconds() / 6e10;
+    std::printf("%-10s %10s %10s %12s %12s %12s %10s %14s %14s\n", "Channels", "reports", "relayed", "reports/min",
+            "avg lag ms", "max lag ms", "drain ms", "unacknowledged", "allocs/report");
+    std::printf("%-10d %10d %10d %12.0f %12.2f %12.2f %10lld %14d %14.1f\n", channels, produced, total,
+            total / qMax(minutes, 1e-9), totalLag / qMax(1, total), maxLag, (long long) drainMs, unacknowledged,
+            double(counters.allocations()) / qMax(1, total));
+
+    piped.clear();
+    connection.reset();
+    services.stopServices();
+    return finished ? 0 : 1;
+}
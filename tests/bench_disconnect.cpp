@@ -0,0 +1,132 @@
+#include "connection.hpp"
+#include "proxy_channel.hpp"
+#include "bench_counters.hpp"
+#include "bench_services.hpp"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QPointer>
+#include <QTemporaryDir>
+#include <cstdio>
+
+/**
+ * Disconnect latency of pipes connection with many open text channels. Client disconnect calls
+ * Disconnect on pipes connection, which closes proxies and their piped channels, it is measured
+ * until the reply and until fake connection has no open channels. Piped disconnect disconnects the
+ * fake connection, so proxies are closed without closing piped channels, it is measured until no
+ * proxy is left. Use --channels to set number of channels. Needs session bus.
+ */
+
+namespace {
+
+    int aliveCount(const QList<QPointer<PipeProxyChannel>> &proxies) {
+        int alive = 0;
+        for(const QPointer<PipeProxyChannel> &proxy: proxies) if(proxy) ++alive;
+        return alive;
+    }
+
+    int fakeChannelCount(FakeServices &services, const QString &connectionPath) {
+        int count = 0;
+        services.invoke([&services, &connectionPath, &count]() {
+                FakeConnectionPtr fakeConnection = services.connection(connectionPath);
+                count = fakeConnection ? fakeConnection->channelCount() : 0;
+            });
+        return count;
+    }
+
+    /**
+     * Pipes account and opens channels to all its contacts, proxies are watched in given list
+     */
+    PipeConnectionPtr openChannels(FakeServices &services, const PipeChain &pipes, const QString &account,
+            int channels, QList<QPointer<PipeProxyChannel>> &proxies)
+    {
+        PipeConnectionPtr connection = pipeAccount(services, pipes, account, channels);
+        if(!connection) return PipeConnectionPtr();
+
+        for(int handle = 1; handle <= channels; ++handle) {
+            Tp::DBusError error;
+            PipeProxyChannelPtr proxy = PipeProxyChannelPtr::dynamicCast(connection->openChannel(
+                        TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeContact, handle, connection->selfHandle(), false, &error));
+            if(error.isValid() || !proxy) {
+                std::fprintf(stderr, "Could not pipe channel: %s\n", qPrintable(error.message()));
+                return PipeConnectionPtr();
+            }
+            proxies << QPointer<PipeProxyChannel>(proxy.data());
+        }
+        settle();
+        return connection;
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    registerBenchTypes();
+    int channels = intArgument(app.arguments(), "--channels", 500);
+
+    if(!QDBusConnection::sessionBus().isConnected()) {
+        std::fprintf(stderr, "No session bus\n");
+        return 1;
+    }
+
+    QTemporaryDir home;
+    qputenv("HOME", home.path().toLocal8Bit());
+
+    FakeServices services;
+    services.startServices();
+    PipeChain pipes { std::make_shared<Pipe>(FakeServices::pipeService(), FakeServices::pipePath(),
+            QDBusConnection::sessionBus()) };
+
+    std::printf("%-18s %10s %14s %14s %14s\n", "Disconnect", "channels", "reply ms", "proxies ms", "piped ms");
+
+    // client disconnects pipes connection, piped channels are closed with proxies
+    QList<QPointer<PipeProxyChannel>> proxies;
+    PipeConnectionPtr connection = openChannels(services, pipes, "clientdisconnect", channels, proxies);
+    if(!connection) return 1;
+    QString connectionPath = connection->getPipedConnection()->objectPath();
+
+    PipeBenchCounters counters;
+    counters.start();
+    QDBusMessage reply = callConnection(connection, TP_QT_IFACE_CONNECTION, "Disconnect", QVariantList());
+    counters.stop();
+    double replyMs = counters.nanoseconds() / 1e6;
+    if(reply.type() != QDBusMessage::ReplyMessage) {
+        std::fprintf(stderr, "Disconnect failed: %s\n", qPrintable(reply.errorMessage()));
+        return 1;
+    }
+    bool proxiesClosed = waitFor([&proxies]() { return aliveCount(proxies) == 0; });
+    counters.stop();
+    double proxiesMs = counters.nanoseconds() / 1e6;
+    bool pipedClosed = waitFor([&services, &connectionPath]() { return fakeChannelCount(services, connectionPath) == 0; });
+    counters.stop();
+    if(!proxiesClosed || !pipedClosed) {
+        std::fprintf(stderr, "Channels were not closed after client disconnect\n");
+        return 1;
+    }
+    std::printf("%-18s %10d %14.2f %14.2f %14.2f\n", "client", channels, replyMs, proxiesMs, counters.nanoseconds() / 1e6);
+    connection.reset();
+    proxies.clear();
+
+    // piped connection goes away, its channels are invalidated with it
+    connection = openChannels(services, pipes, "pipeddisconnect", channels, proxies);
+    if(!connection) return 1;
+    connectionPath = connection->getPipedConnection()->objectPath();
+
+    counters.start();
+    services.invoke([&services, &connectionPath]() {
+            FakeConnectionPtr fakeConnection = services.connection(connectionPath);
+            if(fakeConnection) fakeConnection->setStatus(Tp::ConnectionStatusDisconnected, Tp::ConnectionStatusReasonNetworkError);
+        });
+    proxiesClosed = waitFor([&proxies]() { return aliveCount(proxies) == 0; });
+    counters.stop();
+    if(!proxiesClosed) {
+        std::fprintf(stderr, "Proxies were not closed after piped disconnect\n");
+        return 1;
+    }
+    std::printf("%-18s %10d %14s %14.2f %14s\n", "piped", channels, "-", counters.nanoseconds() / 1e6, "-");
+
+    connection.reset();
+    services.stopServices();
+    return 0;
+}
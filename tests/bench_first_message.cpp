@@ -0,0 +1,164 @@
+#include "connection.hpp"
+#include "bench_counters.hpp"
+#include "bench_services.hpp"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusObjectPath>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+/**
+ * Latency of opening a chat: EnsureChannel of text channel to a contact through Requests interface
+ * of pipes connection, followed by the first message sent through the new channel. Measured for
+ * connection which pipes channels on request and for connection with pre-piping pool, whose
+ * contacts became active by changing their presence before. Use --contacts to set number of chats
+ * opened on each connection. Needs session bus.
+ */
+
+namespace {
+
+    const int MESSAGE_SIZE = 64;
+
+    struct Latencies {
+        std::vector<double> open;
+        std::vector<double> firstMessage;
+    };
+
+    QVariantMap textChannelRequest(uint handle) {
+        QVariantMap request;
+        request[TP_QT_IFACE_CHANNEL + QString(".ChannelType")] = TP_QT_IFACE_CHANNEL_TYPE_TEXT;
+        request[TP_QT_IFACE_CHANNEL + QString(".TargetHandleType")] = uint(Tp::HandleTypeContact);
+        request[TP_QT_IFACE_CHANNEL + QString(".TargetHandle")] = handle;
+        return request;
+    }
+
+    Tp::MessagePartList textMessage() {
+        Tp::MessagePart header;
+        header["message-type"] = QDBusVariant(uint(Tp::ChannelTextMessageTypeNormal));
+        Tp::MessagePart body;
+        body["content-type"] = QDBusVariant(QString("text/plain"));
+        body["content"] = QDBusVariant(QString(MESSAGE_SIZE, QChar('x')));
+        return Tp::MessagePartList() << header << body;
+    }
+
+    /**
+     * Opens chat with each contact and sends first message to it
+     * @return false if any step failed
+     */
+    bool openChats(const PipeConnectionPtr &connection, int contacts, Latencies &latencies) {
+
+        for(int handle = 1; handle <= contacts; ++handle) {
+            PipeBenchCounters counters;
+            counters.start();
+            QDBusMessage ensureReply = callConnection(connection, TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS,
+                    "EnsureChannel", QVariantList() << textChannelRequest(handle));
+            counters.stop();
+            if(ensureReply.type() != QDBusMessage::ReplyMessage || ensureReply.arguments().size() < 2) {
+                std::fprintf(stderr, "Could not open chat: %s\n", qPrintable(ensureReply.errorMessage()));
+                return false;
+            }
+            double openMs = counters.nanoseconds() / 1e6;
+            QString channelPath = qdbus_cast<QDBusObjectPath>(ensureReply.arguments().at(1)).path();
+
+            counters.start();
+            QDBusMessage sendReply = callObject(connection, channelPath, TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES,
+                    "SendMessage", QVariantList() << QVariant::fromValue(textMessage()) << uint(0));
+            counters.stop();
+            if(sendReply.type() != QDBusMessage::ReplyMessage) {
+                std::fprintf(stderr, "Could not send first message: %s\n", qPrintable(sendReply.errorMessage()));
+                return false;
+            }
+            latencies.open.push_back(openMs);
+            latencies.firstMessage.push_back(openMs + counters.nanoseconds() / 1e6);
+        }
+        return true;
+    }
+
+    double percentile(std::vector<double> values, double fraction) {
+        if(values.empty()) return 0;
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, size_t(fraction * values.size()))];
+    }
+
+    void printLatencies(const char *name, const Latencies &latencies) {
+        std::printf("%-12s %12.2f %12.2f %12.2f %16.2f %16.2f %16.2f\n", name,
+                percentile(latencies.open, 0.5), percentile(latencies.open, 0.9), percentile(latencies.open, 1),
+                percentile(latencies.firstMessage, 0.5), percentile(latencies.firstMessage, 0.9),
+                percentile(latencies.firstMessage, 1));
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    registerBenchTypes();
+    int contacts = intArgument(app.arguments(), "--contacts", 20);
+
+    if(!QDBusConnection::sessionBus().isConnected()) {
+        std::fprintf(stderr, "No session bus\n");
+        return 1;
+    }
+
+    QTemporaryDir home;
+    qputenv("HOME", home.path().toLocal8Bit());
+
+    FakeServices services;
+    services.startServices();
+    PipeChain pipes { std::make_shared<Pipe>(FakeServices::pipeService(), FakeServices::pipePath(),
+            QDBusConnection::sessionBus()) };
+
+    Latencies onRequest;
+    PipeConnectionPtr connection = pipeAccount(services, pipes, "onrequest", contacts);
+    if(!connection || !openChats(connection, contacts, onRequest)) return 1;
+    connection.reset();
+
+    // pool has room for all measured contacts and does not expire during the bench
+    Tp::ConnectionPtr pipedConnection = services.connectAccount("prepiped", contacts);
+    if(!pipedConnection) return 1;
+    writePipedContacts("prepiped", contacts);
+    ConnectionAdditionalData additionalData = defaultConnectionData("prepiped");
+    additionalData.prePipePoolSize = contacts;
+    additionalData.prePipeIdleTimeout = 3600;
+    connection = createPipeConnection(pipedConnection, pipes, additionalData);
+    if(!connection || !waitForRoster(connection)) return 1;
+
+    Tp::SimplePresence available;
+    available.type = Tp::ConnectionPresenceTypeAvailable;
+    available.status = "available";
+    Tp::SimpleContactPresences presences;
+    for(int handle = 1; handle <= contacts; ++handle) presences[handle] = available;
+    QString connectionPath = pipedConnection->objectPath();
+    int pooled = 0;
+    auto countPooled = [&services, &connectionPath, &pooled]() {
+            services.invoke([&services, &connectionPath, &pooled]() {
+                    FakeConnectionPtr fakeConnection = services.connection(connectionPath);
+                    pooled = fakeConnection ? fakeConnection->channelCount() : 0;
+                });
+            return pooled;
+        };
+    services.invoke([&services, &connectionPath, &presences]() {
+            FakeConnectionPtr fakeConnection = services.connection(connectionPath);
+            if(fakeConnection) fakeConnection->setPresences(presences);
+        });
+    // pool pipes channels of active contacts one by one
+    if(!waitFor([&countPooled, contacts]() { return countPooled() >= contacts; })) {
+        std::fprintf(stderr, "Only %d of %d channels were pre-piped\n", pooled, contacts);
+        return 1;
+    }
+
+    Latencies prePiped;
+    if(!openChats(connection, contacts, prePiped)) return 1;
+
+    std::printf("%-12s %12s %12s %12s %16s %16s %16s\n", "Connection", "open p50", "open p90", "open max",
+            "message p50", "message p90", "message max");
+    printLatencies("on request", onRequest);
+    printLatencies("pre-piped", prePiped);
+
+    connection.reset();
+    services.stopServices();
+    return 0;
+}
@@ -0,0 +1,113 @@
+#include "connection.hpp"
+#include "proxy_channel.hpp"
+#include "bench_counters.hpp"
+#include "bench_services.hpp"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QPointer>
+#include <QTemporaryDir>
+#include <cstdio>
+
+/**
+ * Resident memory of idle piped text channels. Opens --channels channels on a connection without
+ * memory budget and on one with --budget KiB for proxies and idle timeout of one second, nothing
+ * happens in the channels afterwards. RSS is read before the channels are opened, once they are
+ * open and after idle proxies of the second connection were reclaimed. Fake services live in the
+ * same process, their channels are counted in both connections alike. Needs session bus.
+ */
+
+namespace {
+
+    const uint IDLE_TIMEOUT = 1; // s
+
+    int aliveCount(const QList<QPointer<PipeProxyChannel>> &proxies) {
+        int alive = 0;
+        for(const QPointer<PipeProxyChannel> &proxy: proxies) if(proxy) ++alive;
+        return alive;
+    }
+
+    /**
+     * Opens idle channels and prints memory they hold, waits for reclamation if budget is set
+     * @return false if channels could not be opened
+     */
+    bool measure(const char *name, FakeServices &services, const PipeChain &pipes, int channels, uint budget) {
+
+        QString account = QString("idle%1").arg(budget);
+        Tp::ConnectionPtr pipedConnection = services.connectAccount(account, channels);
+        if(!pipedConnection) return false;
+        writePipedContacts(account, channels);
+        ConnectionAdditionalData additionalData = defaultConnectionData(account);
+        additionalData.channelMemoryBudget = budget;
+        additionalData.channelIdleTimeout = IDLE_TIMEOUT;
+        PipeConnectionPtr connection = createPipeConnection(pipedConnection, pipes, additionalData);
+        if(!connection || !waitForRoster(connection)) return false;
+
+        settle();
+        int64_t before = PipeBenchCounters::residentKilobytes();
+
+        QList<QPointer<PipeProxyChannel>> proxies;
+        for(int handle = 1; handle <= channels; ++handle) {
+            Tp::DBusError error;
+            // connection keeps the channel, only its proxy is watched
+            PipeProxyChannelPtr proxy = PipeProxyChannelPtr::dynamicCast(connection->openChannel(
+                        TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeContact, handle, connection->selfHandle(), false, &error));
+            if(error.isValid() || !proxy) {
+                std::fprintf(stderr, "Could not pipe channel: %s\n", qPrintable(error.message()));
+                return false;
+            }
+            proxies << QPointer<PipeProxyChannel>(proxy.data());
+        }
+        settle();
+        int64_t open = PipeBenchCounters::residentKilobytes();
+
+        if(budget > 0) {
+            // reclamation goes on while proxies exceed the budget, it ends when their number settles
+            waitFor([&proxies, channels]() { return aliveCount(proxies) < channels; });
+            int alive;
+            do {
+                alive = aliveCount(proxies);
+                settle(3 * IDLE_TIMEOUT * 1000);
+            } while(aliveCount(proxies) < alive);
+        }
+        int64_t after = PipeBenchCounters::residentKilobytes();
+
+        std::printf("%-12s %10d %10d %12lld %12lld %12lld %14.1f %14.1f\n", name, channels, aliveCount(proxies),
+                (long long) before, (long long) open, (long long) after,
+                double(open - before) / qMax(1, channels), double(after - before) / qMax(1, channels));
+
+        connection.reset();
+        settle();
+        return true;
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    registerBenchTypes();
+    int channels = intArgument(app.arguments(), "--channels", 1000);
+    uint budget = intArgument(app.arguments(), "--budget", 1024);
+
+    if(!QDBusConnection::sessionBus().isConnected()) {
+        std::fprintf(stderr, "No session bus\n");
+        return 1;
+    }
+
+    QTemporaryDir home;
+    qputenv("HOME", home.path().toLocal8Bit());
+
+    FakeServices services;
+    services.startServices();
+    PipeChain pipes { std::make_shared<Pipe>(FakeServices::pipeService(), FakeServices::pipePath(),
+            QDBusConnection::sessionBus()) };
+
+    std::printf("%-12s %10s %10s %12s %12s %12s %14s %14s\n", "Budget", "channels", "proxies", "before KiB",
+            "open KiB", "after KiB", "open KiB/chan", "after KiB/chan");
+    if(!measure("unlimited", services, pipes, channels, 0)) return 1;
+    if(!measure(qPrintable(QString("%1 KiB").arg(budget)), services, pipes, channels, qMax(1u, budget))) return 1;
+
+    services.stopServices();
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include "normalizer.hpp"
+#include "roster_index.hpp"
+#include "bench_counters.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QCoreApplication>
+#include <QStringList>
+#include <cstdio>
+#include <functional>
+
+/**
+ * Normalizes batches of 1k, 10k and 100k identifiers, half of them JIDs in mixed case and half
+ * phone numbers, all surrounded by white space. Compares normalizer::identifiers with trimming
+ * and lowering by Qt, and measures NORMALIZED lookup of PipeRosterIndex which normalizes the
+ * identifiers it did not find exactly. Use --max-size to limit batch size.
+ */
+
+namespace {
+
+    const int ROUNDS = 10;
+
+    QString idOf(uint i) {
+        return i % 2 ? QString("contact%1@example.com").arg(i) : QString("+44207946%1").arg(i, 6, 10, QChar('0'));
+    }
+
+    /**
+     * @return identifier as a client may write it
+     */
+    QString sloppyIdOf(uint i) {
+        QString id = idOf(i);
+        for(int c = 0; c < id.size(); c += 2) id[c] = id[c].toUpper();
+        return " " + id + "\t";
+    }
+
+    void measure(const char *name, int size, const std::function<void ()> &operation) {
+
+        PipeBenchCounters counters;
+        counters.start();
+        for(int round = 0; round < ROUNDS; ++round) operation();
+        counters.stop();
+
+        int identifiers = size * ROUNDS;
+        std::printf("%-24s %8d %12.1f %12.2f %16.0f\n", name, size, double(counters.nanoseconds()) / identifiers,
+                double(counters.allocations()) / identifiers,
+                identifiers * 1e9 / qMax<int64_t>(1, counters.nanoseconds()));
+    }
+
+    void run(int size) {
+
+        QStringList ids;
+        Tp::ContactAttributesMap attributes;
+        QSet<QString> piped;
+        for(int i = 1; i <= size; ++i) {
+            ids << sloppyIdOf(i);
+            QVariantMap attrs;
+            attrs[QString(TP_QT_IFACE_CONNECTION) + "/contact-id"] = idOf(i);
+            attributes[i] = attrs;
+            piped.insert(idOf(i));
+        }
+        PipeRosterIndex index;
+        index.setAttributes(attributes);
+        index.setPipedContacts(piped);
+
+        volatile int sink = 0;
+        measure("normalizer::identifiers", size, [&ids, &sink]() {
+                sink = normalizer::identifiers(ids).size();
+            });
+        measure("trimmed().toLower()", size, [&ids, &sink]() {
+                QStringList normalized;
+                normalized.reserve(ids.size());
+                for(const QString &id: ids) normalized.append(id.trimmed().toLower());
+                sink = normalized.size();
+            });
+        measure("getHandlesFor/norm", size, [&ids, &index, &sink]() {
+                sink = index.getHandlesFor(ids, RosterLookup::NORMALIZED).size();
+            });
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+
+    int maxSize = 100000;
+    QStringList args = app.arguments();
+    int sizeArg = args.indexOf("--max-size");
+    if(sizeArg >= 0 && sizeArg + 1 < args.size()) maxSize = args[sizeArg + 1].toInt();
+
+    std::printf("%-24s %8s %12s %12s %16s\n", "Benchmark", "Size", "ns/id", "allocs/id", "ids/s");
+    for(int size = 1000; size <= maxSize; size *= 10) run(size);
+    return 0;
+}
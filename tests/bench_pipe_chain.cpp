@@ -0,0 +1,279 @@
+#include "message_batcher.hpp"
+#include "pipe.hpp"
+#include "bench_counters.hpp"
+
+#include <TelepathyQt/Types>
+#include <QCoreApplication>
+#include <QDBusAbstractAdaptor>
+#include <QDBusConnection>
+#include <QDBusServer>
+#include <QDir>
+#include <QEventLoop>
+#include <QThread>
+#include <cstdio>
+#include <future>
+
+/**
+ * Measures latency of relaying received messages through pipes of a piped channel. Pass-through
+ * pipes only observe the channel, transforming pipes cost a TransformMessages round trip, which is
+ * the least a full proxy hop costs, plugins transform messages in process. Latency is also measured
+ * for chains of growing length. Transforming pipe reached over the bus is compared with the same pipe
+ * reached over a private peer connection, both by latency and throughput. Throughput of batched
+ * TransformMessages calls is measured for bursts of messages of different sizes. Latency and allocations
+ * per message are also measured for messages with 1 MB of content. Needs session bus.
+ */
+
+namespace {
+
+    const char PIPE_PATH[] = "/org/freedesktop/Telepathy/BenchPipe/";
+    const char PEER_PIPE_PATH[] = "/org/freedesktop/Telepathy/BenchPipe/peer";
+    const int MAX_CHAIN_LENGTH = 8;
+    const int CONTENT_SIZE = 256;
+    // 1 MB of content on the bus
+    const int LARGE_CONTENT_SIZE = 1024 * 1024;
+
+    Tp::MessagePartList textMessage(int contentSize = CONTENT_SIZE) {
+
+        Tp::MessagePart header;
+        header["message-token"] = QDBusVariant(QString("bench-token"));
+        header["message-type"] = QDBusVariant(uint(Tp::ChannelTextMessageTypeNormal));
+        Tp::MessagePart body;
+        body["content-type"] = QDBusVariant(QString("text/plain"));
+        body["content"] = QDBusVariant(QString(contentSize, QChar('x')));
+        return Tp::MessagePartList() << header << body;
+    }
+
+} /* anonymous namespace */
+
+/**
+ * Pipe returning messages untouched
+ */
+class BenchPipeAdaptor : public QDBusAbstractAdaptor {
+    Q_OBJECT;
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Telepathy.Pipe")
+    Q_PROPERTY(QString name READ name)
+    Q_PROPERTY(bool PassThrough READ passThrough)
+    Q_PROPERTY(bool TransformsMessages READ transformsMessages)
+    Q_PROPERTY(QString PeerAddress READ peerAddress)
+
+    public:
+        BenchPipeAdaptor(QObject *parent, bool observing, const QString &address = QString()) 
+            : QDBusAbstractAdaptor(parent), observing(observing), address(address) { }
+
+        QString name() const { return observing ? "observer" : "transformer"; }
+        bool passThrough() const { return observing; }
+        bool transformsMessages() const { return !observing; }
+        QString peerAddress() const { return address; }
+
+    public slots:
+        Tp::MessagePartListList TransformMessages(bool /* incoming */, const Tp::MessagePartListList &messages) {
+            return messages;
+        }
+
+    private:
+        bool observing;
+        QString address;
+};
+
+/**
+ * Serves bench pipes from its own thread and bus connection, so that blocking calls
+ * of the measured side do not block them. Pipe 0 is pass-through, others transform. Peer pipe
+ * is registered on the bus for its properties and transforms messages over peer connections.
+ */
+class BenchPipeService : public QThread {
+
+    public:
+        QString startService() {
+            std::future<QString> service = servicePromise.get_future();
+            QThread::start();
+            return service.get();
+        }
+
+    protected:
+        void run() override {
+            QDBusConnection bus = QDBusConnection::connectToBus(QDBusConnection::SessionBus, "pipes_bench_service");
+            QList<QObject*> objects;
+            for(int i = 0; i <= MAX_CHAIN_LENGTH; ++i) {
+                QObject *object = new QObject();
+                new BenchPipeAdaptor(object, i == 0);
+                bus.registerObject(PIPE_PATH + QString::number(i), object);
+                objects << object;
+            }
+
+            QDBusServer server("unix:tmpdir=" + QDir::tempPath());
+            QObject *peerObject = new QObject();
+            new BenchPipeAdaptor(peerObject, false, server.address());
+            bus.registerObject(PEER_PIPE_PATH, peerObject);
+            objects << peerObject;
+            QList<QDBusConnection> peers;
+            QObject::connect(&server, &QDBusServer::newConnection, [&peers, peerObject](const QDBusConnection &peer) {
+                    peers << peer;
+                    peers.last().registerObject(PEER_PIPE_PATH, peerObject);
+                });
+
+            servicePromise.set_value(bus.baseService());
+
+            exec();
+
+            for(const QDBusConnection &peer: peers) QDBusConnection::disconnectFromPeer(peer.name());
+            qDeleteAll(objects);
+            QDBusConnection::disconnectFromBus("pipes_bench_service");
+        }
+
+    private:
+        std::promise<QString> servicePromise;
+};
+
+class BenchPlugin : public PipePlugin {
+
+    public:
+        QString name() const override { return "plugin"; }
+        Tp::RequestableChannelClassList requestableChannelClasses() const override {
+            return Tp::RequestableChannelClassList();
+        }
+        void transformIncoming(Tp::MessagePartList &message) override {
+            message[0]["bench-plugin"] = QDBusVariant(true);
+        }
+        void transformOutgoing(Tp::MessagePartList &) override { }
+};
+
+namespace {
+
+    /**
+     * Builds relayed chain the way PipeConnection does, only plugins and transforming pipes get messages
+     */
+    PipeChain relayChain(const PipeChain &pipes) {
+        PipeChain transforms;
+        for(const PipePtr &pipe: pipes) {
+            if(pipe->transformsMessages()) transforms.push_back(pipe);
+        }
+        return transforms;
+    }
+
+    void measure(const char *name, const PipeChain &pipes, int messages, int contentSize = CONTENT_SIZE) {
+
+        QEventLoop loop;
+        PipeMessageBatcher batcher(relayChain(pipes), [&loop](const Tp::MessagePartList&) { loop.quit(); });
+        Tp::MessagePartList message = textMessage(contentSize);
+
+        PipeBenchCounters counters;
+        counters.start();
+        for(int i = 0; i < messages; ++i) {
+            batcher.add(message);
+            loop.exec();
+        }
+        counters.stop();
+
+        std::printf("%-28s %12.1f %12.2f\n", name, 
+                double(counters.nanoseconds()) / messages, double(counters.allocations()) / messages);
+    }
+
+    /**
+     * All messages are received at once, so they are relayed in batches
+     */
+    void measureThroughput(const char *name, const PipeChain &pipes, int messages) {
+
+        QEventLoop loop;
+        int relayed = 0;
+        PipeMessageBatcher batcher(relayChain(pipes), [&loop, &relayed, messages](const Tp::MessagePartList&) { 
+                if(++relayed == messages) loop.quit(); 
+            });
+        Tp::MessagePartList message = textMessage();
+
+        PipeBenchCounters counters;
+        counters.start();
+        for(int i = 0; i < messages; ++i) batcher.add(message);
+        loop.exec();
+        counters.stop();
+
+        std::printf("%-28s %12.0f\n", name, messages * 1e9 / qMax<int64_t>(1, counters.nanoseconds()));
+    }
+
+    /**
+     * Messages are received in bursts of given size, each burst is relayed before the next one comes
+     */
+    void measureBursts(const PipeChain &pipes, int burst, int messages) {
+
+        QEventLoop loop;
+        int relayed = 0;
+        PipeMessageBatcher batcher(relayChain(pipes), [&loop, &relayed, burst](const Tp::MessagePartList&) { 
+                if(++relayed % burst == 0) loop.quit(); 
+            });
+        Tp::MessagePartList message = textMessage();
+
+        int bursts = qMax(1, messages / burst);
+        PipeBenchCounters counters;
+        counters.start();
+        for(int b = 0; b < bursts; ++b) {
+            for(int i = 0; i < burst; ++i) batcher.add(message);
+            loop.exec();
+        }
+        counters.stop();
+
+        std::printf("%-28s %12.0f %12d\n", QString("burst/%1").arg(burst).toLatin1().constData(), 
+                bursts * burst * 1e9 / qMax<int64_t>(1, counters.nanoseconds()), batcher.batchSize());
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    Tp::registerTypes();
+
+    int messages = 2000;
+    QStringList args = app.arguments();
+    int messagesArg = args.indexOf("--messages");
+    if(messagesArg >= 0 && messagesArg + 1 < args.size()) messages = args[messagesArg + 1].toInt();
+
+    if(!QDBusConnection::sessionBus().isConnected()) {
+        std::fprintf(stderr, "No session bus\n");
+        return 1;
+    }
+
+    BenchPipeService pipeService;
+    QString service = pipeService.startService();
+    auto busPipe = [&service](int i) {
+        return std::make_shared<Pipe>(service, PIPE_PATH + QString::number(i), QDBusConnection::sessionBus());
+    };
+
+    BenchPlugin plugin;
+    PipePtr observer = busPipe(0);
+    PipePtr transformer = busPipe(1);
+    PipePtr peerTransformer = std::make_shared<Pipe>(service, PEER_PIPE_PATH, QDBusConnection::sessionBus());
+
+    std::printf("%-28s %12s %12s\n", "Relay", "ns/message", "allocs/message");
+    measure("direct", PipeChain(), messages);
+    measure("pass-through", PipeChain{observer}, messages);
+    measure("plugin", PipeChain{std::make_shared<Pipe>(&plugin)}, messages);
+    measure("transforming", PipeChain{transformer}, messages);
+
+    PipeChain chain;
+    for(int length = 1; length <= MAX_CHAIN_LENGTH; ++length) {
+        chain.push_back(length == 1 ? transformer : busPipe(length));
+        measure(QString("chain/%1").arg(length).toLatin1().constData(), chain, messages);
+    }
+    measure("transforming/peer", PipeChain{peerTransformer}, messages);
+    if(!peerTransformer->isPeerConnected()) std::printf("peer connection failed, bus was used\n");
+
+    // large messages are relayed one by one, each costs its copies and demarshalling
+    int largeMessages = qMax(1, messages / 20);
+    std::printf("\n%-28s %12s %12s\n", "Relay of 1 MB", "ns/message", "allocs/message");
+    measure("direct", PipeChain(), largeMessages, LARGE_CONTENT_SIZE);
+    measure("plugin", PipeChain{std::make_shared<Pipe>(&plugin)}, largeMessages, LARGE_CONTENT_SIZE);
+    measure("transforming", PipeChain{transformer}, largeMessages, LARGE_CONTENT_SIZE);
+    measure("transforming/peer", PipeChain{peerTransformer}, largeMessages, LARGE_CONTENT_SIZE);
+
+    std::printf("\n%-28s %12s\n", "Throughput", "messages/s");
+    measureThroughput("transforming/bus", PipeChain{transformer}, messages);
+    measureThroughput("transforming/peer", PipeChain{peerTransformer}, messages);
+
+    std::printf("\n%-28s %12s %12s\n", "Batching", "messages/s", "batch size");
+    for(int burst: {1, 8, 64, 512}) measureBursts(PipeChain{transformer}, burst, qMax(messages, burst));
+
+    pipeService.quit();
+    pipeService.wait();
+    return 0;
+}
+
+#include "bench_pipe_chain.moc"
@@ -0,0 +1,161 @@
+#include "pipe.hpp"
+#include "pipe_cache.hpp"
+#include "defines.hpp"
+#include "bench_counters.hpp"
+
+#include <TelepathyQt/Types>
+#include <QCoreApplication>
+#include <QDBusAbstractAdaptor>
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusReply>
+#include <QTemporaryDir>
+#include <QThread>
+#include <cstdio>
+#include <future>
+
+/**
+ * Compares cold start of the connection manager, which fetches properties of every installed pipe,
+ * with warm start, which loads them from capability cache. Pipes are served in process, so cold start
+ * does not include spawning of pipe services and the measured difference is the least cache saves.
+ * Needs session bus.
+ */
+
+namespace {
+
+    const int PIPE_COUNT = 20;
+
+    QString pipeService(int i) {
+        return QString(TP_QT_IFACE_PIPE ".bench%1").arg(i);
+    }
+
+    QString pipePath(int i) {
+        return "/" + pipeService(i).replace('.', '/');
+    }
+
+} /* anonymous namespace */
+
+class BenchStartupAdaptor : public QDBusAbstractAdaptor {
+    Q_OBJECT;
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Telepathy.Pipe")
+    Q_PROPERTY(QString name READ name)
+    Q_PROPERTY(bool PassThrough READ passThrough)
+    Q_PROPERTY(Tp::RequestableChannelClassList RequestableChannelClasses READ requestableChannelClasses)
+
+    public:
+        BenchStartupAdaptor(QObject *parent, int index) 
+            : QDBusAbstractAdaptor(parent), index(index) { }
+
+        QString name() const { return QString("bench%1").arg(index); }
+        bool passThrough() const { return true; }
+        Tp::RequestableChannelClassList requestableChannelClasses() const {
+            Tp::RequestableChannelClass textClass;
+            textClass.fixedProperties[QString(TP_QT_IFACE_CHANNEL) + ".ChannelType"] = TP_QT_IFACE_CHANNEL_TYPE_TEXT;
+            textClass.fixedProperties[QString(TP_QT_IFACE_CHANNEL) + ".TargetHandleType"] = uint(Tp::HandleTypeContact);
+            return Tp::RequestableChannelClassList() << textClass;
+        }
+
+    private:
+        int index;
+};
+
+/**
+ * Owns names of all bench pipes on its own bus connection and thread
+ */
+class BenchStartupService : public QThread {
+
+    public:
+        void startService() {
+            std::future<void> started = startedPromise.get_future();
+            QThread::start();
+            started.get();
+        }
+
+    protected:
+        void run() override {
+            QDBusConnection bus = QDBusConnection::connectToBus(QDBusConnection::SessionBus, "pipes_bench_startup");
+            QList<QObject*> objects;
+            for(int i = 0; i < PIPE_COUNT; ++i) {
+                QObject *object = new QObject();
+                new BenchStartupAdaptor(object, i);
+                bus.registerObject(pipePath(i), object);
+                bus.registerService(pipeService(i));
+                objects << object;
+            }
+            startedPromise.set_value();
+
+            exec();
+
+            qDeleteAll(objects);
+            QDBusConnection::disconnectFromBus("pipes_bench_startup");
+        }
+
+    private:
+        std::promise<void> startedPromise;
+};
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    Tp::registerTypes();
+    qDBusRegisterMetaType<Tp::RequestableChannelClassList>();
+
+    int rounds = 50;
+    QStringList args = app.arguments();
+    int roundsArg = args.indexOf("--rounds");
+    if(roundsArg >= 0 && roundsArg + 1 < args.size()) rounds = args[roundsArg + 1].toInt();
+
+    if(!QDBusConnection::sessionBus().isConnected()) {
+        std::fprintf(stderr, "No session bus\n");
+        return 1;
+    }
+
+    BenchStartupService service;
+    service.startService();
+
+    QTemporaryDir dir;
+    PipeCapabilityCache cache(dir.path() + "/pipes.cache");
+    QDBusConnection bus = QDBusConnection::sessionBus();
+
+    PipeBenchCounters cold;
+    cold.start();
+    for(int round = 0; round < rounds; ++round) {
+        std::vector<PipePtr> pipes;
+        for(int i = 0; i < PIPE_COUNT; ++i) {
+            QDBusReply<bool> isRegisteredRep = bus.interface()->isServiceRegistered(pipeService(i));
+            if(!isRegisteredRep.isValid() || !isRegisteredRep.value()) {
+                std::fprintf(stderr, "Pipe %s is not running\n", pipeService(i).toLatin1().constData());
+                return 1;
+            }
+            PipePtr pipe = std::make_shared<Pipe>(pipeService(i), pipePath(i), bus);
+            if(pipe->isActive()) cache.update(pipeService(i), pipe->properties());
+            pipes.push_back(pipe);
+        }
+        cache.save();
+    }
+    cold.stop();
+
+    PipeBenchCounters warm;
+    warm.start();
+    for(int round = 0; round < rounds; ++round) {
+        std::vector<PipePtr> pipes;
+        cache.load();
+        for(int i = 0; i < PIPE_COUNT; ++i) {
+            pipes.push_back(std::make_shared<Pipe>(pipeService(i), pipePath(i), bus, cache.properties(pipeService(i))));
+        }
+    }
+    warm.stop();
+
+    std::printf("%-28s %12s %12s\n", QString("Start, %1 pipes").arg(PIPE_COUNT).toLatin1().constData(), 
+            "us/start", "allocs/start");
+    std::printf("%-28s %12.1f %12.1f\n", "cold", cold.nanoseconds() / 1e3 / rounds, 
+            double(cold.allocations()) / rounds);
+    std::printf("%-28s %12.1f %12.1f\n", "warm", warm.nanoseconds() / 1e3 / rounds, 
+            double(warm.allocations()) / rounds);
+
+    service.quit();
+    service.wait();
+    return 0;
+}
+
+#include "bench_pipe_startup.moc"
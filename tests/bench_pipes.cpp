@@ -0,0 +1,228 @@
+#include "connection.hpp"
+#include "proxy_channel.hpp"
+#include "bench_counters.hpp"
+#include "bench_services.hpp"
+
+#include <TelepathyQt/Types>
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTemporaryDir>
+#include <cstdio>
+#include <vector>
+
+/**
+ * End-to-end benchmark of pipes connection against fake connection manager and fake pass-through
+ * pipe served in process on the bus. Measures connection creation, roster load, channel piping,
+ * relay throughput of received messages and presence fan-out. Results are printed as JSON.
+ * Allocations are counted in the whole process, so they include work of fake services. Needs session bus.
+ */
+
+namespace {
+
+    const uint CONNECTION_CONTACTS = 10;
+    const int MESSAGE_SIZE = 256;
+
+    QJsonObject perOperation(const PipeBenchCounters &counters, int operations) {
+        QJsonObject result;
+        result["operations"] = operations;
+        result["us"] = counters.nanoseconds() / 1e3 / qMax(1, operations);
+        result["allocations"] = double(counters.allocations()) / qMax(1, operations);
+        return result;
+    }
+
+    /**
+     * Requests and connects fake connection and creates pipes connection for it, roster is empty
+     */
+    QJsonObject measureConnection(FakeServices &services, const PipeChain &pipes, int rounds) {
+
+        std::vector<PipeConnectionPtr> connections;
+        PipeBenchCounters counters;
+        counters.start();
+        for(int round = 0; round < rounds; ++round) {
+            QString account = QString("connection%1").arg(round);
+            Tp::ConnectionPtr pipedConnection = services.connectAccount(account, CONNECTION_CONTACTS);
+            if(!pipedConnection) return QJsonObject();
+            connections.push_back(createPipeConnection(pipedConnection, pipes, defaultConnectionData(account)));
+        }
+        counters.stop();
+        return perOperation(counters, rounds);
+    }
+
+    /**
+     * Creates pipes connection for connection with roster of given size, until its contact list is loaded
+     */
+    QJsonArray measureRoster(FakeServices &services, const PipeChain &pipes, int maxContacts) {
+
+        QJsonArray results;
+        for(int contacts = 100; contacts <= maxContacts; contacts *= 10) {
+            QString account = QString("roster%1").arg(contacts);
+            Tp::ConnectionPtr pipedConnection = services.connectAccount(account, contacts);
+            if(!pipedConnection) break;
+            writePipedContacts(account, contacts);
+
+            PipeBenchCounters counters;
+            counters.start();
+            PipeConnectionPtr connection = createPipeConnection(pipedConnection, pipes, defaultConnectionData(account));
+            bool loaded = connection && waitForRoster(connection);
+            counters.stop();
+            if(!loaded) {
+                std::fprintf(stderr, "Roster of %d contacts was not loaded\n", contacts);
+                break;
+            }
+
+            QJsonObject result;
+            result["contacts"] = contacts;
+            result["ms"] = counters.nanoseconds() / 1e6;
+            result["allocations"] = double(counters.allocations());
+            results.append(result);
+        }
+        return results;
+    }
+
+    QJsonObject measurePiping(const PipeConnectionPtr &connection, int channels,
+            std::vector<Tp::BaseChannelPtr> &piped)
+    {
+        PipeBenchCounters counters;
+        counters.start();
+        for(int handle = 1; handle <= channels; ++handle) {
+            Tp::DBusError error;
+            Tp::BaseChannelPtr channel = connection->openChannel(TP_QT_IFACE_CHANNEL_TYPE_TEXT,
+                    Tp::HandleTypeContact, handle, connection->selfHandle(), false, &error);
+            if(error.isValid()) {
+                std::fprintf(stderr, "Could not pipe channel: %s\n", error.message().toLocal8Bit().constData());
+                return QJsonObject();
+            }
+            piped.push_back(channel);
+        }
+        counters.stop();
+        return perOperation(counters, channels);
+    }
+
+    /**
+     * Fake channel receives all messages at once, they are counted when proxy relays them
+     */
+    QJsonObject measureRelay(FakeServices &services, const PipeConnectionPtr &connection,
+            const Tp::BaseChannelPtr &channel, int messages)
+    {
+        Tp::BaseChannelTextTypePtr textType = Tp::BaseChannelTextTypePtr::dynamicCast(
+                channel->interface(TP_QT_IFACE_CHANNEL_TYPE_TEXT));
+        PipeProxyChannelPtr proxy = PipeProxyChannelPtr::dynamicCast(channel);
+        if(!textType || !proxy) return QJsonObject();
+
+        QString connectionPath = connection->getPipedConnection()->objectPath();
+        QString channelPath = proxy->getPipedChannel()->objectPath();
+        int relayed = 0;
+        QMetaObject::Connection counting = QObject::connect(textType.data(), &Tp::BaseChannelTextType::messageReceived,
+                [&relayed](const Tp::MessagePartList&) { ++relayed; });
+        settle();
+
+        PipeBenchCounters counters;
+        counters.start();
+        services.invoke([&services, &connectionPath, &channelPath, messages]() {
+                FakeConnectionPtr fakeConnection = services.connection(connectionPath);
+                FakeChannelPtr fakeChannel = fakeConnection ? fakeConnection->channel(channelPath) : FakeChannelPtr();
+                if(fakeChannel) fakeChannel->receiveMessages(messages, MESSAGE_SIZE);
+            });
+        bool finished = waitFor([&relayed, messages]() { return relayed >= messages; });
+        counters.stop();
+        QObject::disconnect(counting);
+        if(!finished) return QJsonObject();
+
+        QJsonObject result = perOperation(counters, messages);
+        result["messages_per_s"] = messages * 1e9 / qMax<int64_t>(1, counters.nanoseconds());
+        return result;
+    }
+
+    /**
+     * Presences of all contacts change at once, until pipes connection announces all of them
+     */
+    QJsonObject measurePresence(FakeServices &services, const PipeConnectionPtr &connection, int contacts, int rounds) {
+
+        PresenceCounter counter(connection);
+        // initial presences are fetched when contacts start being piped
+        settle();
+
+        QString connectionPath = connection->getPipedConnection()->objectPath();
+        PipeBenchCounters counters;
+        int64_t nanoseconds = 0;
+        uint64_t allocations = 0;
+        for(int round = 0; round < rounds; ++round) {
+            Tp::SimplePresence presence;
+            presence.type = round % 2 ? Tp::ConnectionPresenceTypeAvailable : Tp::ConnectionPresenceTypeAway;
+            presence.status = round % 2 ? "available" : "away";
+            Tp::SimpleContactPresences presences;
+            for(int handle = 1; handle <= contacts; ++handle) presences[handle] = presence;
+
+            counter.received = 0;
+            counters.start();
+            services.invoke([&services, &connectionPath, &presences]() {
+                    FakeConnectionPtr fakeConnection = services.connection(connectionPath);
+                    if(fakeConnection) fakeConnection->setPresences(presences);
+                });
+            bool finished = waitFor([&counter, contacts]() { return counter.received >= contacts; });
+            counters.stop();
+            if(!finished) return QJsonObject();
+            nanoseconds += counters.nanoseconds();
+            allocations += counters.allocations();
+        }
+
+        QJsonObject result;
+        result["contacts"] = contacts;
+        result["rounds"] = rounds;
+        result["ms"] = nanoseconds / 1e6 / qMax(1, rounds);
+        result["allocations"] = double(allocations) / qMax(1, rounds);
+        return result;
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    registerBenchTypes();
+
+    QStringList args = app.arguments();
+    int maxContacts = intArgument(args, "--contacts", 10000);
+    int channels = intArgument(args, "--channels", 100);
+    int messages = intArgument(args, "--messages", 2000);
+    int rounds = intArgument(args, "--rounds", 10);
+
+    if(!QDBusConnection::sessionBus().isConnected()) {
+        std::fprintf(stderr, "No session bus\n");
+        return 1;
+    }
+
+    // contact lists and snapshots of measured connections must not be reused between runs
+    QTemporaryDir home;
+    qputenv("HOME", home.path().toLocal8Bit());
+
+    FakeServices services;
+    services.startServices();
+    PipeChain pipes { std::make_shared<Pipe>(FakeServices::pipeService(), FakeServices::pipePath(),
+            QDBusConnection::sessionBus()) };
+
+    QJsonObject results;
+    results["connection"] = measureConnection(services, pipes, rounds);
+    results["roster"] = measureRoster(services, pipes, maxContacts);
+
+    int contacts = qMax(channels, qMin(maxContacts, 1000));
+    PipeConnectionPtr connection = pipeAccount(services, pipes, "relay", contacts);
+    if(!connection) {
+        std::fprintf(stderr, "Could not pipe connection\n");
+        return 1;
+    }
+    std::vector<Tp::BaseChannelPtr> piped;
+    results["piping"] = measurePiping(connection, channels, piped);
+    if(!piped.empty()) results["relay"] = measureRelay(services, connection, piped.front(), messages);
+    results["presence"] = measurePresence(services, connection, contacts, rounds);
+
+    std::printf("%s", QJsonDocument(results).toJson().constData());
+
+    piped.clear();
+    connection.reset();
+    services.stopServices();
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "connection.hpp"
+#include "bench_counters.hpp"
+#include "bench_services.hpp"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QTemporaryDir>
+#include <cstdio>
+
+/**
+ * Presence traffic of a piped roster. Measures initial sync, which announces presences of all
+ * contacts once they start being piped, updates changing presences of all contacts and updates
+ * repeating presences contacts already have, which should not be announced at all. Each round of
+ * repeated presences ends with a change of one contact, so its announcement marks the end of round.
+ * Use --contacts and --rounds to set the size of traffic. Needs session bus.
+ */
+
+namespace {
+
+    Tp::SimpleContactPresences presencesOf(int contacts, Tp::ConnectionPresenceType type, const QString &status) {
+        Tp::SimplePresence presence;
+        presence.type = type;
+        presence.status = status;
+        Tp::SimpleContactPresences presences;
+        for(int handle = 1; handle <= contacts; ++handle) presences[handle] = presence;
+        return presences;
+    }
+
+    void setFakePresences(FakeServices &services, const QString &connectionPath, const Tp::SimpleContactPresences &presences) {
+        services.invoke([&services, &connectionPath, &presences]() {
+                FakeConnectionPtr fakeConnection = services.connection(connectionPath);
+                if(fakeConnection) fakeConnection->setPresences(presences);
+            });
+    }
+
+    void printResult(const char *name, const PipeBenchCounters &counters, int updates, int announced) {
+        std::printf("%-20s %12d %12d %12.2f %14.0f\n", name, updates, announced, counters.nanoseconds() / 1e6,
+                updates * 1e9 / qMax<int64_t>(1, counters.nanoseconds()));
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    registerBenchTypes();
+    int contacts = intArgument(app.arguments(), "--contacts", 10000);
+    int rounds = intArgument(app.arguments(), "--rounds", 10);
+
+    if(!QDBusConnection::sessionBus().isConnected()) {
+        std::fprintf(stderr, "No session bus\n");
+        return 1;
+    }
+
+    QTemporaryDir home;
+    qputenv("HOME", home.path().toLocal8Bit());
+
+    FakeServices services;
+    services.startServices();
+    PipeChain pipes { std::make_shared<Pipe>(FakeServices::pipeService(), FakeServices::pipePath(),
+            QDBusConnection::sessionBus()) };
+
+    QString account = "presence";
+    Tp::ConnectionPtr pipedConnection = services.connectAccount(account, contacts);
+    if(!pipedConnection) return 1;
+    writePipedContacts(account, contacts);
+    QString connectionPath = pipedConnection->objectPath();
+
+    std::printf("%-20s %12s %12s %12s %14s\n", "Traffic", "updates", "announced", "ms", "updates/s");
+
+    // contacts start offline, all of them are announced when the roster is piped
+    PipeBenchCounters counters;
+    counters.start();
+    PipeConnectionPtr connection = createPipeConnection(pipedConnection, pipes, defaultConnectionData(account));
+    if(!connection) return 1;
+    PresenceCounter counter(connection);
+    bool synced = waitForRoster(connection) && waitFor([&counter, contacts]() { return counter.received >= contacts; });
+    counters.stop();
+    if(!synced) {
+        std::fprintf(stderr, "Initial presences were not announced\n");
+        return 1;
+    }
+    printResult("initial sync", counters, contacts, counter.received);
+
+    Tp::SimpleContactPresences away = presencesOf(contacts, Tp::ConnectionPresenceTypeAway, "away");
+    Tp::SimpleContactPresences available = presencesOf(contacts, Tp::ConnectionPresenceTypeAvailable, "available");
+
+    int64_t nanoseconds = 0;
+    counter.received = 0;
+    for(int round = 0; round < rounds; ++round) {
+        int expected = counter.received + contacts;
+        counters.start();
+        setFakePresences(services, connectionPath, round % 2 ? available : away);
+        bool finished = waitFor([&counter, expected]() { return counter.received >= expected; });
+        counters.stop();
+        if(!finished) {
+            std::fprintf(stderr, "Changed presences were not announced\n");
+            return 1;
+        }
+        nanoseconds += counters.nanoseconds();
+    }
+    std::printf("%-20s %12d %12d %12.2f %14.0f\n", "changes", contacts * rounds, counter.received,
+            nanoseconds / 1e6, contacts * rounds * 1e9 / qMax<int64_t>(1, nanoseconds));
+
+    // presences of the last round are repeated, marker alternates presence of the first contact
+    Tp::SimpleContactPresences repeated = rounds % 2 ? away : available;
+    Tp::SimpleContactPresences marker;
+    nanoseconds = 0;
+    counter.received = 0;
+    for(int round = 0; round < rounds; ++round) {
+        marker[1] = (round % 2 ? repeated : (rounds % 2 ? available : away)).value(1);
+        int expected = counter.received + 1;
+        counters.start();
+        setFakePresences(services, connectionPath, repeated);
+        setFakePresences(services, connectionPath, marker);
+        bool finished = waitFor([&counter, expected]() { return counter.received >= expected; });
+        counters.stop();
+        if(!finished) {
+            std::fprintf(stderr, "Marker presence was not announced\n");
+            return 1;
+        }
+        nanoseconds += counters.nanoseconds();
+    }
+    // a well suppressing cache announces only markers
+    std::printf("%-20s %12d %12d %12.2f %14.0f\n", "repeated", (contacts + 1) * rounds, counter.received,
+            nanoseconds / 1e6, (contacts + 1) * rounds * 1e9 / qMax<int64_t>(1, nanoseconds));
+
+    connection.reset();
+    services.stopServices();
+    return 0;
+}
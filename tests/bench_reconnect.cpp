@@ -0,0 +1,111 @@
+#include "connection.hpp"
+#include "bench_counters.hpp"
+#include "bench_services.hpp"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QTemporaryDir>
+#include <cstdio>
+
+/**
+ * Resync of a large piped roster after piped connection downloaded its contact list again, as it
+ * does after reconnect. The last contact is dropped from the reloaded list, so the resync has to
+ * announce exactly one removal and its ContactsChangedWithID marks the end of measurement. Any
+ * other change or signal means clients got more than the minimal delta. Use --contacts and
+ * --rounds to set size of roster and number of reloads. Needs session bus.
+ */
+
+namespace {
+
+    /**
+     * Counts contact list changes announced by pipes connection on D-Bus
+     */
+    class RosterChangeCounter : public QObject {
+
+        Q_OBJECT;
+
+        public:
+            explicit RosterChangeCounter(const PipeConnectionPtr &connection) {
+                QDBusConnection::sessionBus().connect(connection->busName(), connection->objectPath(),
+                        TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST, "ContactsChangedWithID",
+                        this, SLOT(contactsChangedWithID(Tp::ContactSubscriptionMap, Tp::HandleIdentifierMap,
+                                Tp::HandleIdentifierMap)));
+            }
+
+        public slots:
+            void contactsChangedWithID(const Tp::ContactSubscriptionMap &changes,
+                    const Tp::HandleIdentifierMap & /* identifiers */, const Tp::HandleIdentifierMap &removals)
+            {
+                ++announcements;
+                this->changes += changes.size();
+                this->removals += removals.size();
+            }
+
+        public:
+            int announcements = 0;
+            int changes = 0;
+            int removals = 0;
+    };
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    registerBenchTypes();
+    int contacts = intArgument(app.arguments(), "--contacts", 20000);
+    int rounds = intArgument(app.arguments(), "--rounds", 5);
+
+    if(!QDBusConnection::sessionBus().isConnected()) {
+        std::fprintf(stderr, "No session bus\n");
+        return 1;
+    }
+
+    QTemporaryDir home;
+    qputenv("HOME", home.path().toLocal8Bit());
+
+    FakeServices services;
+    services.startServices();
+    PipeChain pipes { std::make_shared<Pipe>(FakeServices::pipeService(), FakeServices::pipePath(),
+            QDBusConnection::sessionBus()) };
+
+    PipeConnectionPtr connection = pipeAccount(services, pipes, "reconnect", contacts);
+    if(!connection) {
+        std::fprintf(stderr, "Roster of %d contacts was not loaded\n", contacts);
+        return 1;
+    }
+    QString connectionPath = connection->getPipedConnection()->objectPath();
+    RosterChangeCounter counter(connection);
+    settle();
+
+    std::printf("%-10s %10s %10s %10s %10s %12s %14s\n", "Round", "contacts", "signals", "changes", "removals",
+            "ms", "allocations");
+    for(int round = 1; round <= rounds && round < contacts; ++round) {
+        uint reloaded = contacts - round;
+        int announcements = counter.announcements, changes = counter.changes, removals = counter.removals;
+
+        PipeBenchCounters counters;
+        counters.start();
+        services.invoke([&services, &connectionPath, reloaded]() {
+                FakeConnectionPtr fakeConnection = services.connection(connectionPath);
+                if(fakeConnection) fakeConnection->reloadContactList(reloaded);
+            });
+        bool resynced = waitFor([&counter, removals]() { return counter.removals > removals; });
+        counters.stop();
+        if(!resynced) {
+            std::fprintf(stderr, "Roster was not resynced\n");
+            return 1;
+        }
+        // late signals would be counted in the next round, they are given a moment to arrive
+        settle();
+        std::printf("%-10d %10u %10d %10d %10d %12.2f %14llu\n", round, reloaded, counter.announcements - announcements,
+                counter.changes - changes, counter.removals - removals, counters.nanoseconds() / 1e6,
+                (unsigned long long) counters.allocations());
+    }
+
+    connection.reset();
+    services.stopServices();
+    return 0;
+}
+
+#include "bench_reconnect.moc"
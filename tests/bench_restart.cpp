@@ -0,0 +1,78 @@
+#include "connection.hpp"
+#include "bench_counters.hpp"
+#include "bench_services.hpp"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QTemporaryDir>
+#include <cstdio>
+
+/**
+ * Measures restart-to-ready time of pipes connection, from its creation until its contact list is
+ * announced as loaded. Cold start downloads the roster of fake connection, warm start is a restart
+ * with the roster snapshot written by the previous connection. Rosters grow from 100 contacts up to
+ * --contacts. Needs session bus.
+ */
+
+namespace {
+
+    /**
+     * @return ms until roster of new pipes connection is loaded, negative if it was not
+     */
+    double timeToReady(const Tp::ConnectionPtr &pipedConnection, const PipeChain &pipes, const QString &account,
+            uint64_t &allocations)
+    {
+        PipeBenchCounters counters;
+        counters.start();
+        PipeConnectionPtr connection = createPipeConnection(pipedConnection, pipes, defaultConnectionData(account));
+        bool loaded = connection && waitForRoster(connection);
+        counters.stop();
+        allocations = counters.allocations();
+        // snapshot is written when the connection goes away
+        connection.reset();
+        return loaded ? counters.nanoseconds() / 1e6 : -1;
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    registerBenchTypes();
+    int maxContacts = intArgument(app.arguments(), "--contacts", 100000);
+
+    if(!QDBusConnection::sessionBus().isConnected()) {
+        std::fprintf(stderr, "No session bus\n");
+        return 1;
+    }
+
+    // snapshots must not be reused between runs
+    QTemporaryDir home;
+    qputenv("HOME", home.path().toLocal8Bit());
+
+    FakeServices services;
+    services.startServices();
+    PipeChain pipes { std::make_shared<Pipe>(FakeServices::pipeService(), FakeServices::pipePath(),
+            QDBusConnection::sessionBus()) };
+
+    std::printf("%-12s %12s %12s %14s %14s\n", "Contacts", "cold ms", "warm ms", "cold allocs", "warm allocs");
+    for(int contacts = 100; contacts <= maxContacts; contacts *= 10) {
+        QString account = QString("restart%1").arg(contacts);
+        Tp::ConnectionPtr pipedConnection = services.connectAccount(account, contacts);
+        if(!pipedConnection) return 1;
+        writePipedContacts(account, contacts);
+
+        uint64_t coldAllocations = 0, warmAllocations = 0;
+        double cold = timeToReady(pipedConnection, pipes, account, coldAllocations);
+        double warm = timeToReady(pipedConnection, pipes, account, warmAllocations);
+        if(cold < 0 || warm < 0) {
+            std::fprintf(stderr, "Roster of %d contacts was not loaded\n", contacts);
+            return 1;
+        }
+        std::printf("%-12d %12.2f %12.2f %14llu %14llu\n", contacts, cold, warm,
+                (unsigned long long) coldAllocations, (unsigned long long) warmAllocations);
+    }
+
+    services.stopServices();
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include "roster_index.hpp"
+#include "bench_counters.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QCoreApplication>
+#include <QStringList>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+/**
+ * Runs operations of PipeRosterIndex on synthetic rosters from 100 to 1M contacts and prints
+ * time, allocations and cache misses per operation. Use --max-size to limit roster size.
+ */
+
+namespace {
+
+    const int BATCH_SIZE = 64;
+    const int BATCHES = 64;
+
+    QString idOf(uint handle) {
+        return QString("contact%1@example.com").arg(handle);
+    }
+
+    Tp::ContactAttributesMap syntheticRoster(uint size) {
+
+        Tp::ContactAttributesMap attributes;
+        for(uint handle = 1; handle <= size; ++handle) {
+            QVariantMap attrs;
+            attrs[QString(TP_QT_IFACE_CONNECTION) + "/contact-id"] = idOf(handle);
+            attrs[QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/subscribe"] = 
+                uint(Tp::SubscriptionStateYes);
+            attrs[QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/publish"] = 
+                uint(Tp::SubscriptionStateYes);
+            attributes[handle] = attrs;
+        }
+        return attributes;
+    }
+
+    /**
+     * Batches of random handles, handles within one batch are distinct
+     */
+    QList<Tp::UIntList> randomBatches(uint size, std::mt19937 &random) {
+
+        std::vector<uint> handles(size);
+        for(uint i = 0; i < size; ++i) handles[i] = i + 1;
+        std::shuffle(handles.begin(), handles.end(), random);
+
+        QList<Tp::UIntList> batches;
+        uint next = 0;
+        for(int b = 0; b < BATCHES; ++b) {
+            Tp::UIntList batch;
+            for(int i = 0; i < BATCH_SIZE; ++i) batch << handles[next++ % size];
+            batches << batch;
+        }
+        return batches;
+    }
+
+    QStringList identifiersOf(const Tp::UIntList &handles) {
+        QStringList ids;
+        for(uint h: handles) ids << idOf(h);
+        return ids;
+    }
+
+    void report(const char *name, uint size, PipeBenchCounters &counters, int operations) {
+
+        long long misses = counters.cacheMisses();
+        std::printf("%-24s %8u %12.1f %12.2f ", name, size,
+                double(counters.nanoseconds()) / operations, double(counters.allocations()) / operations);
+        if(misses < 0) std::printf("%16s\n", "n/a");
+        else std::printf("%16.2f\n", double(misses) / operations);
+    }
+
+    void measure(const char *name, uint size, const QList<Tp::UIntList> &batches,
+            const std::function<void(const Tp::UIntList&)> &operation)
+    {
+        PipeBenchCounters counters;
+        counters.start();
+        for(const Tp::UIntList &batch: batches) operation(batch);
+        counters.stop();
+        report(name, size, counters, batches.size() * BATCH_SIZE);
+    }
+
+    void run(uint size) {
+
+        std::mt19937 random(size);
+        PipeRosterIndex index;
+        index.setAttributes(syntheticRoster(size));
+        QList<Tp::UIntList> batches = randomBatches(size, random);
+        QList<QStringList> idBatches;
+        QList<QStringList> upperIdBatches;
+        for(const Tp::UIntList &batch: batches) {
+            idBatches << identifiersOf(batch);
+            upperIdBatches << QStringList();
+            for(const QString &id: idBatches.last()) upperIdBatches.last() << id.toUpper();
+        }
+
+        int next = 0;
+        measure("getHandlesFor", size, batches, [&](const Tp::UIntList&) {
+            index.getHandlesFor(idBatches[next++ % idBatches.size()]);
+        });
+
+        next = 0;
+        measure("getHandlesFor/norm", size, batches, [&](const Tp::UIntList&) {
+            index.getHandlesFor(upperIdBatches[next++ % upperIdBatches.size()], RosterLookup::NORMALIZED);
+        });
+
+        measure("getIdentifiersFor", size, batches, [&](const Tp::UIntList &batch) {
+            index.getIdentifiersFor(batch);
+        });
+
+        measure("addToList", size, batches, [&](const Tp::UIntList &batch) {
+            index.addToList(batch);
+        });
+
+        volatile bool found = false;
+        measure("hasHandle", size, batches, [&](const Tp::UIntList &batch) {
+            for(uint h: batch) found = index.hasHandle(h);
+        });
+
+        measure("contactsChangedWithId", size, batches, [&](const Tp::UIntList &batch) {
+            Tp::ContactSubscriptionMap changes;
+            Tp::HandleIdentifierMap identifiers;
+            for(uint h: batch) {
+                Tp::ContactSubscriptions subs;
+                subs.subscribe = Tp::SubscriptionStateYes;
+                subs.publish = Tp::SubscriptionStateAsk;
+                changes[h] = subs;
+                identifiers[h] = idOf(h);
+            }
+            index.applyChanges(changes, identifiers, Tp::HandleIdentifierMap());
+        });
+
+        measure("remove", size, batches, [&](const Tp::UIntList &batch) {
+            Tp::UIntList pipedBatch;
+            for(uint h: batch) if(index.hasHandle(h)) pipedBatch << h;
+            index.remove(pipedBatch);
+        });
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+
+    uint maxSize = 1000000;
+    QStringList args = app.arguments();
+    int sizeArg = args.indexOf("--max-size");
+    if(sizeArg >= 0 && sizeArg + 1 < args.size()) maxSize = args[sizeArg + 1].toUInt();
+
+    std::printf("%-24s %8s %12s %12s %16s\n", "Benchmark", "Size", "ns/op", "allocs/op", "cache-misses/op");
+    for(uint size = 100; size <= maxSize; size *= 10) run(size);
+    return 0;
+}
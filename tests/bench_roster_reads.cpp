@@ -0,0 +1,188 @@
+#include "roster_index.hpp"
+#include "bench_counters.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QCoreApplication>
+#include <QStringList>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Read scaling of roster published as immutable snapshots, the way PipeContactList publishes it,
+ * against the same roster guarded by a mutex. Reader threads look contacts up by handle and by
+ * identifier while one writer publishes a changed roster every --write-interval ms. Prints lookups
+ * per second for 1 up to --max-threads readers. Use --contacts to set size of roster and
+ * --milliseconds to set duration of each run.
+ */
+
+namespace {
+
+    const int LOOKUPS_PER_READ = 16;
+
+    QString idOf(uint handle) {
+        return QString("contact%1@example.com").arg(handle);
+    }
+
+    Tp::ContactAttributesMap syntheticRoster(uint size) {
+
+        Tp::ContactAttributesMap attributes;
+        for(uint handle = 1; handle <= size; ++handle) {
+            QVariantMap attrs;
+            attrs[QString(TP_QT_IFACE_CONNECTION) + "/contact-id"] = idOf(handle);
+            attrs[QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/subscribe"] =
+                uint(Tp::SubscriptionStateYes);
+            attrs[QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/publish"] =
+                uint(Tp::SubscriptionStateYes);
+            attributes[handle] = attrs;
+        }
+        return attributes;
+    }
+
+    /**
+     * Roster published as snapshots, readers only load the current one
+     */
+    class SnapshotRoster {
+
+        public:
+            explicit SnapshotRoster(const PipeRosterIndex &roster) : index(std::make_shared<PipeRosterIndex>(roster)) { }
+
+            template<typename Read> void read(const Read &read) const {
+                PipeRosterSnapshot current = std::atomic_load(&index);
+                read(*current);
+            }
+
+            template<typename Modify> void modify(const Modify &modify) {
+                std::shared_ptr<PipeRosterIndex> next = std::make_shared<PipeRosterIndex>(*std::atomic_load(&index));
+                modify(*next);
+                std::atomic_store(&index, PipeRosterSnapshot(std::move(next)));
+            }
+
+        private:
+            PipeRosterSnapshot index;
+    };
+
+    /**
+     * Roster modified in place, readers and writer take the same lock
+     */
+    class LockedRoster {
+
+        public:
+            explicit LockedRoster(const PipeRosterIndex &roster) : index(roster) { }
+
+            template<typename Read> void read(const Read &read) const {
+                std::lock_guard<std::mutex> guard(lock);
+                read(index);
+            }
+
+            template<typename Modify> void modify(const Modify &modify) {
+                std::lock_guard<std::mutex> guard(lock);
+                modify(index);
+            }
+
+        private:
+            mutable std::mutex lock;
+            PipeRosterIndex index;
+    };
+
+    /**
+     * Runs readers and one writer on roster for given time
+     * @return lookups per second of all readers
+     */
+    template<typename Roster> double measure(Roster &roster, int threads, uint contacts,
+            const std::vector<QString> &identifiers, int milliseconds, int writeInterval)
+    {
+        std::atomic<bool> running(true);
+        std::vector<uint64_t> lookups(threads, 0);
+        std::vector<std::thread> readers;
+
+        PipeBenchCounters counters;
+        counters.start();
+        for(int t = 0; t < threads; ++t) {
+            readers.emplace_back([&roster, &running, &lookups, &identifiers, contacts, t]() {
+                    uint next = t * 7919u;
+                    uint64_t done = 0;
+                    volatile bool found = false;
+                    while(running.load(std::memory_order_relaxed)) {
+                        roster.read([&next, &identifiers, &found, contacts](const PipeRosterIndex &index) {
+                                for(int i = 0; i < LOOKUPS_PER_READ; ++i, ++next) {
+                                    uint handle = next % contacts + 1;
+                                    found = index.hasHandle(handle) && index.hasIdentifier(identifiers[handle - 1]);
+                                }
+                            });
+                        done += LOOKUPS_PER_READ;
+                    }
+                    lookups[t] = done;
+                });
+        }
+
+        std::thread writer([&roster, &running, contacts, writeInterval]() {
+                uint next = 0;
+                while(running.load(std::memory_order_relaxed)) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(writeInterval));
+                    uint handle = next++ % contacts + 1;
+                    roster.modify([handle](PipeRosterIndex &index) {
+                            Tp::ContactSubscriptions subs;
+                            subs.subscribe = Tp::SubscriptionStateYes;
+                            subs.publish = handle % 2 ? Tp::SubscriptionStateAsk : Tp::SubscriptionStateYes;
+                            Tp::ContactSubscriptionMap changes;
+                            changes[handle] = subs;
+                            Tp::HandleIdentifierMap identifiers;
+                            identifiers[handle] = idOf(handle);
+                            index.applyChanges(changes, identifiers, Tp::HandleIdentifierMap());
+                        });
+                }
+            });
+
+        std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+        running = false;
+        for(std::thread &reader: readers) reader.join();
+        writer.join();
+        counters.stop();
+
+        uint64_t total = 0;
+        for(uint64_t done: lookups) total += done;
+        return total * 1e9 / std::max<int64_t>(1, counters.nanoseconds());
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    auto intArgument = [&args](const QString &name, int defaultValue) {
+            int index = args.indexOf(name);
+            return index >= 0 && index + 1 < args.size() ? args[index + 1].toInt() : defaultValue;
+        };
+    uint contacts = qMax(1, intArgument("--contacts", 10000));
+    int maxThreads = intArgument("--max-threads", qMax(1, int(std::thread::hardware_concurrency())));
+    int milliseconds = intArgument("--milliseconds", 1000);
+    int writeInterval = intArgument("--write-interval", 10);
+
+    PipeRosterIndex roster;
+    roster.setAttributes(syntheticRoster(contacts));
+    QSet<QString> piped;
+    std::vector<QString> identifiers;
+    for(uint handle = 1; handle <= contacts; ++handle) {
+        identifiers.push_back(idOf(handle));
+        piped.insert(identifiers.back());
+    }
+    roster.setPipedContacts(piped);
+
+    SnapshotRoster snapshots(roster);
+    LockedRoster locked(roster);
+
+    std::printf("%-10s %18s %18s %10s\n", "Readers", "snapshot lookups/s", "mutex lookups/s", "speedup");
+    for(int threads = 1; threads <= maxThreads; threads *= 2) {
+        double snapshotRate = measure(snapshots, threads, contacts, identifiers, milliseconds, writeInterval);
+        double lockedRate = measure(locked, threads, contacts, identifiers, milliseconds, writeInterval);
+        std::printf("%-10d %18.0f %18.0f %10.2f\n", threads, snapshotRate, lockedRate, snapshotRate / qMax(lockedRate, 1.0));
+    }
+    return 0;
+}
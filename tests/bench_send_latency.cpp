@@ -0,0 +1,186 @@
+#include "connection.hpp"
+#include "bench_counters.hpp"
+#include "bench_services.hpp"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusObjectPath>
+#include <QDBusPendingCallWatcher>
+#include <QTemporaryDir>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+/**
+ * Latency of messages sent by a user on one channel while a bot floods another channel of the same
+ * connection through Messages interface of pipes connection. Measured with no flood, with the default
+ * send scheduler, which caps rate of bulk channels, and with scheduler giving both channels the same
+ * weight without cap. Use --messages to set number of interactive messages of each run. Needs session bus.
+ */
+
+namespace {
+
+    const uint CONTACTS = 2;
+    const uint BULK_CONTACT = 1;
+    const uint INTERACTIVE_CONTACT = 2;
+    // SendMessage calls of the bot waiting for reply at any time
+    const int BULK_IN_FLIGHT = 32;
+    // a user typing, the channel stays interactive
+    const int INTERACTIVE_INTERVAL = 700; // ms
+
+    QVariantMap textChannelRequest(uint handle) {
+        QVariantMap request;
+        request[TP_QT_IFACE_CHANNEL + QString(".ChannelType")] = TP_QT_IFACE_CHANNEL_TYPE_TEXT;
+        request[TP_QT_IFACE_CHANNEL + QString(".TargetHandleType")] = uint(Tp::HandleTypeContact);
+        request[TP_QT_IFACE_CHANNEL + QString(".TargetHandle")] = handle;
+        return request;
+    }
+
+    Tp::MessagePartList textMessage(const QString &text) {
+        Tp::MessagePart header;
+        header["message-type"] = QDBusVariant(uint(Tp::ChannelTextMessageTypeNormal));
+        Tp::MessagePart body;
+        body["content-type"] = QDBusVariant(QString("text/plain"));
+        body["content"] = QDBusVariant(text);
+        return Tp::MessagePartList() << header << body;
+    }
+
+    /**
+     * @return object path of text channel to contact, empty if it could not be opened
+     */
+    QString openChat(const PipeConnectionPtr &connection, uint handle) {
+        QDBusMessage reply = callConnection(connection, TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS,
+                "EnsureChannel", QVariantList() << textChannelRequest(handle));
+        if(reply.type() != QDBusMessage::ReplyMessage || reply.arguments().size() < 2) {
+            std::fprintf(stderr, "Could not open chat: %s\n", qPrintable(reply.errorMessage()));
+            return QString();
+        }
+        return qdbus_cast<QDBusObjectPath>(reply.arguments().at(1)).path();
+    }
+
+    /**
+     * Keeps BULK_IN_FLIGHT messages of a bot queued on a channel until it is destroyed
+     */
+    class BulkSender : public QObject {
+
+        public:
+            BulkSender(const PipeConnectionPtr &connection, const QString &channelPath)
+                : connection(connection), channelPath(channelPath)
+            {
+                for(int i = 0; i < BULK_IN_FLIGHT; ++i) sendNext();
+            }
+
+        public:
+            int sent = 0;
+
+        private:
+            void sendNext() {
+                QDBusMessage call = QDBusMessage::createMethodCall(connection->busName(), channelPath,
+                        TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES, "SendMessage");
+                call << QVariant::fromValue(textMessage("bulk")) << uint(0);
+                QDBusPendingCallWatcher *watcher =
+                    new QDBusPendingCallWatcher(QDBusConnection::sessionBus().asyncCall(call), this);
+                connect(watcher, &QDBusPendingCallWatcher::finished, this, [this](QDBusPendingCallWatcher *finishedWatcher) {
+                        finishedWatcher->deleteLater();
+                        if(!finishedWatcher->isError()) ++sent;
+                        sendNext();
+                    });
+            }
+
+        private:
+            PipeConnectionPtr connection;
+            QString channelPath;
+    };
+
+    double percentile(std::vector<double> values, double fraction) {
+        if(values.empty()) return 0;
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, size_t(fraction * values.size()))];
+    }
+
+    /**
+     * Sends interactive messages with bulk flood running if it is requested
+     * @return false if any message could not be sent
+     */
+    bool run(const char *name, FakeServices &services, const PipeChain &pipes, const QString &account,
+            uint interactiveWeight, uint bulkWeight, uint bulkRate, bool flood, int messages)
+    {
+        Tp::ConnectionPtr pipedConnection = services.connectAccount(account, CONTACTS);
+        if(!pipedConnection) return false;
+        writePipedContacts(account, CONTACTS);
+        ConnectionAdditionalData additionalData = defaultConnectionData(account);
+        additionalData.interactiveSendWeight = interactiveWeight;
+        additionalData.bulkSendWeight = bulkWeight;
+        additionalData.bulkSendRate = bulkRate;
+        PipeConnectionPtr connection = createPipeConnection(pipedConnection, pipes, additionalData);
+        if(!connection || !waitForRoster(connection)) return false;
+
+        QString bulkPath = openChat(connection, BULK_CONTACT);
+        QString interactivePath = openChat(connection, INTERACTIVE_CONTACT);
+        if(bulkPath.isEmpty() || interactivePath.isEmpty()) return false;
+
+        std::unique_ptr<BulkSender> bulk;
+        if(flood) {
+            bulk.reset(new BulkSender(connection, bulkPath));
+            // the bot is recognized as bulk
+            settle(INTERACTIVE_INTERVAL);
+        }
+
+        std::vector<double> latencies;
+        PipeBenchCounters total;
+        total.start();
+        int bulkSent = bulk ? bulk->sent : 0;
+        for(int i = 0; i < messages; ++i) {
+            PipeBenchCounters counters;
+            counters.start();
+            QDBusMessage reply = callObject(connection, interactivePath, TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES,
+                    "SendMessage", QVariantList() << QVariant::fromValue(textMessage("hello")) << uint(0));
+            counters.stop();
+            if(reply.type() != QDBusMessage::ReplyMessage) {
+                std::fprintf(stderr, "Could not send message: %s\n", qPrintable(reply.errorMessage()));
+                return false;
+            }
+            latencies.push_back(counters.nanoseconds() / 1e6);
+            settle(INTERACTIVE_INTERVAL);
+        }
+        total.stop();
+        bulkSent = bulk ? bulk->sent - bulkSent : 0;
+
+        std::printf("%-16s %12.2f %12.2f %12.2f %14.1f\n", name, percentile(latencies, 0.5),
+                percentile(latencies, 0.9), percentile(latencies, 1), bulkSent * 1e9 / std::max<int64_t>(1, total.nanoseconds()));
+
+        bulk.reset();
+        connection.reset();
+        return true;
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    registerBenchTypes();
+    int messages = intArgument(app.arguments(), "--messages", 20);
+
+    if(!QDBusConnection::sessionBus().isConnected()) {
+        std::fprintf(stderr, "No session bus\n");
+        return 1;
+    }
+
+    QTemporaryDir home;
+    qputenv("HOME", home.path().toLocal8Bit());
+
+    FakeServices services;
+    services.startServices();
+    PipeChain pipes { std::make_shared<Pipe>(FakeServices::pipeService(), FakeServices::pipePath(),
+            QDBusConnection::sessionBus()) };
+
+    std::printf("%-16s %12s %12s %12s %14s\n", "Run", "p50 ms", "p90 ms", "max ms", "bulk msgs/s");
+    bool ok = run("no flood", services, pipes, "idle", 4, 1, 5, false, messages)
+        && run("flood, fair", services, pipes, "fair", 4, 1, 5, true, messages)
+        && run("flood, equal", services, pipes, "equal", 1, 1, 0, true, messages);
+
+    services.stopServices();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,623 @@
+#include "bench_services.hpp"
+#include "defines.hpp"
+
+#include <TelepathyQt/ChannelFactory>
+#include <TelepathyQt/ConnectionManager>
+#include <TelepathyQt/ContactFactory>
+#include <TelepathyQt/PendingReady>
+#include <QCoreApplication>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDBusAbstractAdaptor>
+#include <QDBusMetaType>
+#include <QDBusPendingCall>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QTimer>
+#include <cstdio>
+
+namespace {
+
+    const char CM_NAME[] = "bench";
+    const char PROTOCOL_NAME[] = "bench";
+    const char SERVICES_CONNECTION[] = "pipes_bench_fake_services";
+    const char CONTACT_PREFIX[] = "contact";
+    const char CONTACT_DOMAIN[] = "@bench";
+    const char SELF_ID[] = "self@bench";
+    const char URI_SCHEME[] = "bench:";
+
+    Tp::SimpleStatusSpec statusSpec(Tp::ConnectionPresenceType type) {
+        Tp::SimpleStatusSpec spec;
+        spec.type = type;
+        spec.maySetOnSelf = true;
+        spec.canHaveMessage = true;
+        return spec;
+    }
+
+} /* anonymous namespace */
+
+/**
+ * Pass-through pipe accepting text channels to contacts
+ */
+class FakePipeAdaptor : public QDBusAbstractAdaptor {
+    Q_OBJECT;
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.Telepathy.Pipe")
+    Q_PROPERTY(QString name READ name)
+    Q_PROPERTY(bool PassThrough READ passThrough)
+    Q_PROPERTY(bool TransformsMessages READ transformsMessages)
+    Q_PROPERTY(QString PeerAddress READ peerAddress)
+    Q_PROPERTY(Tp::RequestableChannelClassList RequestableChannelClasses READ requestableChannelClasses)
+
+    public:
+        explicit FakePipeAdaptor(QObject *parent) : QDBusAbstractAdaptor(parent) { }
+
+        QString name() const { return "bench"; }
+        bool passThrough() const { return true; }
+        bool transformsMessages() const { return false; }
+        QString peerAddress() const { return QString(); }
+        Tp::RequestableChannelClassList requestableChannelClasses() const {
+            Tp::RequestableChannelClass textClass;
+            textClass.fixedProperties[QString(TP_QT_IFACE_CHANNEL) + ".ChannelType"] = TP_QT_IFACE_CHANNEL_TYPE_TEXT;
+            textClass.fixedProperties[QString(TP_QT_IFACE_CHANNEL) + ".TargetHandleType"] = uint(Tp::HandleTypeContact);
+            return Tp::RequestableChannelClassList() << textClass;
+        }
+
+    public slots:
+        QDBusObjectPath createPipeChannel(const QDBusObjectPath &channelObject) {
+            return channelObject;
+        }
+};
+
+class FakeProtocol : public Tp::BaseProtocol {
+
+    public:
+        explicit FakeProtocol(const QDBusConnection &dbusConnection)
+            : Tp::BaseProtocol(dbusConnection, PROTOCOL_NAME)
+        {
+            setParameters(Tp::ProtocolParameterList()
+                    << Tp::ProtocolParameter(QLatin1String("account"),
+                        QLatin1String("s"), Tp::ConnMgrParamFlagRequired)
+                    << Tp::ProtocolParameter(QLatin1String("contacts"),
+                        QLatin1String("u"), Tp::ConnMgrParamFlagHasDefault, 100u));
+            setRequestableChannelClasses(Tp::RequestableChannelClassSpecList()
+                    << Tp::RequestableChannelClassSpec::textChat());
+            setCreateConnectionCallback(Tp::memFun(this, &FakeProtocol::createConnection));
+        }
+
+    private:
+        Tp::BaseConnectionPtr createConnection(const QVariantMap &parameters, Tp::DBusError * /* error */) {
+            return Tp::BaseConnectionPtr(new FakeConnection(dbusConnection(), CM_NAME, name(), parameters));
+        }
+};
+
+class FakeConnectionManager : public Tp::BaseConnectionManager {
+
+    public:
+        explicit FakeConnectionManager(const QDBusConnection &dbusConnection)
+            : Tp::BaseConnectionManager(dbusConnection, CM_NAME) { }
+};
+
+// ------------ FakeChannel -------------------------------------------------------------------------------------
+FakeChannel::FakeChannel(const QDBusConnection &dbusConnection, Tp::BaseConnection *connection,
+        const QString &channelType, uint targetHandle, uint targetHandleType)
+    : Tp::BaseChannel(dbusConnection, connection, channelType, targetHandle, targetHandleType)
+{
+    setTargetID(FakeServices::contactId(targetHandle));
+
+    textType = Tp::BaseChannelTextType::create(this);
+    plugInterface(Tp::AbstractChannelInterfacePtr::dynamicCast(textType));
+
+    Tp::BaseChannelMessagesInterfacePtr messagesIface = Tp::BaseChannelMessagesInterface::create(
+            textType.data(),
+            QStringList() << "text/plain",
+            Tp::UIntList() << Tp::ChannelTextMessageTypeNormal << Tp::ChannelTextMessageTypeDeliveryReport,
+            0,
+            Tp::DeliveryReportingSupportFlagReceiveSuccesses);
+    messagesIface->setSendMessageCallback(Tp::memFun(this, &FakeChannel::sendMessageCb));
+    plugInterface(Tp::AbstractChannelInterfacePtr::dynamicCast(messagesIface));
+
+    chatStateIface = Tp::BaseChannelChatStateInterface::create();
+    plugInterface(Tp::AbstractChannelInterfacePtr::dynamicCast(chatStateIface));
+}
+
+void FakeChannel::receiveMessages(int count, int contentSize) {
+
+    QString content(contentSize, QChar('x'));
+    for(int i = 0; i < count; ++i) {
+        Tp::MessagePart header;
+        header["message-token"] = QDBusVariant(QString("fake-%1-%2").arg(targetHandle()).arg(++received));
+        header["message-type"] = QDBusVariant(uint(Tp::ChannelTextMessageTypeNormal));
+        header["message-sender"] = QDBusVariant(targetHandle());
+        header["message-received"] = QDBusVariant(qint64(QDateTime::currentMSecsSinceEpoch() / 1000));
+        Tp::MessagePart body;
+        body["content-type"] = QDBusVariant(QString("text/plain"));
+        body["content"] = QDBusVariant(content);
+        textType->addReceivedMessage(Tp::MessagePartList() << header << body);
+    }
+}
+
+void FakeChannel::receiveDeliveryReports(int count) {
+
+    for(int i = 0; i < count; ++i) {
+        Tp::MessagePart header;
+        header["message-token"] = QDBusVariant(QString("fake-report-%1-%2").arg(targetHandle()).arg(++reported));
+        header["message-type"] = QDBusVariant(uint(Tp::ChannelTextMessageTypeDeliveryReport));
+        header["message-sender"] = QDBusVariant(targetHandle());
+        header["message-received"] = QDBusVariant(qint64(QDateTime::currentMSecsSinceEpoch() / 1000));
+        header["delivery-token"] = QDBusVariant(QString("fake-sent-%1-%2").arg(targetHandle()).arg(reported));
+        header["delivery-status"] = QDBusVariant(uint(Tp::DeliveryStatusDelivered));
+        textType->addReceivedMessage(Tp::MessagePartList() << header);
+    }
+}
+
+int FakeChannel::pendingMessages() const {
+    return textType->pendingMessages().size();
+}
+
+void FakeChannel::changeChatState(Tp::ChannelChatState state) {
+    chatStateIface->chatStateChanged(targetHandle(), state);
+}
+
+uint FakeChannel::sentMessages() const {
+    return sent;
+}
+
+QString FakeChannel::sendMessageCb(const Tp::MessagePartList &/* message */, uint /* flags */, Tp::DBusError * /* error */) {
+    return QString("fake-sent-%1-%2").arg(targetHandle()).arg(++sent);
+}
+
+// ------------ FakeConnection ----------------------------------------------------------------------------------
+FakeConnection::FakeConnection(const QDBusConnection &dbusConnection, const QString &cmName,
+        const QString &protocolName, const QVariantMap &parameters)
+    : Tp::BaseConnection(dbusConnection, cmName, protocolName, parameters),
+    contacts(parameters.value("contacts", 100u).toUInt())
+{
+    setConnectCallback(Tp::memFun(this, &FakeConnection::connectCb));
+    setCreateChannelCallback(Tp::memFun(this, &FakeConnection::createChannelCb));
+    setRequestHandlesCallback(Tp::memFun(this, &FakeConnection::requestHandlesCb));
+    setInspectHandlesCallback(Tp::memFun(this, &FakeConnection::inspectHandlesCb));
+    setSelfHandle(contacts + 1);
+
+    Tp::BaseConnectionContactsInterfacePtr contactsIface = Tp::BaseConnectionContactsInterface::create();
+    contactsIface->setGetContactAttributesCallback(Tp::memFun(this, &FakeConnection::getContactAttributesCb));
+    contactsIface->setContactAttributeInterfaces(QStringList()
+            << TP_QT_IFACE_CONNECTION
+            << TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST
+            << TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING);
+    plugInterface(Tp::AbstractConnectionInterfacePtr::dynamicCast(contactsIface));
+
+    Tp::BaseConnectionAddressingInterfacePtr addressingIface = Tp::BaseConnectionAddressingInterface::create();
+    addressingIface->setGetContactsByURICallback(Tp::memFun(this, &FakeConnection::getContactsByURICb));
+    plugInterface(Tp::AbstractConnectionInterfacePtr::dynamicCast(addressingIface));
+
+    contactListIface = Tp::BaseConnectionContactListInterface::create();
+    contactListIface->setGetContactListAttributesCallback(Tp::memFun(this, &FakeConnection::getContactListAttributesCb));
+    contactListIface->setContactListPersists(true);
+    contactListIface->setContactListState(Tp::ContactListStateNone);
+    plugInterface(Tp::AbstractConnectionInterfacePtr::dynamicCast(contactListIface));
+
+    Tp::SimpleStatusSpecMap statuses;
+    statuses.insert("available", statusSpec(Tp::ConnectionPresenceTypeAvailable));
+    statuses.insert("away", statusSpec(Tp::ConnectionPresenceTypeAway));
+    statuses.insert("offline", statusSpec(Tp::ConnectionPresenceTypeOffline));
+    presenceIface = Tp::BaseConnectionSimplePresenceInterface::create();
+    presenceIface->setStatuses(statuses);
+    presenceIface->setMaxmimumStatusMessageLength(256);
+    presenceIface->setSetPresenceCallback(Tp::memFun(this, &FakeConnection::setPresenceCb));
+    plugInterface(Tp::AbstractConnectionInterfacePtr::dynamicCast(presenceIface));
+
+    Tp::BaseConnectionRequestsInterfacePtr requestsIface = Tp::BaseConnectionRequestsInterface::create(this);
+    Tp::RequestableChannelClass textClass;
+    textClass.fixedProperties[QString(TP_QT_IFACE_CHANNEL) + ".ChannelType"] = TP_QT_IFACE_CHANNEL_TYPE_TEXT;
+    textClass.fixedProperties[QString(TP_QT_IFACE_CHANNEL) + ".TargetHandleType"] = uint(Tp::HandleTypeContact);
+    textClass.allowedProperties << QString(TP_QT_IFACE_CHANNEL) + ".TargetHandle";
+    requestsIface->requestableChannelClasses << textClass;
+    plugInterface(Tp::AbstractConnectionInterfacePtr::dynamicCast(requestsIface));
+}
+
+uint FakeConnection::contactCount() const {
+    return contacts;
+}
+
+void FakeConnection::reloadContactList(uint contacts) {
+    contactListIface->setContactListState(Tp::ContactListStateWaiting);
+    this->contacts = contacts;
+    contactListIface->setContactListState(Tp::ContactListStateSuccess);
+}
+
+int FakeConnection::channelCount() const {
+    int count = 0;
+    for(const QPointer<FakeChannel> &fakeChannel: channels) if(fakeChannel) ++count;
+    return count;
+}
+
+int FakeConnection::createdChannels() const {
+    return created;
+}
+
+FakeChannelPtr FakeConnection::channel(const QString &objectPath) const {
+    for(const QPointer<FakeChannel> &fakeChannel: channels) {
+        if(fakeChannel && fakeChannel->objectPath() == objectPath) return FakeChannelPtr(fakeChannel.data());
+    }
+    return FakeChannelPtr();
+}
+
+void FakeConnection::setPresences(const Tp::SimpleContactPresences &presences) {
+    presenceIface->setPresences(presences);
+}
+
+void FakeConnection::connectCb(Tp::DBusError * /* error */) {
+
+    Tp::SimplePresence offline;
+    offline.type = Tp::ConnectionPresenceTypeOffline;
+    offline.status = "offline";
+    Tp::SimpleContactPresences presences;
+    for(uint handle = 1; handle <= contacts; ++handle) presences[handle] = offline;
+    presenceIface->setPresences(presences);
+
+    setStatus(Tp::ConnectionStatusConnected, Tp::ConnectionStatusReasonRequested);
+    contactListIface->setContactListState(Tp::ContactListStateSuccess);
+}
+
+Tp::BaseChannelPtr FakeConnection::createChannelCb(
+        const QString &channelType, uint targetHandleType, uint targetHandle, Tp::DBusError *error)
+{
+    if(channelType != TP_QT_IFACE_CHANNEL_TYPE_TEXT || targetHandleType != Tp::HandleTypeContact) {
+        error->set(TP_QT_ERROR_NOT_IMPLEMENTED, "Only text channels to contacts are supported");
+        return Tp::BaseChannelPtr();
+    }
+    if(targetHandle == 0 || targetHandle > contacts) {
+        error->set(TP_QT_ERROR_INVALID_HANDLE, "No such contact");
+        return Tp::BaseChannelPtr();
+    }
+
+    FakeChannelPtr fakeChannel(new FakeChannel(dbusConnection(), this, channelType, targetHandle, targetHandleType));
+    ++created;
+    channels.removeAll(QPointer<FakeChannel>());
+    channels << QPointer<FakeChannel>(fakeChannel.data());
+    return Tp::BaseChannelPtr::dynamicCast(fakeChannel);
+}
+
+Tp::UIntList FakeConnection::requestHandlesCb(uint handleType, const QStringList &identifiers, Tp::DBusError *error) {
+
+    if(handleType != Tp::HandleTypeContact) {
+        error->set(TP_QT_ERROR_NOT_IMPLEMENTED, "Only contact handles are supported");
+        return Tp::UIntList();
+    }
+
+    Tp::UIntList handles;
+    for(const QString &identifier: identifiers) {
+        uint handle = identifier == SELF_ID ? selfHandle() : FakeServices::contactHandle(identifier);
+        if(handle == 0 || handle > contacts + 1) {
+            error->set(TP_QT_ERROR_INVALID_HANDLE, "No such contact: " + identifier);
+            return Tp::UIntList();
+        }
+        handles << handle;
+    }
+    return handles;
+}
+
+QStringList FakeConnection::inspectHandlesCb(uint handleType, const Tp::UIntList &handles, Tp::DBusError *error) {
+
+    if(handleType != Tp::HandleTypeContact) {
+        error->set(TP_QT_ERROR_NOT_IMPLEMENTED, "Only contact handles are supported");
+        return QStringList();
+    }
+
+    QStringList identifiers;
+    for(uint handle: handles) {
+        if(handle == 0 || handle > contacts + 1) {
+            error->set(TP_QT_ERROR_INVALID_HANDLE, QString("No such handle: %1").arg(handle));
+            return QStringList();
+        }
+        identifiers << (handle == selfHandle() ? QString(SELF_ID) : FakeServices::contactId(handle));
+    }
+    return identifiers;
+}
+
+Tp::ContactAttributesMap FakeConnection::getContactAttributesCb(
+        const Tp::UIntList &handles, const QStringList &/* interfaces */, Tp::DBusError * /* error */)
+{
+    Tp::ContactAttributesMap attributes;
+    for(uint handle: handles) {
+        if(handle == 0 || handle > contacts) continue;
+        QVariantMap attrs;
+        attrs[QString(TP_QT_IFACE_CONNECTION) + "/contact-id"] = FakeServices::contactId(handle);
+        attrs[QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/subscribe"] = uint(Tp::SubscriptionStateYes);
+        attrs[QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/publish"] = uint(Tp::SubscriptionStateYes);
+        attrs[QString(TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING) + "/uris"] = QStringList() << FakeServices::contactURI(handle);
+        attributes[handle] = attrs;
+    }
+    return attributes;
+}
+
+Tp::ContactAttributesMap FakeConnection::getContactListAttributesCb(
+        const QStringList &interfaces, bool /* hold */, Tp::DBusError *error)
+{
+    Tp::UIntList handles;
+    handles.reserve(contacts);
+    for(uint handle = 1; handle <= contacts; ++handle) handles << handle;
+    return getContactAttributesCb(handles, interfaces, error);
+}
+
+uint FakeConnection::setPresenceCb(const QString &/* status */, const QString &/* statusMessage */, Tp::DBusError * /* error */) {
+    return selfHandle();
+}
+
+void FakeConnection::getContactsByURICb(const QStringList &URIs, const QStringList &interfaces,
+        Tp::AddressingNormalizationMap &addressingNormalizationMap,
+        Tp::ContactAttributesMap &contactAttributesMap, Tp::DBusError *error)
+{
+    Tp::UIntList handles;
+    int schemeSize = sizeof(URI_SCHEME) - 1;
+    for(const QString &uri: URIs) {
+        if(!uri.startsWith(URI_SCHEME, Qt::CaseInsensitive)) continue;
+        uint handle = FakeServices::contactHandle(uri.mid(schemeSize).toLower());
+        if(handle == 0 || handle > contacts) continue;
+        addressingNormalizationMap[uri] = handle;
+        handles << handle;
+    }
+    contactAttributesMap = getContactAttributesCb(handles, interfaces, error);
+}
+
+// ------------ FakeServices ------------------------------------------------------------------------------------
+FakeServices::FakeServices() {
+}
+
+FakeServices::~FakeServices() {
+    stopServices();
+}
+
+void FakeServices::startServices() {
+    std::future<void> started = startedPromise.get_future();
+    QThread::start();
+    started.get();
+}
+
+void FakeServices::stopServices() {
+    if(!isRunning()) return;
+    quit();
+    wait();
+}
+
+void FakeServices::invoke(const std::function<void ()> &function) {
+    std::promise<void> donePromise;
+    std::future<void> done = donePromise.get_future();
+    QTimer::singleShot(0, context, [&function, &donePromise]() {
+            function();
+            donePromise.set_value();
+        });
+    done.get();
+}
+
+Tp::ConnectionPtr FakeServices::connectAccount(const QString &account, uint contacts) {
+
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    Tp::Client::ConnectionManagerInterface cmIface(bus,
+            QString(TP_QT_CONNECTION_MANAGER_BUS_NAME_BASE) + CM_NAME,
+            QString(TP_QT_CONNECTION_MANAGER_OBJECT_PATH_BASE) + CM_NAME);
+
+    QVariantMap parameters;
+    parameters["account"] = account;
+    parameters["contacts"] = contacts;
+    QDBusPendingReply<QString, QDBusObjectPath> connectionRep = cmIface.RequestConnection(PROTOCOL_NAME, parameters);
+    connectionRep.waitForFinished();
+    if(!connectionRep.isValid()) {
+        std::fprintf(stderr, "Could not request connection: %s\n", connectionRep.error().message().toLocal8Bit().constData());
+        return Tp::ConnectionPtr();
+    }
+    QString busName = connectionRep.argumentAt<0>();
+    QString objectPath = connectionRep.argumentAt<1>().path();
+
+    Tp::Client::ConnectionInterface connectionIface(bus, busName, objectPath);
+    QDBusPendingReply<> connectRep = connectionIface.Connect();
+    connectRep.waitForFinished();
+    if(!connectRep.isValid()) {
+        std::fprintf(stderr, "Could not connect: %s\n", connectRep.error().message().toLocal8Bit().constData());
+        return Tp::ConnectionPtr();
+    }
+
+    Tp::ConnectionPtr connection = Tp::Connection::create(bus, busName, objectPath,
+            Tp::ChannelFactory::create(bus), Tp::ContactFactory::create());
+    Tp::PendingReady *pendingReady = connection->becomeReady(Tp::Connection::FeatureCore);
+    { // wait for operation to finish
+        QEventLoop loop;
+        QObject::connect(pendingReady, &Tp::PendingOperation::finished,
+                &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+    return connection->isReady() ? connection : Tp::ConnectionPtr();
+}
+
+FakeConnectionPtr FakeServices::connection(const QString &objectPath) const {
+    for(const Tp::BaseConnectionPtr &fakeConnection: cm->connections()) {
+        if(fakeConnection->objectPath() == objectPath) return FakeConnectionPtr::dynamicCast(fakeConnection);
+    }
+    return FakeConnectionPtr();
+}
+
+QString FakeServices::contactId(uint handle) {
+    return QString(CONTACT_PREFIX) + QString::number(handle) + CONTACT_DOMAIN;
+}
+
+QString FakeServices::contactURI(uint handle) {
+    return QString(URI_SCHEME) + contactId(handle);
+}
+
+uint FakeServices::contactHandle(const QString &identifier) {
+    int prefixSize = sizeof(CONTACT_PREFIX) - 1;
+    int domainSize = sizeof(CONTACT_DOMAIN) - 1;
+    if(!identifier.startsWith(CONTACT_PREFIX) || !identifier.endsWith(CONTACT_DOMAIN)) return 0;
+
+    bool valid = false;
+    uint handle = identifier.mid(prefixSize, identifier.size() - prefixSize - domainSize).toUInt(&valid);
+    return valid ? handle : 0;
+}
+
+QString FakeServices::pipeService() {
+    return TP_QT_IFACE_PIPE ".bench";
+}
+
+QString FakeServices::pipePath() {
+    return "/" + pipeService().replace('.', '/');
+}
+
+void FakeServices::run() {
+    {
+        QDBusConnection bus = QDBusConnection::connectToBus(QDBusConnection::SessionBus, SERVICES_CONNECTION);
+        QObject contextObject;
+
+        cm = Tp::BaseConnectionManagerPtr(new FakeConnectionManager(bus));
+        cm->addProtocol(Tp::BaseProtocolPtr(new FakeProtocol(bus)));
+        Tp::DBusError error;
+        if(!cm->registerObject(&error))
+            std::fprintf(stderr, "Could not register fake connection manager: %s\n", error.message().toLocal8Bit().constData());
+
+        QObject pipeObject;
+        new FakePipeAdaptor(&pipeObject);
+        bus.registerObject(pipePath(), &pipeObject);
+        bus.registerService(pipeService());
+
+        context = &contextObject;
+        startedPromise.set_value();
+
+        exec();
+
+        context = nullptr;
+        cm.reset();
+    }
+    QDBusConnection::disconnectFromBus(SERVICES_CONNECTION);
+}
+
+// ------------ PresenceCounter ---------------------------------------------------------------------------------
+PresenceCounter::PresenceCounter(const PipeConnectionPtr &connection) {
+    QDBusConnection::sessionBus().connect(connection->busName(), connection->objectPath(),
+            TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE, "PresencesChanged",
+            this, SLOT(presencesChanged(Tp::SimpleContactPresences)));
+}
+
+void PresenceCounter::presencesChanged(const Tp::SimpleContactPresences &presences) {
+    received += presences.size();
+}
+
+// ------------ helpers -----------------------------------------------------------------------------------------
+void writePipedContacts(const QString &contactListFileName, uint contacts) {
+
+    QString dirPath = QDir::homePath() + QString("/" TP_QT_PIPE_CONTACT_LISTS);
+    QDir().mkpath(dirPath);
+
+    QSet<QString> piped;
+    for(uint handle = 1; handle <= contacts; ++handle) piped << FakeServices::contactId(handle);
+    QFile outFile(dirPath + "/" + contactListFileName);
+    if(!outFile.open(QIODevice::WriteOnly)) {
+        std::fprintf(stderr, "Could not write contact list: %s\n", outFile.fileName().toLocal8Bit().constData());
+        return;
+    }
+    QDataStream os(&outFile);
+    os << piped;
+}
+
+PipeConnectionPtr createPipeConnection(const Tp::ConnectionPtr &pipedConnection, const PipeChain &pipes,
+        const ConnectionAdditionalData &additionalData)
+{
+    QVariantMap parameters;
+    parameters["Protocol"] = pipedConnection->protocolName();
+    parameters["Identificator"] = additionalData.contactListFileName;
+
+    PipeConnectionPtr connection(new PipeConnection(
+                pipedConnection,
+                pipes,
+                QDBusConnection::sessionBus(),
+                TP_QT_PIPE_CONNECTION_MANAGER_NAME,
+                pipes.front()->name() + "Pipe",
+                parameters,
+                additionalData));
+
+    Tp::DBusError error;
+    if(!connection->registerObject(&error)) {
+        std::fprintf(stderr, "Could not register pipe connection: %s\n", error.message().toLocal8Bit().constData());
+        return PipeConnectionPtr();
+    }
+    return connection;
+}
+
+ConnectionAdditionalData defaultConnectionData(const QString &contactListFileName) {
+    return { contactListFileName, 0, 300, 0, 600, 4, 1, 5 };
+}
+
+uint contactListState(const PipeConnectionPtr &connection) {
+    Tp::BaseConnectionContactListInterfacePtr listIface = Tp::BaseConnectionContactListInterfacePtr::dynamicCast(
+            connection->interface(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST));
+    return listIface ? listIface->contactListState() : uint(Tp::ContactListStateFailure);
+}
+
+bool waitForRoster(const PipeConnectionPtr &connection) {
+    return waitFor([&connection]() {
+            uint state = contactListState(connection);
+            return state == Tp::ContactListStateSuccess || state == Tp::ContactListStateFailure;
+        }) && contactListState(connection) == Tp::ContactListStateSuccess;
+}
+
+PipeConnectionPtr pipeAccount(FakeServices &services, const PipeChain &pipes, const QString &account, uint contacts) {
+    Tp::ConnectionPtr pipedConnection = services.connectAccount(account, contacts);
+    if(!pipedConnection) return PipeConnectionPtr();
+    writePipedContacts(account, contacts);
+    PipeConnectionPtr connection = createPipeConnection(pipedConnection, pipes, defaultConnectionData(account));
+    if(connection && !waitForRoster(connection)) return PipeConnectionPtr();
+    return connection;
+}
+
+int intArgument(const QStringList &args, const QString &name, int defaultValue) {
+    int index = args.indexOf(name);
+    if(index >= 0 && index + 1 < args.size()) return args[index + 1].toInt();
+    return defaultValue;
+}
+
+void registerBenchTypes() {
+    Tp::registerTypes();
+    qRegisterMetaType<Tp::RequestableChannelClassList>("RequestableChannelClassList");
+    qDBusRegisterMetaType<Tp::RequestableChannelClassList>();
+    qRegisterMetaType<Tp::MessagePartListList>("MessagePartListList");
+    qDBusRegisterMetaType<Tp::MessagePartListList>();
+}
+
+QDBusMessage callObject(const PipeConnectionPtr &connection, const QString &objectPath, const QString &interface,
+        const QString &method, const QVariantList &arguments)
+{
+    QDBusMessage call = QDBusMessage::createMethodCall(connection->busName(), objectPath, interface, method);
+    call.setArguments(arguments);
+    QDBusPendingCall pendingCall = QDBusConnection::sessionBus().asyncCall(call);
+    if(!waitFor([&pendingCall]() { return pendingCall.isFinished(); }))
+        return QDBusMessage::createError(QDBusError::Timeout, method + " was not answered");
+    return pendingCall.reply();
+}
+
+QDBusMessage callConnection(const PipeConnectionPtr &connection, const QString &interface, const QString &method,
+        const QVariantList &arguments)
+{
+    return callObject(connection, connection->objectPath(), interface, method, arguments);
+}
+
+bool waitFor(const std::function<bool ()> &condition, int timeout) {
+
+    QElapsedTimer timer;
+    timer.start();
+    // wakes up the loop, so that conditions not bound to any event are checked too
+    QTimer wakeUp;
+    wakeUp.start(10);
+    while(!condition()) {
+        if(timer.hasExpired(timeout)) return false;
+        QCoreApplication::processEvents(QEventLoop::WaitForMoreEvents);
+    }
+    return true;
+}
+
+void settle(int ms) {
+    QEventLoop loop;
+    QTimer::singleShot(ms, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+#include "bench_services.moc"
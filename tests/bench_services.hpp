@@ -0,0 +1,251 @@
+#ifndef PIPE_BENCH_SERVICES_HPP
+#define PIPE_BENCH_SERVICES_HPP
+
+#include <TelepathyQt/BaseChannel>
+#include <TelepathyQt/BaseConnection>
+#include <TelepathyQt/BaseConnectionManager>
+#include <TelepathyQt/BaseProtocol>
+#include <TelepathyQt/Connection>
+#include <QDBusMessage>
+#include <QPointer>
+#include <QThread>
+#include <functional>
+#include <future>
+
+#include "connection.hpp"
+
+/**
+ * Text channel of fake connection, messages sent through it are only counted. Chat state of its
+ * target contact is changed by the bench.
+ */
+class FakeChannel : public Tp::BaseChannel {
+
+    public:
+        FakeChannel(const QDBusConnection &dbusConnection, Tp::BaseConnection *connection,
+                const QString &channelType, uint targetHandle, uint targetHandleType);
+
+        /**
+         * Adds given number of text messages from the target contact to pending messages
+         */
+        void receiveMessages(int count, int contentSize);
+        /**
+         * Adds given number of delivery reports of messages sent to the target contact to pending messages
+         */
+        void receiveDeliveryReports(int count);
+        /**
+         * @return number of received messages and reports not acknowledged yet
+         */
+        int pendingMessages() const;
+        /**
+         * Announces new chat state of the target contact, even if it did not change
+         */
+        void changeChatState(Tp::ChannelChatState state);
+
+        uint sentMessages() const;
+
+    private:
+        QString sendMessageCb(const Tp::MessagePartList &message, uint flags, Tp::DBusError *error);
+
+    private:
+        Tp::BaseChannelTextTypePtr textType;
+        Tp::BaseChannelChatStateInterfacePtr chatStateIface;
+        uint received = 0;
+        uint reported = 0;
+        uint sent = 0;
+};
+
+typedef Tp::SharedPtr<FakeChannel> FakeChannelPtr;
+
+/**
+ * Connection of fake connection manager. Its roster has contacts with handles from 1 to the value
+ * of "contacts" parameter, self handle follows them. All contacts are subscribed and start offline.
+ * Each contact has one URI, its identifier with "bench:" scheme, URIs are resolved case insensitively.
+ */
+class FakeConnection : public Tp::BaseConnection {
+
+    public:
+        FakeConnection(const QDBusConnection &dbusConnection, const QString &cmName,
+                const QString &protocolName, const QVariantMap &parameters);
+
+        uint contactCount() const;
+        /**
+         * @return number of open channels
+         */
+        int channelCount() const;
+        /**
+         * @return number of channels created on request of clients
+         */
+        int createdChannels() const;
+        /**
+         * @return open channel with given object path, null if there is none
+         */
+        FakeChannelPtr channel(const QString &objectPath) const;
+
+        void setPresences(const Tp::SimpleContactPresences &presences);
+        /**
+         * Downloads contact list again, as after reconnect, and keeps given number of contacts in it
+         */
+        void reloadContactList(uint contacts);
+
+    private:
+        void connectCb(Tp::DBusError *error);
+        Tp::BaseChannelPtr createChannelCb(
+                const QString &channelType, uint targetHandleType, uint targetHandle, Tp::DBusError *error);
+        Tp::UIntList requestHandlesCb(uint handleType, const QStringList &identifiers, Tp::DBusError *error);
+        QStringList inspectHandlesCb(uint handleType, const Tp::UIntList &handles, Tp::DBusError *error);
+        Tp::ContactAttributesMap getContactAttributesCb(
+                const Tp::UIntList &handles, const QStringList &interfaces, Tp::DBusError *error);
+        Tp::ContactAttributesMap getContactListAttributesCb(
+                const QStringList &interfaces, bool hold, Tp::DBusError *error);
+        uint setPresenceCb(const QString &status, const QString &statusMessage, Tp::DBusError *error);
+        void getContactsByURICb(const QStringList &URIs, const QStringList &interfaces,
+                Tp::AddressingNormalizationMap &addressingNormalizationMap,
+                Tp::ContactAttributesMap &contactAttributesMap, Tp::DBusError *error);
+
+    private:
+        uint contacts;
+        int created = 0;
+        QList<QPointer<FakeChannel>> channels;
+        Tp::BaseConnectionContactListInterfacePtr contactListIface;
+        Tp::BaseConnectionSimplePresenceInterfacePtr presenceIface;
+};
+
+typedef Tp::SharedPtr<FakeConnection> FakeConnectionPtr;
+
+/**
+ * Fake connection manager, fake protocol "bench" and fake pass-through pipe served from their own
+ * thread and bus connection, so that blocking calls of pipes connection do not block them. The pipe
+ * accepts text channels to contacts.
+ */
+class FakeServices : public QThread {
+
+    public:
+        FakeServices();
+        virtual ~FakeServices();
+
+        /**
+         * Starts the thread and returns when all services are registered
+         */
+        void startServices();
+        void stopServices();
+
+        /**
+         * Runs function in thread of services and returns when it finished
+         */
+        void invoke(const std::function<void ()> &function);
+
+        /**
+         * Requests connection of fake connection manager and connects it, called from main thread
+         * @return ready connection, null if it failed
+         */
+        Tp::ConnectionPtr connectAccount(const QString &account, uint contacts);
+        /**
+         * @return fake connection with given object path, only to be used in invoked functions
+         */
+        FakeConnectionPtr connection(const QString &objectPath) const;
+
+        static QString contactId(uint handle);
+        static QString contactURI(uint handle);
+        /**
+         * @return handle of contact with given identifier, 0 if it is not a fake contact
+         */
+        static uint contactHandle(const QString &identifier);
+        static QString pipeService();
+        static QString pipePath();
+
+    protected:
+        void run() override;
+
+    private:
+        std::promise<void> startedPromise;
+        QObject *context = nullptr;
+        Tp::BaseConnectionManagerPtr cm;
+};
+
+/**
+ * Counts presences announced by pipes connection on D-Bus
+ */
+class PresenceCounter : public QObject {
+
+    Q_OBJECT;
+
+    public:
+        explicit PresenceCounter(const PipeConnectionPtr &connection);
+
+    public slots:
+        void presencesChanged(const Tp::SimpleContactPresences &presences);
+
+    public:
+        int received = 0;
+};
+
+/**
+ * Writes contact list file of pipes connection, so that contacts with handles up to given one are piped
+ */
+void writePipedContacts(const QString &contactListFileName, uint contacts);
+
+/**
+ * Creates pipes connection the way PipeProtocol does once it found the piped account and registers it
+ * @return null if connection could not be registered
+ */
+PipeConnectionPtr createPipeConnection(const Tp::ConnectionPtr &pipedConnection, const PipeChain &pipes,
+        const ConnectionAdditionalData &additionalData);
+
+/**
+ * @return additional data of connection with defaults of PipeProtocol parameters
+ */
+ConnectionAdditionalData defaultConnectionData(const QString &contactListFileName);
+
+/**
+ * @return contact list state announced by pipes connection
+ */
+uint contactListState(const PipeConnectionPtr &connection);
+
+/**
+ * Waits until contact list of pipes connection is loaded or fails
+ * @return true if it was loaded
+ */
+bool waitForRoster(const PipeConnectionPtr &connection);
+
+/**
+ * Connects fake account and creates pipes connection piping all its contacts, once its roster is loaded
+ * @return null if it failed
+ */
+PipeConnectionPtr pipeAccount(FakeServices &services, const PipeChain &pipes, const QString &account, uint contacts);
+
+/**
+ * @return value of integer command line argument following given name
+ */
+int intArgument(const QStringList &args, const QString &name, int defaultValue);
+
+/**
+ * Registers D-Bus types used by pipes connection and fake services
+ */
+void registerBenchTypes();
+
+/**
+ * Calls method of object of pipes connection on the bus and processes events until it is answered,
+ * so that the connection served from the calling thread can answer it
+ * @return reply, error reply if the call failed or timed out
+ */
+QDBusMessage callObject(const PipeConnectionPtr &connection, const QString &objectPath, const QString &interface,
+        const QString &method, const QVariantList &arguments);
+
+/**
+ * Calls method of pipes connection itself, see callObject
+ */
+QDBusMessage callConnection(const PipeConnectionPtr &connection, const QString &interface, const QString &method,
+        const QVariantList &arguments);
+
+/**
+ * Processes events until condition holds or timeout in ms passes
+ * @return false on timeout
+ */
+bool waitFor(const std::function<bool ()> &condition, int timeout = 30000);
+
+/**
+ * Processes events for given time, so that proxies finish their asynchronous setup
+ */
+void settle(int ms = 100);
+
+#endif
@@ -0,0 +1,108 @@
+#include "socket_relay.hpp"
+#include "bench_counters.hpp"
+
+#include <QCoreApplication>
+#include <QStringList>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/**
+ * Moves a file of given size from one local socket to another through PipeSocketRelay and through
+ * a plain read/write loop, the way the data would be copied without the relay, and prints throughput
+ * of both. Use --megabytes to set size of the file, multi-GB transfers are the default.
+ */
+
+namespace {
+
+    const size_t CHUNK = 1 << 16;
+
+    /**
+     * Writes megabytes of data to fd and closes it
+     */
+    void produce(int fd, int megabytes) {
+        std::vector<char> buffer(CHUNK, 'f');
+        size_t total = size_t(megabytes) << 20;
+        for(size_t written = 0; written < total; ) {
+            ssize_t chunk = write(fd, buffer.data(), std::min(CHUNK, total - written));
+            if(chunk <= 0) break;
+            written += chunk;
+        }
+        close(fd);
+    }
+
+    /**
+     * @return bytes read from fd until end of stream
+     */
+    size_t consume(int fd) {
+        std::vector<char> buffer(CHUNK);
+        size_t total = 0;
+        ssize_t chunk;
+        while((chunk = read(fd, buffer.data(), buffer.size())) > 0) total += chunk;
+        close(fd);
+        return total;
+    }
+
+    /**
+     * Copies from one socket to another through user space buffer until end of stream
+     */
+    void copy(int from, int to) {
+        std::vector<char> buffer(CHUNK);
+        ssize_t chunk;
+        while((chunk = read(from, buffer.data(), buffer.size())) > 0) {
+            for(ssize_t written = 0; written < chunk; ) {
+                ssize_t out = write(to, buffer.data() + written, chunk - written);
+                if(out <= 0) return;
+                written += out;
+            }
+        }
+        close(from);
+        close(to);
+    }
+
+    /**
+     * Transfers the file from producer to consumer, moveData connects the two inner sockets
+     */
+    void measure(const char *name, int megabytes, const std::function<void (int, int)> &moveData) {
+
+        int source[2], sink[2];
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, source) == -1 || socketpair(AF_UNIX, SOCK_STREAM, 0, sink) == -1) {
+            std::fprintf(stderr, "Could not create sockets\n");
+            return;
+        }
+
+        PipeBenchCounters counters;
+        counters.start();
+        std::thread producer(produce, source[0], megabytes);
+        moveData(source[1], sink[0]);
+        size_t received = consume(sink[1]);
+        producer.join();
+        counters.stop();
+
+        double seconds = counters.nanoseconds() / 1e9;
+        std::printf("%-20s %12zu %12.1f\n", name, received >> 20, (received >> 20) / qMax(seconds, 1e-9));
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    int megabytes = 4096;
+    int index = args.indexOf("--megabytes");
+    if(index >= 0 && index + 1 < args.size()) megabytes = args[index + 1].toInt();
+
+    PipeSocketRelay relay;
+    std::thread copier;
+
+    std::printf("%-20s %12s %12s\n", "Transfer", "MB", "MB/s");
+    measure("splice relay", megabytes, [&relay](int from, int to) { relay.relay(from, to); });
+    measure("read/write copy", megabytes, [&copier](int from, int to) { copier = std::thread(copy, from, to); });
+    copier.join();
+    return 0;
+}
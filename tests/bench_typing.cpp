@@ -0,0 +1,148 @@
+#include "connection.hpp"
+#include "proxy_channel.hpp"
+#include "bench_counters.hpp"
+#include "bench_services.hpp"
+
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QTemporaryDir>
+#include <cstdio>
+#include <vector>
+
+/**
+ * Replays heavy typing in many piped text channels at once. Every tick each contact announces that
+ * it is composing, every tenth tick it pauses and when the replay ends it becomes active, so most
+ * announcements repeat the previous state. Reports how many ChatStateChanged signals proxy channels
+ * forwarded. Use --channels, --ticks and --interval (ms between ticks) to shape the workload. Needs
+ * session bus.
+ */
+
+namespace {
+
+    const int PAUSE_EVERY = 10;
+
+    /**
+     * Counts chat states forwarded by proxy channels on D-Bus
+     */
+    class ChatStateCounter : public QObject {
+
+        Q_OBJECT;
+
+        public:
+            ChatStateCounter(const PipeConnectionPtr &connection, const std::vector<Tp::BaseChannelPtr> &channels) {
+                for(const Tp::BaseChannelPtr &channel: channels) {
+                    QDBusConnection::sessionBus().connect(connection->busName(), channel->objectPath(),
+                            TP_QT_IFACE_CHANNEL_INTERFACE_CHAT_STATE, "ChatStateChanged",
+                            this, SLOT(chatStateChanged(uint, uint)));
+                }
+            }
+
+        public slots:
+            void chatStateChanged(uint /* contact */, uint state) {
+                ++received;
+                if(state == Tp::ChannelChatStateActive) ++active;
+            }
+
+        public:
+            int received = 0;
+            int active = 0;
+    };
+
+    /**
+     * Announces chat state in all fake channels at once
+     */
+    void changeChatStates(FakeServices &services, const QString &connectionPath, const QStringList &channelPaths,
+            Tp::ChannelChatState state)
+    {
+        services.invoke([&services, &connectionPath, &channelPaths, state]() {
+                FakeConnectionPtr fakeConnection = services.connection(connectionPath);
+                if(!fakeConnection) return;
+                for(const QString &channelPath: channelPaths) {
+                    FakeChannelPtr fakeChannel = fakeConnection->channel(channelPath);
+                    if(fakeChannel) fakeChannel->changeChatState(state);
+                }
+            });
+    }
+
+} /* anonymous namespace */
+
+int main(int argc, char *argv[]) {
+
+    QCoreApplication app(argc, argv);
+    registerBenchTypes();
+    QStringList args = app.arguments();
+    int channels = intArgument(args, "--channels", 200);
+    int ticks = intArgument(args, "--ticks", 100);
+    int interval = intArgument(args, "--interval", 50);
+
+    if(!QDBusConnection::sessionBus().isConnected()) {
+        std::fprintf(stderr, "No session bus\n");
+        return 1;
+    }
+
+    QTemporaryDir home;
+    qputenv("HOME", home.path().toLocal8Bit());
+
+    FakeServices services;
+    services.startServices();
+    PipeChain pipes { std::make_shared<Pipe>(FakeServices::pipeService(), FakeServices::pipePath(),
+            QDBusConnection::sessionBus()) };
+
+    PipeConnectionPtr connection = pipeAccount(services, pipes, "typing", channels);
+    if(!connection) {
+        std::fprintf(stderr, "Roster of %d contacts was not loaded\n", channels);
+        return 1;
+    }
+
+    std::vector<Tp::BaseChannelPtr> piped;
+    QStringList channelPaths;
+    for(int handle = 1; handle <= channels; ++handle) {
+        Tp::DBusError error;
+        Tp::BaseChannelPtr channel = connection->openChannel(TP_QT_IFACE_CHANNEL_TYPE_TEXT,
+                Tp::HandleTypeContact, handle, connection->selfHandle(), false, &error);
+        PipeProxyChannelPtr proxy = PipeProxyChannelPtr::dynamicCast(channel);
+        if(error.isValid() || !proxy) {
+            std::fprintf(stderr, "Could not pipe channel: %s\n", qPrintable(error.message()));
+            return 1;
+        }
+        piped.push_back(channel);
+        channelPaths << proxy->getPipedChannel()->objectPath();
+    }
+
+    ChatStateCounter counter(connection, piped);
+    // proxies fetch initial chat states
+    settle();
+
+    QString connectionPath = connection->getPipedConnection()->objectPath();
+    int announced = 0;
+    PipeBenchCounters counters;
+    counters.start();
+    for(int tick = 1; tick <= ticks; ++tick) {
+        changeChatStates(services, connectionPath, channelPaths,
+                tick % PAUSE_EVERY ? Tp::ChannelChatStateComposing : Tp::ChannelChatStatePaused);
+        announced += channels;
+        settle(interval);
+    }
+    changeChatStates(services, connectionPath, channelPaths, Tp::ChannelChatStateActive);
+    announced += channels;
+    // the final state may wait for the end of rate limiting interval
+    bool finished = waitFor([&counter, channels]() { return counter.active >= channels; });
+    counters.stop();
+    if(!finished) {
+        std::fprintf(stderr, "Final chat states were not forwarded\n");
+        return 1;
+    }
+
+    double seconds = counters.nanoseconds() / 1e9;
+    std::printf("%-12s %12s %12s %12s %12s %20s\n", "Channels", "announced", "forwarded", "forwarded %", "seconds",
+            "forwarded/channel/s");
+    std::printf("%-12d %12d %12d %12.1f %12.2f %20.2f\n", channels, announced, counter.received,
+            100.0 * counter.received / qMax(1, announced), seconds, counter.received / qMax(seconds, 1e-9) / channels);
+
+    piped.clear();
+    connection.reset();
+    services.stopServices();
+    return 0;
+}
+
+#include "bench_typing.moc"
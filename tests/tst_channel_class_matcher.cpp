@@ -0,0 +1,94 @@
+#include "channel_class_matcher.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QtTest/QtTest>
+
+namespace {
+
+    const QString CHANNEL_TYPE = QString(TP_QT_IFACE_CHANNEL) + ".ChannelType";
+    const QString TARGET_HANDLE_TYPE = QString(TP_QT_IFACE_CHANNEL) + ".TargetHandleType";
+
+    Tp::RequestableChannelClass channelClass(const QString &channelType, uint handleType) {
+        Tp::RequestableChannelClass cc;
+        cc.fixedProperties[CHANNEL_TYPE] = channelType;
+        cc.fixedProperties[TARGET_HANDLE_TYPE] = handleType;
+        return cc;
+    }
+
+    QVariantMap channelProperties(const QString &channelType, uint handleType) {
+        QVariantMap properties;
+        properties[CHANNEL_TYPE] = channelType;
+        properties[TARGET_HANDLE_TYPE] = handleType;
+        properties[QString(TP_QT_IFACE_CHANNEL) + ".TargetHandle"] = 42u;
+        return properties;
+    }
+
+} /* anonymous namespace */
+
+class TestChannelClassMatcher : public QObject {
+    Q_OBJECT;
+
+    private slots:
+        void matchesChannelType();
+        void matchesFixedProperties();
+        void emptyMatcher();
+        void dispatchChecks();
+};
+
+void TestChannelClassMatcher::matchesChannelType() {
+
+    ChannelClassMatcher matcher(Tp::RequestableChannelClassList()
+            << channelClass(TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeContact));
+
+    QVERIFY(matcher.matchesChannelType(TP_QT_IFACE_CHANNEL_TYPE_TEXT));
+    QVERIFY(!matcher.matchesChannelType(TP_QT_IFACE_CHANNEL_TYPE_CALL));
+    QCOMPARE(matcher.classes().size(), 1);
+}
+
+void TestChannelClassMatcher::matchesFixedProperties() {
+
+    ChannelClassMatcher matcher(Tp::RequestableChannelClassList()
+            << channelClass(TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeContact)
+            << channelClass(TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeRoom));
+
+    QVERIFY(matcher.matches(TP_QT_IFACE_CHANNEL_TYPE_TEXT, 
+                channelProperties(TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeContact)));
+    QVERIFY(matcher.matches(TP_QT_IFACE_CHANNEL_TYPE_TEXT, 
+                channelProperties(TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeRoom)));
+    QVERIFY(!matcher.matches(TP_QT_IFACE_CHANNEL_TYPE_TEXT, 
+                channelProperties(TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeGroup)));
+
+    QVariantMap missing = channelProperties(TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeContact);
+    missing.remove(TARGET_HANDLE_TYPE);
+    QVERIFY(!matcher.matches(TP_QT_IFACE_CHANNEL_TYPE_TEXT, missing));
+}
+
+void TestChannelClassMatcher::emptyMatcher() {
+
+    ChannelClassMatcher matcher;
+    QVERIFY(!matcher.matchesChannelType(TP_QT_IFACE_CHANNEL_TYPE_TEXT));
+    QVERIFY(!matcher.matches(TP_QT_IFACE_CHANNEL_TYPE_TEXT, 
+                channelProperties(TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeContact)));
+    QVERIFY(matcher.channelFilter().isEmpty());
+}
+
+void TestChannelClassMatcher::dispatchChecks() {
+
+    ChannelClassMatcher matcher(Tp::RequestableChannelClassList()
+            << channelClass(TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeContact)
+            << channelClass(TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeRoom)
+            << channelClass(TP_QT_IFACE_CHANNEL_TYPE_CALL, Tp::HandleTypeContact));
+    QVariantMap text = channelProperties(TP_QT_IFACE_CHANNEL_TYPE_TEXT, Tp::HandleTypeRoom);
+    QVariantMap fileTransfer = channelProperties(TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER, Tp::HandleTypeContact);
+
+    // one iteration is one dispatch operation with a matching and a non-matching channel
+    bool matched = false;
+    QBENCHMARK {
+        matched = matcher.matches(TP_QT_IFACE_CHANNEL_TYPE_TEXT, text)
+            && !matcher.matches(TP_QT_IFACE_CHANNEL_TYPE_FILE_TRANSFER, fileTransfer);
+    }
+    QVERIFY(matched);
+}
+
+QTEST_GUILESS_MAIN(TestChannelClassMatcher)
+#include "tst_channel_class_matcher.moc"
@@ -0,0 +1,109 @@
+#include "channel_pool.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QtTest/QtTest>
+
+/**
+ * Channel which is never registered on the bus, it only stands for a piped channel
+ */
+class PoolTestChannel : public Tp::BaseChannel {
+
+    public:
+        explicit PoolTestChannel(uint handle)
+            : Tp::BaseChannel(QDBusConnection::sessionBus(), nullptr, 
+                    TP_QT_IFACE_CHANNEL_TYPE_TEXT, handle, Tp::HandleTypeContact) { }
+};
+
+class TestChannelPool : public QObject {
+    Q_OBJECT;
+
+    private slots:
+        void init();
+        void pipesMostActiveFirst();
+        void replacesLessActive();
+        void doesNotRetryFailed();
+        void dropsIdleChannels();
+
+    private:
+        PipeChannelPool::ChannelFactory factory(bool fail = false);
+
+    private:
+        QList<uint> piped;
+};
+
+PipeChannelPool::ChannelFactory TestChannelPool::factory(bool fail) {
+    return [this, fail](uint handle) {
+        piped << handle;
+        return fail ? Tp::BaseChannelPtr() : Tp::BaseChannelPtr(new PoolTestChannel(handle));
+    };
+}
+
+void TestChannelPool::init() {
+    piped.clear();
+}
+
+void TestChannelPool::pipesMostActiveFirst() {
+
+    PipeChannelPool pool(factory(), 2, 60000);
+    pool.recordActivity(1, 1);
+    pool.recordActivity(2, 5);
+    pool.recordActivity(3, 3);
+
+    // one channel per event loop iteration, the most active contacts first
+    QTRY_COMPARE(piped, QList<uint>() << 2 << 3);
+    QTest::qWait(50);
+    QCOMPARE(piped.size(), 2);
+
+    Tp::BaseChannelPtr channel = pool.take(2);
+    QVERIFY(channel);
+    QCOMPARE(channel->targetHandle(), 2u);
+    QVERIFY(!pool.take(2));
+
+    // taking a channel is no activity, the contact is still the most active one
+    QTRY_COMPARE(piped, QList<uint>() << 2 << 3 << 2);
+}
+
+void TestChannelPool::replacesLessActive() {
+
+    PipeChannelPool pool(factory(), 1, 60000);
+    pool.recordActivity(1, 1);
+    QTRY_COMPARE(piped, QList<uint>() << 1);
+
+    pool.recordActivity(2, 0.5);
+    QTest::qWait(50);
+    QCOMPARE(piped, QList<uint>() << 1);
+
+    pool.recordActivity(2, 5);
+    QTRY_COMPARE(piped, QList<uint>() << 1 << 2);
+    QVERIFY(!pool.take(1));
+    QVERIFY(pool.take(2));
+}
+
+void TestChannelPool::doesNotRetryFailed() {
+
+    PipeChannelPool pool(factory(true), 1, 60000);
+    pool.recordActivity(1, 1);
+    QTRY_COMPARE(piped, QList<uint>() << 1);
+    QTest::qWait(50);
+    QCOMPARE(piped.size(), 1);
+
+    // contact is tried again when its score grows
+    pool.recordActivity(1, 1);
+    QTRY_COMPARE(piped, QList<uint>() << 1 << 1);
+}
+
+void TestChannelPool::dropsIdleChannels() {
+
+    PipeChannelPool pool(factory(), 1, 100);
+    pool.recordActivity(1, 1);
+    QTRY_COMPARE(piped, QList<uint>() << 1);
+
+    // expiry is checked once per second at most
+    QTest::qWait(1500);
+    QVERIFY(!pool.take(1));
+    // activity which got the channel pooled is spent, so it is not piped again
+    QCOMPARE(piped.size(), 1);
+}
+
+QTEST_GUILESS_MAIN(TestChannelPool)
+#include "tst_channel_pool.moc"
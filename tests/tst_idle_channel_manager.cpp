@@ -0,0 +1,77 @@
+#include "idle_channel_manager.hpp"
+#include "message_size.hpp"
+
+#include <QtTest/QtTest>
+
+namespace {
+
+    Tp::MessagePartList textMessage(int length) {
+        Tp::MessagePart header;
+        header["message-token"] = QDBusVariant(QString("token"));
+        header["message-type"] = QDBusVariant(uint(Tp::ChannelTextMessageTypeNormal));
+        Tp::MessagePart body;
+        body["content-type"] = QDBusVariant(QString("text/plain"));
+        body["content"] = QDBusVariant(QString(length, QChar('x')));
+        return Tp::MessagePartList() << header << body;
+    }
+
+    PipeIdleChannelManager::ChannelUsage usage(size_t size, qint64 lastActivity, bool pending = false) {
+        PipeIdleChannelManager::ChannelUsage channel = { size, lastActivity, pending };
+        return channel;
+    }
+
+} /* anonymous namespace */
+
+class TestIdleChannelManager : public QObject {
+    Q_OBJECT;
+
+    private slots:
+        void messageSizeFollowsContent();
+        void selectsNothingWithinBudget();
+        void selectsLongestIdleFirst();
+        void keepsActiveAndPending();
+};
+
+void TestIdleChannelManager::messageSizeFollowsContent() {
+
+    size_t small = message_size::estimate(textMessage(10));
+    size_t large = message_size::estimate(textMessage(10000));
+    QVERIFY(small > 0);
+    // content of 9990 more UTF-16 units
+    QCOMPARE(large - small, size_t(9990 * 2));
+
+    Tp::MessagePartList withHeader = textMessage(10);
+    withHeader[0]["sender-nickname"] = QDBusVariant(QString("nickname"));
+    QVERIFY(message_size::estimate(withHeader) > small);
+
+    QCOMPARE(message_size::estimate(Tp::MessagePartListList() << textMessage(10) << textMessage(10000)) 
+            - small - large, size_t(2 * 16));
+}
+
+void TestIdleChannelManager::selectsNothingWithinBudget() {
+
+    QList<PipeIdleChannelManager::ChannelUsage> channels;
+    channels << usage(100, 0) << usage(100, 0);
+    QVERIFY(PipeIdleChannelManager::selectIdle(channels, 200, 10000, 1000).isEmpty());
+}
+
+void TestIdleChannelManager::selectsLongestIdleFirst() {
+
+    QList<PipeIdleChannelManager::ChannelUsage> channels;
+    channels << usage(100, 3000) << usage(100, 1000) << usage(100, 2000) << usage(100, 4000);
+
+    // 400 bytes with budget 250, two channels have to go, the ones idle for the longest time
+    QCOMPARE(PipeIdleChannelManager::selectIdle(channels, 250, 10000, 1000), QList<int>() << 1 << 2);
+}
+
+void TestIdleChannelManager::keepsActiveAndPending() {
+
+    QList<PipeIdleChannelManager::ChannelUsage> channels;
+    channels << usage(100, 1000, true) << usage(100, 9500) << usage(100, 2000) << usage(1000, 9500);
+
+    // channel 3 is large but active, the budget cannot be kept then
+    QCOMPARE(PipeIdleChannelManager::selectIdle(channels, 100, 10000, 1000), QList<int>() << 2);
+}
+
+QTEST_GUILESS_MAIN(TestIdleChannelManager)
+#include "tst_idle_channel_manager.moc"
@@ -0,0 +1,94 @@
+#include "message_batcher.hpp"
+#include "pipe.hpp"
+
+#include <QtTest/QtTest>
+
+/**
+ * Appends its name to "path" of message header
+ */
+class PathPlugin : public PipePlugin {
+
+    public:
+        explicit PathPlugin(const QString &pluginName) : pluginName(pluginName) { }
+
+        QString name() const override { return pluginName; }
+        Tp::RequestableChannelClassList requestableChannelClasses() const override {
+            return Tp::RequestableChannelClassList();
+        }
+        void transformIncoming(Tp::MessagePartList &message) override {
+            QString path = message[0].value("path").variant().toString();
+            message[0]["path"] = QDBusVariant(path + pluginName);
+        }
+        void transformOutgoing(Tp::MessagePartList &) override { }
+
+    private:
+        QString pluginName;
+};
+
+namespace {
+
+    Tp::MessagePartList numbered(int number) {
+        Tp::MessagePart header;
+        header["message-token"] = QDBusVariant(QString::number(number));
+        return Tp::MessagePartList() << header;
+    }
+
+    int numberOf(const Tp::MessagePartList &message) {
+        return message[0].value("message-token").variant().toString().toInt();
+    }
+
+} /* anonymous namespace */
+
+class TestMessageBatcher : public QObject {
+    Q_OBJECT;
+
+    private slots:
+        void keepsOrder();
+        void appliesPipesInOrder();
+        void growsBatchUnderLoad();
+};
+
+void TestMessageBatcher::keepsOrder() {
+
+    QList<int> received;
+    PipeMessageBatcher batcher(PipeChain(), [&received](const Tp::MessagePartList &message) {
+            received << numberOf(message);
+        });
+    for(int i = 0; i < 50; ++i) batcher.add(numbered(i));
+
+    QTRY_COMPARE(received.size(), 50);
+    for(int i = 0; i < 50; ++i) QCOMPARE(received[i], i);
+}
+
+void TestMessageBatcher::appliesPipesInOrder() {
+
+    PathPlugin first("a"), second("b");
+    PipeChain chain{std::make_shared<Pipe>(&first), std::make_shared<Pipe>(&second)};
+
+    QStringList paths;
+    PipeMessageBatcher batcher(chain, [&paths](const Tp::MessagePartList &message) {
+            paths << message[0].value("path").variant().toString();
+        });
+    batcher.add(numbered(0));
+    batcher.add(numbered(1));
+
+    QTRY_COMPARE(paths.size(), 2);
+    QCOMPARE(paths, QStringList() << "ab" << "ab");
+}
+
+void TestMessageBatcher::growsBatchUnderLoad() {
+
+    PathPlugin plugin("a");
+    int received = 0;
+    PipeMessageBatcher batcher(PipeChain{std::make_shared<Pipe>(&plugin)}, 
+            [&received](const Tp::MessagePartList&) { ++received; });
+    QCOMPARE(batcher.batchSize(), 1);
+
+    // fast pipe with full queue lets batches grow
+    for(int i = 0; i < 1000; ++i) batcher.add(numbered(i));
+    QTRY_COMPARE(received, 1000);
+    QVERIFY(batcher.batchSize() > 1);
+}
+
+QTEST_GUILESS_MAIN(TestMessageBatcher)
+#include "tst_message_batcher.moc"
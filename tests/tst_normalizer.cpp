@@ -0,0 +1,43 @@
+#include "normalizer.hpp"
+
+#include <QtTest/QtTest>
+
+class TestNormalizer : public QObject {
+    Q_OBJECT;
+
+    private slots:
+        void identifier_data();
+        void identifier();
+        void uriIdentifier();
+};
+
+void TestNormalizer::identifier_data() {
+
+    QTest::addColumn<QString>("id");
+
+    QTest::newRow("empty") << QString();
+    QTest::newRow("spaces") << QString("  \t ");
+    QTest::newRow("short") << QString(" Bob@Example.com ");
+    // long enough for every vector width, with tails of all lengths
+    QString longId = "Alice.Wonderland-ABCDEFGHIJKLMNOPQRSTUVWXYZ@Example.COM[]`{}";
+    for(int length = 15; length <= 50; ++length)
+        QTest::newRow(qPrintable(QString("ascii %1").arg(length))) << longId.left(length);
+    QTest::newRow("non ascii in tail") << QString("ABCDEFGHIJKLMNOPQRSTUVWXYZABCDEFG") + QChar(0x00C9);
+    QTest::newRow("non ascii in vector") << QString(" ") + QChar(0x0130) + QString("STANBUL@EXAMPLE.COM.TR ");
+    QTest::newRow("cyrillic") << QString::fromUtf8("Пользователь@Пример.РФ");
+}
+
+void TestNormalizer::identifier() {
+
+    QFETCH(QString, id);
+    QCOMPARE(normalizer::identifier(id), id.trimmed().toLower());
+}
+
+void TestNormalizer::uriIdentifier() {
+
+    QCOMPARE(normalizer::uriIdentifier("XMPP:Bob@Example.com "), QString("bob@example.com"));
+    QCOMPARE(normalizer::uriIdentifier("Bob@Example.com"), QString("bob@example.com"));
+}
+
+QTEST_GUILESS_MAIN(TestNormalizer)
+#include "tst_normalizer.moc"
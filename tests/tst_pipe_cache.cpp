@@ -0,0 +1,95 @@
+#include "pipe_cache.hpp"
+
+#include <TelepathyQt/Constants>
+#include <TelepathyQt/Types>
+#include <QDataStream>
+#include <QTemporaryDir>
+#include <QtTest/QtTest>
+
+namespace {
+
+    QVariantMap pipeProperties(const QString &name) {
+
+        Tp::RequestableChannelClass textClass;
+        textClass.fixedProperties[QString(TP_QT_IFACE_CHANNEL) + ".ChannelType"] = TP_QT_IFACE_CHANNEL_TYPE_TEXT;
+        textClass.fixedProperties[QString(TP_QT_IFACE_CHANNEL) + ".TargetHandleType"] = uint(Tp::HandleTypeContact);
+        textClass.allowedProperties << QString(TP_QT_IFACE_CHANNEL) + ".TargetHandle";
+
+        QVariantMap props;
+        props["name"] = name;
+        props["PassThrough"] = false;
+        props["TransformsMessages"] = true;
+        props["PeerAddress"] = QString();
+        props["RequestableChannelClasses"] = QVariant::fromValue(Tp::RequestableChannelClassList() << textClass);
+        return props;
+    }
+
+} /* anonymous namespace */
+
+class TestPipeCache : public QObject {
+    Q_OBJECT;
+
+    private slots:
+        void roundTrip();
+        void retain();
+        void ignoresOtherVersion();
+};
+
+void TestPipeCache::roundTrip() {
+
+    QTemporaryDir dir;
+    QString path = dir.path() + "/state/pipes.cache";
+
+    PipeCapabilityCache cache(path);
+    cache.update("org.freedesktop.Telepathy.Pipe.a", pipeProperties("a"));
+    QVERIFY(cache.save());
+
+    PipeCapabilityCache loaded(path);
+    loaded.load();
+    QVERIFY(loaded.contains("org.freedesktop.Telepathy.Pipe.a"));
+    QVariantMap props = loaded.properties("org.freedesktop.Telepathy.Pipe.a");
+    QCOMPARE(props.value("name").toString(), QString("a"));
+    QCOMPARE(props.value("TransformsMessages").toBool(), true);
+
+    Tp::RequestableChannelClassList classes = props.value("RequestableChannelClasses").value<Tp::RequestableChannelClassList>();
+    QCOMPARE(classes.size(), 1);
+    QCOMPARE(classes[0].fixedProperties.value(QString(TP_QT_IFACE_CHANNEL) + ".ChannelType").toString(), 
+            QString(TP_QT_IFACE_CHANNEL_TYPE_TEXT));
+    QCOMPARE(classes[0].allowedProperties, QStringList() << QString(TP_QT_IFACE_CHANNEL) + ".TargetHandle");
+}
+
+void TestPipeCache::retain() {
+
+    QTemporaryDir dir;
+    PipeCapabilityCache cache(dir.path() + "/pipes.cache");
+    cache.update("org.freedesktop.Telepathy.Pipe.a", pipeProperties("a"));
+    cache.update("org.freedesktop.Telepathy.Pipe.b", pipeProperties("b"));
+
+    cache.retain(QStringList() << "org.freedesktop.Telepathy.Pipe.b");
+    QVERIFY(!cache.contains("org.freedesktop.Telepathy.Pipe.a"));
+    QVERIFY(cache.contains("org.freedesktop.Telepathy.Pipe.b"));
+}
+
+void TestPipeCache::ignoresOtherVersion() {
+
+    QTemporaryDir dir;
+    QString path = dir.path() + "/pipes.cache";
+    {
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QDataStream out(&file);
+        out << quint32(0xffff) << QMap<QString, QVariantMap>();
+    }
+
+    PipeCapabilityCache cache(path);
+    cache.load();
+    QVERIFY(!cache.contains("org.freedesktop.Telepathy.Pipe.a"));
+
+    // missing file leaves cache empty too
+    PipeCapabilityCache missing(dir.path() + "/missing.cache");
+    missing.load();
+    QVERIFY(!missing.contains("org.freedesktop.Telepathy.Pipe.a"));
+}
+
+QTEST_GUILESS_MAIN(TestPipeCache)
+#include "tst_pipe_cache.moc"
@@ -0,0 +1,115 @@
+#include "presence_cache.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QtTest/QtTest>
+
+namespace {
+
+    Tp::SimplePresence presence(Tp::ConnectionPresenceType type, const QString &status) {
+        Tp::SimplePresence simplePresence;
+        simplePresence.type = type;
+        simplePresence.status = status;
+        return simplePresence;
+    }
+
+    Tp::SimpleContactPresences presences(int count, Tp::ConnectionPresenceType type, const QString &status) {
+        Tp::SimpleContactPresences all;
+        for(int handle = 1; handle <= count; ++handle) all[handle] = presence(type, status);
+        return all;
+    }
+
+    bool anyPiped(uint) {
+        return true;
+    }
+
+} /* anonymous namespace */
+
+class TestPresenceCache : public QObject {
+    Q_OBJECT;
+
+    private slots:
+        void batchesFetches();
+        void suppressesUnchanged();
+        void skipsContactsNotPiped();
+        void announcesRestoredPresences();
+};
+
+void TestPresenceCache::batchesFetches() {
+
+    PipePresenceCache cache;
+    Tp::UIntList handles;
+    for(uint handle = 1; handle <= 250; ++handle) handles << handle;
+
+    QList<Tp::UIntList> batches = cache.fetchBatches(handles);
+    QCOMPARE(batches.size(), 3);
+    QCOMPARE(batches[0].size(), 100);
+    QCOMPARE(batches[2].size(), 50);
+    QCOMPARE(batches[2].last(), 250u);
+    QCOMPARE(cache.counters().fetches, quint64(3));
+    QVERIFY(cache.fetchBatches(Tp::UIntList()).isEmpty());
+}
+
+void TestPresenceCache::suppressesUnchanged() {
+
+    PipePresenceCache cache;
+    QCOMPARE(cache.update(presences(200, Tp::ConnectionPresenceTypeAvailable, "available"), anyPiped).size(), 200);
+
+    // piped connection repeats whole roster when one contact changes
+    Tp::SimpleContactPresences repeated = presences(200, Tp::ConnectionPresenceTypeAvailable, "available");
+    repeated[7] = presence(Tp::ConnectionPresenceTypeAway, "away");
+    Tp::SimpleContactPresences changed = cache.update(repeated, anyPiped);
+    QCOMPARE(changed.keys(), QList<uint>() << 7);
+
+    const PresenceCounters &counters = cache.counters();
+    QCOMPARE(counters.received, quint64(400));
+    QCOMPARE(counters.suppressed, quint64(199));
+    QCOMPARE(counters.emitted, quint64(201));
+}
+
+void TestPresenceCache::skipsContactsNotPiped() {
+
+    PipePresenceCache cache;
+    Tp::SimpleContactPresences changed = cache.update(presences(10, Tp::ConnectionPresenceTypeAvailable, "available"),
+            [](uint handle) { return handle % 2 == 0; });
+    QCOMPARE(changed.size(), 5);
+    QVERIFY(!changed.contains(1));
+}
+
+void TestPresenceCache::announcesRestoredPresences() {
+
+    PipePresenceCache cache;
+    QHash<QString, Tp::SimplePresence> restored;
+    restored["alice@example.com"] = presence(Tp::ConnectionPresenceTypeAway, "away");
+    cache.restore(restored);
+
+    // handles are new after restart, presences are matched by identifiers
+    RosterDelta delta;
+    delta.identifiers[11] = "alice@example.com";
+    delta.identifiers[12] = "bob@example.com";
+    Tp::UIntList missing;
+    Tp::SimpleContactPresences known = cache.applyRoster(delta, missing);
+    QCOMPARE(known.keys(), QList<uint>() << 11);
+    QCOMPARE(known[11].status, QString("away"));
+    QCOMPARE(missing, Tp::UIntList() << 11 << 12);
+
+    // fetched presence equal to restored one is not announced again
+    Tp::SimpleContactPresences fetched;
+    fetched[11] = presence(Tp::ConnectionPresenceTypeAway, "away");
+    fetched[12] = presence(Tp::ConnectionPresenceTypeAvailable, "available");
+    QCOMPARE(cache.update(fetched, anyPiped).keys(), QList<uint>() << 12);
+
+    QHash<QString, Tp::SimplePresence> byId = cache.byIdentifier([&delta](uint handle) { 
+            return delta.identifiers.value(handle); 
+        });
+    QCOMPARE(byId.value("bob@example.com").status, QString("available"));
+
+    // removed contacts are forgotten
+    RosterDelta removal;
+    removal.removals[12] = "bob@example.com";
+    cache.applyRoster(removal, missing);
+    QVERIFY(!cache.byIdentifier([&delta](uint handle) { return delta.identifiers.value(handle); })
+            .contains("bob@example.com"));
+}
+
+QTEST_GUILESS_MAIN(TestPresenceCache)
+#include "tst_presence_cache.moc"
@@ -0,0 +1,99 @@
+#include "request_merger.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QtTest/QtTest>
+
+namespace {
+
+    const QString TEXT_TO_BOB = TP_QT_IFACE_CHANNEL_TYPE_TEXT + QString("/1/2");
+
+    /**
+     * Serves requests the way requests interface does, the first one calls upstream CreateChannel
+     * which answers after a while, identical ones made meanwhile wait for it
+     */
+    class ChannelRequests {
+
+        public:
+            explicit ChannelRequests(const QString &errorName = QString()) : errorName(errorName) { }
+
+            void request(const QString &key) {
+                bool first = merger.start(key, [this](const QString &error, const QString &) {
+                        if(error.isEmpty()) ++ensured;
+                        else ++failed;
+                    });
+                if(!first) return;
+
+                ++upstreamCalls;
+                QTimer::singleShot(50, [this, key]() {
+                        if(errorName.isEmpty()) ++created;
+                        else ++failed;
+                        merger.finish(key, errorName, "Upstream failed");
+                    });
+            }
+
+        public:
+            PipeRequestMerger merger;
+            QString errorName;
+            int upstreamCalls = 0;
+            int created = 0;
+            int ensured = 0;
+            int failed = 0;
+    };
+
+} /* anonymous namespace */
+
+class TestRequestMerger : public QObject {
+    Q_OBJECT;
+
+    private slots:
+        void concurrentRequestsCreateOnce();
+        void waitersGetError();
+        void finishedRequestIsServedAgain();
+};
+
+void TestRequestMerger::concurrentRequestsCreateOnce() {
+
+    ChannelRequests requests;
+    for(int i = 0; i < 100; ++i) 
+        QTimer::singleShot(0, [&requests]() { requests.request(TEXT_TO_BOB); });
+    QTimer::singleShot(0, [&requests]() { requests.request(TP_QT_IFACE_CHANNEL_TYPE_TEXT + QString("/1/3")); });
+
+    QTRY_COMPARE(requests.created + requests.ensured, 101);
+    QCOMPARE(requests.upstreamCalls, 2);
+    QCOMPARE(requests.created, 2);
+    QCOMPARE(requests.ensured, 99);
+    QCOMPARE(requests.failed, 0);
+    QCOMPARE(requests.merger.merged(), quint64(99));
+    QVERIFY(!requests.merger.isInFlight(TEXT_TO_BOB));
+}
+
+void TestRequestMerger::waitersGetError() {
+
+    ChannelRequests requests(TP_QT_ERROR_NOT_AVAILABLE);
+    for(int i = 0; i < 10; ++i) 
+        QTimer::singleShot(0, [&requests]() { requests.request(TEXT_TO_BOB); });
+
+    QTRY_COMPARE(requests.failed, 10);
+    QCOMPARE(requests.upstreamCalls, 1);
+    QCOMPARE(requests.ensured, 0);
+}
+
+void TestRequestMerger::finishedRequestIsServedAgain() {
+
+    PipeRequestMerger merger;
+    int waited = 0;
+    QVERIFY(merger.start(TEXT_TO_BOB, PipeRequestMerger::Waiter()));
+    QVERIFY(!merger.start(TEXT_TO_BOB, [&merger, &waited](const QString &, const QString &) {
+                ++waited;
+                // request made by a waiter is not merged with the finished one
+                QVERIFY(merger.start(TEXT_TO_BOB, PipeRequestMerger::Waiter()));
+            }));
+    merger.finish(TEXT_TO_BOB);
+    QCOMPARE(waited, 1);
+    QVERIFY(merger.isInFlight(TEXT_TO_BOB));
+    merger.finish(TEXT_TO_BOB);
+    QVERIFY(!merger.isInFlight(TEXT_TO_BOB));
+}
+
+QTEST_GUILESS_MAIN(TestRequestMerger)
+#include "tst_request_merger.moc"
@@ -0,0 +1,165 @@
+#include "connection.hpp"
+#include "bench_services.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QDBusConnection>
+#include <QDBusObjectPath>
+#include <QDBusPendingCall>
+#include <QTemporaryDir>
+#include <QtTest/QtTest>
+
+namespace {
+
+    const uint CONTACTS = 10;
+
+    QVariantMap textChannelRequest() {
+        QVariantMap request;
+        request[TP_QT_IFACE_CHANNEL + QString(".ChannelType")] = TP_QT_IFACE_CHANNEL_TYPE_TEXT;
+        request[TP_QT_IFACE_CHANNEL + QString(".TargetHandleType")] = uint(Tp::HandleTypeContact);
+        return request;
+    }
+
+    QVariantMap textChannelRequest(uint handle) {
+        QVariantMap request = textChannelRequest();
+        request[TP_QT_IFACE_CHANNEL + QString(".TargetHandle")] = handle;
+        return request;
+    }
+
+    QDBusPendingCall requestChannel(const PipeConnectionPtr &connection, const QString &method,
+            const QVariantMap &request)
+    {
+        QDBusMessage call = QDBusMessage::createMethodCall(connection->busName(), connection->objectPath(),
+                TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS, method);
+        call << request;
+        return QDBusConnection::sessionBus().asyncCall(call);
+    }
+
+    bool waitForReplies(const QList<QDBusPendingCall> &calls) {
+        return waitFor([&calls]() {
+                for(const QDBusPendingCall &call: calls) if(!call.isFinished()) return false;
+                return true;
+            });
+    }
+
+} /* anonymous namespace */
+
+/**
+ * Requests interface of pipes connection to fake account, requests are made on the bus as clients
+ * make them
+ */
+class TestRequestsInterface : public QObject {
+    Q_OBJECT;
+
+    private slots:
+        void initTestCase();
+        void cleanupTestCase();
+        void concurrentEnsuresCreateOnce();
+        void createIsNotMerged();
+        void targetIdIsResolved();
+        void targetIdWithHandleIsRejected();
+
+    private:
+        /**
+         * @return number of channels created by piped connection
+         */
+        int upstreamCreated();
+
+    private:
+        QTemporaryDir home;
+        FakeServices services;
+        PipeChain pipes;
+        PipeConnectionPtr connection;
+        QString pipedPath;
+};
+
+void TestRequestsInterface::initTestCase() {
+
+    if(!QDBusConnection::sessionBus().isConnected()) QSKIP("No session bus");
+    registerBenchTypes();
+    qputenv("HOME", home.path().toLocal8Bit());
+
+    services.startServices();
+    pipes = PipeChain { std::make_shared<Pipe>(FakeServices::pipeService(), FakeServices::pipePath(),
+            QDBusConnection::sessionBus()) };
+    connection = pipeAccount(services, pipes, "requests", CONTACTS);
+    QVERIFY(connection);
+    pipedPath = connection->getPipedConnection()->objectPath();
+}
+
+void TestRequestsInterface::cleanupTestCase() {
+    connection.reset();
+    if(services.isRunning()) services.stopServices();
+}
+
+int TestRequestsInterface::upstreamCreated() {
+    int created = 0;
+    services.invoke([this, &created]() {
+            FakeConnectionPtr fakeConnection = services.connection(pipedPath);
+            if(fakeConnection) created = fakeConnection->createdChannels();
+        });
+    return created;
+}
+
+void TestRequestsInterface::concurrentEnsuresCreateOnce() {
+
+    int created = upstreamCreated();
+    QList<QDBusPendingCall> calls;
+    for(int i = 0; i < 100; ++i) calls << requestChannel(connection, "EnsureChannel", textChannelRequest(1));
+    QVERIFY(waitForReplies(calls));
+
+    int yours = 0;
+    QSet<QString> paths;
+    for(const QDBusPendingCall &call: calls) {
+        QDBusMessage reply = call.reply();
+        QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+        if(reply.arguments().at(0).toBool()) ++yours;
+        paths.insert(qdbus_cast<QDBusObjectPath>(reply.arguments().at(1)).path());
+    }
+    QCOMPARE(yours, 1);
+    QCOMPARE(paths.size(), 1);
+    QCOMPARE(upstreamCreated(), created + 1);
+}
+
+void TestRequestsInterface::createIsNotMerged() {
+
+    QList<QDBusPendingCall> calls;
+    calls << requestChannel(connection, "EnsureChannel", textChannelRequest(2));
+    calls << requestChannel(connection, "CreateChannel", textChannelRequest(2));
+    QVERIFY(waitForReplies(calls));
+
+    QCOMPARE(calls[0].reply().type(), QDBusMessage::ReplyMessage);
+    QCOMPARE(calls[1].reply().type(), QDBusMessage::ErrorMessage);
+    QCOMPARE(calls[1].reply().errorName(), QString(TP_QT_ERROR_NOT_AVAILABLE));
+}
+
+void TestRequestsInterface::targetIdIsResolved() {
+
+    QVariantMap request = textChannelRequest();
+    request[TP_QT_IFACE_CHANNEL + QString(".TargetID")] = FakeServices::contactId(3);
+    QDBusMessage reply = callConnection(connection, TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS, "EnsureChannel",
+            QVariantList() << request);
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    QVariantMap properties = qdbus_cast<QVariantMap>(reply.arguments().at(2));
+    QCOMPARE(properties.value(TP_QT_IFACE_CHANNEL + QString(".TargetHandle")).toUInt(), 3u);
+
+    // the same channel requested by handle is not created again
+    int created = upstreamCreated();
+    reply = callConnection(connection, TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS, "EnsureChannel",
+            QVariantList() << textChannelRequest(3));
+    QCOMPARE(reply.type(), QDBusMessage::ReplyMessage);
+    QVERIFY(!reply.arguments().at(0).toBool());
+    QCOMPARE(upstreamCreated(), created);
+}
+
+void TestRequestsInterface::targetIdWithHandleIsRejected() {
+
+    QVariantMap request = textChannelRequest(4);
+    request[TP_QT_IFACE_CHANNEL + QString(".TargetID")] = FakeServices::contactId(4);
+    QDBusMessage reply = callConnection(connection, TP_QT_IFACE_CONNECTION_INTERFACE_REQUESTS, "EnsureChannel",
+            QVariantList() << request);
+    QCOMPARE(reply.type(), QDBusMessage::ErrorMessage);
+    QCOMPARE(reply.errorName(), QString(TP_QT_ERROR_INVALID_ARGUMENT));
+}
+
+QTEST_GUILESS_MAIN(TestRequestsInterface)
+#include "tst_requests_interface.moc"
@@ -0,0 +1,255 @@
+#include "roster_index.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QtTest/QtTest>
+
+namespace {
+
+    QVariantMap contact(const QString &id) {
+        QVariantMap attrs;
+        attrs[QString(TP_QT_IFACE_CONNECTION) + "/contact-id"] = id;
+        attrs[QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/subscribe"] = uint(Tp::SubscriptionStateYes);
+        attrs[QString(TP_QT_IFACE_CONNECTION_INTERFACE_CONTACT_LIST) + "/publish"] = uint(Tp::SubscriptionStateYes);
+        return attrs;
+    }
+
+    Tp::ContactAttributesMap roster() {
+        Tp::ContactAttributesMap attributes;
+        attributes[1] = contact("alice@example.com");
+        attributes[2] = contact("bob@example.com");
+        attributes[3] = contact("carol@example.com");
+        return attributes;
+    }
+
+} /* anonymous namespace */
+
+class TestRosterIndex : public QObject {
+    Q_OBJECT;
+
+    private slots:
+        void lookups();
+        void piping();
+        void renameDropsOldIdentifier();
+        void reconcileReportsNewHandles();
+        void reconcileSwapsHandles();
+        void snapshotKeepsPlainAttributes();
+        void addressesAreExactFirst();
+        void resyncKeepsAttributes();
+        void snapshotsAreNotModified();
+};
+
+void TestRosterIndex::lookups() {
+
+    PipeRosterIndex index;
+    index.setAttributes(roster());
+
+    QCOMPARE(index.getHandlesFor(QStringList() << "bob@example.com" << "alice@example.com"),
+            Tp::UIntList() << 2 << 1);
+    QVERIFY_EXCEPTION_THROWN(index.getHandlesFor(QStringList() << "Carol@Example.com"), ContactListExeption);
+    QCOMPARE(index.getHandlesFor(QStringList() << "bob@example.com" << " Carol@Example.com", RosterLookup::NORMALIZED),
+            Tp::UIntList() << 2 << 3);
+    QCOMPARE(index.getIdentifiersFor(Tp::UIntList() << 3), QStringList() << "carol@example.com");
+    QVERIFY_EXCEPTION_THROWN(index.getHandlesFor(QStringList() << "dave@example.com"), ContactListExeption);
+    QVERIFY_EXCEPTION_THROWN(index.getIdentifiersFor(Tp::UIntList() << 4), ContactListExeption);
+}
+
+void TestRosterIndex::piping() {
+
+    PipeRosterIndex index;
+    index.setAttributes(roster());
+    QStringList missing = index.setPipedContacts(QSet<QString>() << "alice@example.com" << "dave@example.com");
+    QCOMPARE(missing, QStringList() << "dave@example.com");
+    QVERIFY(index.hasHandle(1));
+    QVERIFY(!index.hasHandle(2));
+
+    RosterDelta added = index.addToList(Tp::UIntList() << 2);
+    QCOMPARE(added.identifiers.value(2), QString("bob@example.com"));
+    QVERIFY(index.hasHandle(2));
+
+    RosterDelta removed = index.remove(Tp::UIntList() << 1);
+    QCOMPARE(removed.removals.value(1), QString("alice@example.com"));
+    QVERIFY(!index.hasHandle(1));
+    QVERIFY_EXCEPTION_THROWN(index.remove(Tp::UIntList() << 3), ContactListExeption);
+}
+
+void TestRosterIndex::renameDropsOldIdentifier() {
+
+    PipeRosterIndex index;
+    index.setAttributes(roster());
+    index.setPipedContacts(QSet<QString>() << "bob@example.com");
+
+    Tp::ContactSubscriptions subs;
+    subs.subscribe = Tp::SubscriptionStateYes;
+    subs.publish = Tp::SubscriptionStateYes;
+    Tp::ContactSubscriptionMap changes;
+    changes[2] = subs;
+    Tp::HandleIdentifierMap identifiers;
+    identifiers[2] = "robert@example.com";
+
+    RosterDelta delta = index.applyChanges(changes, identifiers, Tp::HandleIdentifierMap());
+    QCOMPARE(delta.identifiers.value(2), QString("robert@example.com"));
+    QVERIFY(index.hasHandle(2));
+    QVERIFY(index.hasIdentifier("robert@example.com"));
+    QVERIFY(!index.hasIdentifier("bob@example.com"));
+    QCOMPARE(index.getHandlesFor(QStringList() << "robert@example.com"), Tp::UIntList() << 2);
+    QVERIFY_EXCEPTION_THROWN(index.getHandlesFor(QStringList() << "bob@example.com"), ContactListExeption);
+    QVERIFY_EXCEPTION_THROWN(index.getHandlesFor(QStringList() << "BOB@example.com"), ContactListExeption);
+}
+
+void TestRosterIndex::reconcileReportsNewHandles() {
+
+    PipeRosterIndex index;
+    index.setAttributes(roster());
+    index.setPipedContacts(QSet<QString>() << "alice@example.com" << "bob@example.com");
+
+    // piped connection restarted and gave alice a new handle, bob is gone
+    Tp::ContactAttributesMap restarted;
+    restarted[7] = contact("alice@example.com");
+    restarted[3] = contact("carol@example.com");
+
+    RosterDelta delta = index.reconcile(restarted, index.pipedContacts());
+    QCOMPARE(delta.removals.value(1), QString("alice@example.com"));
+    QCOMPARE(delta.removals.value(2), QString("bob@example.com"));
+    QCOMPARE(delta.identifiers.value(7), QString("alice@example.com"));
+    QVERIFY(index.hasHandle(7));
+}
+
+void TestRosterIndex::reconcileSwapsHandles() {
+
+    PipeRosterIndex index;
+    index.setAttributes(roster());
+    index.setPipedContacts(QSet<QString>() << "alice@example.com" << "bob@example.com");
+
+    // alice and bob swapped their handles, carol kept hers
+    Tp::ContactAttributesMap restarted;
+    restarted[1] = contact("bob@example.com");
+    restarted[2] = contact("alice@example.com");
+    restarted[3] = contact("carol@example.com");
+
+    RosterDelta delta = index.reconcile(restarted, index.pipedContacts());
+    QVERIFY(delta.removals.isEmpty());
+    QCOMPARE(delta.identifiers.value(1), QString("bob@example.com"));
+    QCOMPARE(delta.identifiers.value(2), QString("alice@example.com"));
+    QVERIFY(delta.changes.contains(1) && delta.changes.contains(2));
+    QCOMPARE(index.getHandlesFor(QStringList() << "alice@example.com" << "bob@example.com"), Tp::UIntList() << 2 << 1);
+}
+
+void TestRosterIndex::snapshotKeepsPlainAttributes() {
+
+    Tp::StringStringMap addresses;
+    addresses["x-jabber"] = "alice@example.com";
+    Tp::SimplePresence presence;
+    presence.type = Tp::ConnectionPresenceTypeAvailable;
+    presence.status = "available";
+
+    Tp::ContactAttributesMap attributes = roster();
+    attributes[1][QString(TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING) + "/addresses"] = QVariant::fromValue(addresses);
+    attributes[1][QString(TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE) + "/presence"] = QVariant::fromValue(presence);
+
+    PipeRosterIndex index;
+    index.setAttributes(attributes);
+    index.setPipedContacts(QSet<QString>() << "alice@example.com");
+
+    QByteArray data;
+    {
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out << index;
+    }
+    PipeRosterIndex restored;
+    QDataStream in(data);
+    in >> restored;
+    QCOMPARE(in.status(), QDataStream::Ok);
+
+    QVERIFY(restored.hasHandle(1));
+    QCOMPARE(restored.resolveVCardAddress("x-jabber", "alice@example.com"), 1u);
+    QVariantMap alice = restored.getContactAttributes(Tp::UIntList() << 1).value(1);
+    QCOMPARE(alice.value(QString(TP_QT_IFACE_CONNECTION) + "/contact-id").toString(), QString("alice@example.com"));
+    QCOMPARE(qdbus_cast<Tp::StringStringMap>(alice.value(QString(TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING) + "/addresses")), 
+            addresses);
+    // structures are fetched again by reconciliation
+    QVERIFY(!alice.contains(QString(TP_QT_IFACE_CONNECTION_INTERFACE_SIMPLE_PRESENCE) + "/presence"));
+}
+
+void TestRosterIndex::addressesAreExactFirst() {
+
+    Tp::ContactAttributesMap attributes = roster();
+    attributes[1][QString(TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING) + "/uris"] = QStringList() << "xmpp:alice@example.com";
+    Tp::StringStringMap addresses;
+    addresses["x-jabber"] = "alice@example.com";
+    attributes[1][QString(TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING) + "/addresses"] = QVariant::fromValue(addresses);
+
+    PipeRosterIndex index;
+    index.setAttributes(attributes);
+    index.setPipedContacts(QSet<QString>() << "alice@example.com" << "bob@example.com");
+
+    QCOMPARE(index.resolveURI("xmpp:alice@example.com"), 1u);
+    QCOMPARE(index.resolveURI("xmpp:bob@example.com"), 2u);
+    QCOMPARE(index.resolveVCardAddress("X-JABBER", "alice@example.com"), 1u);
+
+    // letter case is left to piped connection, roster ignores it only when asked to
+    QCOMPARE(index.resolveURI("XMPP:Alice@Example.com"), 0u);
+    QCOMPARE(index.resolveURI("XMPP:Alice@Example.com", RosterLookup::NORMALIZED), 1u);
+    QCOMPARE(index.resolveVCardAddress("x-jabber", "Alice@Example.com"), 0u);
+    QCOMPARE(index.resolveVCardAddress("x-jabber", "Alice@Example.com", RosterLookup::NORMALIZED), 1u);
+
+    // contacts which are not piped are not resolved
+    QCOMPARE(index.resolveURI("xmpp:carol@example.com"), 0u);
+}
+
+void TestRosterIndex::resyncKeepsAttributes() {
+
+    Tp::ContactAttributesMap attributes = roster();
+    Tp::StringStringMap addresses;
+    addresses["x-jabber"] = "alice@example.com";
+    attributes[1][QString(TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING) + "/addresses"] = QVariant::fromValue(addresses);
+
+    PipeRosterIndex index;
+    index.setAttributes(attributes);
+    index.setPipedContacts(QSet<QString>() << "alice@example.com" << "bob@example.com" << "carol@example.com");
+
+    // piped list was reloaded: alice got a new handle, bob kept his one and carol is gone
+    Tp::ContactAttributesMap identities;
+    identities[7] = contact("alice@example.com");
+    identities[2] = contact("bob@example.com");
+
+    RosterDelta delta = index.resync(identities);
+    QCOMPARE(delta.removals.value(1), QString("alice@example.com"));
+    QCOMPARE(delta.removals.value(3), QString("carol@example.com"));
+    QCOMPARE(delta.identifiers.value(7), QString("alice@example.com"));
+    QVERIFY(!delta.identifiers.contains(2));
+    QVERIFY(!delta.removals.contains(2));
+
+    QCOMPARE(index.getHandlesFor(QStringList() << "alice@example.com" << "bob@example.com"), Tp::UIntList() << 7 << 2);
+    QVERIFY(!index.hasIdentifier("carol@example.com"));
+    // only identities were fetched, addresses are carried over to the new handle
+    QCOMPARE(index.resolveVCardAddress("x-jabber", "alice@example.com"), 7u);
+    QVariantMap alice = index.getContactAttributes(Tp::UIntList() << 7).value(7);
+    QCOMPARE(qdbus_cast<Tp::StringStringMap>(alice.value(QString(TP_QT_IFACE_CONNECTION_INTERFACE_ADDRESSING) + "/addresses")),
+            addresses);
+}
+
+void TestRosterIndex::snapshotsAreNotModified() {
+
+    std::shared_ptr<PipeRosterIndex> first = std::make_shared<PipeRosterIndex>();
+    first->setAttributes(roster());
+    first->setPipedContacts(QSet<QString>() << "alice@example.com");
+    PipeRosterSnapshot published(first);
+    first.reset();
+
+    // writers modify a copy and publish it, readers keep the snapshot they loaded
+    PipeRosterIndex next(*published);
+    next.addToList(Tp::UIntList() << 2);
+    next.remove(Tp::UIntList() << 1);
+    QVERIFY(published->hasHandle(1));
+    QVERIFY(!published->hasHandle(2));
+    QCOMPARE(published->pipedContacts(), QSet<QString>() << "alice@example.com");
+    QCOMPARE(next.pipedHandles(), Tp::UIntList() << 2);
+
+    // failed modification leaves published snapshot as it was
+    PipeRosterIndex failed(*published);
+    QVERIFY_EXCEPTION_THROWN(failed.remove(Tp::UIntList() << 3), ContactListExeption);
+    QCOMPARE(published->getHandlesFor(QStringList() << "alice@example.com"), Tp::UIntList() << 1);
+}
+
+QTEST_GUILESS_MAIN(TestRosterIndex)
+#include "tst_roster_index.moc"
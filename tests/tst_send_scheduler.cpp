@@ -0,0 +1,101 @@
+#include "send_scheduler.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QDBusMessage>
+#include <QDBusPendingReply>
+#include <QtTest/QtTest>
+
+namespace {
+
+    /**
+     * Records order in which messages are sent, piped channel accepts them at once
+     */
+    class SentLog {
+
+        public:
+            PipeSendScheduler::SendFunction sender(const QString &message) {
+                return [this, message]() -> QDBusPendingCall {
+                    order.append(message);
+                    QDBusMessage call = QDBusMessage::createMethodCall(
+                            "org.freedesktop.Telepathy.Test", "/", TP_QT_IFACE_CHANNEL_INTERFACE_MESSAGES, "SendMessage");
+                    return QDBusPendingCall::fromCompletedCall(call.createReply(message));
+                };
+            }
+
+            PipeSendScheduler::SentFunction receiver() {
+                return [this](const QDBusPendingCall &reply) {
+                    QDBusPendingReply<QString> tokenRep = reply;
+                    if(tokenRep.isValid()) sent.append(tokenRep.value());
+                    else failed.append(tokenRep.error().name());
+                };
+            }
+
+        public:
+            QStringList order;
+            QStringList sent;
+            QStringList failed;
+    };
+
+} /* anonymous namespace */
+
+class TestSendScheduler : public QObject {
+    Q_OBJECT;
+
+    private slots:
+        void interactiveChannelIsNotStarved();
+        void bulkRateIsCapped();
+        void queuedMessagesFailWithScheduler();
+};
+
+void TestSendScheduler::interactiveChannelIsNotStarved() {
+
+    PipeSendScheduler scheduler(4, 1, 0);
+    SentLog log;
+    QString bulk("/bulk"), interactive("/interactive");
+    for(int i = 0; i < 40; ++i) 
+        scheduler.send(bulk, log.sender("bulk" + QString::number(i)), log.receiver());
+    for(int i = 0; i < 5; ++i) 
+        scheduler.send(interactive, log.sender("interactive" + QString::number(i)), log.receiver());
+
+    QTRY_COMPARE(log.sent.size(), 45);
+    // first in first out would send them after all bulk messages
+    int lastInteractive = log.order.indexOf("interactive4");
+    QVERIFY2(lastInteractive < 12, qPrintable(log.order.join(',')));
+    // each channel keeps its own order
+    QVERIFY(log.order.indexOf("interactive0") < log.order.indexOf("interactive1"));
+    QVERIFY(log.order.indexOf("bulk38") < log.order.indexOf("bulk39"));
+    QVERIFY(log.failed.isEmpty());
+}
+
+void TestSendScheduler::bulkRateIsCapped() {
+
+    PipeSendScheduler scheduler(4, 1, 10);
+    SentLog log;
+    QString bulk("/bulk");
+    QElapsedTimer timer;
+    timer.start();
+    for(int i = 0; i < 20; ++i) 
+        scheduler.send(bulk, log.sender("bulk" + QString::number(i)), log.receiver());
+
+    // three messages before the channel is bulk and ten tokens are sent at once, the rest at ten per second
+    QTRY_COMPARE_WITH_TIMEOUT(log.sent.size(), 20, 5000);
+    QVERIFY2(timer.elapsed() >= 500, qPrintable(QString::number(timer.elapsed())));
+}
+
+void TestSendScheduler::queuedMessagesFailWithScheduler() {
+
+    SentLog log;
+    {
+        PipeSendScheduler scheduler(4, 1, 1);
+        QString bulk("/bulk");
+        for(int i = 0; i < 10; ++i) 
+            scheduler.send(bulk, log.sender("bulk" + QString::number(i)), log.receiver());
+    }
+
+    QCOMPARE(log.sent.size() + log.failed.size(), 10);
+    QVERIFY(!log.failed.isEmpty());
+    QCOMPARE(log.failed.first(), QString(TP_QT_ERROR_DISCONNECTED));
+}
+
+QTEST_GUILESS_MAIN(TestSendScheduler)
+#include "tst_send_scheduler.moc"
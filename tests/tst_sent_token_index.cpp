@@ -0,0 +1,45 @@
+#include "sent_token_index.hpp"
+
+#include <TelepathyQt/Constants>
+#include <QtTest/QtTest>
+
+class TestSentTokenIndex : public QObject {
+    Q_OBJECT;
+
+    private slots:
+        void matchesReports();
+        void dropsOldestTokens();
+};
+
+void TestSentTokenIndex::matchesReports() {
+
+    PipeSentTokenIndex index;
+    index.add("a");
+    index.add("b");
+
+    QCOMPARE(index.report("a", Tp::DeliveryStatusDelivered), DeliveryReportMatch::NEW_STATUS);
+    QCOMPARE(index.report("a", Tp::DeliveryStatusDelivered), DeliveryReportMatch::REPEATED);
+    QCOMPARE(index.report("a", Tp::DeliveryStatusRead), DeliveryReportMatch::NEW_STATUS);
+    QCOMPARE(index.report("c", Tp::DeliveryStatusDelivered), DeliveryReportMatch::UNKNOWN);
+
+    const DeliveryReportStats &stats = index.stats();
+    QCOMPARE(stats.reports, quint64(4));
+    QCOMPARE(stats.repeated, quint64(1));
+    QCOMPARE(stats.unmatched, quint64(1));
+    QVERIFY(stats.maxLag >= 0);
+}
+
+void TestSentTokenIndex::dropsOldestTokens() {
+
+    PipeSentTokenIndex index(2);
+    index.add("a");
+    index.add("b");
+    index.add("c");
+
+    QCOMPARE(index.report("a", Tp::DeliveryStatusDelivered), DeliveryReportMatch::UNKNOWN);
+    QCOMPARE(index.report("b", Tp::DeliveryStatusDelivered), DeliveryReportMatch::NEW_STATUS);
+    QCOMPARE(index.report("c", Tp::DeliveryStatusDelivered), DeliveryReportMatch::NEW_STATUS);
+}
+
+QTEST_GUILESS_MAIN(TestSentTokenIndex)
+#include "tst_sent_token_index.moc"
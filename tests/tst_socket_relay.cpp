@@ -0,0 +1,115 @@
+#include "socket_relay.hpp"
+#include "socket_forwarder.hpp"
+
+#include <QTemporaryDir>
+#include <QtTest/QtTest>
+#include <cstring>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+    QByteArray readAll(int fd) {
+        QByteArray data;
+        char buffer[4096];
+        ssize_t got;
+        while((got = read(fd, buffer, sizeof(buffer))) > 0) data.append(buffer, got);
+        return data;
+    }
+
+    int connectTo(const QByteArray &path) {
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        std::memcpy(address.sun_path, path.constData(), path.size());
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+} /* anonymous namespace */
+
+class TestSocketRelay : public QObject {
+    Q_OBJECT;
+
+    private slots:
+        void relaysBothDirections();
+        void forwardsConnections();
+};
+
+void TestSocketRelay::relaysBothDirections() {
+
+    int client[2], server[2];
+    QVERIFY(socketpair(AF_UNIX, SOCK_STREAM, 0, client) == 0);
+    QVERIFY(socketpair(AF_UNIX, SOCK_STREAM, 0, server) == 0);
+
+    PipeSocketRelay relay;
+    relay.relay(client[1], server[0]);
+    QCOMPARE(relay.activeRelays(), size_t(1));
+
+    // more than fits into one pipe, so the relay has to wait for writability
+    QByteArray upload(1 << 20, 'u');
+    QByteArray download("reply");
+    QVERIFY(write(server[1], download.constData(), download.size()) == download.size());
+    shutdown(server[1], SHUT_WR);
+
+    ssize_t written = 0;
+    QByteArray received;
+    std::thread reader([&received, &server]() { received = readAll(server[1]); });
+    while(written < upload.size()) {
+        ssize_t chunk = write(client[0], upload.constData() + written, upload.size() - written);
+        if(chunk <= 0) break;
+        written += chunk;
+    }
+    shutdown(client[0], SHUT_WR);
+    reader.join();
+
+    QCOMPARE(written, ssize_t(upload.size()));
+
+    QCOMPARE(received, upload);
+    QCOMPARE(readAll(client[0]), download);
+    QTRY_COMPARE(relay.activeRelays(), size_t(0));
+    close(client[0]);
+    close(server[1]);
+}
+
+void TestSocketRelay::forwardsConnections() {
+
+    QTemporaryDir dir;
+    QByteArray targetPath = QFile::encodeName(dir.path() + "/target");
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, targetPath.constData(), targetPath.size());
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    QVERIFY(bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0);
+    QVERIFY(listen(listenFd, 4) == 0);
+
+    QByteArray forwarderPath;
+    {
+        PipeSocketForwarder forwarder(targetPath);
+        forwarderPath = forwarder.path();
+        int clientFd = connectTo(forwarderPath);
+        QVERIFY(clientFd != -1);
+        QTRY_COMPARE(forwarder.forwarded(), uint(1));
+
+        int targetFd = accept(listenFd, nullptr, nullptr);
+        QVERIFY(targetFd != -1);
+        QVERIFY(write(clientFd, "file", 4) == 4);
+        shutdown(clientFd, SHUT_WR);
+        QCOMPARE(readAll(targetFd), QByteArray("file"));
+        close(targetFd);
+        close(clientFd);
+    }
+    // socket of forwarder is removed with it
+    QVERIFY(!QFile::exists(QFile::decodeName(forwarderPath)));
+    close(listenFd);
+}
+
+QTEST_GUILESS_MAIN(TestSocketRelay)
+#include "tst_socket_relay.moc"